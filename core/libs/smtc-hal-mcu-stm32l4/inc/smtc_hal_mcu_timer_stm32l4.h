@@ -46,12 +46,18 @@ extern "C" {
 
 #include <stdint.h>
 #include "stm32l4xx.h"
+#include "smtc_hal_mcu_timer.h"
 
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC MACROS -----------------------------------------------------------
  */
 
+/**
+ * @brief Frequency of the LPTIM counter, clocked by the LSI without prescaler
+ */
+#define SMTC_HAL_MCU_TIMER_STM32L4_TICKS_PER_S 32000
+
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC CONSTANTS --------------------------------------------------------
@@ -74,6 +80,18 @@ struct smtc_hal_mcu_timer_cfg_s
  * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
  */
 
+/**
+ * @brief Get the time elapsed since the timer was initialised, in ticks of the LPTIM counter
+ *
+ * @remark LPTIM1 and LPTIM2 are supported, only LPTIM1 keeps counting in STOP2. The 16-bit counter runs freely and
+ * is extended to 64 bits by counting its wrap-arounds, so the time never wraps around.
+ *
+ * @param [in] inst Timer instance
+ *
+ * @returns Monotonic time, see @ref SMTC_HAL_MCU_TIMER_STM32L4_TICKS_PER_S
+ */
+uint64_t smtc_hal_mcu_timer_stm32l4_get_ticks( smtc_hal_mcu_timer_inst_t inst );
+
 #ifdef __cplusplus
 }
 #endif
@@ -56,9 +56,26 @@
  * @brief Maximum number of timer instances
  */
 #ifndef SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX
-#define SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX 1
+#define SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX 2
 #endif
 
+/**
+ * @brief Range of the LPTIM counter, it wraps around every 2^16 ticks
+ */
+#define SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX 0xFFFF
+#define SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_BITS 16
+
+/**
+ * @brief Highest compare value, the compare register has to stay below the auto-reload one (RM0351)
+ */
+#define SMTC_HAL_MCU_TIMER_STM32L4_COMPARE_MAX ( SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX - 1 )
+
+/**
+ * @brief Conversion of milliseconds to ticks of the counter
+ */
+#define SMTC_HAL_MCU_TIMER_STM32L4_MS_TO_TICKS( ms ) \
+    ( ( ( uint64_t )( ms ) * SMTC_HAL_MCU_TIMER_STM32L4_TICKS_PER_S ) / 1000 )
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE CONSTANTS -------------------------------------------------------
@@ -74,10 +91,14 @@
  */
 struct smtc_hal_mcu_timer_inst_s
 {
-    bool           is_cfged;
-    LPTIM_TypeDef* tim;
-    uint32_t       max_value;
+    bool              is_cfged;
+    LPTIM_TypeDef*    tim;
+    IRQn_Type         irq;
+    uint32_t          max_value;
     void ( *callback_expiry )( void );
+    volatile uint64_t n_laps;             // Number of times the counter wrapped around, upper bits of the time
+    volatile bool     is_armed;           // The expiry callback is due at deadline_in_ticks
+    uint64_t          deadline_in_ticks;  // Time at which the timer expires
 };
 
 /*
@@ -122,6 +143,32 @@ static struct smtc_hal_mcu_timer_inst_s* smtc_hal_mcu_timer_stm32l4_get_free_slo
  */
 static bool smtc_hal_mcu_timer_stm32l4_is_real_inst( smtc_hal_mcu_timer_inst_t inst );
 
+/**
+ * @brief Read the LPTIM counter, which runs asynchronously to the CPU: two successive reads have to match
+ *
+ * @param [in] tim LPTIM peripheral
+ *
+ * @returns Counter value
+ */
+static uint32_t smtc_hal_mcu_timer_stm32l4_read_counter( LPTIM_TypeDef* tim );
+
+/**
+ * @brief Program the compare register if the deadline falls in the current lap of the counter
+ *
+ * @remark If the deadline has passed, or passes while the register is written, the interrupt is pended so
+ * that the expiry callback always runs from the interrupt handler of the LPTIM.
+ *
+ * @param [in] inst Timer instance
+ */
+static void smtc_hal_mcu_timer_stm32l4_arm_compare( smtc_hal_mcu_timer_inst_t inst );
+
+/**
+ * @brief Count the wrap-arounds and raise the expiry of the timer instance running on an LPTIM
+ *
+ * @param [in] tim LPTIM peripheral which raised the interrupt
+ */
+static void smtc_hal_mcu_timer_stm32l4_irq_handler( LPTIM_TypeDef* tim );
+
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
@@ -145,12 +192,14 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_init( const smtc_hal_mcu_timer_cfg_t
 
     tim_cfg_slot->is_cfged        = false;
     tim_cfg_slot->tim             = cfg->tim;
-    tim_cfg_slot->max_value       = 0xFFFF;
+    tim_cfg_slot->max_value       = UINT32_MAX;
     tim_cfg_slot->callback_expiry = cfg_app->expiry_func;
+    tim_cfg_slot->n_laps          = 0;
+    tim_cfg_slot->is_armed        = false;
 
     const LL_LPTIM_InitTypeDef LPTIM_InitStruct = {
         .ClockSource = LL_LPTIM_CLK_SOURCE_INTERNAL,
-        .Prescaler   = LL_LPTIM_PRESCALER_DIV32,
+        .Prescaler   = LL_LPTIM_PRESCALER_DIV1,
         .Waveform    = LL_LPTIM_OUTPUT_WAVEFORM_PWM,
         .Polarity    = LL_LPTIM_OUTPUT_POLARITY_REGULAR,
     };
@@ -159,19 +208,32 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_init( const smtc_hal_mcu_timer_cfg_t
     {
         LL_RCC_SetLPTIMClockSource( LL_RCC_LPTIM1_CLKSOURCE_LSI );
 
-        NVIC_SetPriority( LPTIM1_IRQn, 0 );
-        NVIC_EnableIRQ( LPTIM1_IRQn );
+        tim_cfg_slot->irq = LPTIM1_IRQn;
 
         LL_APB1_GRP1_EnableClock( LL_APB1_GRP1_PERIPH_LPTIM1 );
         while( LL_APB1_GRP1_IsEnabledClock( LL_APB1_GRP1_PERIPH_LPTIM1 ) != 1 )
         {
         }
     }
+    else if( tim_cfg_slot->tim == LPTIM2 )
+    {
+        LL_RCC_SetLPTIMClockSource( LL_RCC_LPTIM2_CLKSOURCE_LSI );
+
+        tim_cfg_slot->irq = LPTIM2_IRQn;
+
+        LL_APB1_GRP2_EnableClock( LL_APB1_GRP2_PERIPH_LPTIM2 );
+        while( LL_APB1_GRP2_IsEnabledClock( LL_APB1_GRP2_PERIPH_LPTIM2 ) != 1 )
+        {
+        }
+    }
     else
     {
         return SMTC_HAL_MCU_STATUS_BAD_PARAMETERS;
     }
 
+    NVIC_SetPriority( tim_cfg_slot->irq, 0 );
+    NVIC_EnableIRQ( tim_cfg_slot->irq );
+
     if( LL_LPTIM_Init( tim_cfg_slot->tim, &LPTIM_InitStruct ) != SUCCESS )
     {
         return SMTC_HAL_MCU_STATUS_ERROR;
@@ -179,6 +241,33 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_init( const smtc_hal_mcu_timer_cfg_t
 
     LL_LPTIM_SetCounterMode( tim_cfg_slot->tim, LL_LPTIM_COUNTER_MODE_INTERNAL );
 
+    // The interrupts can only be enabled while the LPTIM is disabled. The counter then runs freely: the
+    // wrap-arounds extend it to 64 bits and the compare match raises the expiry
+    LL_LPTIM_EnableIT_ARRM( tim_cfg_slot->tim );
+    LL_LPTIM_EnableIT_CMPM( tim_cfg_slot->tim );
+
+    LL_LPTIM_Enable( tim_cfg_slot->tim );
+    while( LL_LPTIM_IsEnabled( tim_cfg_slot->tim ) != 1 )
+    {
+    }
+
+    LL_LPTIM_ClearFlag_ARROK( tim_cfg_slot->tim );
+    LL_LPTIM_SetAutoReload( tim_cfg_slot->tim, SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX );
+    while( LL_LPTIM_IsActiveFlag_ARROK( tim_cfg_slot->tim ) != 1 )
+    {
+    }
+    LL_LPTIM_ClearFlag_ARROK( tim_cfg_slot->tim );
+
+    // Compare right before the wrap-around while disarmed, so that the LPTIM wakes the MCU about once per lap
+    LL_LPTIM_ClearFlag_CMPOK( tim_cfg_slot->tim );
+    LL_LPTIM_SetCompare( tim_cfg_slot->tim, SMTC_HAL_MCU_TIMER_STM32L4_COMPARE_MAX );
+    while( LL_LPTIM_IsActiveFlag_CMPOK( tim_cfg_slot->tim ) != 1 )
+    {
+    }
+    LL_LPTIM_ClearFlag_CMPOK( tim_cfg_slot->tim );
+
+    LL_LPTIM_StartCounter( tim_cfg_slot->tim, LL_LPTIM_OPERATING_MODE_CONTINUOUS );
+
     tim_cfg_slot->is_cfged = true;
 
     *inst = tim_cfg_slot;
@@ -200,21 +289,11 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_start( smtc_hal_mcu_timer_inst_t inst,
 
     if( ( inst->tim == LPTIM1 ) || ( inst->tim == LPTIM2 ) )
     {
-        LL_LPTIM_EnableIT_ARRM( inst->tim );
-
-        LL_LPTIM_Enable( inst->tim );
-        while( LL_LPTIM_IsEnabled( inst->tim ) != 1 )
-        {
-        }
-
-        LL_LPTIM_ClearFlag_ARROK( inst->tim );
-        LL_LPTIM_SetAutoReload( inst->tim, timeout_in_ms );
-        while( LL_LPTIM_IsActiveFlag_ARROK( inst->tim ) != 1 )
-        {
-        }
-        LL_LPTIM_ClearFlag_ARROK( inst->tim );
-
-        LL_LPTIM_StartCounter( inst->tim, LL_LPTIM_OPERATING_MODE_ONESHOT );
+        // The deadline is absolute: any timeout fits, the compare register is set in the lap it falls in
+        inst->deadline_in_ticks =
+            smtc_hal_mcu_timer_stm32l4_get_ticks( inst ) + SMTC_HAL_MCU_TIMER_STM32L4_MS_TO_TICKS( timeout_in_ms );
+        inst->is_armed = true;
+        smtc_hal_mcu_timer_stm32l4_arm_compare( inst );
     }
     else
     {
@@ -238,12 +317,8 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_stop( smtc_hal_mcu_timer_inst_t inst )
 
     if( ( inst->tim == LPTIM1 ) || ( inst->tim == LPTIM2 ) )
     {
-        LL_LPTIM_Disable( inst->tim );
-        while( LL_LPTIM_IsEnabled( inst->tim ) != 0 )
-        {
-        }
-
-        LL_LPTIM_DisableIT_ARRM( inst->tim );
+        // The counter keeps running, it is the time base
+        inst->is_armed = false;
     }
     else
     {
@@ -267,22 +342,12 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_get_remaining_time( smtc_hal_mcu_timer_
 
     if( ( inst->tim == LPTIM1 ) || ( inst->tim == LPTIM2 ) )
     {
-        uint32_t val[2];
-        int      i = 0;
-
-        val[i++ % 2] = LL_LPTIM_GetCounter( inst->tim );
+        const uint64_t now_in_ticks = smtc_hal_mcu_timer_stm32l4_get_ticks( inst );
 
-        do
-        {
-            val[i++ % 2] = LL_LPTIM_GetCounter( inst->tim );
-
-            if( i == 10 )
-            {
-                return SMTC_HAL_MCU_STATUS_ERROR;
-            }
-        } while( val[0] != val[1] );
-
-        *value_in_ms = val[0];
+        *value_in_ms = ( ( inst->is_armed == true ) && ( inst->deadline_in_ticks > now_in_ticks ) )
+                           ? ( uint32_t )( ( ( inst->deadline_in_ticks - now_in_ticks ) * 1000 ) /
+                                           SMTC_HAL_MCU_TIMER_STM32L4_TICKS_PER_S )
+                           : 0;
     }
     else
     {
@@ -309,11 +374,88 @@ smtc_hal_mcu_status_t smtc_hal_mcu_timer_get_max_value( smtc_hal_mcu_timer_inst_
     return SMTC_HAL_MCU_STATUS_OK;
 }
 
+uint64_t smtc_hal_mcu_timer_stm32l4_get_ticks( smtc_hal_mcu_timer_inst_t inst )
+{
+    const uint32_t primask = __get_PRIMASK( );
+    uint32_t       counter;
+    uint64_t       n_laps;
+
+    __disable_irq( );
+    counter = smtc_hal_mcu_timer_stm32l4_read_counter( inst->tim );
+    n_laps  = inst->n_laps;
+    // The counter wrapped around but the interrupt has not been served yet: the lap is not counted. The flag
+    // is raised as the counter reaches the auto-reload value, which still belongs to the current lap
+    if( LL_LPTIM_IsActiveFlag_ARRM( inst->tim ) == 1 )
+    {
+        counter = smtc_hal_mcu_timer_stm32l4_read_counter( inst->tim );
+        if( counter != SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX )
+        {
+            n_laps++;
+        }
+    }
+    __set_PRIMASK( primask );
+
+    return ( n_laps << SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_BITS ) | counter;
+}
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
  */
 
+static uint32_t smtc_hal_mcu_timer_stm32l4_read_counter( LPTIM_TypeDef* tim )
+{
+    uint32_t counter;
+
+    do
+    {
+        counter = LL_LPTIM_GetCounter( tim );
+    } while( counter != LL_LPTIM_GetCounter( tim ) );
+
+    return counter;
+}
+
+static void smtc_hal_mcu_timer_stm32l4_arm_compare( smtc_hal_mcu_timer_inst_t inst )
+{
+    const uint64_t now_in_ticks = smtc_hal_mcu_timer_stm32l4_get_ticks( inst );
+
+    if( inst->is_armed == false )
+    {
+        return;
+    }
+    if( inst->deadline_in_ticks <= now_in_ticks )
+    {
+        NVIC_SetPendingIRQ( inst->irq );
+        return;
+    }
+    if( ( inst->deadline_in_ticks >> SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_BITS ) !=
+        ( now_in_ticks >> SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_BITS ) )
+    {
+        // A later lap, the wrap-around interrupt comes back here
+        return;
+    }
+
+    const uint32_t compare = ( uint32_t )( inst->deadline_in_ticks & SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX );
+    if( compare > SMTC_HAL_MCU_TIMER_STM32L4_COMPARE_MAX )
+    {
+        // The last tick of the lap cannot be compared, the wrap-around interrupt raises the expiry one tick late
+        return;
+    }
+
+    LL_LPTIM_ClearFlag_CMPOK( inst->tim );
+    LL_LPTIM_SetCompare( inst->tim, compare );
+    while( LL_LPTIM_IsActiveFlag_CMPOK( inst->tim ) != 1 )
+    {
+    }
+    LL_LPTIM_ClearFlag_CMPOK( inst->tim );
+
+    // The write takes a few LPTIM clock cycles, the counter may have gone past the deadline meanwhile
+    if( inst->deadline_in_ticks <= smtc_hal_mcu_timer_stm32l4_get_ticks( inst ) )
+    {
+        NVIC_SetPendingIRQ( inst->irq );
+    }
+}
+
 static bool smtc_hal_mcu_timer_stm32l4_is_configured( smtc_hal_mcu_timer_cfg_t cfg )
 {
     for( int i = 0; i < SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX; i++ )
@@ -356,29 +498,64 @@ static bool smtc_hal_mcu_timer_stm32l4_is_real_inst( smtc_hal_mcu_timer_inst_t i
     return false;
 }
 
-/**
- * @brief  This function handles LPTIM1 interrupts.
- */
-void LPTIM1_IRQHandler( void )
+static void smtc_hal_mcu_timer_stm32l4_irq_handler( LPTIM_TypeDef* tim )
 {
-    /* Check whether Autoreload match interrupt is pending */
-    if( LL_LPTIM_IsActiveFlag_ARRM( LPTIM1 ) == 1 )
+    for( int i = 0; i < SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX; i++ )
     {
-        /* Clear the Autoreload match interrupt flag */
-        LL_LPTIM_ClearFLAG_ARRM( LPTIM1 );
+        struct smtc_hal_mcu_timer_inst_s* inst = &tim_inst_array[i];
+
+        if( ( inst->is_cfged == false ) || ( inst->tim != tim ) )
+        {
+            continue;
+        }
+
+        /* Check whether Autoreload match interrupt is pending: one more lap of the counter */
+        if( LL_LPTIM_IsActiveFlag_ARRM( tim ) == 1 )
+        {
+            // The flag is raised on the last tick of the lap, which is only over once the counter wrapped around
+            while( smtc_hal_mcu_timer_stm32l4_read_counter( tim ) == SMTC_HAL_MCU_TIMER_STM32L4_COUNTER_MAX )
+            {
+            }
+            LL_LPTIM_ClearFLAG_ARRM( tim );
+            inst->n_laps++;
+        }
+        if( LL_LPTIM_IsActiveFlag_CMPM( tim ) == 1 )
+        {
+            LL_LPTIM_ClearFLAG_CMPM( tim );
+        }
 
-        for( int i = 0; i < SMTC_HAL_MCU_TIMER_STM32L4_N_INSTANCES_MAX; i++ )
+        if( ( inst->is_armed == true ) &&
+            ( inst->deadline_in_ticks <= smtc_hal_mcu_timer_stm32l4_get_ticks( inst ) ) )
         {
-            if( tim_inst_array[i].tim == LPTIM1 )
+            inst->is_armed = false;
+            if( inst->callback_expiry != NULL )
             {
-                if( tim_inst_array[i].callback_expiry != NULL )
-                {
-                    tim_inst_array[i].callback_expiry( );
-                    return;
-                }
+                inst->callback_expiry( );
             }
         }
+        else
+        {
+            // The deadline may fall in the lap which just started
+            smtc_hal_mcu_timer_stm32l4_arm_compare( inst );
+        }
+        return;
     }
 }
 
+/**
+ * @brief  This function handles LPTIM1 interrupts.
+ */
+void LPTIM1_IRQHandler( void )
+{
+    smtc_hal_mcu_timer_stm32l4_irq_handler( LPTIM1 );
+}
+
+/**
+ * @brief  This function handles LPTIM2 interrupts.
+ */
+void LPTIM2_IRQHandler( void )
+{
+    smtc_hal_mcu_timer_stm32l4_irq_handler( LPTIM2 );
+}
+
 /* --- EOF ------------------------------------------------------------------ */
@@ -58,6 +58,7 @@ extern "C" {
         .is_dio2_set_as_rf_switch = smtc_shield_sx1261mb1bas_is_dio2_set_as_rf_switch,                                \
         .get_reg_mode = smtc_shield_sx1261mb1bas_get_reg_mode, .get_xosc_cfg = smtc_shield_sx1261mb1bas_get_xosc_cfg, \
         .get_pinout = smtc_shield_sx1261mb1bas_get_pinout,                                                            \
+        .get_current_cfg = smtc_shield_sx1261mb1bas_get_current_cfg,                                                  \
     }
 
 /*
@@ -101,6 +102,11 @@ const smtc_shield_sx126x_xosc_cfg_t* smtc_shield_sx1261mb1bas_get_xosc_cfg( void
  */
 const smtc_shield_sx126x_pinout_t* smtc_shield_sx1261mb1bas_get_pinout( void );
 
+/**
+ * @see smtc_shield_sx126x_get_current_cfg
+ */
+const smtc_shield_sx126x_current_cfg_t* smtc_shield_sx1261mb1bas_get_current_cfg( void );
+
 #ifdef __cplusplus
 }
 #endif
@@ -89,6 +89,11 @@ typedef const smtc_shield_sx126x_xosc_cfg_t* ( *smtc_shield_sx126x_get_xosc_cfg_
  */
 typedef const smtc_shield_sx126x_pinout_t* ( *smtc_shield_sx126x_get_pinout_f )( void );
 
+/**
+ * @brief Function pointer to abstract supply current configuration getter
+ */
+typedef const smtc_shield_sx126x_current_cfg_t* ( *smtc_shield_sx126x_get_current_cfg_f )( void );
+
 /**
  * @brief SX126x shield function pointer structure definition
  */
@@ -99,6 +104,7 @@ typedef struct smtc_shield_sx126x_s
     smtc_shield_sx126x_get_reg_mode_f             get_reg_mode;
     smtc_shield_sx126x_get_xosc_cfg_f             get_xosc_cfg;
     smtc_shield_sx126x_get_pinout_f               get_pinout;
+    smtc_shield_sx126x_get_current_cfg_f          get_current_cfg;
 } smtc_shield_sx126x_t;
 
 /*
@@ -169,6 +175,54 @@ static inline const smtc_shield_sx126x_pinout_t* smtc_shield_sx126x_get_pinout(
     return shield->get_pinout( );
 }
 
+/**
+ * @brief Return the supply current configuration
+ *
+ * @param [in] shield  Pointer to a shield data structure
+ *
+ * @return Supply current configuration
+ */
+static inline const smtc_shield_sx126x_current_cfg_t* smtc_shield_sx126x_get_current_cfg(
+    smtc_shield_sx126x_t* shield )
+{
+    return shield->get_current_cfg( );
+}
+
+/**
+ * @brief Return the supply current drawn in TX at a given output power
+ *
+ * The current is interpolated linearly between the anchors of the shield and clamped to the first and last ones.
+ *
+ * @param [in] shield  Pointer to a shield data structure
+ * @param [in] output_pwr_in_dbm  Output power in dBm
+ *
+ * @return TX supply current in microampere
+ */
+static inline uint32_t smtc_shield_sx126x_get_tx_current_in_ua( smtc_shield_sx126x_t* shield,
+                                                                int8_t                output_pwr_in_dbm )
+{
+    const smtc_shield_sx126x_current_cfg_t* cfg    = shield->get_current_cfg( );
+    const smtc_shield_sx126x_tx_current_t*  points = cfg->tx_points;
+    const uint8_t                           last   = cfg->n_tx_points - 1;
+
+    if( output_pwr_in_dbm <= points[0].power )
+    {
+        return points[0].current_in_ua;
+    }
+    for( uint8_t i = 1; i <= last; i++ )
+    {
+        if( output_pwr_in_dbm <= points[i].power )
+        {
+            const int32_t span_in_db = points[i].power - points[i - 1].power;
+            const int32_t step_in_db = output_pwr_in_dbm - points[i - 1].power;
+            const int32_t delta_ua   = ( int32_t ) points[i].current_in_ua - ( int32_t ) points[i - 1].current_in_ua;
+
+            return ( uint32_t ) ( ( int32_t ) points[i - 1].current_in_ua + delta_ua * step_in_db / span_in_db );
+        }
+    }
+    return points[last].current_in_ua;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -93,6 +93,34 @@ typedef struct smtc_shield_sx126x_xosc_cfg_s
     uint32_t                    startup_time_in_tick;
 } smtc_shield_sx126x_xosc_cfg_t;
 
+/**
+ * @brief Supply current drawn at one output power, used as an interpolation anchor
+ */
+typedef struct smtc_shield_sx126x_tx_current_s
+{
+    int8_t   power;
+    uint32_t current_in_ua;
+} smtc_shield_sx126x_tx_current_t;
+
+/**
+ * @brief Supply current of each chip mode structure definition
+ *
+ * Typical datasheet figures for the regulator mode used by the shield. CAD is drawn at the RX current. The TX
+ * anchors are sorted by increasing power.
+ */
+typedef struct smtc_shield_sx126x_current_cfg_s
+{
+    uint32_t                               sleep_cold_in_na;
+    uint32_t                               sleep_warm_in_na;
+    uint32_t                               stdby_rc_in_ua;
+    uint32_t                               stdby_xosc_in_ua;
+    uint32_t                               fs_in_ua;
+    uint32_t                               rx_in_ua;
+    uint32_t                               rx_boosted_in_ua;
+    uint8_t                                n_tx_points;
+    const smtc_shield_sx126x_tx_current_t* tx_points;
+} smtc_shield_sx126x_current_cfg_t;
+
 /**
  * @brief Pinout structure definition
  */
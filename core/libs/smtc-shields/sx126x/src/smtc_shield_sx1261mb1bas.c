@@ -407,6 +407,29 @@ const smtc_shield_sx126x_pinout_t smtc_shield_sx1261mb1bas_pinout = {
     .led_rx     = SMTC_SHIELD_PINOUT_A5,
 };
 
+/**
+ * @brief TX supply current anchors, typical SX1261 datasheet figures
+ */
+const smtc_shield_sx126x_tx_current_t smtc_shield_sx1261mb1bas_tx_current_table[] = {
+    { -17, 5000 }, { 0, 8000 }, { 10, 15000 }, { 14, 25500 }, { 15, 32700 },
+};
+
+/**
+ * @brief Supply current configuration, typical datasheet figures with the DC-DC regulator
+ */
+const smtc_shield_sx126x_current_cfg_t smtc_shield_sx1261mb1bas_current_cfg = {
+    .sleep_cold_in_na = 160,
+    .sleep_warm_in_na = 600,
+    .stdby_rc_in_ua   = 600,
+    .stdby_xosc_in_ua = 800,
+    .fs_in_ua         = 2100,
+    .rx_in_ua         = 4600,
+    .rx_boosted_in_ua = 5300,
+    .n_tx_points      = sizeof( smtc_shield_sx1261mb1bas_tx_current_table ) /
+                        sizeof( smtc_shield_sx1261mb1bas_tx_current_table[0] ),
+    .tx_points        = smtc_shield_sx1261mb1bas_tx_current_table,
+};
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE TYPES -----------------------------------------------------------
@@ -468,6 +491,11 @@ const smtc_shield_sx126x_pinout_t* smtc_shield_sx1261mb1bas_get_pinout( void )
     return &smtc_shield_sx1261mb1bas_pinout;
 }
 
+const smtc_shield_sx126x_current_cfg_t* smtc_shield_sx1261mb1bas_get_current_cfg( void )
+{
+    return &smtc_shield_sx1261mb1bas_current_cfg;
+}
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
@@ -365,6 +365,29 @@ const smtc_shield_sx126x_pinout_t smtc_shield_sx1262mb1cbs_pinout = {
     .led_rx     = SMTC_SHIELD_PINOUT_A5,
 };
 
+/**
+ * @brief TX supply current anchors, typical SX1262 datasheet figures
+ */
+const smtc_shield_sx126x_tx_current_t smtc_shield_sx1262mb1cbs_tx_current_table[] = {
+    { -9, 24000 }, { 0, 28000 }, { 10, 36000 }, { 14, 45000 }, { 17, 90000 }, { 20, 102000 }, { 22, 118000 },
+};
+
+/**
+ * @brief Supply current configuration, typical datasheet figures with the LDO regulator
+ */
+const smtc_shield_sx126x_current_cfg_t smtc_shield_sx1262mb1cbs_current_cfg = {
+    .sleep_cold_in_na = 160,
+    .sleep_warm_in_na = 600,
+    .stdby_rc_in_ua   = 600,
+    .stdby_xosc_in_ua = 1600,
+    .fs_in_ua         = 3500,
+    .rx_in_ua         = 8800,
+    .rx_boosted_in_ua = 10100,
+    .n_tx_points      = sizeof( smtc_shield_sx1262mb1cbs_tx_current_table ) /
+                        sizeof( smtc_shield_sx1262mb1cbs_tx_current_table[0] ),
+    .tx_points        = smtc_shield_sx1262mb1cbs_tx_current_table,
+};
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE TYPES -----------------------------------------------------------
@@ -426,6 +449,11 @@ const smtc_shield_sx126x_pinout_t* smtc_shield_sx1262mb1cbs_get_pinout( void )
     return &smtc_shield_sx1262mb1cbs_pinout;
 }
 
+const smtc_shield_sx126x_current_cfg_t* smtc_shield_sx1262mb1cbs_get_current_cfg( void )
+{
+    return &smtc_shield_sx1262mb1cbs_current_cfg;
+}
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
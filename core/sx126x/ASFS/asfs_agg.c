@@ -0,0 +1,353 @@
+/*!
+ * @file      asfs_agg.c
+ *
+ * @brief     Aggregation of application messages into shared frames, with length-prefixed framing
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_agg.h"
+#include "apps_common.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*!
+ * @brief Offset of the byte of flags in the frame header, after the source address
+ */
+#define ASFS_AGG_FLAGS_OFFSET ( ASFS_LINK_ADDR_OFFSET + 2 )
+
+/*!
+ * @brief Bits of the flags holding the codec of the body, APPS_COMPRESS_CODEC_NONE for plain messages
+ *
+ * The other bits are not understood yet, they must be 0.
+ */
+#define ASFS_AGG_FLAGS_CODEC_MASK 0x03
+
+#if( APPS_COMPRESS_N_CODECS > ( ASFS_AGG_FLAGS_CODEC_MASK + 1 ) )
+#error "The codec identifiers do not fit in the frame flags"
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static uint8_t agg_frame[ASFS_AGG_FRAME_SIZE];
+
+static uint8_t agg_size;
+
+static uint8_t agg_n_messages;
+
+static asfs_link_addr_t agg_dst;
+
+static uint32_t agg_first_in_ms;
+
+static asfs_agg_stats_t agg_stats;
+
+#if( ASFS_AGG_CODEC != APPS_COMPRESS_CODEC_NONE )
+static uint8_t agg_packed[ASFS_AGG_FRAME_SIZE];
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Queue the frame being built and start an empty one
+ *
+ * @returns false if the transmit queue was full, the messages of the frame are then lost
+ */
+static bool asfs_agg_queue_frame( uint32_t now_in_ms );
+
+/*!
+ * @brief Get the time on air of a payload at a given SF, with the modulation and packet parameters of the frames sent
+ */
+static uint32_t asfs_agg_get_time_on_air_in_ms( sx126x_lora_sf_t sf, uint8_t size );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_agg_init( asfs_link_addr_t src )
+{
+    memset( &agg_stats, 0, sizeof( agg_stats ) );
+    memset( agg_frame, 0, sizeof( agg_frame ) );
+    agg_frame[ASFS_LINK_ADDR_OFFSET]     = ( uint8_t )( src >> 8 );
+    agg_frame[ASFS_LINK_ADDR_OFFSET + 1] = ( uint8_t )( src & 0xFF );
+    agg_frame[ASFS_AGG_FLAGS_OFFSET]     = APPS_COMPRESS_CODEC_NONE;
+    agg_size                             = ASFS_AGG_HEADER_SIZE;
+    agg_n_messages                       = 0;
+}
+
+bool asfs_agg_push( asfs_link_addr_t dst, const uint8_t* msg, uint8_t size, uint32_t now_in_ms )
+{
+    if( ( size == 0 ) || ( size > ASFS_AGG_MAX_MSG_SIZE ) )
+    {
+        return false;
+    }
+
+    // A frame has a single destination
+    if( ( agg_n_messages != 0 ) && ( dst != agg_dst ) )
+    {
+        asfs_agg_queue_frame( now_in_ms );
+    }
+    if( ( agg_size + 1 + size ) > ASFS_AGG_FRAME_SIZE )
+    {
+        agg_stats.flush_full++;
+        asfs_agg_queue_frame( now_in_ms );
+    }
+    if( agg_n_messages == 0 )
+    {
+        agg_dst         = dst;
+        agg_first_in_ms = now_in_ms;
+    }
+
+    agg_frame[agg_size] = size;
+    memcpy( &agg_frame[agg_size + 1], msg, size );
+    agg_size += 1 + size;
+    agg_n_messages++;
+    agg_stats.tx_messages++;
+    agg_stats.tx_bytes += size;
+
+    // Nothing more fits behind a length byte, no need to wait
+    if( ( agg_size + 2 ) > ASFS_AGG_FRAME_SIZE )
+    {
+        agg_stats.flush_full++;
+        return asfs_agg_queue_frame( now_in_ms );
+    }
+    return true;
+}
+
+void asfs_agg_process( uint32_t now_in_ms )
+{
+    if( ( agg_n_messages != 0 ) && ( ( now_in_ms - agg_first_in_ms ) >= ASFS_AGG_MAX_DELAY_MS ) )
+    {
+        agg_stats.flush_delay++;
+        asfs_agg_queue_frame( now_in_ms );
+    }
+}
+
+void asfs_agg_flush( uint32_t now_in_ms )
+{
+    if( agg_n_messages != 0 )
+    {
+        asfs_agg_queue_frame( now_in_ms );
+    }
+}
+
+bool asfs_agg_reader_init( asfs_agg_reader_t* reader, const uint8_t* frame, uint8_t size )
+{
+    agg_stats.rx_frames++;
+    if( ( size < ASFS_AGG_HEADER_SIZE ) || ( ( frame[ASFS_AGG_FLAGS_OFFSET] & ~ASFS_AGG_FLAGS_CODEC_MASK ) != 0 ) )
+    {
+        agg_stats.rx_malformed++;
+        return false;
+    }
+
+    const uint8_t codec_id = frame[ASFS_AGG_FLAGS_OFFSET] & ASFS_AGG_FLAGS_CODEC_MASK;
+
+    reader->body   = &frame[ASFS_AGG_HEADER_SIZE];
+    reader->size   = size - ASFS_AGG_HEADER_SIZE;
+    reader->offset = 0;
+    reader->src    = ( asfs_link_addr_t )( ( frame[ASFS_LINK_ADDR_OFFSET] << 8 ) | frame[ASFS_LINK_ADDR_OFFSET + 1] );
+    if( codec_id != APPS_COMPRESS_CODEC_NONE )
+    {
+        const apps_compress_codec_t* codec = apps_compress_get_codec( codec_id );
+
+        reader->size = ( codec != NULL ) && ( reader->size != 0 )
+                           ? codec->decompress( reader->body, reader->size, reader->plain, sizeof( reader->plain ) )
+                           : 0;
+        if( reader->size == 0 )
+        {
+            agg_stats.rx_malformed++;
+            return false;
+        }
+        reader->body = reader->plain;
+        agg_stats.rx_compressed++;
+    }
+    return true;
+}
+
+bool asfs_agg_reader_next( asfs_agg_reader_t* reader, const uint8_t** msg, uint8_t* size )
+{
+    if( reader->offset >= reader->size )
+    {
+        return false;
+    }
+
+    const uint8_t msg_size = reader->body[reader->offset];
+
+    // An empty message or one running past the end of the frame means the framing is lost
+    if( ( msg_size == 0 ) || ( msg_size > ( reader->size - reader->offset - 1 ) ) )
+    {
+        agg_stats.rx_malformed++;
+        reader->offset = reader->size;
+        return false;
+    }
+
+    *msg  = &reader->body[reader->offset + 1];
+    *size = msg_size;
+    reader->offset += 1 + msg_size;
+    agg_stats.rx_messages++;
+    return true;
+}
+
+void asfs_agg_get_stats( asfs_agg_stats_t* stats )
+{
+    *stats = agg_stats;
+}
+
+void asfs_agg_print( void )
+{
+    HAL_DBG_TRACE_INFO( "Aggregation: %u messages (%u bytes) in %u frames - %u full, %u late, %u dropped\n",
+                        agg_stats.tx_messages, agg_stats.tx_bytes, agg_stats.tx_frames, agg_stats.flush_full,
+                        agg_stats.flush_delay, agg_stats.dropped );
+    HAL_DBG_TRACE_INFO( "Aggregation: %u frames compressed, %u bytes saved, %u cycles at most (%u us)\n",
+                        agg_stats.compressed, agg_stats.saved_bytes, agg_stats.max_cycles,
+                        apps_common_cycles_to_us( agg_stats.max_cycles ) );
+    HAL_DBG_TRACE_INFO( "Aggregation: %u messages received in %u frames (%u compressed), %u malformed\n",
+                        agg_stats.rx_messages, agg_stats.rx_frames, agg_stats.rx_compressed, agg_stats.rx_malformed );
+    if( agg_stats.tx_frames == 0 )
+    {
+        return;
+    }
+
+    // Average message, and average frame, sent so far
+    const uint32_t n_messages = agg_stats.tx_messages;
+    const uint32_t n_frames   = agg_stats.tx_frames;
+    const uint8_t  msg_size   = ( uint8_t )( ( agg_stats.tx_bytes + n_messages / 2 ) / n_messages );
+    const uint8_t  frame_size =
+        ( uint8_t )( ASFS_AGG_HEADER_SIZE + ( agg_stats.tx_bytes + n_messages + n_frames / 2 ) / n_frames );
+
+    for( sx126x_lora_sf_t sf = SX126X_LORA_SF7; sf <= SX126X_LORA_SF12; sf++ )
+    {
+        const uint32_t alone_in_us  = asfs_agg_get_time_on_air_in_ms( sf, ASFS_AGG_HEADER_SIZE + 1 + msg_size ) * 1000;
+        const uint64_t frames_in_us = ( uint64_t ) asfs_agg_get_time_on_air_in_ms( sf, frame_size ) * 1000 * n_frames;
+        const uint32_t shared_in_us = ( uint32_t )( frames_in_us / n_messages );
+
+        HAL_DBG_TRACE_INFO( "Aggregation %s: %u us per message alone, %u us aggregated, %u us saved\n",
+                            sx126x_lora_sf_to_str( sf ), alone_in_us, shared_in_us,
+                            ( alone_in_us > shared_in_us ) ? alone_in_us - shared_in_us : 0 );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static bool asfs_agg_queue_frame( uint32_t now_in_ms )
+{
+    const uint8_t* frame = agg_frame;
+    uint8_t        size  = agg_size;
+
+#if( ASFS_AGG_CODEC != APPS_COMPRESS_CODEC_NONE )
+    const apps_compress_codec_t* codec        = apps_compress_get_codec( ASFS_AGG_CODEC );
+    const uint32_t               start_cycles = apps_common_get_cycle_count( );
+    const uint8_t                body_size    = agg_size - ASFS_AGG_HEADER_SIZE;
+
+    // Only worth it if the body shrinks, the codec gives up as soon as it would not
+    const uint8_t packed_size = codec->compress( &agg_frame[ASFS_AGG_HEADER_SIZE], body_size,
+                                                 &agg_packed[ASFS_AGG_HEADER_SIZE], body_size - 1 );
+    const uint32_t cycles = apps_common_get_cycle_count( ) - start_cycles;
+
+    if( cycles > agg_stats.max_cycles )
+    {
+        agg_stats.max_cycles = cycles;
+    }
+    if( packed_size != 0 )
+    {
+        memcpy( agg_packed, agg_frame, ASFS_AGG_HEADER_SIZE );
+        agg_packed[ASFS_AGG_FLAGS_OFFSET] = ASFS_AGG_CODEC;
+        frame                             = agg_packed;
+        size                              = ASFS_AGG_HEADER_SIZE + packed_size;
+        agg_stats.compressed++;
+        agg_stats.saved_bytes += body_size - packed_size;
+    }
+#endif
+
+    const bool is_queued = asfs_tx_enqueue( agg_dst, frame, size, now_in_ms );
+
+    if( is_queued == true )
+    {
+        agg_stats.tx_frames++;
+    }
+    else
+    {
+        agg_stats.dropped += agg_n_messages;
+    }
+    agg_size       = ASFS_AGG_HEADER_SIZE;
+    agg_n_messages = 0;
+    return is_queued;
+}
+
+static uint32_t asfs_agg_get_time_on_air_in_ms( sx126x_lora_sf_t sf, uint8_t size )
+{
+    const sx126x_mod_params_lora_t mod_params = {
+        .sf   = sf,
+        .bw   = LORA_BANDWIDTH,
+        .cr   = LORA_CODING_RATE,
+        .ldro = apps_common_compute_lora_ldro( sf, LORA_BANDWIDTH ),
+    };
+    const sx126x_pkt_params_lora_t pkt_params = {
+        .preamble_len_in_symb = LORA_PREAMBLE_LENGTH,
+        .header_type          = LORA_PKT_LEN_MODE,
+        .pld_len_in_bytes     = size,
+        .crc_is_on            = LORA_CRC,
+        .invert_iq_is_on      = LORA_IQ,
+    };
+
+    return sx126x_get_lora_time_on_air_in_ms( &pkt_params, &mod_params );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,233 @@
+/*!
+ * @file      asfs_agg.h
+ *
+ * @brief     Aggregation of application messages into shared frames, with length-prefixed framing
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_AGG_H
+#define ASFS_AGG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "apps_compress.h"
+#include "asfs_link.h"
+#include "asfs_tx.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Longest time a message waits for others before its frame is queued - in ms
+ */
+#ifndef ASFS_AGG_MAX_DELAY_MS
+#define ASFS_AGG_MAX_DELAY_MS 10000
+#endif
+
+/*!
+ * @brief Size of the frames built - in bytes
+ *
+ * Raise ASFS_TX_MAX_PAYLOAD, up to MAX_PAYLOAD_LENGTH, to pack more messages. The receivers need reception slots at
+ * least as large, see APPS_RX_POOL_SLOT_SIZE.
+ */
+#ifndef ASFS_AGG_FRAME_SIZE
+#define ASFS_AGG_FRAME_SIZE ASFS_TX_MAX_PAYLOAD
+#endif
+
+/*!
+ * @brief Codec of the frames sent, APPS_COMPRESS_CODEC_NONE to send them as they are
+ *
+ * The codec is written in the frame header, a frame is only compressed if it shrinks. The receivers decompress every
+ * codec of apps_compress.h whatever their own setting, set APPS_COMPRESS_CODEC_NONE to talk to older receivers.
+ */
+#ifndef ASFS_AGG_CODEC
+#define ASFS_AGG_CODEC APPS_COMPRESS_CODEC_LZ
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Size of the frame header: the source address, where asfs_link expects it, then a byte of flags
+ */
+#define ASFS_AGG_HEADER_SIZE 3
+
+/*!
+ * @brief Largest body of a frame once decompressed, behind the header of the largest frame
+ */
+#define ASFS_AGG_MAX_BODY_SIZE ( 255 - ASFS_AGG_HEADER_SIZE )
+
+/*!
+ * @brief Longest message, alone in a frame behind its length byte
+ */
+#define ASFS_AGG_MAX_MSG_SIZE ( ASFS_AGG_FRAME_SIZE - ASFS_AGG_HEADER_SIZE - 1 )
+
+#if( ASFS_AGG_FRAME_SIZE > ASFS_TX_MAX_PAYLOAD ) || ( ASFS_AGG_FRAME_SIZE <= ASFS_AGG_HEADER_SIZE + 1 )
+#error "ASFS_AGG_FRAME_SIZE must fit in a queued frame and hold at least one message"
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Walks the messages of a received frame, see asfs_agg_reader_init
+ */
+typedef struct asfs_agg_reader_s
+{
+    const uint8_t*   body;                           //!< Messages of the frame, behind its header or decompressed
+    uint8_t          size;                           //!< Size of the body
+    uint8_t          offset;                         //!< Offset of the next length byte in the body
+    asfs_link_addr_t src;                            //!< Source address of the frame
+    uint8_t          plain[ASFS_AGG_MAX_BODY_SIZE];  //!< Body of a compressed frame, once decompressed
+} asfs_agg_reader_t;
+
+/*!
+ * @brief Aggregation counters
+ */
+typedef struct asfs_agg_stats_s
+{
+    uint32_t tx_messages;    //!< Messages packed
+    uint32_t tx_bytes;       //!< Bytes of the messages packed, without their length byte
+    uint32_t tx_frames;      //!< Frames queued
+    uint32_t flush_full;     //!< Frames queued because the next message did not fit
+    uint32_t flush_delay;    //!< Frames queued because their first message waited ASFS_AGG_MAX_DELAY_MS
+    uint32_t dropped;        //!< Messages lost because the transmit queue was full
+    uint32_t compressed;     //!< Frames sent compressed
+    uint32_t saved_bytes;    //!< Bytes saved by the compression of the frames sent
+    uint32_t max_cycles;     //!< Longest compression of a frame - in CPU cycles
+    uint32_t rx_frames;      //!< Frames split
+    uint32_t rx_messages;    //!< Messages found in the frames split
+    uint32_t rx_compressed;  //!< Frames decompressed
+    uint32_t rx_malformed;   //!< Frames whose header or framing was invalid
+} asfs_agg_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Drop the frame being packed and reset the counters
+ *
+ * @param [in] src Address of the node, written in the header of every frame
+ */
+void asfs_agg_init( asfs_link_addr_t src );
+
+/*!
+ * @brief Pack a message into the frame being built
+ *
+ * The frame is queued first when the message does not fit, or goes to another destination.
+ *
+ * @param [in] dst Address of the destination, ASFS_TX_BROADCAST for every neighbour
+ * @param [in] msg Message, copied into the frame
+ * @param [in] size Message size, 1 to ASFS_AGG_MAX_MSG_SIZE
+ * @param [in] now_in_ms Current time
+ *
+ * @returns false if the message is too long, or its frame could not be queued
+ */
+bool asfs_agg_push( asfs_link_addr_t dst, const uint8_t* msg, uint8_t size, uint32_t now_in_ms );
+
+/*!
+ * @brief Queue the frame being built once its first message waited ASFS_AGG_MAX_DELAY_MS
+ *
+ * @param [in] now_in_ms Current time
+ */
+void asfs_agg_process( uint32_t now_in_ms );
+
+/*!
+ * @brief Queue the frame being built now, if it holds any message
+ *
+ * @param [in] now_in_ms Current time
+ */
+void asfs_agg_flush( uint32_t now_in_ms );
+
+/*!
+ * @brief Check the header of a received frame and start walking its messages
+ *
+ * A compressed frame is decompressed into the reader, the messages of a plain one are read in place.
+ *
+ * @param [out] reader Reader to pass to asfs_agg_reader_next
+ * @param [in] frame Received payload, it must outlive the reader
+ * @param [in] size Payload size
+ *
+ * @returns false if the frame is too short, its flags or codec are unknown, or it does not decompress
+ */
+bool asfs_agg_reader_init( asfs_agg_reader_t* reader, const uint8_t* frame, uint8_t size );
+
+/*!
+ * @brief Get the next message of a received frame, without any copy
+ *
+ * A length byte running past the end of the frame ends the walk and counts the frame as malformed.
+ *
+ * @param [in,out] reader Reader set by asfs_agg_reader_init
+ * @param [out] msg Points to the message within the frame
+ * @param [out] size Message size
+ *
+ * @returns false once every message was read
+ */
+bool asfs_agg_reader_next( asfs_agg_reader_t* reader, const uint8_t** msg, uint8_t* size );
+
+/*!
+ * @brief Get the aggregation counters
+ *
+ * @param [out] stats Counters
+ */
+void asfs_agg_get_stats( asfs_agg_stats_t* stats );
+
+/*!
+ * @brief Print the counters and, for each SF, the time on air of a message sent alone and aggregated
+ *
+ * The times on air use the average message size and number of messages per frame seen so far.
+ */
+void asfs_agg_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_AGG_H
+
+/* --- EOF ------------------------------------------------------------------ */
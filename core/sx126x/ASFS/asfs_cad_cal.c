@@ -0,0 +1,381 @@
+/*!
+ * @file      asfs_cad_cal.c
+ *
+ * @brief     Per spreading factor CAD threshold calibration against the local noise floor
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include "asfs_cad_cal.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+#include "stm32l4xx_ll_utils.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Range of spreading factors with a calibration entry
+ */
+#define ASFS_CAD_CAL_SF_FIRST SX126X_LORA_SF5
+#define ASFS_CAD_CAL_SF_LAST SX126X_LORA_SF12
+
+/*!
+ * @brief Range of bandwidths with a calibration entry, contiguous in sx126x_lora_bw_t
+ */
+#define ASFS_CAD_CAL_BW_FIRST SX126X_LORA_BW_125
+#define ASFS_CAD_CAL_BW_LAST SX126X_LORA_BW_500
+
+/*!
+ * @brief Longest CAD, 16 symbols at SF12 / 125 kHz take about 560 ms - in milliseconds
+ */
+#define ASFS_CAD_CAL_CAD_TIMEOUT_MS 1000
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_cad_cal_entry_t cal_entries[ASFS_CAD_CAL_SF_LAST - ASFS_CAD_CAL_SF_FIRST + 1]
+                                       [ASFS_CAD_CAL_BW_LAST - ASFS_CAD_CAL_BW_FIRST + 1];
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the writable entry of a spreading factor and bandwidth, NULL if out of range
+ */
+static asfs_cad_cal_entry_t* asfs_cad_cal_get( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Average instantaneous RSSI samples taken in continuous RX
+ */
+static int16_t asfs_cad_cal_measure_noise_floor( const void* context );
+
+/*!
+ * @brief Run CADs back to back and count the detections
+ */
+static uint8_t asfs_cad_cal_count_detections( const void* context, uint8_t n_cads );
+
+/*!
+ * @brief Make the CAD less sensitive: raise the peak, then double the symbols and restart from the base peak
+ *
+ * @returns false if the CAD is already at its least sensitive setting
+ */
+static bool asfs_cad_cal_tighten( asfs_cad_cal_entry_t* entry );
+
+/*!
+ * @brief Undo one tightening step, without going below the calibrated thresholds
+ *
+ * @returns false if the thresholds are already the calibrated ones
+ */
+static bool asfs_cad_cal_relax( asfs_cad_cal_entry_t* entry );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_cad_cal_run( const void* context, const sx126x_mod_params_lora_t* lora_mod_params,
+                       const sx126x_cad_params_t* cad_params )
+{
+    asfs_cad_cal_entry_t* entry = asfs_cad_cal_get( lora_mod_params->sf, lora_mod_params->bw );
+    sx126x_cad_params_t   params;
+    uint8_t               detections;
+
+    if( entry == NULL )
+    {
+        return;
+    }
+
+    apps_common_sx126x_set_lora_mod_params( context, lora_mod_params );
+    ASSERT_SX126X_RC( sx126x_set_dio_irq_params( context, SX126X_IRQ_CAD_DONE | SX126X_IRQ_CAD_DETECTED,
+                                                 SX126X_IRQ_NONE, SX126X_IRQ_NONE, SX126X_IRQ_NONE ) );
+
+    entry->noise_floor_in_dbm = asfs_cad_cal_measure_noise_floor( context );
+    entry->cad_detect_peak    = cad_params->cad_detect_peak;
+    entry->cad_detect_min     = cad_params->cad_detect_min;
+    entry->cad_symb_nb        = cad_params->cad_symb_nb;
+    entry->base_detect_peak   = cad_params->cad_detect_peak;
+
+    // A raised noise floor lifts the correlation of empty symbols, keep the minimum above it
+    const int16_t quiet_floor_in_dbm =
+        ASFS_CAD_CAL_QUIET_NOISE_FLOOR_DBM + 3 * ( lora_mod_params->bw - ASFS_CAD_CAL_BW_FIRST );
+    if( entry->noise_floor_in_dbm > quiet_floor_in_dbm )
+    {
+        const int16_t step = ( entry->noise_floor_in_dbm - quiet_floor_in_dbm ) / 2;
+
+        entry->cad_detect_min = ( entry->cad_detect_min + step < entry->cad_detect_peak )
+                                    ? ( uint8_t )( entry->cad_detect_min + step )
+                                    : ( uint8_t )( entry->cad_detect_peak - 1 );
+    }
+
+    params               = *cad_params;
+    params.cad_exit_mode = SX126X_CAD_ONLY;
+    params.cad_timeout   = 0;
+
+    while( true )
+    {
+        params.cad_detect_peak = entry->cad_detect_peak;
+        params.cad_detect_min  = entry->cad_detect_min;
+        params.cad_symb_nb     = entry->cad_symb_nb;
+        ASSERT_SX126X_RC( sx126x_set_cad_params( context, &params ) );
+
+        detections = asfs_cad_cal_count_detections( context, ASFS_CAD_CAL_N_CADS );
+        if( ( detections * 100 ) <= ( ASFS_CAD_CAL_TARGET_FALSE_PERCENT * ASFS_CAD_CAL_N_CADS ) )
+        {
+            break;
+        }
+        if( asfs_cad_cal_tighten( entry ) == false )
+        {
+            HAL_DBG_TRACE_WARNING( "CAD on %s / %s still detects %d/%d on an empty channel\n",
+                                   sx126x_lora_sf_to_str( lora_mod_params->sf ),
+                                   sx126x_lora_bw_to_str( lora_mod_params->bw ), detections, ASFS_CAD_CAL_N_CADS );
+            break;
+        }
+    }
+
+    entry->base_detect_peak = entry->cad_detect_peak;
+    entry->base_symb_nb     = entry->cad_symb_nb;
+    entry->cads             = 0;
+    entry->false_cads       = 0;
+    entry->is_set           = true;
+    entry->is_calibrated    = true;
+
+    HAL_DBG_TRACE_INFO( "CAD %s / %s: noise floor %d dBm, peak %d, min %d, %s, %d/%d false\n",
+                        sx126x_lora_sf_to_str( lora_mod_params->sf ), sx126x_lora_bw_to_str( lora_mod_params->bw ),
+                        entry->noise_floor_in_dbm,
+                        entry->cad_detect_peak, entry->cad_detect_min, sx126x_cad_symbs_to_str( entry->cad_symb_nb ),
+                        detections, ASFS_CAD_CAL_N_CADS );
+
+    ASSERT_SX126X_RC( sx126x_set_standby( context, SX126X_STANDBY_CFG_RC ) );
+    ASSERT_SX126X_RC( sx126x_clear_irq_status( context, SX126X_IRQ_ALL ) );
+}
+
+void asfs_cad_cal_apply( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params )
+{
+    asfs_cad_cal_entry_t* entry = asfs_cad_cal_get( sf, bw );
+
+    if( entry == NULL )
+    {
+        return;
+    }
+
+    if( entry->is_set == false )
+    {
+        // Not calibrated, the online re-tuning starts from the given thresholds
+        entry->cad_detect_peak  = cad_params->cad_detect_peak;
+        entry->cad_detect_min   = cad_params->cad_detect_min;
+        entry->cad_symb_nb      = cad_params->cad_symb_nb;
+        entry->base_detect_peak = cad_params->cad_detect_peak;
+        entry->base_symb_nb     = cad_params->cad_symb_nb;
+        entry->is_set           = true;
+    }
+
+    cad_params->cad_detect_peak = entry->cad_detect_peak;
+    cad_params->cad_detect_min  = entry->cad_detect_min;
+    cad_params->cad_symb_nb     = entry->cad_symb_nb;
+}
+
+bool asfs_cad_cal_on_cad_done( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    asfs_cad_cal_entry_t* entry = asfs_cad_cal_get( sf, bw );
+    bool                  has_changed;
+
+    if( ( entry == NULL ) || ( entry->is_set == false ) )
+    {
+        return false;
+    }
+
+    entry->cads++;
+    if( entry->cads < ASFS_CAD_CAL_WINDOW )
+    {
+        return false;
+    }
+
+    const sx126x_cad_symbs_t cad_symb_nb = entry->cad_symb_nb;
+
+    if( ( entry->false_cads * 100 ) > ( ASFS_CAD_CAL_TARGET_FALSE_PERCENT * entry->cads ) )
+    {
+        has_changed = asfs_cad_cal_tighten( entry );
+    }
+    else if( entry->false_cads == 0 )
+    {
+        has_changed = asfs_cad_cal_relax( entry );
+    }
+    else
+    {
+        has_changed = false;
+    }
+
+    if( has_changed == true )
+    {
+        entry->retunes++;
+        HAL_DBG_TRACE_INFO( "CAD %s / %s re-tuned after %d/%d false: peak %d, %s\n", sx126x_lora_sf_to_str( sf ),
+                            sx126x_lora_bw_to_str( bw ), entry->false_cads, entry->cads, entry->cad_detect_peak,
+                            sx126x_cad_symbs_to_str( entry->cad_symb_nb ) );
+    }
+
+    entry->cads       = 0;
+    entry->false_cads = 0;
+
+    return entry->cad_symb_nb != cad_symb_nb;
+}
+
+void asfs_cad_cal_on_false_cad( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    asfs_cad_cal_entry_t* entry = asfs_cad_cal_get( sf, bw );
+
+    if( entry != NULL )
+    {
+        entry->false_cads++;
+    }
+}
+
+const asfs_cad_cal_entry_t* asfs_cad_cal_get_entry( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    return asfs_cad_cal_get( sf, bw );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static asfs_cad_cal_entry_t* asfs_cad_cal_get( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    if( ( sf < ASFS_CAD_CAL_SF_FIRST ) || ( sf > ASFS_CAD_CAL_SF_LAST ) || ( bw < ASFS_CAD_CAL_BW_FIRST ) ||
+        ( bw > ASFS_CAD_CAL_BW_LAST ) )
+    {
+        return NULL;
+    }
+    return &cal_entries[sf - ASFS_CAD_CAL_SF_FIRST][bw - ASFS_CAD_CAL_BW_FIRST];
+}
+
+static int16_t asfs_cad_cal_measure_noise_floor( const void* context )
+{
+    int32_t sum = 0;
+    int16_t rssi_in_dbm;
+
+    ASSERT_SX126X_RC( sx126x_set_rx_with_timeout_in_rtc_step( context, RX_CONTINUOUS ) );
+
+    for( uint8_t i = 0; i < ASFS_CAD_CAL_N_RSSI_SAMPLES; i++ )
+    {
+        LL_mDelay( 1 );
+        ASSERT_SX126X_RC( sx126x_get_rssi_inst( context, &rssi_in_dbm ) );
+        sum += rssi_in_dbm;
+    }
+
+    ASSERT_SX126X_RC( sx126x_set_standby( context, SX126X_STANDBY_CFG_RC ) );
+
+    return ( int16_t )( sum / ASFS_CAD_CAL_N_RSSI_SAMPLES );
+}
+
+static uint8_t asfs_cad_cal_count_detections( const void* context, uint8_t n_cads )
+{
+    uint8_t           detections = 0;
+    sx126x_irq_mask_t irq        = SX126X_IRQ_NONE;
+
+    for( uint8_t i = 0; i < n_cads; i++ )
+    {
+        const uint32_t start_ms = apps_common_get_time_in_ms( );
+
+        ASSERT_SX126X_RC( sx126x_clear_irq_status( context, SX126X_IRQ_ALL ) );
+        ASSERT_SX126X_RC( sx126x_set_cad( context ) );
+
+        do
+        {
+            ASSERT_SX126X_RC( sx126x_get_irq_status( context, &irq ) );
+        } while( ( ( irq & SX126X_IRQ_CAD_DONE ) == 0 ) &&
+                 ( ( apps_common_get_time_in_ms( ) - start_ms ) < ASFS_CAD_CAL_CAD_TIMEOUT_MS ) );
+
+        if( ( irq & SX126X_IRQ_CAD_DETECTED ) == SX126X_IRQ_CAD_DETECTED )
+        {
+            detections++;
+        }
+    }
+
+    return detections;
+}
+
+static bool asfs_cad_cal_tighten( asfs_cad_cal_entry_t* entry )
+{
+    if( entry->cad_detect_peak < ASFS_CAD_CAL_PEAK_MAX )
+    {
+        entry->cad_detect_peak++;
+        return true;
+    }
+    if( entry->cad_symb_nb < SX126X_CAD_16_SYMB )
+    {
+        entry->cad_symb_nb++;
+        entry->cad_detect_peak = entry->base_detect_peak;
+        return true;
+    }
+    return false;
+}
+
+static bool asfs_cad_cal_relax( asfs_cad_cal_entry_t* entry )
+{
+    if( entry->cad_detect_peak > entry->base_detect_peak )
+    {
+        entry->cad_detect_peak--;
+        return true;
+    }
+    if( entry->cad_symb_nb > entry->base_symb_nb )
+    {
+        entry->cad_symb_nb--;
+        entry->cad_detect_peak = ASFS_CAD_CAL_PEAK_MAX;
+        return true;
+    }
+    return false;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,195 @@
+/*!
+ * @file      asfs_cad_cal.h
+ *
+ * @brief     Per spreading factor CAD threshold calibration against the local noise floor
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_CAD_CAL_H
+#define ASFS_CAD_CAL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief False CAD rate the thresholds are tuned for - in percent of the CADs
+ */
+#ifndef ASFS_CAD_CAL_TARGET_FALSE_PERCENT
+#define ASFS_CAD_CAL_TARGET_FALSE_PERCENT 5
+#endif
+
+/*!
+ * @brief Number of CADs run on an empty channel for each step of the start-up calibration
+ */
+#ifndef ASFS_CAD_CAL_N_CADS
+#define ASFS_CAD_CAL_N_CADS 20
+#endif
+
+/*!
+ * @brief Number of instantaneous RSSI samples averaged to estimate the noise floor
+ */
+#ifndef ASFS_CAD_CAL_N_RSSI_SAMPLES
+#define ASFS_CAD_CAL_N_RSSI_SAMPLES 32
+#endif
+
+/*!
+ * @brief Noise floor of a quiet site at 125 kHz - in dBm
+ *
+ * It is 3 dB higher each time the bandwidth doubles. Every 2 dB above it raise cad_detect_min by one
+ */
+#ifndef ASFS_CAD_CAL_QUIET_NOISE_FLOOR_DBM
+#define ASFS_CAD_CAL_QUIET_NOISE_FLOOR_DBM ( -117 )
+#endif
+
+/*!
+ * @brief Highest cad_detect_peak, the symbol count is doubled once it is reached
+ */
+#ifndef ASFS_CAD_CAL_PEAK_MAX
+#define ASFS_CAD_CAL_PEAK_MAX 30
+#endif
+
+/*!
+ * @brief Number of CADs on a (spreading factor, bandwidth) pair between two online re-tunings
+ */
+#ifndef ASFS_CAD_CAL_WINDOW
+#define ASFS_CAD_CAL_WINDOW 32
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Calibrated CAD thresholds of one (spreading factor, bandwidth) pair, and the counters of the tuning window
+ */
+typedef struct asfs_cad_cal_entry_s
+{
+    bool               is_set;              //!< The thresholds below are valid
+    bool               is_calibrated;       //!< The thresholds come from asfs_cad_cal_run
+    int16_t            noise_floor_in_dbm;  //!< Average of the instantaneous RSSI on an empty channel
+    uint8_t            cad_detect_peak;
+    uint8_t            cad_detect_min;
+    sx126x_cad_symbs_t cad_symb_nb;
+    uint8_t            base_detect_peak;  //!< Peak found at calibration, online relaxing stops there
+    sx126x_cad_symbs_t base_symb_nb;      //!< Symbol count found at calibration, online relaxing stops there
+    uint16_t           cads;        //!< CADs run in the current window
+    uint16_t           false_cads;  //!< Detections in the current window not followed by a packet
+    uint32_t           retunes;     //!< Number of online threshold changes
+} asfs_cad_cal_entry_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Calibrate the CAD thresholds of a spreading factor and bandwidth on an empty channel
+ *
+ * The noise floor is first estimated from instantaneous RSSI samples in continuous RX and sets cad_detect_min.
+ * CADs are then run with the starting thresholds: as long as more than ASFS_CAD_CAL_TARGET_FALSE_PERCENT of them
+ * detect something, cad_detect_peak is raised, then the symbol count once the peak reaches ASFS_CAD_CAL_PEAK_MAX.
+ *
+ * @remark The radio must be initialized for LoRa and is left in STDBY_RC, with its IRQ parameters overwritten.
+ * Any detection is counted as false, so no transmitter may be active on the channel.
+ *
+ * @param [in] context Pointer to the radio context
+ * @param [in] lora_mod_params LoRa modulation parameters of the spreading factor and bandwidth to calibrate
+ * @param [in] cad_params Starting CAD parameters, usually the default ones of the spreading factor
+ */
+void asfs_cad_cal_run( const void* context, const sx126x_mod_params_lora_t* lora_mod_params,
+                       const sx126x_cad_params_t* cad_params );
+
+/*!
+ * @brief Overwrite CAD parameters with the thresholds calibrated for a spreading factor and bandwidth, if any
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ * @param [in,out] cad_params CAD parameters to update
+ */
+void asfs_cad_cal_apply( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params );
+
+/*!
+ * @brief Count a CAD for the online re-tuning
+ *
+ * @param [in] sf Spreading factor of the CAD
+ * @param [in] bw Bandwidth of the CAD
+ *
+ * @returns true if the re-tuning changed the number of CAD symbols, hence the time needed by the CAD
+ */
+bool asfs_cad_cal_on_cad_done( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Count a false CAD, i.e. a detection followed by an RX timeout
+ *
+ * @param [in] sf Spreading factor of the CAD
+ * @param [in] bw Bandwidth of the CAD
+ */
+void asfs_cad_cal_on_false_cad( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Get the calibration state of a spreading factor on a bandwidth
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ *
+ * @returns Pointer to the entry, NULL if the spreading factor is out of SF5-SF12 or the bandwidth out of 125-500 kHz
+ */
+const asfs_cad_cal_entry_t* asfs_cad_cal_get_entry( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_CAD_CAL_H
+
+/* --- EOF ------------------------------------------------------------------ */
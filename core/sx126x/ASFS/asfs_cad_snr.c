@@ -0,0 +1,319 @@
+/*!
+ * @file      asfs_cad_snr.c
+ *
+ * @brief     CAD symbol count of each spreading factor adapted to the SNR of the packets received
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_cad_snr.h"
+#include "asfs_link.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Range of spreading factors with an SNR entry
+ */
+#define ASFS_CAD_SNR_SF_FIRST SX126X_LORA_SF5
+#define ASFS_CAD_SNR_SF_LAST SX126X_LORA_SF12
+
+/*!
+ * @brief Range of bandwidths with an SNR entry, contiguous in sx126x_lora_bw_t
+ */
+#define ASFS_CAD_SNR_BW_FIRST SX126X_LORA_BW_125
+#define ASFS_CAD_SNR_BW_LAST SX126X_LORA_BW_500
+
+/*!
+ * @brief Weight of a new SNR sample, as a power of two, when it is lower and when it is higher than the average
+ */
+#define ASFS_CAD_SNR_FALL_SHIFT 1
+#define ASFS_CAD_SNR_RISE_SHIFT 3
+
+/*!
+ * @brief Conversion of dB to the 1/16 dB fixed point of the SNR averages
+ */
+#define ASFS_CAD_SNR_DB_TO_Q4( x ) ( ( int16_t )( ( x ) * 16 ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_cad_snr_entry_t snr_entries[ASFS_CAD_SNR_SF_LAST - ASFS_CAD_SNR_SF_FIRST + 1]
+                                       [ASFS_CAD_SNR_BW_LAST - ASFS_CAD_SNR_BW_FIRST + 1];
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the writable entry of a spreading factor and bandwidth, NULL if out of range
+ */
+static asfs_cad_snr_entry_t* asfs_cad_snr_get( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Get the shortest CAD allowed by an SNR margin above the demodulation limit
+ */
+static asfs_cad_snr_level_t asfs_cad_snr_get_level( int16_t margin_q4 );
+
+/*!
+ * @brief Get the name of a CAD length
+ */
+static const char* asfs_cad_snr_level_to_str( asfs_cad_snr_level_t level );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_cad_snr_init( void )
+{
+    memset( snr_entries, 0, sizeof( snr_entries ) );
+}
+
+bool asfs_cad_snr_on_rx( const apps_rx_pkt_desc_t* desc )
+{
+    asfs_cad_snr_entry_t* entry     = asfs_cad_snr_get( desc->sf, desc->bw );
+    const int16_t         sample_q4 = ASFS_CAD_SNR_DB_TO_Q4( desc->snr_pkt_in_db );
+    asfs_cad_snr_level_t  level;
+
+    if( entry == NULL )
+    {
+        return false;
+    }
+
+    entry->packet_count++;
+    entry->last_rx_in_ms = desc->timestamp_in_ms;
+    if( entry->is_set == false )
+    {
+        entry->snr_q4 = sample_q4;
+        entry->level  = asfs_cad_snr_get_level( sample_q4 - asfs_link_get_snr_limit_q4( desc->sf ) );
+        entry->is_set = true;
+        return ASFS_CAD_SNR_ADAPTIVE && ( entry->level != ASFS_CAD_SNR_LEVEL_BASE );
+    }
+
+    // A weak sender is caught up with at once, a strong one has to last
+    if( sample_q4 < entry->snr_q4 )
+    {
+        entry->snr_q4 += ( sample_q4 - entry->snr_q4 ) / ( 1 << ASFS_CAD_SNR_FALL_SHIFT );
+    }
+    else
+    {
+        entry->snr_q4 += ( sample_q4 - entry->snr_q4 ) / ( 1 << ASFS_CAD_SNR_RISE_SHIFT );
+    }
+
+    const int16_t margin_q4 = entry->snr_q4 - asfs_link_get_snr_limit_q4( desc->sf );
+
+    level = asfs_cad_snr_get_level( margin_q4 );
+    if( level < entry->level )
+    {
+        // Shorter CAD only once the margin is above the threshold with the hysteresis
+        level = asfs_cad_snr_get_level( margin_q4 - ASFS_CAD_SNR_DB_TO_Q4( ASFS_CAD_SNR_HYSTERESIS_DB ) );
+        if( level > entry->level )
+        {
+            level = entry->level;
+        }
+    }
+    if( level == entry->level )
+    {
+        return false;
+    }
+
+    HAL_DBG_TRACE_INFO( "CAD %s / %s: SNR %d dB, %s instead of %s\n", sx126x_lora_sf_to_str( desc->sf ),
+                        sx126x_lora_bw_to_str( desc->bw ), entry->snr_q4 / 16, asfs_cad_snr_level_to_str( level ),
+                        asfs_cad_snr_level_to_str( entry->level ) );
+    entry->level = level;
+    entry->change_count++;
+
+    return ASFS_CAD_SNR_ADAPTIVE;
+}
+
+void asfs_cad_snr_apply( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params,
+                         uint32_t now_in_ms )
+{
+    const asfs_cad_snr_entry_t* entry = asfs_cad_snr_get( sf, bw );
+    sx126x_cad_symbs_t          symb_nb;
+
+    if( ( ASFS_CAD_SNR_ADAPTIVE == false ) || ( entry == NULL ) || ( entry->is_set == false ) ||
+        ( ( now_in_ms - entry->last_rx_in_ms ) > ASFS_CAD_SNR_MAX_AGE_MS ) )
+    {
+        return;
+    }
+
+    switch( entry->level )
+    {
+    case ASFS_CAD_SNR_LEVEL_STRONG:
+        symb_nb = SX126X_CAD_01_SYMB;
+        break;
+    case ASFS_CAD_SNR_LEVEL_GOOD:
+        symb_nb = ( cad_params->cad_symb_nb < SX126X_CAD_02_SYMB ) ? cad_params->cad_symb_nb : SX126X_CAD_02_SYMB;
+        break;
+    case ASFS_CAD_SNR_LEVEL_WEAK:
+        symb_nb = ( cad_params->cad_symb_nb < SX126X_CAD_16_SYMB )
+                      ? ( sx126x_cad_symbs_t )( cad_params->cad_symb_nb + 1 )
+                      : SX126X_CAD_16_SYMB;
+        break;
+    default:
+        symb_nb = cad_params->cad_symb_nb;
+        break;
+    }
+
+    if( symb_nb < cad_params->cad_symb_nb )
+    {
+        cad_params->cad_detect_peak += ASFS_CAD_SNR_PEAK_STEP * ( cad_params->cad_symb_nb - symb_nb );
+    }
+    cad_params->cad_symb_nb = symb_nb;
+}
+
+bool asfs_cad_snr_process( uint32_t now_in_ms )
+{
+    bool has_changed = false;
+
+    for( sx126x_lora_sf_t sf = ASFS_CAD_SNR_SF_FIRST; sf <= ASFS_CAD_SNR_SF_LAST; sf++ )
+    {
+        for( sx126x_lora_bw_t bw = ASFS_CAD_SNR_BW_FIRST; bw <= ASFS_CAD_SNR_BW_LAST; bw++ )
+        {
+            asfs_cad_snr_entry_t* entry = asfs_cad_snr_get( sf, bw );
+
+            if( ( entry->is_set == false ) || ( entry->level == ASFS_CAD_SNR_LEVEL_BASE ) ||
+                ( ( now_in_ms - entry->last_rx_in_ms ) <= ASFS_CAD_SNR_MAX_AGE_MS ) )
+            {
+                continue;
+            }
+
+            HAL_DBG_TRACE_INFO( "CAD %s / %s: no packet for %u ms, %s instead of %s\n", sx126x_lora_sf_to_str( sf ),
+                                sx126x_lora_bw_to_str( bw ), ASFS_CAD_SNR_MAX_AGE_MS,
+                                asfs_cad_snr_level_to_str( ASFS_CAD_SNR_LEVEL_BASE ),
+                                asfs_cad_snr_level_to_str( entry->level ) );
+            // apply already skips the entry, the level is reset so that the change is only reported once
+            entry->level = ASFS_CAD_SNR_LEVEL_BASE;
+            entry->change_count++;
+            has_changed = true;
+        }
+    }
+
+    return ASFS_CAD_SNR_ADAPTIVE && has_changed;
+}
+
+const asfs_cad_snr_entry_t* asfs_cad_snr_get_entry( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    return asfs_cad_snr_get( sf, bw );
+}
+
+void asfs_cad_snr_print( void )
+{
+    for( sx126x_lora_sf_t sf = ASFS_CAD_SNR_SF_FIRST; sf <= ASFS_CAD_SNR_SF_LAST; sf++ )
+    {
+        for( sx126x_lora_bw_t bw = ASFS_CAD_SNR_BW_FIRST; bw <= ASFS_CAD_SNR_BW_LAST; bw++ )
+        {
+            const asfs_cad_snr_entry_t* entry = asfs_cad_snr_get( sf, bw );
+
+            if( entry->is_set == false )
+            {
+                continue;
+            }
+            HAL_DBG_TRACE_INFO( "CAD %s / %s: %u packets, SNR %d dB (%d dB above the limit) - %s CAD, %u changes\n",
+                                sx126x_lora_sf_to_str( sf ), sx126x_lora_bw_to_str( bw ), entry->packet_count,
+                                entry->snr_q4 / 16, ( entry->snr_q4 - asfs_link_get_snr_limit_q4( sf ) ) / 16,
+                                asfs_cad_snr_level_to_str( entry->level ), entry->change_count );
+        }
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static asfs_cad_snr_entry_t* asfs_cad_snr_get( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    if( ( sf < ASFS_CAD_SNR_SF_FIRST ) || ( sf > ASFS_CAD_SNR_SF_LAST ) || ( bw < ASFS_CAD_SNR_BW_FIRST ) ||
+        ( bw > ASFS_CAD_SNR_BW_LAST ) )
+    {
+        return NULL;
+    }
+    return &snr_entries[sf - ASFS_CAD_SNR_SF_FIRST][bw - ASFS_CAD_SNR_BW_FIRST];
+}
+
+static asfs_cad_snr_level_t asfs_cad_snr_get_level( int16_t margin_q4 )
+{
+    if( margin_q4 >= ASFS_CAD_SNR_DB_TO_Q4( ASFS_CAD_SNR_STRONG_DB ) )
+    {
+        return ASFS_CAD_SNR_LEVEL_STRONG;
+    }
+    if( margin_q4 >= ASFS_CAD_SNR_DB_TO_Q4( ASFS_CAD_SNR_GOOD_DB ) )
+    {
+        return ASFS_CAD_SNR_LEVEL_GOOD;
+    }
+    if( margin_q4 >= ASFS_CAD_SNR_DB_TO_Q4( ASFS_CAD_SNR_WEAK_DB ) )
+    {
+        return ASFS_CAD_SNR_LEVEL_BASE;
+    }
+    return ASFS_CAD_SNR_LEVEL_WEAK;
+}
+
+static const char* asfs_cad_snr_level_to_str( asfs_cad_snr_level_t level )
+{
+    switch( level )
+    {
+    case ASFS_CAD_SNR_LEVEL_STRONG:
+        return "strong";
+    case ASFS_CAD_SNR_LEVEL_GOOD:
+        return "good";
+    case ASFS_CAD_SNR_LEVEL_BASE:
+        return "base";
+    default:
+        return "weak";
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
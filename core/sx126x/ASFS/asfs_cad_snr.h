@@ -0,0 +1,212 @@
+/*!
+ * @file      asfs_cad_snr.h
+ *
+ * @brief     CAD symbol count of each spreading factor adapted to the SNR of the packets received
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_CAD_SNR_H
+#define ASFS_CAD_SNR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "apps_rx_pool.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Adapt the CAD symbol count to the SNR of the packets received, false to keep the calibrated one
+ */
+#ifndef ASFS_CAD_SNR_ADAPTIVE
+#define ASFS_CAD_SNR_ADAPTIVE true
+#endif
+
+/*!
+ * @brief SNR above the demodulation limit for a CAD on 1 symbol - in dB
+ */
+#ifndef ASFS_CAD_SNR_STRONG_DB
+#define ASFS_CAD_SNR_STRONG_DB 10
+#endif
+
+/*!
+ * @brief SNR above the demodulation limit for a CAD on 2 symbols - in dB
+ */
+#ifndef ASFS_CAD_SNR_GOOD_DB
+#define ASFS_CAD_SNR_GOOD_DB 5
+#endif
+
+/*!
+ * @brief SNR above the demodulation limit below which the CAD runs on twice the calibrated symbols - in dB
+ */
+#ifndef ASFS_CAD_SNR_WEAK_DB
+#define ASFS_CAD_SNR_WEAK_DB 2
+#endif
+
+/*!
+ * @brief Extra SNR needed to move to a shorter CAD, so that a link close to a threshold does not flap - in dB
+ */
+#ifndef ASFS_CAD_SNR_HYSTERESIS_DB
+#define ASFS_CAD_SNR_HYSTERESIS_DB 2
+#endif
+
+/*!
+ * @brief Raise of cad_detect_peak each time the symbol count is halved below the calibrated one
+ *
+ * A strong preamble correlates well above the thresholds tuned for more symbols, while the noise of
+ * fewer symbols averages less: the peak is raised to keep the false detections down.
+ */
+#ifndef ASFS_CAD_SNR_PEAK_STEP
+#define ASFS_CAD_SNR_PEAK_STEP 1
+#endif
+
+/*!
+ * @brief Time without a packet after which a spreading factor is back to the calibrated symbol count - in
+ * milliseconds
+ */
+#ifndef ASFS_CAD_SNR_MAX_AGE_MS
+#define ASFS_CAD_SNR_MAX_AGE_MS 600000
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief CAD length chosen for a spreading factor and bandwidth, from the shortest to the longest
+ */
+typedef enum asfs_cad_snr_level_e
+{
+    ASFS_CAD_SNR_LEVEL_STRONG = 0,  //!< 1 symbol
+    ASFS_CAD_SNR_LEVEL_GOOD,        //!< 2 symbols at most
+    ASFS_CAD_SNR_LEVEL_BASE,        //!< Calibrated symbol count
+    ASFS_CAD_SNR_LEVEL_WEAK,        //!< Twice the calibrated symbol count, 16 at most
+} asfs_cad_snr_level_t;
+
+/*!
+ * @brief SNR of the packets received on one (spreading factor, bandwidth) pair and the CAD length it leads to
+ */
+typedef struct asfs_cad_snr_entry_s
+{
+    bool                 is_set;         //!< At least one packet was received
+    int16_t              snr_q4;         //!< SNR of the weakest recent senders - in 1/16 dB
+    asfs_cad_snr_level_t level;          //!< CAD length while the entry is not older than ASFS_CAD_SNR_MAX_AGE_MS
+    uint32_t             last_rx_in_ms;  //!< Timestamp of the last packet
+    uint32_t             packet_count;   //!< Number of packets received
+    uint32_t             change_count;   //!< Number of level changes
+} asfs_cad_snr_entry_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget the SNR of every spreading factor, the CADs run on the calibrated symbol count
+ */
+void asfs_cad_snr_init( void );
+
+/*!
+ * @brief Account for the SNR of a received packet
+ *
+ * The SNR follows a drop at once and a rise slowly, so that the weakest senders heard recently set the
+ * CAD length. A lower SNR lengthens the CAD at once, a higher one only shortens it with
+ * ASFS_CAD_SNR_HYSTERESIS_DB more than the threshold.
+ *
+ * @param [in] desc Descriptor of the received packet
+ *
+ * @returns true if the CAD length of the spreading factor and bandwidth of the packet changed
+ */
+bool asfs_cad_snr_on_rx( const apps_rx_pkt_desc_t* desc );
+
+/*!
+ * @brief Overwrite the CAD symbol count with the one suited to the SNR received on a spreading factor and bandwidth
+ *
+ * The given parameters are the calibrated ones. Without a packet for ASFS_CAD_SNR_MAX_AGE_MS, they are kept.
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ * @param [in,out] cad_params CAD parameters to update
+ * @param [in] now_in_ms Current time
+ */
+void asfs_cad_snr_apply( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params,
+                         uint32_t now_in_ms );
+
+/*!
+ * @brief Bring the spreading factors without a packet for ASFS_CAD_SNR_MAX_AGE_MS back to the calibrated symbol
+ * count
+ *
+ * @param [in] now_in_ms Current time
+ *
+ * @returns true if the CAD length of some spreading factor and bandwidth changed
+ */
+bool asfs_cad_snr_process( uint32_t now_in_ms );
+
+/*!
+ * @brief Get the SNR state of a spreading factor on a bandwidth
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ *
+ * @returns Pointer to the entry, NULL if the spreading factor is out of SF5-SF12 or the bandwidth out of 125-500 kHz
+ */
+const asfs_cad_snr_entry_t* asfs_cad_snr_get_entry( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Print the SNR and CAD length of every spreading factor and bandwidth a packet was received on
+ */
+void asfs_cad_snr_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_CAD_SNR_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,290 @@
+/*!
+ * @file      asfs_cell.c
+ *
+ * @brief     Cost-aware scheduling of the (channel, bandwidth, spreading factor) cells scanned by one radio
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include "asfs_cell.h"
+#include "apps_channel_plan.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( ASFS_CELL_MAX_CELLS > 255 )
+#error "ASFS_CELL_MAX_CELLS must be lower than or equal to 255"
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Time needed to move the radio from one channel to another - in microseconds
+ */
+static uint32_t asfs_cell_get_retune_cost_in_us( uint8_t from_channel, uint8_t to_channel );
+
+/*!
+ * @brief Size the sweep time and the default maximum age from the current costs of the cells
+ */
+static void asfs_cell_table_size_sweep( asfs_cell_table_t* table );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+bool asfs_cell_table_init( asfs_cell_table_t* table, const sx126x_lora_bw_t* bws, uint8_t n_bws,
+                           sx126x_lora_sf_t sf_first, sx126x_lora_sf_t sf_last, asfs_cell_cad_cost_t get_cad_cost,
+                           uint32_t wait_in_us, uint32_t now_in_ms )
+{
+    const uint8_t n_channels = apps_channel_plan_get_n_channels( );
+    const uint8_t n_sf       = sf_last - sf_first + 1;
+
+    table->n_cells       = 0;
+    table->current       = 0;
+    table->wait_in_us    = wait_in_us;
+    table->overdue_count = 0;
+
+    if( ( ( uint32_t ) n_channels * n_bws * n_sf ) > ASFS_CELL_MAX_CELLS )
+    {
+        return false;
+    }
+
+    // Channel-major: a plain sweep of the table only retunes once per channel
+    for( uint8_t channel = 0; channel < n_channels; channel++ )
+    {
+        for( uint8_t j = 0; j < n_bws; j++ )
+        {
+            for( uint8_t i = 0; i < n_sf; i++ )
+            {
+                asfs_cell_t* cell = &table->cells[table->n_cells++];
+
+                cell->channel          = channel;
+                cell->bw               = bws[j];
+                cell->sf               = ( sx126x_lora_sf_t )( sf_first + i );
+                cell->hit_rate         = 0;
+                cell->cost_in_us       = get_cad_cost( cell->sf, cell->bw );
+                cell->last_visit_in_ms = now_in_ms;
+                cell->max_gap_in_ms    = 0;
+                cell->visit_count      = 0;
+                cell->hit_count        = 0;
+            }
+        }
+    }
+    asfs_cell_table_size_sweep( table );
+
+    return true;
+}
+
+void asfs_cell_table_update_costs( asfs_cell_table_t* table, asfs_cell_cad_cost_t get_cad_cost )
+{
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        asfs_cell_t* cell = &table->cells[i];
+
+        cell->cost_in_us = get_cad_cost( cell->sf, cell->bw );
+    }
+    asfs_cell_table_size_sweep( table );
+}
+
+const asfs_cell_t* asfs_cell_table_get_current( const asfs_cell_table_t* table )
+{
+    return &table->cells[table->current];
+}
+
+void asfs_cell_table_on_visit( asfs_cell_table_t* table, uint32_t now_in_ms )
+{
+    asfs_cell_t*   cell      = &table->cells[table->current];
+    const uint32_t gap_in_ms = now_in_ms - cell->last_visit_in_ms;
+
+    if( gap_in_ms > cell->max_gap_in_ms )
+    {
+        cell->max_gap_in_ms = gap_in_ms;
+    }
+    cell->last_visit_in_ms = now_in_ms;
+    cell->visit_count++;
+
+    // Decay towards 0, on_hit pulls the rate back up when the visit ends with a packet
+    cell->hit_rate -= cell->hit_rate >> ASFS_CELL_HIT_SHIFT;
+}
+
+void asfs_cell_table_on_hit( asfs_cell_table_t* table )
+{
+    asfs_cell_t* cell = &table->cells[table->current];
+
+    // Makes up for the decay of on_visit, so that a packet on every visit drives the rate to 255
+    const uint8_t step = 255 >> ASFS_CELL_HIT_SHIFT;
+    cell->hit_rate     = ( cell->hit_rate > ( 255 - step ) ) ? 255 : ( uint8_t )( cell->hit_rate + step );
+    cell->hit_count++;
+}
+
+const asfs_cell_t* asfs_cell_table_select_next( asfs_cell_table_t* table, uint32_t now_in_ms )
+{
+    const uint8_t from_channel = table->cells[table->current].channel;
+    uint8_t       best         = table->current;
+    uint32_t      best_overdue = 0;
+    uint64_t      best_score   = 0;
+
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        const asfs_cell_t* cell      = &table->cells[i];
+        const uint32_t     age_in_ms = now_in_ms - cell->last_visit_in_ms;
+
+        if( age_in_ms >= table->max_age_in_ms )
+        {
+            // Bounded latency first: the most overdue cell wins whatever its cost
+            const uint32_t overdue = age_in_ms - table->max_age_in_ms + 1;
+            if( overdue > best_overdue )
+            {
+                best_overdue = overdue;
+                best         = i;
+            }
+        }
+        else if( best_overdue == 0 )
+        {
+            const uint32_t cost_in_us =
+                cell->cost_in_us + asfs_cell_get_retune_cost_in_us( from_channel, cell->channel );
+            const uint64_t score =
+                ( ( ( uint64_t ) age_in_ms * ( ASFS_CELL_COLD_WEIGHT + cell->hit_rate ) ) << 16 ) / cost_in_us;
+
+            if( score > best_score )
+            {
+                best_score = score;
+                best       = i;
+            }
+        }
+    }
+
+    if( best_overdue != 0 )
+    {
+        table->overdue_count++;
+    }
+    table->current = best;
+
+    return &table->cells[best];
+}
+
+const asfs_cell_t* asfs_cell_table_select( asfs_cell_table_t* table, uint8_t channel, sx126x_lora_bw_t bw,
+                                           sx126x_lora_sf_t sf )
+{
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        const asfs_cell_t* cell = &table->cells[i];
+
+        if( ( cell->channel == channel ) && ( cell->bw == bw ) && ( cell->sf == sf ) )
+        {
+            table->current = i;
+            return cell;
+        }
+    }
+    return NULL;
+}
+
+void asfs_cell_table_print( const asfs_cell_table_t* table, uint8_t id )
+{
+    HAL_DBG_TRACE_INFO( "Radio %d: %d cells, max age %u ms, %u overdue\n", id, table->n_cells, table->max_age_in_ms,
+                        table->overdue_count );
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        const asfs_cell_t* cell = &table->cells[i];
+
+        HAL_DBG_TRACE_INFO( "Radio %d: %u Hz %s %s - %u CADs, %u hits, hit rate %d/255, max gap %u ms\n", id,
+                            apps_channel_plan_get_channel( cell->channel )->freq_in_hz,
+                            sx126x_lora_bw_to_str( cell->bw ), sx126x_lora_sf_to_str( cell->sf ), cell->visit_count,
+                            cell->hit_count, cell->hit_rate, cell->max_gap_in_ms );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint32_t asfs_cell_get_retune_cost_in_us( uint8_t from_channel, uint8_t to_channel )
+{
+    if( from_channel == to_channel )
+    {
+        return 0;
+    }
+    if( apps_channel_plan_get_channel( from_channel )->band != apps_channel_plan_get_channel( to_channel )->band )
+    {
+        return ASFS_CELL_HOP_COST_US + ASFS_CELL_CAL_IMG_COST_US;
+    }
+    return ASFS_CELL_HOP_COST_US;
+}
+
+static void asfs_cell_table_size_sweep( asfs_cell_table_t* table )
+{
+    uint64_t sweep_in_us = 0;
+
+    // The cells are channel-major, a plain sweep only retunes once per channel
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        const asfs_cell_t* cell = &table->cells[i];
+        const asfs_cell_t* next = &table->cells[( i + 1 ) % table->n_cells];
+
+        sweep_in_us += table->wait_in_us + cell->cost_in_us;
+        sweep_in_us += asfs_cell_get_retune_cost_in_us( cell->channel, next->channel );
+    }
+
+    table->sweep_in_us = ( uint32_t ) sweep_in_us;
+    // Default to twice a plain sweep
+    table->max_age_in_ms =
+        ( ASFS_CELL_MAX_AGE_MS != 0 ) ? ASFS_CELL_MAX_AGE_MS : ( uint32_t )( ( 2 * sweep_in_us ) / 1000 );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,251 @@
+/*!
+ * @file      asfs_cell.h
+ *
+ * @brief     Cost-aware scheduling of the (channel, bandwidth, spreading factor) cells scanned by one radio
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_CELL_H
+#define ASFS_CELL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Highest number of cells scanned by one radio
+ */
+#ifndef ASFS_CELL_MAX_CELLS
+#define ASFS_CELL_MAX_CELLS 40
+#endif
+
+/*!
+ * @brief Longest time a cell may wait for its next CAD before it is served first - in milliseconds
+ *
+ * 0 sets it to twice the time of a plain sweep of all the cells of the radio. A cell is then never left
+ * unchecked for more than this time plus one plain sweep.
+ */
+#ifndef ASFS_CELL_MAX_AGE_MS
+#define ASFS_CELL_MAX_AGE_MS 0
+#endif
+
+/*!
+ * @brief Weight of a cell without any hit, against 255 for a cell where every CAD led to a packet
+ */
+#ifndef ASFS_CELL_COLD_WEIGHT
+#define ASFS_CELL_COLD_WEIGHT 32
+#endif
+
+/*!
+ * @brief Smoothing of the hit rate, each visit moves it by 1 / 2^ASFS_CELL_HIT_SHIFT towards its outcome
+ */
+#ifndef ASFS_CELL_HIT_SHIFT
+#define ASFS_CELL_HIT_SHIFT 3
+#endif
+
+/*!
+ * @brief Cost of moving to another channel of the same calibration band - in microseconds
+ */
+#ifndef ASFS_CELL_HOP_COST_US
+#define ASFS_CELL_HOP_COST_US 150
+#endif
+
+/*!
+ * @brief Additional cost of moving to a channel of another calibration band - in microseconds
+ *
+ * Upper bound of an image calibration, the radio stays busy meanwhile
+ */
+#ifndef ASFS_CELL_CAL_IMG_COST_US
+#define ASFS_CELL_CAL_IMG_COST_US 3500
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief One channel of the channel plan on one bandwidth and spreading factor
+ */
+typedef struct asfs_cell_s
+{
+    uint8_t          channel;           //!< Index of the channel in the channel plan
+    sx126x_lora_bw_t bw;                //!< Bandwidth
+    sx126x_lora_sf_t sf;                //!< Spreading factor
+    uint8_t          hit_rate;          //!< Moving average of the visits which ended with a LoRa packet, 255 for all
+    uint32_t         cost_in_us;        //!< Time the radio is busy checking the cell, retune excluded
+    uint32_t         last_visit_in_ms;  //!< Time of the last CAD done on the cell
+    uint32_t         max_gap_in_ms;     //!< Longest time observed between two CADs on the cell
+    uint32_t         visit_count;       //!< Number of CADs done on the cell
+    uint32_t         hit_count;         //!< Number of LoRa packets seen on the cell
+} asfs_cell_t;
+
+/*!
+ * @brief Cells scanned by one radio
+ */
+typedef struct asfs_cell_table_s
+{
+    asfs_cell_t cells[ASFS_CELL_MAX_CELLS];
+    uint8_t     n_cells;
+    uint8_t     current;        //!< Index of the cell the radio is on
+    uint32_t    max_age_in_ms;  //!< See ASFS_CELL_MAX_AGE_MS
+    uint32_t    wait_in_us;     //!< Time waited before each CAD
+    uint32_t    sweep_in_us;    //!< Time of a plain sweep of all the cells, waits and retunes included
+    uint32_t    overdue_count;  //!< Number of cells served first because they waited for max_age_in_ms
+} asfs_cell_table_t;
+
+/*!
+ * @brief Time spent by a radio in CAD on one spreading factor and bandwidth - in microseconds
+ */
+typedef uint32_t ( *asfs_cell_cad_cost_t )( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Build the cells of every channel of the channel plan on some bandwidths and a range of spreading factors
+ *
+ * The radio starts on the first channel with the first bandwidth and the first spreading factor.
+ *
+ * @param [out] table Cell table
+ * @param [in] bws List of bandwidths
+ * @param [in] n_bws Number of bandwidths in the list
+ * @param [in] sf_first First spreading factor of the range
+ * @param [in] sf_last Last spreading factor of the range
+ * @param [in] get_cad_cost Time needed by a CAD on a spreading factor and bandwidth
+ * @param [in] wait_in_us Time waited before each CAD, only used to size the sweep time and the maximum age
+ * @param [in] now_in_ms Current time
+ *
+ * @returns false if the channels, bandwidths and spreading factors make more than @ref ASFS_CELL_MAX_CELLS cells
+ */
+bool asfs_cell_table_init( asfs_cell_table_t* table, const sx126x_lora_bw_t* bws, uint8_t n_bws,
+                           sx126x_lora_sf_t sf_first, sx126x_lora_sf_t sf_last, asfs_cell_cad_cost_t get_cad_cost,
+                           uint32_t wait_in_us, uint32_t now_in_ms );
+
+/*!
+ * @brief Compute again the time needed by the CAD of every cell, after its parameters changed
+ *
+ * The sweep time and the default maximum age are sized again from the new costs.
+ *
+ * @param [in,out] table Cell table
+ * @param [in] get_cad_cost Time needed by a CAD on a spreading factor and bandwidth
+ */
+void asfs_cell_table_update_costs( asfs_cell_table_t* table, asfs_cell_cad_cost_t get_cad_cost );
+
+/*!
+ * @brief Get the cell the radio is on
+ *
+ * @param [in] table Cell table
+ */
+const asfs_cell_t* asfs_cell_table_get_current( const asfs_cell_table_t* table );
+
+/*!
+ * @brief Account for a CAD done on the current cell, whatever its result
+ *
+ * @param [in,out] table Cell table
+ * @param [in] now_in_ms Current time
+ */
+void asfs_cell_table_on_visit( asfs_cell_table_t* table, uint32_t now_in_ms );
+
+/*!
+ * @brief Account for a LoRa packet seen on the current cell
+ *
+ * @param [in,out] table Cell table
+ */
+void asfs_cell_table_on_hit( asfs_cell_table_t* table );
+
+/*!
+ * @brief Choose the next cell to be checked and make it the current one
+ *
+ * A cell which waited for longer than the maximum age is served first, the oldest one if several did.
+ * Otherwise the chosen cell has the best ratio of waiting time, weighted by its hit rate, over the time
+ * the radio is busy checking it from the current cell, retune and image calibration included.
+ * As the preamble and the CAD both last a number of symbols, a cell whose CAD is N times shorter has
+ * a preamble N times shorter to be caught in, and is checked about N times more often: a 500 kHz cell
+ * comes back four times as often as the same spreading factor at 125 kHz.
+ *
+ * @param [in,out] table Cell table
+ * @param [in] now_in_ms Current time
+ *
+ * @returns Pointer to the chosen cell
+ */
+const asfs_cell_t* asfs_cell_table_select_next( asfs_cell_table_t* table, uint32_t now_in_ms );
+
+/*!
+ * @brief Make a given cell the current one, for instance where a packet is expected
+ *
+ * @param [in,out] table Cell table
+ * @param [in] channel Index of the channel in the channel plan
+ * @param [in] bw Bandwidth
+ * @param [in] sf Spreading factor
+ *
+ * @returns Pointer to the cell, NULL if it is not in the table and the current cell is unchanged
+ */
+const asfs_cell_t* asfs_cell_table_select( asfs_cell_table_t* table, uint8_t channel, sx126x_lora_bw_t bw,
+                                           sx126x_lora_sf_t sf );
+
+/*!
+ * @brief Print the counters of every cell
+ *
+ * @param [in] table Cell table
+ * @param [in] id Index of the radio scanning the cells
+ */
+void asfs_cell_table_print( const asfs_cell_table_t* table, uint8_t id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_CELL_H
+
+/* --- EOF ------------------------------------------------------------------ */
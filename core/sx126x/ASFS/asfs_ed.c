@@ -0,0 +1,239 @@
+/*!
+ * @file      asfs_ed.c
+ *
+ * @brief     Energy detection stage skipping the long CADs while the channel is silent
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_ed.h"
+#include "asfs_sniff.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Conversion of dB to the 1/16 dB fixed point of the noise floors
+ */
+#define ASFS_ED_DB_TO_Q4( x ) ( ( int16_t )( ( x ) * 16 ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Busy-wait on the cycle counter
+ */
+static void asfs_ed_wait_us( uint32_t delay_in_us );
+
+/*!
+ * @brief Move a noise floor by 1 / 2^ASFS_ED_FLOOR_SHIFT towards a sample
+ */
+static void asfs_ed_update_floor( int16_t* floor_q4, int16_t rssi_q4 );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_ed_init( asfs_ed_t* ed )
+{
+    memset( ed, 0, sizeof( asfs_ed_t ) );
+}
+
+asfs_ed_verdict_t asfs_ed_check( asfs_ed_t* ed, const void* context, uint8_t channel, sx126x_lora_bw_t bw,
+                                 uint32_t cad_cost_in_us )
+{
+    const uint32_t start_cycles = apps_common_get_cycle_count( );
+    int32_t        sum          = 0;
+    int16_t        max_in_dbm   = INT16_MIN;
+    int16_t        rssi_in_dbm;
+
+    ed->is_pending = false;
+
+    if( ( channel >= APPS_CHANNEL_PLAN_MAX_CHANNELS ) || ( bw < SX126X_LORA_BW_125 ) || ( bw > SX126X_LORA_BW_500 ) )
+    {
+        return ASFS_ED_BUSY;
+    }
+
+    ASSERT_SX126X_RC( sx126x_set_rx_with_timeout_in_rtc_step( context, RX_CONTINUOUS ) );
+    for( uint8_t i = 0; i < ASFS_ED_N_SAMPLES; i++ )
+    {
+        asfs_ed_wait_us( ASFS_ED_SAMPLE_SPACING_US );
+        ASSERT_SX126X_RC( sx126x_get_rssi_inst( context, &rssi_in_dbm ) );
+        sum += rssi_in_dbm;
+        if( rssi_in_dbm > max_in_dbm )
+        {
+            max_in_dbm = rssi_in_dbm;
+        }
+    }
+    ASSERT_SX126X_RC( sx126x_set_standby( context, SX126X_STANDBY_CFG_RC ) );
+
+    const uint32_t ed_time_in_us = apps_common_cycles_to_us( apps_common_get_cycle_count( ) - start_cycles );
+    int16_t*       floor_q4      = &ed->floor_q4[channel][bw - SX126X_LORA_BW_125];
+    bool*          floor_is_set  = &ed->floor_is_set[channel][bw - SX126X_LORA_BW_125];
+
+    ed->stats.checks++;
+    ed->stats.ed_time_in_us += ed_time_in_us;
+
+    ed->pending_floor_q4 = floor_q4;
+    ed->pending_rssi_q4  = ( int16_t )( ( sum * 16 ) / ASFS_ED_N_SAMPLES );
+    ed->is_pending       = true;
+
+    if( *floor_is_set == false )
+    {
+        // First look at this channel: learn its level, but let the CAD decide
+        *floor_q4            = ed->pending_rssi_q4;
+        *floor_is_set        = true;
+        ed->pending_floor_q4 = NULL;
+        ed->pending_verdict  = ASFS_ED_BUSY;
+        return ASFS_ED_BUSY;
+    }
+
+    if( ASFS_ED_DB_TO_Q4( max_in_dbm ) >= ( *floor_q4 + ASFS_ED_DB_TO_Q4( ASFS_ED_MARGIN_DB ) ) )
+    {
+        ed->pending_verdict = ASFS_ED_BUSY;
+        return ASFS_ED_BUSY;
+    }
+
+    asfs_ed_update_floor( floor_q4, ed->pending_rssi_q4 );
+    ed->pending_floor_q4 = NULL;
+
+    ed->silent_count++;
+    if( ( ASFS_ED_AUDIT_PERIOD != 0 ) && ( ed->silent_count >= ASFS_ED_AUDIT_PERIOD ) )
+    {
+        ed->silent_count    = 0;
+        ed->pending_verdict = ASFS_ED_SILENT_AUDIT;
+        ed->stats.audits++;
+        return ASFS_ED_SILENT_AUDIT;
+    }
+
+    ed->is_pending = false;
+    ed->stats.skips++;
+    if( cad_cost_in_us > ed_time_in_us )
+    {
+        ed->stats.saved_time_in_us += cad_cost_in_us - ed_time_in_us;
+    }
+    return ASFS_ED_SILENT;
+}
+
+void asfs_ed_on_cad_result( asfs_ed_t* ed, bool is_detected )
+{
+    if( ed->is_pending == false )
+    {
+        return;
+    }
+    ed->is_pending = false;
+
+    if( ed->pending_verdict == ASFS_ED_SILENT_AUDIT )
+    {
+        if( is_detected == true )
+        {
+            ed->stats.missed_detections++;
+        }
+    }
+    else if( ( ed->pending_verdict == ASFS_ED_BUSY ) && ( is_detected == false ) )
+    {
+        // The energy was not LoRa: let the floor rise towards it, or the CAD would never be skipped again
+        ed->stats.false_busy++;
+        if( ed->pending_floor_q4 != NULL )
+        {
+            asfs_ed_update_floor( ed->pending_floor_q4, ed->pending_rssi_q4 );
+        }
+    }
+}
+
+void asfs_ed_print( const asfs_ed_t* ed, uint8_t id )
+{
+    const asfs_ed_stats_t* stats = &ed->stats;
+
+    if( stats->checks == 0 )
+    {
+        return;
+    }
+
+    // CAD and RX draw the same current, the charge saved is the RX current over the time saved
+    const uint64_t saved_in_uc = ( stats->saved_time_in_us * ASFS_SNIFF_CURRENT_RX_NA ) / 1000000000;
+
+    HAL_DBG_TRACE_INFO( "Radio %d: energy detection %u checks, %u%% skipped, %u/%u audits missed, %u false busy\n",
+                        id, stats->checks, ( uint32_t )( ( ( uint64_t ) stats->skips * 100 ) / stats->checks ),
+                        stats->missed_detections, stats->audits, stats->false_busy );
+    HAL_DBG_TRACE_INFO( "Radio %d: %u ms of CAD saved for %u ms of RX windows, about %u uC\n", id,
+                        ( uint32_t )( stats->saved_time_in_us / 1000 ), ( uint32_t )( stats->ed_time_in_us / 1000 ),
+                        ( uint32_t ) saved_in_uc );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void asfs_ed_wait_us( uint32_t delay_in_us )
+{
+    const uint32_t start_cycles = apps_common_get_cycle_count( );
+
+    while( apps_common_cycles_to_us( apps_common_get_cycle_count( ) - start_cycles ) < delay_in_us )
+    {
+    }
+}
+
+static void asfs_ed_update_floor( int16_t* floor_q4, int16_t rssi_q4 )
+{
+    *floor_q4 += ( int16_t )( ( rssi_q4 - *floor_q4 ) / ( 1 << ASFS_ED_FLOOR_SHIFT ) );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,211 @@
+/*!
+ * @file      asfs_ed.h
+ *
+ * @brief     Energy detection stage skipping the long CADs while the channel is silent
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_ED_H
+#define ASFS_ED_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "apps_channel_plan.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of instantaneous RSSI samples taken in the RX window
+ */
+#ifndef ASFS_ED_N_SAMPLES
+#define ASFS_ED_N_SAMPLES 8
+#endif
+
+/*!
+ * @brief Time between two RSSI samples, and before the first one - in microseconds
+ */
+#ifndef ASFS_ED_SAMPLE_SPACING_US
+#define ASFS_ED_SAMPLE_SPACING_US 100
+#endif
+
+/*!
+ * @brief Margin above the noise floor under which every sample must stay for the channel to be silent - in dB
+ */
+#ifndef ASFS_ED_MARGIN_DB
+#define ASFS_ED_MARGIN_DB 6
+#endif
+
+/*!
+ * @brief Smoothing of the noise floor, each update moves it by 1 / 2^ASFS_ED_FLOOR_SHIFT towards the sample
+ */
+#ifndef ASFS_ED_FLOOR_SHIFT
+#define ASFS_ED_FLOOR_SHIFT 4
+#endif
+
+/*!
+ * @brief Shortest CAD worth an energy detection first - in microseconds
+ *
+ * The default keeps SF7 and SF8 at 125 kHz out of the pre-filter, their CAD is hardly longer than the RX window
+ */
+#ifndef ASFS_ED_MIN_CAD_US
+#define ASFS_ED_MIN_CAD_US 16000
+#endif
+
+/*!
+ * @brief One silent verdict out of ASFS_ED_AUDIT_PERIOD is checked with the CAD anyway, 0 to never audit
+ */
+#ifndef ASFS_ED_AUDIT_PERIOD
+#define ASFS_ED_AUDIT_PERIOD 16
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of bandwidths with a noise floor, 125 kHz to 500 kHz
+ */
+#define ASFS_ED_N_BW ( SX126X_LORA_BW_500 - SX126X_LORA_BW_125 + 1 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Outcome of an energy detection
+ */
+typedef enum asfs_ed_verdict_e
+{
+    ASFS_ED_BUSY,          //!< Energy above the threshold, or no noise floor yet: the CAD has to run
+    ASFS_ED_SILENT,        //!< Nothing on air: the CAD can be skipped
+    ASFS_ED_SILENT_AUDIT,  //!< Nothing on air, but the CAD has to run to measure the missed detections
+} asfs_ed_verdict_t;
+
+/*!
+ * @brief Energy detection counters
+ */
+typedef struct asfs_ed_stats_s
+{
+    uint32_t checks;             //!< Energy detections run
+    uint32_t skips;              //!< CADs skipped on a silent verdict
+    uint32_t audits;             //!< CADs run anyway on a silent verdict
+    uint32_t missed_detections;  //!< Audit CADs which detected activity, the pre-filter would have missed it
+    uint32_t false_busy;         //!< Busy verdicts followed by a CAD without detection
+    uint64_t ed_time_in_us;      //!< Time spent in the RX windows
+    uint64_t saved_time_in_us;   //!< CAD time avoided by the skips, RX windows deducted
+} asfs_ed_stats_t;
+
+/*!
+ * @brief Energy detection state of one radio
+ */
+typedef struct asfs_ed_s
+{
+    int16_t           floor_q4[APPS_CHANNEL_PLAN_MAX_CHANNELS][ASFS_ED_N_BW];  //!< Noise floor - in 1/16 dBm
+    bool              floor_is_set[APPS_CHANNEL_PLAN_MAX_CHANNELS][ASFS_ED_N_BW];
+    int16_t*          pending_floor_q4;  //!< Floor of the last verdict waiting for the CAD result
+    int16_t           pending_rssi_q4;   //!< Mean RSSI of the last verdict - in 1/16 dBm
+    asfs_ed_verdict_t pending_verdict;   //!< Last verdict waiting for the CAD result
+    bool              is_pending;        //!< A verdict waits for the result of its CAD
+    uint16_t          silent_count;      //!< Silent verdicts since the last audit
+    asfs_ed_stats_t   stats;
+} asfs_ed_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget every noise floor and clear the counters
+ *
+ * @param [out] ed Energy detection state
+ */
+void asfs_ed_init( asfs_ed_t* ed );
+
+/*!
+ * @brief Sample the instantaneous RSSI in a short RX window and compare it to the noise floor of the channel
+ *
+ * The radio is silent if every sample stays below the noise floor plus @ref ASFS_ED_MARGIN_DB. The noise floor
+ * follows the silent windows, and the busy ones whose CAD found no LoRa activity, so a raised noise level is
+ * learnt instead of keeping every CAD on. A silent verdict accounts for the CAD time saved.
+ *
+ * @param [in,out] ed Energy detection state
+ * @param [in] context Radio context, in STDBY_RC and tuned on the channel and bandwidth; left in STDBY_RC
+ * @param [in] channel Index of the channel in the channel plan
+ * @param [in] bw Bandwidth, outside of 125-500 kHz the channel is always busy
+ * @param [in] cad_cost_in_us Duration of the CAD that a silent verdict avoids
+ *
+ * @returns Verdict, @ref asfs_ed_on_cad_result has to be called after the CAD unless it is ASFS_ED_SILENT
+ */
+asfs_ed_verdict_t asfs_ed_check( asfs_ed_t* ed, const void* context, uint8_t channel, sx126x_lora_bw_t bw,
+                                 uint32_t cad_cost_in_us );
+
+/*!
+ * @brief Report the result of a CAD run after an energy detection
+ *
+ * @remark Nothing is done if no verdict is pending, so this can be called after every CAD
+ *
+ * @param [in,out] ed Energy detection state
+ * @param [in] is_detected The CAD detected activity
+ */
+void asfs_ed_on_cad_result( asfs_ed_t* ed, bool is_detected );
+
+/*!
+ * @brief Print the energy detection counters and the energy saved
+ *
+ * @param [in] ed Energy detection state
+ * @param [in] id Index of the radio
+ */
+void asfs_ed_print( const asfs_ed_t* ed, uint8_t id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_ED_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,324 @@
+/*!
+ * @file      asfs_link.c
+ *
+ * @brief     Per neighbour link quality and transmit spreading factor selection
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_link.h"
+#include "apps_common.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Conversion of dB to the 1/16 dB fixed point of the link averages
+ */
+#define ASFS_LINK_DB_TO_Q4( x ) ( ( int16_t )( ( x ) * 16 ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*!
+ * @brief Lowest SNR at which a packet is demodulated, from SF5 to SF12 - in 1/16 dB
+ */
+static const int16_t asfs_link_snr_limits_q4[] = {
+    ASFS_LINK_DB_TO_Q4( -5 ),    ASFS_LINK_DB_TO_Q4( -7.5 ),  ASFS_LINK_DB_TO_Q4( -7.5 ),  ASFS_LINK_DB_TO_Q4( -10 ),
+    ASFS_LINK_DB_TO_Q4( -12.5 ), ASFS_LINK_DB_TO_Q4( -15 ),   ASFS_LINK_DB_TO_Q4( -17.5 ), ASFS_LINK_DB_TO_Q4( -20 ),
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_nbr_table_t link_table;
+
+static asfs_link_stats_t link_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Move an average by 1 / 2^ASFS_LINK_AVG_SHIFT towards a sample
+ */
+static void asfs_link_update_avg( int16_t* avg_q4, int16_t sample_q4 );
+
+/*!
+ * @brief Lowest spreading factor of ASFS_LINK_SF_MIN-ASFS_LINK_SF_MAX demodulated with a margin at a given SNR
+ *
+ * @returns ASFS_LINK_SF_MAX if even this one misses the margin
+ */
+static sx126x_lora_sf_t asfs_link_get_lowest_sf( int16_t snr_q4, int16_t margin_q4 );
+
+/*!
+ * @brief Move the transmit spreading factor of the neighbour in a slot after its SNR changed
+ */
+static void asfs_link_select_tx_sf( uint16_t slot );
+
+/*!
+ * @brief Copy the neighbour in a slot
+ */
+static void asfs_link_get_slot( uint16_t slot, asfs_link_neighbor_t* neighbor );
+
+/*!
+ * @brief Fill LoRa modulation parameters for a spreading factor and bandwidth
+ */
+static void asfs_link_fill_mod_params( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_mod_params_lora_t* params );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_link_init( void )
+{
+    asfs_nbr_init( &link_table );
+    memset( &link_stats, 0, sizeof( link_stats ) );
+}
+
+bool asfs_link_on_rx( const apps_rx_pkt_desc_t* desc )
+{
+    asfs_link_addr_t addr;
+    bool             is_new;
+
+    if( asfs_link_get_src( desc, &addr ) == false )
+    {
+        link_stats.short_packets++;
+        return false;
+    }
+
+    const uint16_t slot = asfs_nbr_insert( &link_table, addr, &is_new );
+
+    if( is_new == true )
+    {
+        link_table.snr_q4[slot]  = ASFS_LINK_DB_TO_Q4( desc->snr_pkt_in_db );
+        link_table.rssi_q4[slot] = ASFS_LINK_DB_TO_Q4( desc->rssi_pkt_in_dbm );
+        link_table.tx_sf[slot]   = ASFS_LINK_SF_MAX;
+    }
+    else
+    {
+        asfs_link_update_avg( &link_table.snr_q4[slot], ASFS_LINK_DB_TO_Q4( desc->snr_pkt_in_db ) );
+        asfs_link_update_avg( &link_table.rssi_q4[slot], ASFS_LINK_DB_TO_Q4( desc->rssi_pkt_in_dbm ) );
+    }
+    link_table.rx_sf[slot]           = ( uint8_t ) desc->sf;
+    link_table.bw[slot]              = ( uint8_t ) desc->bw;
+    link_table.last_seen_in_ms[slot] = desc->timestamp_in_ms;
+    link_table.rx_count[slot]++;
+    link_stats.updates++;
+
+    asfs_link_select_tx_sf( slot );
+    return true;
+}
+
+bool asfs_link_get_src( const apps_rx_pkt_desc_t* desc, asfs_link_addr_t* addr )
+{
+    if( desc->size < ( ASFS_LINK_ADDR_OFFSET + sizeof( asfs_link_addr_t ) ) )
+    {
+        return false;
+    }
+
+    *addr = ( asfs_link_addr_t )( ( desc->payload[ASFS_LINK_ADDR_OFFSET] << 8 ) |
+                                  desc->payload[ASFS_LINK_ADDR_OFFSET + 1] );
+    return true;
+}
+
+bool asfs_link_get_neighbor( asfs_link_addr_t addr, asfs_link_neighbor_t* neighbor )
+{
+    const uint16_t slot = asfs_nbr_find( &link_table, addr );
+
+    if( slot == ASFS_NBR_NONE )
+    {
+        return false;
+    }
+    asfs_link_get_slot( slot, neighbor );
+    return true;
+}
+
+bool asfs_link_get_tx_mod_params( asfs_link_addr_t addr, sx126x_mod_params_lora_t* params )
+{
+    const uint16_t slot = asfs_nbr_find( &link_table, addr );
+
+    if( slot == ASFS_NBR_NONE )
+    {
+        asfs_link_fill_mod_params( ASFS_LINK_SF_MAX, LORA_BANDWIDTH, params );
+        return false;
+    }
+    asfs_link_fill_mod_params( ( sx126x_lora_sf_t ) link_table.tx_sf[slot], ( sx126x_lora_bw_t ) link_table.bw[slot],
+                               params );
+    return true;
+}
+
+void asfs_link_get_stats( asfs_link_stats_t* stats, asfs_nbr_stats_t* nbr_stats )
+{
+    *stats = link_stats;
+    if( nbr_stats != NULL )
+    {
+        *nbr_stats = link_table.stats;
+    }
+}
+
+int16_t asfs_link_get_snr_limit_q4( sx126x_lora_sf_t sf )
+{
+    if( sf < SX126X_LORA_SF5 )
+    {
+        sf = SX126X_LORA_SF5;
+    }
+    else if( sf > SX126X_LORA_SF12 )
+    {
+        sf = SX126X_LORA_SF12;
+    }
+    return asfs_link_snr_limits_q4[sf - SX126X_LORA_SF5];
+}
+
+void asfs_link_print( void )
+{
+    const asfs_nbr_stats_t*  nbr_stats = &link_table.stats;
+    asfs_link_neighbor_t     neighbor;
+    sx126x_mod_params_lora_t params;
+    uint32_t                 toa_in_ms;
+    uint32_t                 toa_max_in_ms;
+
+    HAL_DBG_TRACE_INFO( "Links: %u packets, %u without address - %u/%u neighbours, %u evicted, %u.%02u probes per "
+                        "lookup (max %u)\n",
+                        link_stats.updates, link_stats.short_packets, link_table.n_entries, ASFS_NBR_MAX_ENTRIES,
+                        nbr_stats->evictions, ( nbr_stats->lookups != 0 ) ? nbr_stats->probes / nbr_stats->lookups : 0,
+                        ( nbr_stats->lookups != 0 ) ? ( nbr_stats->probes * 100 / nbr_stats->lookups ) % 100 : 0,
+                        nbr_stats->max_probes );
+    for( uint16_t slot = 0; slot < ASFS_NBR_CAPACITY; slot++ )
+    {
+        if( ( link_table.flags[slot] & ASFS_NBR_FLAG_USED ) == 0 )
+        {
+            continue;
+        }
+        asfs_link_get_slot( slot, &neighbor );
+        asfs_link_fill_mod_params( neighbor.tx_sf, neighbor.bw, &params );
+        toa_in_ms = apps_common_get_lora_time_on_air_in_ms( &params );
+        asfs_link_fill_mod_params( ASFS_LINK_SF_MAX, neighbor.bw, &params );
+        toa_max_in_ms = apps_common_get_lora_time_on_air_in_ms( &params );
+
+        HAL_DBG_TRACE_INFO( "  0x%04x: %u packets, SNR %d dB, RSSI %d dBm - TX on %s / %s (%u changes), %u ms on air "
+                            "instead of %u ms\n",
+                            neighbor.addr, neighbor.rx_count, neighbor.snr_q4 / 16, neighbor.rssi_q4 / 16,
+                            sx126x_lora_sf_to_str( neighbor.tx_sf ), sx126x_lora_bw_to_str( neighbor.bw ),
+                            neighbor.sf_changes, toa_in_ms, toa_max_in_ms );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void asfs_link_update_avg( int16_t* avg_q4, int16_t sample_q4 )
+{
+    *avg_q4 += ( sample_q4 - *avg_q4 ) / ( 1 << ASFS_LINK_AVG_SHIFT );
+}
+
+static sx126x_lora_sf_t asfs_link_get_lowest_sf( int16_t snr_q4, int16_t margin_q4 )
+{
+    for( sx126x_lora_sf_t sf = ASFS_LINK_SF_MIN; sf < ASFS_LINK_SF_MAX; sf++ )
+    {
+        if( ( snr_q4 - asfs_link_snr_limits_q4[sf - SX126X_LORA_SF5] ) >= margin_q4 )
+        {
+            return sf;
+        }
+    }
+    return ASFS_LINK_SF_MAX;
+}
+
+static void asfs_link_select_tx_sf( uint16_t slot )
+{
+    const int16_t          margin_q4 = ASFS_LINK_DB_TO_Q4( ASFS_LINK_MARGIN_DB );
+    const int16_t          hyst_q4   = ASFS_LINK_DB_TO_Q4( ASFS_LINK_HYSTERESIS_DB );
+    const sx126x_lora_sf_t up_sf     = asfs_link_get_lowest_sf( link_table.snr_q4[slot], margin_q4 );
+    const sx126x_lora_sf_t down_sf   = asfs_link_get_lowest_sf( link_table.snr_q4[slot], margin_q4 + hyst_q4 );
+    sx126x_lora_sf_t       tx_sf     = ( sx126x_lora_sf_t ) link_table.tx_sf[slot];
+
+    if( up_sf > tx_sf )
+    {
+        // The margin is lost, move up at once
+        tx_sf = up_sf;
+    }
+    else if( down_sf < tx_sf )
+    {
+        // The margin is kept even with the hysteresis on a lower spreading factor
+        tx_sf = down_sf;
+    }
+
+    if( tx_sf != link_table.tx_sf[slot] )
+    {
+        link_table.tx_sf[slot] = ( uint8_t ) tx_sf;
+        link_table.sf_changes[slot]++;
+    }
+}
+
+static void asfs_link_get_slot( uint16_t slot, asfs_link_neighbor_t* neighbor )
+{
+    neighbor->addr            = link_table.ids[slot];
+    neighbor->snr_q4          = link_table.snr_q4[slot];
+    neighbor->rssi_q4         = link_table.rssi_q4[slot];
+    neighbor->rx_sf           = ( sx126x_lora_sf_t ) link_table.rx_sf[slot];
+    neighbor->bw              = ( sx126x_lora_bw_t ) link_table.bw[slot];
+    neighbor->tx_sf           = ( sx126x_lora_sf_t ) link_table.tx_sf[slot];
+    neighbor->last_seen_in_ms = link_table.last_seen_in_ms[slot];
+    neighbor->rx_count        = link_table.rx_count[slot];
+    neighbor->sf_changes      = link_table.sf_changes[slot];
+}
+
+static void asfs_link_fill_mod_params( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_mod_params_lora_t* params )
+{
+    params->sf   = sf;
+    params->bw   = bw;
+    params->cr   = LORA_CODING_RATE;
+    params->ldro = apps_common_compute_lora_ldro( sf, bw );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,224 @@
+/*!
+ * @file      asfs_link.h
+ *
+ * @brief     Per neighbour link quality and transmit spreading factor selection
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_LINK_H
+#define ASFS_LINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "apps_rx_pool.h"
+#include "asfs_nbr.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Offset in the payload of the 16-bit source address of the sender, sent MSB first
+ */
+#ifndef ASFS_LINK_ADDR_OFFSET
+#define ASFS_LINK_ADDR_OFFSET 0
+#endif
+
+/*!
+ * @brief Lowest spreading factor a neighbour is sent to, the receivers have to scan it
+ */
+#ifndef ASFS_LINK_SF_MIN
+#define ASFS_LINK_SF_MIN SX126X_LORA_SF7
+#endif
+
+/*!
+ * @brief Highest spreading factor a neighbour is sent to, also used for the neighbours not heard yet
+ */
+#ifndef ASFS_LINK_SF_MAX
+#define ASFS_LINK_SF_MAX SX126X_LORA_SF11
+#endif
+
+/*!
+ * @brief SNR to keep above the demodulation limit of the transmit spreading factor - in dB
+ */
+#ifndef ASFS_LINK_MARGIN_DB
+#define ASFS_LINK_MARGIN_DB 5
+#endif
+
+/*!
+ * @brief Extra margin needed to move to a lower spreading factor - in dB
+ *
+ * A link losing its margin moves up at once, it only moves down again once the SNR rose by this much more
+ */
+#ifndef ASFS_LINK_HYSTERESIS_DB
+#define ASFS_LINK_HYSTERESIS_DB 3
+#endif
+
+/*!
+ * @brief Smoothing of the link SNR and RSSI, each packet moves them by 1 / 2^ASFS_LINK_AVG_SHIFT towards its values
+ */
+#ifndef ASFS_LINK_AVG_SHIFT
+#define ASFS_LINK_AVG_SHIFT 2
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Address of a node
+ */
+typedef asfs_nbr_id_t asfs_link_addr_t;
+
+/*!
+ * @brief Link to one neighbour, as measured on the packets received from it
+ */
+typedef struct asfs_link_neighbor_s
+{
+    asfs_link_addr_t addr;
+    int16_t          snr_q4;           //!< Average SNR of the packets - in 1/16 dB
+    int16_t          rssi_q4;          //!< Average RSSI of the packets - in 1/16 dBm
+    sx126x_lora_sf_t rx_sf;            //!< Spreading factor of the last packet
+    sx126x_lora_bw_t bw;               //!< Bandwidth of the last packet, also used to transmit
+    sx126x_lora_sf_t tx_sf;            //!< Lowest spreading factor keeping the margin, with hysteresis
+    uint32_t         last_seen_in_ms;  //!< Time of the last packet
+    uint32_t         rx_count;         //!< Packets received from the neighbour
+    uint16_t         sf_changes;       //!< Number of tx_sf changes
+} asfs_link_neighbor_t;
+
+/*!
+ * @brief Link counters
+ */
+typedef struct asfs_link_stats_s
+{
+    uint32_t updates;        //!< Packets accounted to a neighbour
+    uint32_t short_packets;  //!< Packets too short to carry a source address
+} asfs_link_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget every neighbour and reset the counters
+ */
+void asfs_link_init( void );
+
+/*!
+ * @brief Account a received packet to its sender and update the transmit spreading factor towards it
+ *
+ * The sender is added to the neighbour table if needed, see asfs_nbr_insert.
+ *
+ * @param [in] desc Descriptor of the packet, with its payload and status
+ *
+ * @returns false if the packet does not carry a source address
+ */
+bool asfs_link_on_rx( const apps_rx_pkt_desc_t* desc );
+
+/*!
+ * @brief Get the address of the sender of a received packet
+ *
+ * @param [in] desc Descriptor of the packet
+ * @param [out] addr Address found at ASFS_LINK_ADDR_OFFSET in the payload
+ *
+ * @returns false if the packet is too short to carry a source address
+ */
+bool asfs_link_get_src( const apps_rx_pkt_desc_t* desc, asfs_link_addr_t* addr );
+
+/*!
+ * @brief Get the link to a neighbour
+ *
+ * @param [in] addr Address of the neighbour
+ * @param [out] neighbor Copy of the link
+ *
+ * @returns false if the neighbour is not in the table
+ */
+bool asfs_link_get_neighbor( asfs_link_addr_t addr, asfs_link_neighbor_t* neighbor );
+
+/*!
+ * @brief Get the modulation parameters to transmit to a neighbour
+ *
+ * An unknown neighbour is sent to with ASFS_LINK_SF_MAX on LORA_BANDWIDTH.
+ *
+ * @param [in] addr Address of the neighbour
+ * @param [out] params Modulation parameters, with the low data rate optimization set for the spreading factor
+ *
+ * @returns true if the neighbour is known, false if the default parameters were returned
+ */
+bool asfs_link_get_tx_mod_params( asfs_link_addr_t addr, sx126x_mod_params_lora_t* params );
+
+/*!
+ * @brief Get the counters of the links and of the neighbour table
+ *
+ * @param [out] stats Link counters
+ * @param [out] nbr_stats Neighbour table counters, can be NULL
+ */
+void asfs_link_get_stats( asfs_link_stats_t* stats, asfs_nbr_stats_t* nbr_stats );
+
+/*!
+ * @brief Get the lowest SNR a packet can be demodulated at on a spreading factor
+ *
+ * @param [in] sf Spreading factor, SF5-SF12
+ *
+ * @returns Demodulation limit - in 1/16 dB
+ */
+int16_t asfs_link_get_snr_limit_q4( sx126x_lora_sf_t sf );
+
+/*!
+ * @brief Print every neighbour with its link, transmit spreading factor and time on air
+ */
+void asfs_link_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_LINK_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,273 @@
+/*!
+ * @file      asfs_nbr.c
+ *
+ * @brief     Fixed-capacity neighbour table with open addressing and clock eviction
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_nbr.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Mask wrapping a slot index around the table
+ */
+#define ASFS_NBR_MASK ( ASFS_NBR_CAPACITY - 1 )
+
+/*!
+ * @brief Move of the clock hand, odd so that it visits every slot once per turn
+ *
+ * Stepping one slot at a time would evict whole runs of neighbours in a row, leaving all the free slots behind the
+ * hand and long clusters everywhere else. The golden ratio of the capacity spreads the evictions over the table.
+ */
+#define ASFS_NBR_HAND_STEP ( ( ( ASFS_NBR_CAPACITY * 0x9E37u ) >> 16 ) | 1 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief First slot of the probe sequence of an identifier
+ *
+ * Node identifiers are often allocated in sequence or with a fixed stride: a plain multiplicative hash keeps them in
+ * a regular pattern which may fill runs of slots, the xor-shift between the two multiplications breaks it
+ */
+static inline uint16_t asfs_nbr_get_home( asfs_nbr_id_t id );
+
+/*!
+ * @brief Count the slots compared by a lookup
+ */
+static void asfs_nbr_count_probes( asfs_nbr_table_t* table, uint16_t probes );
+
+/*!
+ * @brief Copy every field of a neighbour to another slot
+ */
+static void asfs_nbr_move( asfs_nbr_table_t* table, uint16_t dst, uint16_t src );
+
+/*!
+ * @brief Empty a slot and move back the following neighbours which belong before it
+ */
+static void asfs_nbr_remove_slot( asfs_nbr_table_t* table, uint16_t slot );
+
+/*!
+ * @brief Move the clock hand until a neighbour not referenced since the last pass is found, and evict it
+ */
+static void asfs_nbr_evict( asfs_nbr_table_t* table );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_nbr_init( asfs_nbr_table_t* table )
+{
+    memset( table, 0, sizeof( asfs_nbr_table_t ) );
+}
+
+uint16_t asfs_nbr_find( asfs_nbr_table_t* table, asfs_nbr_id_t id )
+{
+    uint16_t slot   = asfs_nbr_get_home( id );
+    uint16_t probes = 1;
+
+    while( ( table->flags[slot] & ASFS_NBR_FLAG_USED ) != 0 )
+    {
+        if( table->ids[slot] == id )
+        {
+            table->flags[slot] |= ASFS_NBR_FLAG_REFERENCED;
+            asfs_nbr_count_probes( table, probes );
+            return slot;
+        }
+        slot = ( slot + 1 ) & ASFS_NBR_MASK;
+        probes++;
+    }
+    asfs_nbr_count_probes( table, probes );
+    return ASFS_NBR_NONE;
+}
+
+uint16_t asfs_nbr_insert( asfs_nbr_table_t* table, asfs_nbr_id_t id, bool* is_new )
+{
+    uint16_t slot = asfs_nbr_find( table, id );
+
+    if( is_new != NULL )
+    {
+        *is_new = ( slot == ASFS_NBR_NONE );
+    }
+    if( slot != ASFS_NBR_NONE )
+    {
+        return slot;
+    }
+
+    if( table->n_entries >= ASFS_NBR_MAX_ENTRIES )
+    {
+        asfs_nbr_evict( table );
+    }
+
+    // The lookup stopped on the first free slot, but the eviction may have freed an earlier one
+    slot = asfs_nbr_get_home( id );
+    while( ( table->flags[slot] & ASFS_NBR_FLAG_USED ) != 0 )
+    {
+        slot = ( slot + 1 ) & ASFS_NBR_MASK;
+    }
+
+    table->ids[slot]             = id;
+    table->flags[slot]           = ASFS_NBR_FLAG_USED | ASFS_NBR_FLAG_REFERENCED;
+    table->rx_sf[slot]           = 0;
+    table->bw[slot]              = 0;
+    table->tx_sf[slot]           = 0;
+    table->rssi_q4[slot]         = 0;
+    table->snr_q4[slot]          = 0;
+    table->last_seen_in_ms[slot] = 0;
+    table->rx_count[slot]        = 0;
+    table->sf_changes[slot]      = 0;
+    table->n_entries++;
+    return slot;
+}
+
+bool asfs_nbr_remove( asfs_nbr_table_t* table, asfs_nbr_id_t id )
+{
+    const uint16_t slot = asfs_nbr_find( table, id );
+
+    if( slot == ASFS_NBR_NONE )
+    {
+        return false;
+    }
+    asfs_nbr_remove_slot( table, slot );
+    return true;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static inline uint16_t asfs_nbr_get_home( asfs_nbr_id_t id )
+{
+    uint32_t hash = ( uint32_t ) id * 0x9E3779B1u;
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    return ( uint16_t )( hash >> ( 32 - ASFS_NBR_CAPACITY_LOG2 ) );
+}
+
+static void asfs_nbr_count_probes( asfs_nbr_table_t* table, uint16_t probes )
+{
+    table->stats.lookups++;
+    table->stats.probes += probes;
+    if( probes > table->stats.max_probes )
+    {
+        table->stats.max_probes = probes;
+    }
+}
+
+static void asfs_nbr_move( asfs_nbr_table_t* table, uint16_t dst, uint16_t src )
+{
+    table->ids[dst]             = table->ids[src];
+    table->flags[dst]           = table->flags[src];
+    table->rx_sf[dst]           = table->rx_sf[src];
+    table->bw[dst]              = table->bw[src];
+    table->tx_sf[dst]           = table->tx_sf[src];
+    table->rssi_q4[dst]         = table->rssi_q4[src];
+    table->snr_q4[dst]          = table->snr_q4[src];
+    table->last_seen_in_ms[dst] = table->last_seen_in_ms[src];
+    table->rx_count[dst]        = table->rx_count[src];
+    table->sf_changes[dst]      = table->sf_changes[src];
+}
+
+static void asfs_nbr_remove_slot( asfs_nbr_table_t* table, uint16_t slot )
+{
+    uint16_t hole = slot;
+    uint16_t next = ( slot + 1 ) & ASFS_NBR_MASK;
+
+    while( ( table->flags[next] & ASFS_NBR_FLAG_USED ) != 0 )
+    {
+        const uint16_t home = asfs_nbr_get_home( table->ids[next] );
+
+        // The neighbour can fill the hole if the hole is not before its home slot, wrapping around included
+        if( ( ( next - home ) & ASFS_NBR_MASK ) >= ( ( next - hole ) & ASFS_NBR_MASK ) )
+        {
+            asfs_nbr_move( table, hole, next );
+            hole = next;
+        }
+        next = ( next + 1 ) & ASFS_NBR_MASK;
+    }
+    table->flags[hole] = 0;
+    table->n_entries--;
+}
+
+static void asfs_nbr_evict( asfs_nbr_table_t* table )
+{
+    // At most two passes: the first one clears every referenced flag
+    for( ;; )
+    {
+        const uint16_t slot = table->hand;
+
+        table->hand = ( table->hand + ASFS_NBR_HAND_STEP ) & ASFS_NBR_MASK;
+        if( ( table->flags[slot] & ASFS_NBR_FLAG_USED ) == 0 )
+        {
+            continue;
+        }
+        if( ( table->flags[slot] & ASFS_NBR_FLAG_REFERENCED ) != 0 )
+        {
+            table->flags[slot] &= ( uint8_t ) ~ASFS_NBR_FLAG_REFERENCED;
+            continue;
+        }
+        asfs_nbr_remove_slot( table, slot );
+        table->stats.evictions++;
+        return;
+    }
+}
+
+/* --- EOF ------------------------------------------------------------------ */
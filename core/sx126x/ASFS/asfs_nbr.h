@@ -0,0 +1,188 @@
+/*!
+ * @file      asfs_nbr.h
+ *
+ * @brief     Fixed-capacity neighbour table with open addressing and clock eviction
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_NBR_H
+#define ASFS_NBR_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of slots of the table as a power of two
+ *
+ * Only 3/4 of the slots are filled, so that a lookup seldom probes more than a couple of them
+ */
+#ifndef ASFS_NBR_CAPACITY_LOG2
+#define ASFS_NBR_CAPACITY_LOG2 5
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of slots of the table
+ */
+#define ASFS_NBR_CAPACITY ( 1u << ASFS_NBR_CAPACITY_LOG2 )
+
+/*!
+ * @brief Number of neighbours held before the clock evicts one for each new one
+ */
+#define ASFS_NBR_MAX_ENTRIES ( ASFS_NBR_CAPACITY - ASFS_NBR_CAPACITY / 4 )
+
+/*!
+ * @brief Slot index returned when a neighbour is not in the table
+ */
+#define ASFS_NBR_NONE 0xFFFF
+
+/*!
+ * @brief Bits of the slot flags
+ */
+#define ASFS_NBR_FLAG_USED 0x01        //!< The slot holds a neighbour
+#define ASFS_NBR_FLAG_REFERENCED 0x02  //!< The neighbour was used since the clock hand last passed
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Node identifier
+ */
+typedef uint16_t asfs_nbr_id_t;
+
+/*!
+ * @brief Table counters
+ */
+typedef struct asfs_nbr_stats_s
+{
+    uint32_t lookups;     //!< Calls to asfs_nbr_find and asfs_nbr_insert
+    uint32_t probes;      //!< Slots compared by the lookups
+    uint16_t max_probes;  //!< Longest lookup
+    uint32_t evictions;   //!< Neighbours evicted by the clock to make room
+} asfs_nbr_stats_t;
+
+/*!
+ * @brief Neighbour table, laid out as one array per field
+ *
+ * A lookup only walks ids and flags, which stay in a few cache lines whatever the number of fields. The fields of a
+ * neighbour are read and written by the caller at the slot index returned by asfs_nbr_find or asfs_nbr_insert.
+ * Slot indexes are only valid until the next insertion, which may move the neighbours.
+ */
+typedef struct asfs_nbr_table_s
+{
+    asfs_nbr_id_t    ids[ASFS_NBR_CAPACITY];
+    uint8_t          flags[ASFS_NBR_CAPACITY];            //!< ASFS_NBR_FLAG_xxx
+    uint8_t          rx_sf[ASFS_NBR_CAPACITY];            //!< Spreading factor of the last packet received
+    uint8_t          bw[ASFS_NBR_CAPACITY];               //!< Bandwidth of the last packet received
+    uint8_t          tx_sf[ASFS_NBR_CAPACITY];            //!< Spreading factor to transmit with
+    int16_t          rssi_q4[ASFS_NBR_CAPACITY];          //!< Average RSSI - in 1/16 dBm
+    int16_t          snr_q4[ASFS_NBR_CAPACITY];           //!< Average SNR - in 1/16 dB
+    uint32_t         last_seen_in_ms[ASFS_NBR_CAPACITY];  //!< Time of the last packet received
+    uint32_t         rx_count[ASFS_NBR_CAPACITY];         //!< Packets received
+    uint16_t         sf_changes[ASFS_NBR_CAPACITY];       //!< Changes of tx_sf
+    uint16_t         n_entries;                           //!< Neighbours in the table
+    uint16_t         hand;                                //!< Next slot looked at by the clock
+    asfs_nbr_stats_t stats;
+} asfs_nbr_table_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Empty a table and reset its counters
+ *
+ * @param [out] table Table
+ */
+void asfs_nbr_init( asfs_nbr_table_t* table );
+
+/*!
+ * @brief Find a neighbour, and mark it referenced
+ *
+ * @param [in,out] table Table
+ * @param [in] id Identifier of the neighbour
+ *
+ * @returns Slot of the neighbour, ASFS_NBR_NONE if it is not in the table
+ */
+uint16_t asfs_nbr_find( asfs_nbr_table_t* table, asfs_nbr_id_t id );
+
+/*!
+ * @brief Find a neighbour, or add it with all its fields cleared
+ *
+ * When ASFS_NBR_MAX_ENTRIES neighbours are already there, the clock hand walks the slots, clearing the referenced
+ * flags, and evicts the first neighbour not referenced since its last pass.
+ *
+ * @param [in,out] table Table
+ * @param [in] id Identifier of the neighbour
+ * @param [out] is_new Set to true if the neighbour was added, can be NULL
+ *
+ * @returns Slot of the neighbour
+ */
+uint16_t asfs_nbr_insert( asfs_nbr_table_t* table, asfs_nbr_id_t id, bool* is_new );
+
+/*!
+ * @brief Remove a neighbour, the following ones of its probe sequence are moved back so no tombstone is left
+ *
+ * @param [in,out] table Table
+ * @param [in] id Identifier of the neighbour
+ *
+ * @returns true if the neighbour was in the table
+ */
+bool asfs_nbr_remove( asfs_nbr_table_t* table, asfs_nbr_id_t id );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_NBR_H
+
+/* --- EOF ------------------------------------------------------------------ */
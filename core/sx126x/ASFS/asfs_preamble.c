@@ -0,0 +1,187 @@
+/*!
+ * @file      asfs_preamble.c
+ *
+ * @brief     Preamble length of the frames sent, long enough for the CAD sweep of the receivers to catch them
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include "asfs_preamble.h"
+#include "apps_common.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_preamble_profile_t preamble_profiles[ASFS_PREAMBLE_MAX_PROFILES];
+
+static uint8_t preamble_n_profiles;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the profile of a spreading factor and bandwidth, NULL if none
+ */
+static asfs_preamble_profile_t* asfs_preamble_find( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_preamble_init( void )
+{
+    preamble_n_profiles = 0;
+}
+
+bool asfs_preamble_set_profile( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, uint32_t gap_in_us, uint32_t cad_in_us )
+{
+    asfs_preamble_profile_t* profile = asfs_preamble_find( sf, bw );
+
+    if( profile == NULL )
+    {
+        if( preamble_n_profiles >= ASFS_PREAMBLE_MAX_PROFILES )
+        {
+            return false;
+        }
+        profile     = &preamble_profiles[preamble_n_profiles++];
+        profile->sf = sf;
+        profile->bw = bw;
+    }
+
+    const uint64_t symb_time_in_ns = ( ( uint64_t ) 1000000000 << sf ) / sx126x_get_lora_bw_in_hz( bw );
+    // Rounded up, a symbol short and the CAD may end past the preamble
+    uint64_t symbols = ( ( ( uint64_t ) gap_in_us + cad_in_us ) * 1000 + symb_time_in_ns - 1 ) / symb_time_in_ns +
+                       ASFS_PREAMBLE_RX_SYMBOLS;
+
+    if( symbols < ASFS_PREAMBLE_MIN_SYMBOLS )
+    {
+        symbols = ASFS_PREAMBLE_MIN_SYMBOLS;
+    }
+    if( symbols > ASFS_PREAMBLE_MAX_SYMBOLS )
+    {
+        symbols = ASFS_PREAMBLE_MAX_SYMBOLS;
+    }
+    profile->gap_in_us = gap_in_us;
+    profile->cad_in_us = cad_in_us;
+    profile->symbols   = ( uint16_t ) symbols;
+    return true;
+}
+
+bool asfs_preamble_set_profiles_from_cells( const asfs_cell_table_t* table, uint8_t channel, bool is_guaranteed )
+{
+    // A cell is never left unchecked for longer than the maximum age plus a plain sweep, see asfs_cell.h
+    const uint32_t gap_in_us =
+        ( is_guaranteed == true ) ? table->max_age_in_ms * 1000 + table->sweep_in_us : table->sweep_in_us;
+
+    for( uint8_t i = 0; i < table->n_cells; i++ )
+    {
+        const asfs_cell_t* cell = &table->cells[i];
+
+        if( ( cell->channel == channel ) &&
+            ( asfs_preamble_set_profile( cell->sf, cell->bw, gap_in_us, cell->cost_in_us ) == false ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint16_t asfs_preamble_get_length( const sx126x_mod_params_lora_t* mod_params )
+{
+#if( ASFS_PREAMBLE_ADAPTIVE == true )
+    const asfs_preamble_profile_t* profile = asfs_preamble_find( mod_params->sf, mod_params->bw );
+
+    if( profile != NULL )
+    {
+        return profile->symbols;
+    }
+#else
+    ( void ) mod_params;
+#endif
+    return LORA_PREAMBLE_LENGTH;
+}
+
+void asfs_preamble_print( void )
+{
+    for( uint8_t i = 0; i < preamble_n_profiles; i++ )
+    {
+        const asfs_preamble_profile_t* profile = &preamble_profiles[i];
+
+        HAL_DBG_TRACE_INFO( "Preamble %s %s: CADs up to %u ms apart, %u us long - %u symbols instead of %u\n",
+                            sx126x_lora_sf_to_str( profile->sf ), sx126x_lora_bw_to_str( profile->bw ),
+                            profile->gap_in_us / 1000, profile->cad_in_us, profile->symbols, LORA_PREAMBLE_LENGTH );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static asfs_preamble_profile_t* asfs_preamble_find( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw )
+{
+    for( uint8_t i = 0; i < preamble_n_profiles; i++ )
+    {
+        if( ( preamble_profiles[i].sf == sf ) && ( preamble_profiles[i].bw == bw ) )
+        {
+            return &preamble_profiles[i];
+        }
+    }
+    return NULL;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,189 @@
+/*!
+ * @file      asfs_preamble.h
+ *
+ * @brief     Preamble length of the frames sent, long enough for the CAD sweep of the receivers to catch them
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_PREAMBLE_H
+#define ASFS_PREAMBLE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "asfs_cell.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Fit the preamble of each frame to the scan of the receivers, LORA_PREAMBLE_LENGTH for every frame otherwise
+ */
+#ifndef ASFS_PREAMBLE_ADAPTIVE
+#define ASFS_PREAMBLE_ADAPTIVE true
+#endif
+
+/*!
+ * @brief Cover the longest gap between two CADs the cell scheduling allows, instead of a plain sweep of the cells
+ *
+ * A cell which led to packets is checked more often than once a sweep, one which never did may wait for up to three
+ * sweeps, see ASFS_CELL_MAX_AGE_MS.
+ */
+#ifndef ASFS_PREAMBLE_GUARANTEED
+#define ASFS_PREAMBLE_GUARANTEED false
+#endif
+
+/*!
+ * @brief Preamble symbols left after the CAD, for the receiver to switch to RX and lock on the frame
+ */
+#ifndef ASFS_PREAMBLE_RX_SYMBOLS
+#define ASFS_PREAMBLE_RX_SYMBOLS 6
+#endif
+
+/*!
+ * @brief Shortest preamble sent - in symbols
+ */
+#ifndef ASFS_PREAMBLE_MIN_SYMBOLS
+#define ASFS_PREAMBLE_MIN_SYMBOLS 8
+#endif
+
+/*!
+ * @brief Longest preamble sent - in symbols
+ *
+ * Lower it to bound the time on air, the frames are then only caught by the receivers whose CAD comes early enough.
+ */
+#ifndef ASFS_PREAMBLE_MAX_SYMBOLS
+#define ASFS_PREAMBLE_MAX_SYMBOLS 0xFFFF
+#endif
+
+/*!
+ * @brief Highest number of (spreading factor, bandwidth) pairs with a known scan
+ */
+#ifndef ASFS_PREAMBLE_MAX_PROFILES
+#define ASFS_PREAMBLE_MAX_PROFILES ASFS_CELL_MAX_CELLS
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief How the receivers scan one spreading factor and bandwidth on the transmit channel
+ */
+typedef struct asfs_preamble_profile_s
+{
+    sx126x_lora_sf_t sf;
+    sx126x_lora_bw_t bw;
+    uint32_t         gap_in_us;  //!< Longest time between the starts of two CADs on the cell
+    uint32_t         cad_in_us;  //!< Duration of a CAD on the cell
+    uint16_t         symbols;    //!< Preamble length computed for the cell
+} asfs_preamble_profile_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget every scan profile, all the frames then use LORA_PREAMBLE_LENGTH
+ */
+void asfs_preamble_init( void );
+
+/*!
+ * @brief Set how the receivers scan a spreading factor and bandwidth, and compute the preamble length of its frames
+ *
+ * A frame is caught if a whole CAD, then ASFS_PREAMBLE_RX_SYMBOLS, fit in its preamble whenever it starts, so the
+ * preamble lasts the longest gap between two CADs, plus one CAD, plus ASFS_PREAMBLE_RX_SYMBOLS. It is a number of
+ * symbols: a gap of the same length needs 16 times fewer symbols at SF11 than at SF7.
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ * @param [in] gap_in_us Longest time between the starts of two CADs on the cell
+ * @param [in] cad_in_us Duration of a CAD on the cell
+ *
+ * @returns false if there are already ASFS_PREAMBLE_MAX_PROFILES profiles
+ */
+bool asfs_preamble_set_profile( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, uint32_t gap_in_us, uint32_t cad_in_us );
+
+/*!
+ * @brief Set the profiles from the cells of a radio on a channel, for receivers scanning the same cells
+ *
+ * The scan of this node stands for the scan of the receivers: the preambles only fit if every receiver sweeps the
+ * same channels, bandwidths and spreading factors with the same wait and CAD parameters. Otherwise, the scan of the
+ * receivers has to be given with asfs_preamble_set_profile.
+ *
+ * @param [in] table Cells of the radio
+ * @param [in] channel Index of the transmit channel in the channel plan
+ * @param [in] is_guaranteed true to cover the longest gap the cell scheduling allows, false to cover a plain sweep
+ *
+ * @returns false if the profiles do not fit
+ */
+bool asfs_preamble_set_profiles_from_cells( const asfs_cell_table_t* table, uint8_t channel, bool is_guaranteed );
+
+/*!
+ * @brief Get the preamble length of a frame
+ *
+ * @param [in] mod_params Modulation of the frame
+ *
+ * @returns The length computed for its spreading factor and bandwidth, LORA_PREAMBLE_LENGTH if no receiver scans them
+ *          or ASFS_PREAMBLE_ADAPTIVE is false
+ */
+uint16_t asfs_preamble_get_length( const sx126x_mod_params_lora_t* mod_params );
+
+/*!
+ * @brief Print the gap, CAD duration and preamble length of every profile
+ */
+void asfs_preamble_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_PREAMBLE_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,349 @@
+/*!
+ * @file      asfs_predict.c
+ *
+ * @brief     Period and phase of the periodic neighbours, to scan where and when their next frame is expected
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "asfs_predict.h"
+#include "apps_common.h"
+#include "asfs_preamble.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Weight of a new interval in the period and jitter averages, as a power of two
+ */
+#define ASFS_PREDICT_AVG_SHIFT 2
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_predict_entry_t predict_entries[ASFS_PREDICT_MAX_NEIGHBORS];
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the entry of a neighbour, or the one to reuse for it if it has none
+ *
+ * @returns Pointer to the entry, is_used is false if it has to be initialized
+ */
+static asfs_predict_entry_t* asfs_predict_get( asfs_link_addr_t addr );
+
+/*!
+ * @brief Get the time from the start of a frame to its RX_DONE
+ *
+ * The neighbours scan like this node, so their frames carry the preamble it would send on the same cell.
+ */
+static uint32_t asfs_predict_get_lead_in_ms( const apps_rx_pkt_desc_t* desc );
+
+/*!
+ * @brief Match the interval between two frames against the period of a neighbour
+ *
+ * @returns true if the interval is a multiple of the period, count of periods in n_periods
+ */
+static bool asfs_predict_match( asfs_predict_entry_t* entry, uint32_t interval_in_ms, uint32_t* n_periods );
+
+/*!
+ * @brief Half width of the scan windows of a neighbour
+ */
+static uint32_t asfs_predict_get_guard_in_ms( const asfs_predict_entry_t* entry );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_predict_init( void )
+{
+    memset( predict_entries, 0, sizeof( predict_entries ) );
+}
+
+bool asfs_predict_on_rx( const apps_rx_pkt_desc_t* desc )
+{
+    asfs_link_addr_t      addr;
+    asfs_predict_entry_t* entry;
+    uint32_t              n_periods;
+
+    if( asfs_link_get_src( desc, &addr ) == false )
+    {
+        return false;
+    }
+
+    entry                  = asfs_predict_get( addr );
+    const uint32_t start   = desc->timestamp_in_ms - asfs_predict_get_lead_in_ms( desc );
+    const uint32_t elapsed = start - entry->last_start_in_ms;
+
+    if( entry->is_used == false )
+    {
+        memset( entry, 0, sizeof( *entry ) );
+        entry->is_used = true;
+        entry->addr    = addr;
+    }
+    else if( asfs_predict_match( entry, elapsed, &n_periods ) == true )
+    {
+        if( entry->is_locked == true )
+        {
+            entry->caught_count++;
+            entry->missed_count += n_periods - 1;
+        }
+        else if( ++entry->matches >= ASFS_PREDICT_LOCK_COUNT )
+        {
+            entry->is_locked       = true;
+            entry->lock_time_in_ms = start - entry->first_rx_in_ms;
+            HAL_DBG_TRACE_INFO( "Neighbour 0x%04x predicted every %u ms on %s / %s after %u ms\n", addr,
+                                entry->period_in_ms, sx126x_lora_sf_to_str( desc->sf ),
+                                sx126x_lora_bw_to_str( desc->bw ), entry->lock_time_in_ms );
+        }
+    }
+    else if( entry->is_locked == true )
+    {
+        // An event-driven frame in between, the periodic frames keep their phase
+        entry->rx_count++;
+        return true;
+    }
+    else if( ( elapsed >= ASFS_PREDICT_MIN_PERIOD_MS ) && ( elapsed <= ASFS_PREDICT_MAX_PERIOD_MS ) )
+    {
+        // First interval, or the previous guess was wrong: try this one as the period
+        entry->period_in_ms   = elapsed;
+        entry->jitter_in_ms   = 0;
+        entry->matches        = 1;
+        entry->first_rx_in_ms = entry->last_start_in_ms;
+    }
+    else
+    {
+        entry->matches = 0;
+    }
+
+    entry->last_start_in_ms = start;
+    entry->channel          = desc->channel;
+    entry->sf               = desc->sf;
+    entry->bw               = desc->bw;
+    entry->rx_count++;
+
+    return true;
+}
+
+bool asfs_predict_get_next_window( uint32_t now_in_ms, sx126x_lora_sf_t sf_first, sx126x_lora_sf_t sf_last,
+                                   asfs_predict_window_t* window )
+{
+    bool is_found = false;
+
+    for( uint8_t i = 0; i < ASFS_PREDICT_MAX_NEIGHBORS; i++ )
+    {
+        asfs_predict_entry_t* entry = &predict_entries[i];
+
+        if( ( entry->is_locked == false ) || ( entry->sf < sf_first ) || ( entry->sf > sf_last ) )
+        {
+            continue;
+        }
+
+        // Windows k >= 1 are centred on last_start + k * period, count the ones which closed already
+        const uint32_t guard_in_ms = asfs_predict_get_guard_in_ms( entry );
+        const uint32_t elapsed     = now_in_ms - entry->last_start_in_ms;
+        const uint32_t n_passed = ( elapsed >= entry->period_in_ms + guard_in_ms )
+                                      ? ( elapsed - guard_in_ms ) / entry->period_in_ms
+                                      : 0;
+
+        if( n_passed > ASFS_PREDICT_MAX_MISSES )
+        {
+            entry->is_locked = false;
+            entry->matches   = 0;
+            entry->missed_count += n_passed;
+            HAL_DBG_TRACE_INFO( "Neighbour 0x%04x no longer predicted, %u windows missed\n", entry->addr, n_passed );
+            continue;
+        }
+
+        const uint32_t center_in_ms = entry->last_start_in_ms + ( n_passed + 1 ) * entry->period_in_ms;
+
+        if( ( is_found == false ) || ( ( int32_t )( center_in_ms - guard_in_ms - window->open_in_ms ) < 0 ) )
+        {
+            window->addr        = entry->addr;
+            window->channel     = entry->channel;
+            window->sf          = entry->sf;
+            window->bw          = entry->bw;
+            window->open_in_ms  = center_in_ms - guard_in_ms;
+            window->close_in_ms = center_in_ms + guard_in_ms;
+            is_found            = true;
+        }
+    }
+
+    return is_found;
+}
+
+uint8_t asfs_predict_get_n_locked( void )
+{
+    uint8_t n_locked = 0;
+
+    for( uint8_t i = 0; i < ASFS_PREDICT_MAX_NEIGHBORS; i++ )
+    {
+        if( predict_entries[i].is_locked == true )
+        {
+            n_locked++;
+        }
+    }
+    return n_locked;
+}
+
+void asfs_predict_print( void )
+{
+    HAL_DBG_TRACE_INFO( "Predicted neighbours: %u/%u\n", asfs_predict_get_n_locked( ), ASFS_PREDICT_MAX_NEIGHBORS );
+    for( uint8_t i = 0; i < ASFS_PREDICT_MAX_NEIGHBORS; i++ )
+    {
+        const asfs_predict_entry_t* entry = &predict_entries[i];
+
+        if( entry->is_used == false )
+        {
+            continue;
+        }
+        HAL_DBG_TRACE_INFO( "  0x%04x: %u frames on %s / %s, channel %u - %s, period %u ms, jitter %u ms, locked "
+                            "after %u ms, %u caught, %u windows missed\n",
+                            entry->addr, entry->rx_count, sx126x_lora_sf_to_str( entry->sf ),
+                            sx126x_lora_bw_to_str( entry->bw ), entry->channel,
+                            ( entry->is_locked == true ) ? "predicted" : "learning", entry->period_in_ms,
+                            entry->jitter_in_ms, entry->lock_time_in_ms, entry->caught_count, entry->missed_count );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static asfs_predict_entry_t* asfs_predict_get( asfs_link_addr_t addr )
+{
+    asfs_predict_entry_t* oldest = &predict_entries[0];
+
+    for( uint8_t i = 0; i < ASFS_PREDICT_MAX_NEIGHBORS; i++ )
+    {
+        asfs_predict_entry_t* entry = &predict_entries[i];
+
+        if( entry->is_used == false )
+        {
+            return entry;
+        }
+        if( entry->addr == addr )
+        {
+            return entry;
+        }
+        // Every used entry has a frame, the one heard least recently has the oldest one
+        if( ( int32_t )( entry->last_start_in_ms - oldest->last_start_in_ms ) < 0 )
+        {
+            oldest = entry;
+        }
+    }
+
+    oldest->is_used = false;
+    return oldest;
+}
+
+static uint32_t asfs_predict_get_lead_in_ms( const apps_rx_pkt_desc_t* desc )
+{
+    const sx126x_mod_params_lora_t mod_params = {
+        .sf   = desc->sf,
+        .bw   = desc->bw,
+        .cr   = LORA_CODING_RATE,
+        .ldro = apps_common_compute_lora_ldro( desc->sf, desc->bw ),
+    };
+    const sx126x_pkt_params_lora_t pkt_params = {
+        .preamble_len_in_symb = asfs_preamble_get_length( &mod_params ),
+        .header_type          = LORA_PKT_LEN_MODE,
+        .pld_len_in_bytes     = desc->size,
+        .crc_is_on            = LORA_CRC,
+        .invert_iq_is_on      = LORA_IQ,
+    };
+
+    return sx126x_get_lora_time_on_air_in_ms( &pkt_params, &mod_params );
+}
+
+static bool asfs_predict_match( asfs_predict_entry_t* entry, uint32_t interval_in_ms, uint32_t* n_periods )
+{
+    if( entry->matches == 0 )
+    {
+        return false;
+    }
+
+    const uint32_t tolerance_in_ms =
+        ASFS_PREDICT_TOLERANCE_MS + ( entry->period_in_ms * ASFS_PREDICT_TOLERANCE_PERMILLE ) / 1000;
+
+    *n_periods = ( interval_in_ms + entry->period_in_ms / 2 ) / entry->period_in_ms;
+    if( *n_periods == 0 )
+    {
+        return false;
+    }
+
+    const int32_t error_in_ms = ( int32_t )( interval_in_ms - *n_periods * entry->period_in_ms );
+
+    if( ( uint32_t ) abs( error_in_ms ) > tolerance_in_ms )
+    {
+        return false;
+    }
+
+    // Spread the error over the periods it built up in
+    entry->period_in_ms += error_in_ms / ( int32_t )( *n_periods << ASFS_PREDICT_AVG_SHIFT );
+    entry->jitter_in_ms += ( ( int32_t ) abs( error_in_ms ) - ( int32_t ) entry->jitter_in_ms ) /
+                           ( 1 << ASFS_PREDICT_AVG_SHIFT );
+    return true;
+}
+
+static uint32_t asfs_predict_get_guard_in_ms( const asfs_predict_entry_t* entry )
+{
+    return ASFS_PREDICT_GUARD_MS + 2 * entry->jitter_in_ms;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
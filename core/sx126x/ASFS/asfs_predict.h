@@ -0,0 +1,208 @@
+/*!
+ * @file      asfs_predict.h
+ *
+ * @brief     Period and phase of the periodic neighbours, to scan where and when their next frame is expected
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_PREDICT_H
+#define ASFS_PREDICT_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "apps_rx_pool.h"
+#include "asfs_link.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of neighbours whose period is tracked, the one heard least recently is replaced
+ */
+#ifndef ASFS_PREDICT_MAX_NEIGHBORS
+#define ASFS_PREDICT_MAX_NEIGHBORS 8
+#endif
+
+/*!
+ * @brief Shortest and longest period tracked - in milliseconds
+ */
+#ifndef ASFS_PREDICT_MIN_PERIOD_MS
+#define ASFS_PREDICT_MIN_PERIOD_MS 1000
+#endif
+#ifndef ASFS_PREDICT_MAX_PERIOD_MS
+#define ASFS_PREDICT_MAX_PERIOD_MS 3600000
+#endif
+
+/*!
+ * @brief Number of successive intervals matching the period before the neighbour is predicted
+ */
+#ifndef ASFS_PREDICT_LOCK_COUNT
+#define ASFS_PREDICT_LOCK_COUNT 2
+#endif
+
+/*!
+ * @brief Deviation from a multiple of the period still counted as a match: a fixed part for the timestamps, and
+ * a part of the period for the clock drift of both nodes - in milliseconds and per mille
+ */
+#ifndef ASFS_PREDICT_TOLERANCE_MS
+#define ASFS_PREDICT_TOLERANCE_MS 20
+#endif
+#ifndef ASFS_PREDICT_TOLERANCE_PERMILLE
+#define ASFS_PREDICT_TOLERANCE_PERMILLE 5
+#endif
+
+/*!
+ * @brief Half width of a scan window around the predicted start of a frame, without jitter - in milliseconds
+ *
+ * Twice the average jitter of the neighbour is added.
+ */
+#ifndef ASFS_PREDICT_GUARD_MS
+#define ASFS_PREDICT_GUARD_MS 10
+#endif
+
+/*!
+ * @brief Number of windows in a row without a frame after which the neighbour is no longer predicted
+ */
+#ifndef ASFS_PREDICT_MAX_MISSES
+#define ASFS_PREDICT_MAX_MISSES 3
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Timing of the frames of one neighbour
+ */
+typedef struct asfs_predict_entry_s
+{
+    bool             is_used;
+    bool             is_locked;         //!< The period is known, the next frames are predicted
+    asfs_link_addr_t addr;              //!< Address of the neighbour
+    uint8_t          channel;           //!< Channel of the last frame
+    sx126x_lora_sf_t sf;                //!< Spreading factor of the last frame
+    sx126x_lora_bw_t bw;                //!< Bandwidth of the last frame
+    uint8_t          matches;           //!< Successive intervals matching the period
+    uint32_t         last_start_in_ms;  //!< Start of the last frame: its RX_DONE time less its time on air
+    uint32_t         first_rx_in_ms;    //!< Time of the first frame, or of the first one after losing the lock
+    uint32_t         period_in_ms;      //!< Average interval between two frames
+    uint32_t         jitter_in_ms;      //!< Average deviation of the intervals from the period
+    uint32_t         lock_time_in_ms;   //!< Time from the first frame to the lock
+    uint32_t         rx_count;          //!< Frames received
+    uint32_t         caught_count;      //!< Frames received where they were predicted
+    uint32_t         missed_count;      //!< Predicted windows without a frame
+} asfs_predict_entry_t;
+
+/*!
+ * @brief Time, channel and modulation where the next frame of a neighbour is expected
+ */
+typedef struct asfs_predict_window_s
+{
+    asfs_link_addr_t addr;         //!< Address of the neighbour
+    uint8_t          channel;      //!< Index of the channel in the channel plan
+    sx126x_lora_sf_t sf;           //!< Spreading factor
+    sx126x_lora_bw_t bw;           //!< Bandwidth
+    uint32_t         open_in_ms;   //!< Earliest time of the start of the frame
+    uint32_t         close_in_ms;  //!< Latest time of the start of the frame
+} asfs_predict_window_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget every neighbour
+ */
+void asfs_predict_init( void );
+
+/*!
+ * @brief Account for the timestamp of a received frame
+ *
+ * The interval from the previous frame of the sender is matched against a multiple of its period, so that missed
+ * frames do not break the lock. After ASFS_PREDICT_LOCK_COUNT matches, the next frames are predicted.
+ *
+ * @param [in] desc Descriptor of the packet, with its RX_DONE timestamp and channel
+ *
+ * @returns false if the packet does not carry a source address
+ */
+bool asfs_predict_on_rx( const apps_rx_pkt_desc_t* desc );
+
+/*!
+ * @brief Get the earliest window, not closed yet, where a frame is expected on a range of spreading factors
+ *
+ * The neighbours whose windows passed ASFS_PREDICT_MAX_MISSES times in a row without a frame lose their lock.
+ *
+ * @param [in] now_in_ms Current time
+ * @param [in] sf_first First spreading factor of the range
+ * @param [in] sf_last Last spreading factor of the range
+ * @param [out] window Next window, open already if open_in_ms is not after now_in_ms
+ *
+ * @returns false if no frame is expected on the range
+ */
+bool asfs_predict_get_next_window( uint32_t now_in_ms, sx126x_lora_sf_t sf_first, sx126x_lora_sf_t sf_last,
+                                   asfs_predict_window_t* window );
+
+/*!
+ * @brief Get the number of neighbours whose frames are predicted
+ */
+uint8_t asfs_predict_get_n_locked( void );
+
+/*!
+ * @brief Print the period, jitter and predicted frames of every neighbour
+ */
+void asfs_predict_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_PREDICT_H
+
+/* --- EOF ------------------------------------------------------------------ */
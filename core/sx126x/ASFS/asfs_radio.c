@@ -0,0 +1,273 @@
+/*!
+ * @file      asfs_radio.c
+ *
+ * @brief     Per-radio ASFS state and split of the spreading factors between several radios
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "asfs_radio.h"
+#include "apps_channel_plan.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Compare two sets of LoRa modulation parameters field by field
+ */
+static bool asfs_radio_lora_mod_params_are_equal( const sx126x_mod_params_lora_t* a,
+                                                   const sx126x_mod_params_lora_t* b );
+
+/*!
+ * @brief Compare two sets of CAD parameters field by field
+ */
+static bool asfs_radio_cad_params_are_equal( const sx126x_cad_params_t* a, const sx126x_cad_params_t* b );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_radio_init( asfs_radio_t* radio, uint8_t id, const void* context )
+{
+    memset( radio, 0, sizeof( asfs_radio_t ) );
+
+    radio->context  = context;
+    radio->id       = id;
+    radio->bw       = LORA_BANDWIDTH;
+    radio->sf_first = SX126X_LORA_SF7;
+    radio->sf_last  = SX126X_LORA_SF11;
+
+    asfs_radio_set_sf( radio, radio->sf_first );
+    asfs_ed_init( &radio->ed );
+}
+
+uint32_t asfs_radio_assign_sf_ranges( asfs_radio_t* radios, uint8_t n_radios, sx126x_lora_sf_t sf_first,
+                                      sx126x_lora_sf_t sf_last, asfs_radio_sf_cost_t get_sf_cost )
+{
+    const uint8_t n_sf           = sf_last - sf_first + 1;
+    const uint8_t n_split        = ( n_radios < n_sf ) ? n_radios : n_sf;
+    uint32_t      remaining_cost = 0;
+    uint32_t      worst_sweep    = 0;
+    uint8_t       sf             = sf_first;
+
+    for( uint8_t i = 0; i < n_sf; i++ )
+    {
+        remaining_cost += get_sf_cost( ( sx126x_lora_sf_t )( sf_first + i ) );
+    }
+
+    for( uint8_t i = 0; i < n_split; i++ )
+    {
+        // Even share of what is left, the last radio takes everything remaining
+        const uint32_t target     = remaining_cost / ( n_split - i );
+        const uint8_t  sf_max     = sf_last - ( n_split - 1 - i );
+        uint32_t       sweep_cost = get_sf_cost( ( sx126x_lora_sf_t ) sf );
+
+        radios[i].sf_first = ( sx126x_lora_sf_t ) sf;
+
+        // Take one more SF as long as it brings the sweep closer to the target
+        while( sf < sf_max )
+        {
+            const uint32_t next_cost = get_sf_cost( ( sx126x_lora_sf_t )( sf + 1 ) );
+
+            if( ( i != ( n_split - 1 ) ) && ( ( sweep_cost + next_cost / 2 ) > target ) )
+            {
+                break;
+            }
+            sweep_cost += next_cost;
+            sf++;
+        }
+
+        radios[i].sf_last = ( sx126x_lora_sf_t ) sf;
+        asfs_radio_set_sf( &radios[i], radios[i].sf_first );
+
+        remaining_cost -= sweep_cost;
+        if( sweep_cost > worst_sweep )
+        {
+            worst_sweep = sweep_cost;
+        }
+        sf++;
+    }
+
+    for( uint8_t i = n_split; i < n_radios; i++ )
+    {
+        radios[i].sf_first = radios[i % n_split].sf_first;
+        radios[i].sf_last  = radios[i % n_split].sf_last;
+        asfs_radio_set_sf( &radios[i], radios[i].sf_first );
+    }
+
+    for( uint8_t i = 0; i < n_radios; i++ )
+    {
+        HAL_DBG_TRACE_INFO( "Radio %d scans %s to %s\n", radios[i].id, sx126x_lora_sf_to_str( radios[i].sf_first ),
+                            sx126x_lora_sf_to_str( radios[i].sf_last ) );
+    }
+    HAL_DBG_TRACE_INFO( "Worst-case sweep: %u us\n", worst_sweep );
+
+    return worst_sweep;
+}
+
+void asfs_radio_set_sf( asfs_radio_t* radio, sx126x_lora_sf_t sf )
+{
+    radio->sf                   = sf;
+    radio->lora_mod_params.sf   = sf;
+    radio->lora_mod_params.bw   = radio->bw;
+    radio->lora_mod_params.cr   = LORA_CODING_RATE;
+    radio->lora_mod_params.ldro = apps_common_compute_lora_ldro( sf, radio->bw );
+}
+
+void asfs_radio_set_bw( asfs_radio_t* radio, sx126x_lora_bw_t bw )
+{
+    radio->bw = bw;
+    asfs_radio_set_sf( radio, radio->sf );
+}
+
+void asfs_radio_set_channel( asfs_radio_t* radio, uint8_t channel )
+{
+    radio->channel = channel;
+}
+
+void asfs_radio_configure( asfs_radio_t* radio )
+{
+    const uint32_t start_cycles = apps_common_get_cycle_count( );
+
+    apps_common_sx126x_radio_init_with_lora_mod_params( radio->context, &radio->lora_mod_params );
+    apps_channel_plan_set_channel( radio->context, radio->channel );
+    ASSERT_SX126X_RC( sx126x_set_cad_params( radio->context, &radio->cad_params ) );
+
+    radio->configured_channel         = radio->channel;
+    radio->configured_lora_mod_params = radio->lora_mod_params;
+    radio->configured_cad_params      = radio->cad_params;
+    radio->is_configured              = true;
+
+    radio->power_stats.full_configs++;
+    radio->power_stats.last_config_in_us = apps_common_cycles_to_us( apps_common_get_cycle_count( ) - start_cycles );
+}
+
+void asfs_radio_sync_config( asfs_radio_t* radio )
+{
+    if( radio->is_configured == false )
+    {
+        asfs_radio_configure( radio );
+        return;
+    }
+
+    if( radio->channel != radio->configured_channel )
+    {
+        // Image calibration only if the channel is in another band
+        apps_channel_plan_set_channel( radio->context, radio->channel );
+        radio->configured_channel = radio->channel;
+        radio->power_stats.delta_commands++;
+    }
+
+    if( asfs_radio_lora_mod_params_are_equal( &radio->lora_mod_params, &radio->configured_lora_mod_params ) == false )
+    {
+        apps_common_sx126x_set_lora_mod_params( radio->context, &radio->lora_mod_params );
+        radio->configured_lora_mod_params = radio->lora_mod_params;
+        radio->power_stats.delta_commands++;
+    }
+
+    if( asfs_radio_cad_params_are_equal( &radio->cad_params, &radio->configured_cad_params ) == false )
+    {
+        ASSERT_SX126X_RC( sx126x_set_cad_params( radio->context, &radio->cad_params ) );
+        radio->configured_cad_params = radio->cad_params;
+        radio->power_stats.delta_commands++;
+    }
+}
+
+void asfs_radio_sleep( asfs_radio_t* radio )
+{
+    if( radio->is_asleep == false )
+    {
+        ASSERT_SX126X_RC( sx126x_set_sleep( radio->context, SX126X_SLEEP_CFG_WARM_START ) );
+        radio->is_asleep = true;
+    }
+}
+
+void asfs_radio_wake( asfs_radio_t* radio )
+{
+    if( radio->is_asleep == true )
+    {
+        ASSERT_SX126X_RC( sx126x_wakeup( radio->context ) );
+        radio->is_asleep = false;
+        radio->power_stats.wake_count++;
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static bool asfs_radio_lora_mod_params_are_equal( const sx126x_mod_params_lora_t* a,
+                                                   const sx126x_mod_params_lora_t* b )
+{
+    return ( a->sf == b->sf ) && ( a->bw == b->bw ) && ( a->cr == b->cr ) && ( a->ldro == b->ldro );
+}
+
+static bool asfs_radio_cad_params_are_equal( const sx126x_cad_params_t* a, const sx126x_cad_params_t* b )
+{
+    return ( a->cad_symb_nb == b->cad_symb_nb ) && ( a->cad_detect_peak == b->cad_detect_peak ) &&
+           ( a->cad_detect_min == b->cad_detect_min ) && ( a->cad_exit_mode == b->cad_exit_mode ) &&
+           ( a->cad_timeout == b->cad_timeout );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,223 @@
+/*!
+ * @file      asfs_radio.h
+ *
+ * @brief     Per-radio ASFS state and split of the spreading factors between several radios
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_RADIO_H
+#define ASFS_RADIO_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "apps_timer.h"
+#include "asfs_cell.h"
+#include "asfs_ed.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Time spent by a radio between two CADs, and cost of getting it ready for the next one
+ */
+typedef struct asfs_radio_power_stats_s
+{
+    uint32_t wake_count;              //!< Number of wake-ups from warm-start sleep
+    uint32_t sleep_time_in_ms;        //!< Time spent in warm-start sleep while waiting for a CAD
+    uint32_t stdby_time_in_ms;        //!< Time spent in STDBY_RC while waiting for a CAD
+    uint32_t delta_commands;          //!< Configuration commands sent on wake-up, on top of SetCad
+    uint32_t full_configs;            //!< Number of complete radio configurations
+    uint32_t last_config_in_us;       //!< Duration of the last complete radio configuration
+    uint32_t last_wake_to_cad_in_us;  //!< Time from the CAD due date to the end of SetCad, wake-up included
+    uint32_t max_wake_to_cad_in_us;   //!< Highest value of last_wake_to_cad_in_us
+} asfs_radio_power_stats_t;
+
+/*!
+ * @brief ASFS state of one radio, which sweeps its own contiguous range of spreading factors
+ */
+typedef struct asfs_radio_s
+{
+    const void*              context;            //!< Radio context, see apps_common_sx126x_get_radio_context
+    uint8_t                  id;                 //!< Index of the radio
+    sx126x_lora_sf_t         sf_first;           //!< First spreading factor of the range swept by this radio
+    sx126x_lora_sf_t         sf_last;            //!< Last spreading factor of the range swept by this radio
+    sx126x_lora_sf_t         sf;                 //!< Spreading factor currently scanned
+    sx126x_lora_bw_t         bw;                 //!< Bandwidth currently scanned
+    sx126x_mod_params_lora_t lora_mod_params;    //!< Modulation parameters programmed on the current SF
+    sx126x_cad_params_t      cad_params;         //!< CAD parameters programmed on the current SF
+    uint8_t                  channel;            //!< Index of the channel in the channel plan
+    uint32_t                 detection_counter;  //!< Activity detected since the last reset of the sweep
+    apps_timer_t             cad_timer;          //!< Starts the next CAD once its delay elapsed
+    bool                     is_cad_rx_ongoing;  //!< In RX after a CAD detection, no packet seen yet
+    bool                     is_tx_ongoing;      //!< Listening before talking, or transmitting a queued frame
+    uint32_t                 cad_start_count;    //!< Number of CAD commands sent to the radio
+    uint32_t                 cad_done_count;     //!< Number of CAD_DONE interrupts raised by the radio
+    uint32_t                 wait_start_in_ms;   //!< Time at which the radio started waiting for its next CAD
+    bool                     is_configured;      //!< The radio went through a complete configuration
+    bool                     is_asleep;          //!< The radio is in warm-start sleep
+    sx126x_mod_params_lora_t configured_lora_mod_params;  //!< Modulation parameters held by the radio
+    sx126x_cad_params_t      configured_cad_params;       //!< CAD parameters held by the radio
+    uint8_t                  configured_channel;          //!< Channel the radio is tuned on
+    asfs_radio_power_stats_t power_stats;
+    asfs_cell_table_t        cells;  //!< (channel, bandwidth, SF) cells of the sub-range, see asfs_cell.h
+    asfs_ed_t                ed;     //!< Energy detection run before the long CADs, see asfs_ed.h
+} asfs_radio_t;
+
+/*!
+ * @brief Time spent by a radio to check one spreading factor - in microseconds
+ */
+typedef uint32_t ( *asfs_radio_sf_cost_t )( sx126x_lora_sf_t sf );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Attach a radio context to an ASFS radio and reset its state
+ *
+ * @param [out] radio ASFS radio
+ * @param [in] id Index of the radio
+ * @param [in] context Pointer to the radio context
+ */
+void asfs_radio_init( asfs_radio_t* radio, uint8_t id, const void* context );
+
+/*!
+ * @brief Split a range of spreading factors between radios
+ *
+ * Each radio gets a contiguous and disjoint sub-range, sized so that the time needed to sweep it is as even
+ * as possible between the radios. As higher spreading factors take longer to check, the radio starting at
+ * the lowest one gets more of them. If there are more radios than spreading factors, the extra radios
+ * duplicate the last sub-ranges.
+ *
+ * @param [in,out] radios Array of ASFS radios
+ * @param [in] n_radios Number of radios in the array
+ * @param [in] sf_first First spreading factor to be scanned
+ * @param [in] sf_last Last spreading factor to be scanned
+ * @param [in] get_sf_cost Time needed to check one spreading factor
+ *
+ * @returns Worst-case time for the slowest radio to sweep its sub-range - in microseconds
+ */
+uint32_t asfs_radio_assign_sf_ranges( asfs_radio_t* radios, uint8_t n_radios, sx126x_lora_sf_t sf_first,
+                                      sx126x_lora_sf_t sf_last, asfs_radio_sf_cost_t get_sf_cost );
+
+/*!
+ * @brief Move a radio to a channel of the channel plan
+ *
+ * @remark The radio itself is not reconfigured
+ *
+ * @param [in,out] radio ASFS radio
+ * @param [in] channel Index of the channel, see apps_channel_plan.h
+ */
+void asfs_radio_set_channel( asfs_radio_t* radio, uint8_t channel );
+
+/*!
+ * @brief Move a radio to a spreading factor and update its modulation parameters accordingly
+ *
+ * @remark The radio itself is not reconfigured
+ *
+ * @param [in,out] radio ASFS radio
+ * @param [in] sf Spreading factor
+ */
+void asfs_radio_set_sf( asfs_radio_t* radio, sx126x_lora_sf_t sf );
+
+/*!
+ * @brief Move a radio to a bandwidth and update its modulation parameters accordingly
+ *
+ * @remark The radio itself is not reconfigured
+ *
+ * @param [in,out] radio ASFS radio
+ * @param [in] bw Bandwidth
+ */
+void asfs_radio_set_bw( asfs_radio_t* radio, sx126x_lora_bw_t bw );
+
+/*!
+ * @brief Send the complete configuration to a radio: common RF parameters, channel, modulation and CAD parameters
+ *
+ * @param [in,out] radio ASFS radio, in STDBY_RC
+ */
+void asfs_radio_configure( asfs_radio_t* radio );
+
+/*!
+ * @brief Send to a radio only the channel, modulation and CAD parameters which changed since they were last sent
+ *
+ * @remark A radio never configured gets the complete configuration
+ *
+ * @param [in,out] radio ASFS radio, in STDBY_RC
+ */
+void asfs_radio_sync_config( asfs_radio_t* radio );
+
+/*!
+ * @brief Put a radio in warm-start sleep, its configuration and calibrations are retained
+ *
+ * @remark The registers which are not retained by default are in the retention list, see apps_common_sx126x_init
+ *
+ * @param [in,out] radio ASFS radio, in STDBY_RC
+ */
+void asfs_radio_sleep( asfs_radio_t* radio );
+
+/*!
+ * @brief Wake a radio up from warm-start sleep, it is back in STDBY_RC when this function returns
+ *
+ * @param [in,out] radio ASFS radio, nothing is done if it is not asleep
+ */
+void asfs_radio_wake( asfs_radio_t* radio );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_RADIO_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,233 @@
+/*!
+ * @file      asfs_sniff.c
+ *
+ * @brief     ASFS variant relying on the SX126x autonomous RX duty cycle instead of MCU-driven CAD
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include "asfs_sniff.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x_str.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Duration of one step of the radio RTC (64 kHz), in nanoseconds
+ */
+#define ASFS_SNIFF_RTC_STEP_IN_NS 15625
+
+/*!
+ * @brief Range of spreading factors scanned, same as the CAD loop
+ */
+#define ASFS_SNIFF_SF_FIRST SX126X_LORA_SF7
+#define ASFS_SNIFF_SF_LAST SX126X_LORA_SF11
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static sx126x_lora_sf_t     sniff_sf = ASFS_SNIFF_SF_FIRST;
+static asfs_sniff_timings_t sniff_timings;
+static uint32_t             sniff_dwell_start_ms = 0;
+static uint32_t             sniff_dwell_in_ms    = 0;
+static bool                 sniff_pkt_ongoing    = false;
+static asfs_sniff_stats_t   sniff_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Reconfigure the modem on the current spreading factor and start the duty cycle
+ */
+static void asfs_sniff_program( const void* context );
+
+/*!
+ * @brief Convert a duration in microseconds to radio RTC steps, rounded down
+ */
+static uint32_t asfs_sniff_us_to_rtc_step( uint32_t time_in_us );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_sniff_compute_timings( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, uint16_t preamble_len_in_symb,
+                                 asfs_sniff_timings_t* timings )
+{
+    const uint32_t bw_in_hz    = sx126x_get_lora_bw_in_hz( bw );
+    const uint32_t symb_in_us  = ( uint32_t )( ( ( uint64_t ) 1000000 << sf ) / bw_in_hz );
+    const uint32_t preamble_us = symb_in_us * preamble_len_in_symb;
+    const uint32_t rx_us       = ( symb_in_us * ASFS_SNIFF_RX_SYMBOLS ) + ASFS_SNIFF_WAKEUP_US;
+
+    timings->symb_time_in_us     = symb_in_us;
+    timings->rx_time_in_rtc_step = asfs_sniff_us_to_rtc_step( rx_us );
+
+    if( preamble_us > ( 2 * rx_us ) )
+    {
+        timings->sleep_time_in_rtc_step = asfs_sniff_us_to_rtc_step( preamble_us - ( 2 * rx_us ) );
+    }
+    else
+    {
+        timings->sleep_time_in_rtc_step = 0;
+    }
+
+    timings->period_in_us = ( uint32_t )(
+        ( ( uint64_t )( timings->rx_time_in_rtc_step + timings->sleep_time_in_rtc_step ) * ASFS_SNIFF_RTC_STEP_IN_NS ) /
+        1000 );
+}
+
+void asfs_sniff_start( const void* context, sx126x_lora_sf_t sf )
+{
+    sniff_sf = sf;
+    asfs_sniff_program( context );
+}
+
+void asfs_sniff_restart( const void* context )
+{
+    asfs_sniff_program( context );
+}
+
+void asfs_sniff_on_preamble_detected( void )
+{
+    sniff_pkt_ongoing = true;
+    sniff_stats.preambles++;
+    sniff_stats.last_latency_ms = apps_common_get_time_in_ms( ) - sniff_dwell_start_ms;
+}
+
+void asfs_sniff_process( const void* context )
+{
+    if( ( sniff_pkt_ongoing == true ) || ( ( apps_common_get_time_in_ms( ) - sniff_dwell_start_ms ) < sniff_dwell_in_ms ) )
+    {
+        return;
+    }
+
+    sniff_sf = ( sniff_sf >= ASFS_SNIFF_SF_LAST ) ? ASFS_SNIFF_SF_FIRST : ( sx126x_lora_sf_t )( sniff_sf + 1 );
+    sniff_stats.sf_switches++;
+
+    asfs_sniff_program( context );
+}
+
+void asfs_sniff_get_stats( asfs_sniff_stats_t* stats )
+{
+    *stats = sniff_stats;
+}
+
+void asfs_sniff_print_budget( sx126x_lora_sf_t sf, sx126x_cad_symbs_t cad_symb_nb, uint32_t cad_interval_in_ms )
+{
+    asfs_sniff_timings_t timings;
+    const uint32_t       n_sf = ( ASFS_SNIFF_SF_LAST - ASFS_SNIFF_SF_FIRST ) + 1;
+
+    asfs_sniff_compute_timings( sf, LORA_BANDWIDTH, LORA_PREAMBLE_LENGTH, &timings );
+
+    // Sniff mode: RX window then warm sleep, repeated
+    const uint64_t rx_us       = ( ( uint64_t ) timings.rx_time_in_rtc_step * ASFS_SNIFF_RTC_STEP_IN_NS ) / 1000;
+    const uint64_t sleep_us    = ( ( uint64_t ) timings.sleep_time_in_rtc_step * ASFS_SNIFF_RTC_STEP_IN_NS ) / 1000;
+    const uint32_t sniff_avg_na = ( uint32_t )( ( rx_us * ASFS_SNIFF_CURRENT_RX_NA +
+                                                  sleep_us * ASFS_SNIFF_CURRENT_SLEEP_WARM_NA ) /
+                                                ( rx_us + sleep_us ) );
+    const uint32_t sniff_latency_ms = ( n_sf * ASFS_SNIFF_PERIODS_PER_SF * timings.period_in_us ) / 1000;
+
+    // CAD loop: CAD (about one more symbol of processing) then STDBY_RC while the MCU waits
+    const uint64_t cad_us      = ( uint64_t ) timings.symb_time_in_us * ( ( 1u << cad_symb_nb ) + 1 );
+    const uint64_t wait_us     = ( uint64_t ) cad_interval_in_ms * 1000;
+    const uint32_t cad_avg_na  = ( uint32_t )( ( cad_us * ASFS_SNIFF_CURRENT_RX_NA +
+                                                wait_us * ASFS_SNIFF_CURRENT_STDBY_RC_NA ) /
+                                              ( cad_us + wait_us ) );
+    const uint32_t cad_latency_ms = ( uint32_t )( ( n_sf * ( cad_us + wait_us ) ) / 1000 );
+
+    HAL_DBG_TRACE_INFO( "%s: sniff rx %u us / sleep %u us -> %u uAh/h, worst latency %u ms | "
+                        "CAD loop -> %u uAh/h, worst latency %u ms\n",
+                        sx126x_lora_sf_to_str( sf ), ( uint32_t ) rx_us, ( uint32_t ) sleep_us, sniff_avg_na / 1000,
+                        sniff_latency_ms, cad_avg_na / 1000, cad_latency_ms );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void asfs_sniff_program( const void* context )
+{
+    asfs_sniff_compute_timings( sniff_sf, LORA_BANDWIDTH, LORA_PREAMBLE_LENGTH, &sniff_timings );
+
+    ASSERT_SX126X_RC( sx126x_set_standby( context, SX126X_STANDBY_CFG_RC ) );
+
+    change_LORA_SPREADING_FACTOR_t( sniff_sf );
+    change_lora_mod_params( sniff_sf );
+    lora_mod_params.ldro = apps_common_compute_lora_ldro( sniff_sf, LORA_BANDWIDTH );
+    apps_common_sx126x_set_lora_mod_params( context, &lora_mod_params );
+
+    if( sniff_timings.sleep_time_in_rtc_step == 0 )
+    {
+        HAL_DBG_TRACE_WARNING( "Preamble too short for duty cycling on %s, staying in RX\n",
+                               sx126x_lora_sf_to_str( sniff_sf ) );
+        ASSERT_SX126X_RC( sx126x_set_rx_with_timeout_in_rtc_step( context, RX_CONTINUOUS ) );
+    }
+    else
+    {
+        ASSERT_SX126X_RC( sx126x_set_rx_duty_cycle_with_timings_in_rtc_step(
+            context, sniff_timings.rx_time_in_rtc_step, sniff_timings.sleep_time_in_rtc_step ) );
+    }
+
+    sniff_pkt_ongoing    = false;
+    sniff_dwell_start_ms = apps_common_get_time_in_ms( );
+    sniff_dwell_in_ms    = ( ASFS_SNIFF_PERIODS_PER_SF * sniff_timings.period_in_us + 999 ) / 1000;
+}
+
+static uint32_t asfs_sniff_us_to_rtc_step( uint32_t time_in_us )
+{
+    return ( uint32_t )( ( ( uint64_t ) time_in_us * 1000 ) / ASFS_SNIFF_RTC_STEP_IN_NS );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,192 @@
+/*!
+ * @file      asfs_sniff.h
+ *
+ * @brief     ASFS variant relying on the SX126x autonomous RX duty cycle instead of MCU-driven CAD
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_SNIFF_H
+#define ASFS_SNIFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of symbols the radio listens for in each RX window of the duty cycle
+ */
+#ifndef ASFS_SNIFF_RX_SYMBOLS
+#define ASFS_SNIFF_RX_SYMBOLS 4
+#endif
+
+/*!
+ * @brief Time needed by the radio to go from sleep to RX, added to each RX window - in microseconds
+ */
+#ifndef ASFS_SNIFF_WAKEUP_US
+#define ASFS_SNIFF_WAKEUP_US 1000
+#endif
+
+/*!
+ * @brief Number of duty cycle periods spent on a spreading factor before moving to the next one
+ */
+#ifndef ASFS_SNIFF_PERIODS_PER_SF
+#define ASFS_SNIFF_PERIODS_PER_SF 1
+#endif
+
+/*!
+ * @brief Radio current consumption used by the energy estimations - in nA (SX1262 datasheet, DC-DC, 125 kHz)
+ */
+#ifndef ASFS_SNIFF_CURRENT_RX_NA
+#define ASFS_SNIFF_CURRENT_RX_NA 4600000
+#endif
+#ifndef ASFS_SNIFF_CURRENT_SLEEP_WARM_NA
+#define ASFS_SNIFF_CURRENT_SLEEP_WARM_NA 600
+#endif
+#ifndef ASFS_SNIFF_CURRENT_STDBY_RC_NA
+#define ASFS_SNIFF_CURRENT_STDBY_RC_NA 600000
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Duty cycle timings derived for one spreading factor
+ */
+typedef struct asfs_sniff_timings_s
+{
+    uint32_t symb_time_in_us;      //!< Duration of one LoRa symbol
+    uint32_t rx_time_in_rtc_step;  //!< RX window, in steps of 15.625 us
+    uint32_t sleep_time_in_rtc_step;  //!< Sleep window, in steps of 15.625 us
+    uint32_t period_in_us;         //!< Duration of one RX + sleep period
+} asfs_sniff_timings_t;
+
+/*!
+ * @brief Sniff mode counters
+ */
+typedef struct asfs_sniff_stats_s
+{
+    uint32_t sf_switches;      //!< Number of times the MCU moved the duty cycle to another SF
+    uint32_t preambles;        //!< Number of preambles which woke the MCU up
+    uint32_t last_latency_ms;  //!< Time between the start of the dwell and the preamble detection
+} asfs_sniff_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Compute the duty cycle timings for a spreading factor
+ *
+ * The radio has to wake up at least twice during a preamble so that one RX window fully overlaps it:
+ * sleep = preamble - 2 x rx. If the preamble is too short, sleep is 0 and the radio stays in RX.
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] bw Bandwidth
+ * @param [in] preamble_len_in_symb Preamble length of the transmitters
+ * @param [out] timings Computed timings
+ */
+void asfs_sniff_compute_timings( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, uint16_t preamble_len_in_symb,
+                                 asfs_sniff_timings_t* timings );
+
+/*!
+ * @brief Program the radio duty cycle on a spreading factor and start the dwell on it
+ *
+ * @param [in] context Pointer to the radio context
+ * @param [in] sf Spreading factor to listen on
+ */
+void asfs_sniff_start( const void* context, sx126x_lora_sf_t sf );
+
+/*!
+ * @brief Restart the duty cycle on the current spreading factor, after a reception or an error
+ *
+ * @param [in] context Pointer to the radio context
+ */
+void asfs_sniff_restart( const void* context );
+
+/*!
+ * @brief To be called when the radio raised a preamble detection - stops the SF rotation until the packet ends
+ */
+void asfs_sniff_on_preamble_detected( void );
+
+/*!
+ * @brief Move the duty cycle to the next spreading factor once the dwell on the current one elapsed
+ *
+ * @remark Must be called from the main loop
+ *
+ * @param [in] context Pointer to the radio context
+ */
+void asfs_sniff_process( const void* context );
+
+/*!
+ * @brief Get a copy of the sniff mode counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void asfs_sniff_get_stats( asfs_sniff_stats_t* stats );
+
+/*!
+ * @brief Print the estimated radio charge per hour and worst-case detection latency of sniff mode and CAD loop
+ *
+ * @param [in] sf Spreading factor
+ * @param [in] cad_symb_nb Number of CAD symbols used by the CAD loop on this spreading factor
+ * @param [in] cad_interval_in_ms Delay between two CADs in the CAD loop
+ */
+void asfs_sniff_print_budget( sx126x_lora_sf_t sf, sx126x_cad_symbs_t cad_symb_nb, uint32_t cad_interval_in_ms );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_SNIFF_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,317 @@
+/*!
+ * @file      asfs_tx.c
+ *
+ * @brief     Listen-before-talk transmit queue with backoff scaled by the time on air
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "asfs_tx.h"
+#include "asfs_preamble.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Offset of the payload in the radio data buffer
+ */
+#define ASFS_TX_BUFFER_OFFSET 0x00
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_tx_frame_t tx_frames[ASFS_TX_QUEUE_DEPTH];
+
+static uint8_t tx_head;
+
+static uint8_t tx_count;
+
+static bool tx_is_in_flight;
+
+static asfs_tx_stats_t tx_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Retry the frame in flight after a backoff, or drop it once out of retries
+ */
+static void asfs_tx_back_off( uint32_t now_in_ms );
+
+/*!
+ * @brief Remove the frame at the head of the queue
+ */
+static void asfs_tx_pop( void );
+
+/*!
+ * @brief Choose the modulation of a frame from its link and compute its time on air
+ */
+static void asfs_tx_prepare( asfs_tx_frame_t* frame, sx126x_pkt_params_lora_t* pkt_params );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void asfs_tx_init( void )
+{
+    memset( tx_frames, 0, sizeof( tx_frames ) );
+    memset( &tx_stats, 0, sizeof( tx_stats ) );
+    tx_head         = 0;
+    tx_count        = 0;
+    tx_is_in_flight = false;
+}
+
+bool asfs_tx_enqueue( asfs_link_addr_t dst, const uint8_t* payload, uint8_t size, uint32_t now_in_ms )
+{
+    if( size > ASFS_TX_MAX_PAYLOAD )
+    {
+        return false;
+    }
+    if( tx_count >= ASFS_TX_QUEUE_DEPTH )
+    {
+        tx_stats.dropped_full++;
+        return false;
+    }
+
+    asfs_tx_frame_t* frame = &tx_frames[( tx_head + tx_count ) % ASFS_TX_QUEUE_DEPTH];
+
+    frame->dst = dst;
+    memcpy( frame->payload, payload, size );
+    frame->size               = size;
+    frame->enqueue_time_in_ms = now_in_ms;
+    frame->due_in_ms          = now_in_ms;
+    frame->retries            = 0;
+
+    tx_count++;
+    tx_stats.enqueued++;
+    if( tx_count > tx_stats.max_depth )
+    {
+        tx_stats.max_depth = tx_count;
+    }
+    return true;
+}
+
+bool asfs_tx_is_due( uint32_t now_in_ms )
+{
+    return ( tx_count != 0 ) && ( tx_is_in_flight == false ) &&
+           ( ( int32_t )( now_in_ms - tx_frames[tx_head].due_in_ms ) >= 0 );
+}
+
+uint32_t asfs_tx_get_time_on_air_in_ms( void )
+{
+    if( tx_count == 0 )
+    {
+        return 0;
+    }
+
+    asfs_tx_frame_t*         frame = &tx_frames[tx_head];
+    sx126x_pkt_params_lora_t pkt_params;
+
+    asfs_tx_prepare( frame, &pkt_params );
+    return frame->time_on_air_in_ms;
+}
+
+void asfs_tx_defer( uint32_t due_in_ms )
+{
+    if( ( tx_count == 0 ) || ( tx_is_in_flight == true ) )
+    {
+        return;
+    }
+    tx_stats.deferred++;
+    tx_frames[tx_head].due_in_ms = due_in_ms;
+}
+
+void asfs_tx_drop( void )
+{
+    if( ( tx_count == 0 ) || ( tx_is_in_flight == true ) )
+    {
+        return;
+    }
+    tx_stats.dropped_airtime++;
+    asfs_tx_pop( );
+}
+
+const asfs_tx_frame_t* asfs_tx_load( const void* context )
+{
+    if( tx_count == 0 )
+    {
+        return NULL;
+    }
+
+    asfs_tx_frame_t*         frame = &tx_frames[tx_head];
+    sx126x_pkt_params_lora_t pkt_params;
+
+    asfs_tx_prepare( frame, &pkt_params );
+
+    apps_common_sx126x_set_lora_mod_params( context, &frame->mod_params );
+    ASSERT_SX126X_RC( sx126x_set_lora_pkt_params( context, &pkt_params ) );
+    ASSERT_SX126X_RC( sx126x_set_buffer_base_address( context, ASFS_TX_BUFFER_OFFSET, 0x00 ) );
+    ASSERT_SX126X_RC( sx126x_write_buffer( context, ASFS_TX_BUFFER_OFFSET, frame->payload, frame->size ) );
+
+    tx_is_in_flight = true;
+    return frame;
+}
+
+void asfs_tx_on_busy( uint32_t now_in_ms )
+{
+    if( tx_is_in_flight == false )
+    {
+        return;
+    }
+    tx_stats.busy++;
+    asfs_tx_back_off( now_in_ms );
+}
+
+void asfs_tx_on_timeout( uint32_t now_in_ms )
+{
+    if( tx_is_in_flight == false )
+    {
+        return;
+    }
+    tx_stats.timeouts++;
+    asfs_tx_back_off( now_in_ms );
+}
+
+void asfs_tx_on_done( uint32_t now_in_ms )
+{
+    if( tx_is_in_flight == false )
+    {
+        return;
+    }
+
+    const uint32_t latency_in_ms = now_in_ms - tx_frames[tx_head].enqueue_time_in_ms;
+
+    tx_stats.sent++;
+    tx_stats.latency_in_ms += latency_in_ms;
+    if( latency_in_ms > tx_stats.max_latency_in_ms )
+    {
+        tx_stats.max_latency_in_ms = latency_in_ms;
+    }
+    asfs_tx_pop( );
+}
+
+uint8_t asfs_tx_get_depth( void )
+{
+    return tx_count;
+}
+
+void asfs_tx_get_stats( asfs_tx_stats_t* stats )
+{
+    *stats = tx_stats;
+}
+
+void asfs_tx_print( void )
+{
+    HAL_DBG_TRACE_INFO( "TX queue: %u/%u frames (max %u) - %u queued, %u sent, %u refused, %u dropped\n", tx_count,
+                        ASFS_TX_QUEUE_DEPTH, tx_stats.max_depth, tx_stats.enqueued, tx_stats.sent,
+                        tx_stats.dropped_full, tx_stats.dropped_retries );
+    HAL_DBG_TRACE_INFO( "TX retries: %u busy, %u timeouts - latency %u ms on average, %u ms max\n", tx_stats.busy,
+                        tx_stats.timeouts,
+                        ( tx_stats.sent != 0 ) ? ( uint32_t )( tx_stats.latency_in_ms / tx_stats.sent ) : 0,
+                        tx_stats.max_latency_in_ms );
+    HAL_DBG_TRACE_INFO( "TX airtime: %u deferred, %u dropped\n", tx_stats.deferred, tx_stats.dropped_airtime );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void asfs_tx_back_off( uint32_t now_in_ms )
+{
+    asfs_tx_frame_t* frame = &tx_frames[tx_head];
+
+    tx_is_in_flight = false;
+    frame->retries++;
+    if( frame->retries >= ASFS_TX_MAX_RETRIES )
+    {
+        tx_stats.dropped_retries++;
+        asfs_tx_pop( );
+        return;
+    }
+
+    // Whatever was heard lasts about one frame, so wait at least that long, then a random number of frames
+    // from a window doubling with each retry
+    const uint8_t  exp   = ( frame->retries < ASFS_TX_BACKOFF_MAX_EXP ) ? frame->retries : ASFS_TX_BACKOFF_MAX_EXP;
+    const uint32_t slots = 1 + ( uint32_t ) rand( ) % ( 1u << exp );
+
+    frame->due_in_ms = now_in_ms + slots * frame->time_on_air_in_ms;
+}
+
+static void asfs_tx_pop( void )
+{
+    tx_is_in_flight = false;
+    tx_head         = ( tx_head + 1 ) % ASFS_TX_QUEUE_DEPTH;
+    tx_count--;
+}
+
+static void asfs_tx_prepare( asfs_tx_frame_t* frame, sx126x_pkt_params_lora_t* pkt_params )
+{
+    // The link may have changed since the last attempt
+    asfs_link_get_tx_mod_params( frame->dst, &frame->mod_params );
+    // Long enough for the receivers scanning that modulation to catch the frame
+    frame->preamble_len_in_symb = asfs_preamble_get_length( &frame->mod_params );
+
+    pkt_params->preamble_len_in_symb = frame->preamble_len_in_symb;
+    pkt_params->header_type          = LORA_PKT_LEN_MODE;
+    pkt_params->pld_len_in_bytes     = frame->size;
+    pkt_params->crc_is_on            = LORA_CRC;
+    pkt_params->invert_iq_is_on      = LORA_IQ;
+    frame->time_on_air_in_ms = sx126x_get_lora_time_on_air_in_ms( pkt_params, &frame->mod_params );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
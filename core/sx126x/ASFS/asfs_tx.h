@@ -0,0 +1,249 @@
+/*!
+ * @file      asfs_tx.h
+ *
+ * @brief     Listen-before-talk transmit queue with backoff scaled by the time on air
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef ASFS_TX_H
+#define ASFS_TX_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sx126x.h"
+#include "asfs_link.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of frames waiting for transmission, the frame in flight included
+ */
+#ifndef ASFS_TX_QUEUE_DEPTH
+#define ASFS_TX_QUEUE_DEPTH 8
+#endif
+
+/*!
+ * @brief Largest payload of a queued frame - in bytes
+ */
+#ifndef ASFS_TX_MAX_PAYLOAD
+#define ASFS_TX_MAX_PAYLOAD 64
+#endif
+
+/*!
+ * @brief Busy channels, or transmit timeouts, before a frame is dropped
+ */
+#ifndef ASFS_TX_MAX_RETRIES
+#define ASFS_TX_MAX_RETRIES 8
+#endif
+
+/*!
+ * @brief Cap of the backoff exponent, the backoff window is never longer than 2^ASFS_TX_BACKOFF_MAX_EXP times on air
+ */
+#ifndef ASFS_TX_BACKOFF_MAX_EXP
+#define ASFS_TX_BACKOFF_MAX_EXP 5
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Destination of the frames sent to every neighbour, they use ASFS_LINK_SF_MAX
+ */
+#define ASFS_TX_BROADCAST 0xFFFF
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Queued frame
+ */
+typedef struct asfs_tx_frame_s
+{
+    asfs_link_addr_t         dst;
+    uint8_t                  payload[ASFS_TX_MAX_PAYLOAD];
+    uint8_t                  size;
+    sx126x_mod_params_lora_t mod_params;            //!< Modulation of the last attempt, chosen from the link to dst
+    uint16_t                 preamble_len_in_symb;  //!< Preamble of the last attempt, see asfs_preamble.h
+    uint32_t                 time_on_air_in_ms;     //!< Time on air with mod_params and preamble_len_in_symb
+    uint32_t                 enqueue_time_in_ms;    //!< Time the frame was queued, for the latency
+    uint32_t                 due_in_ms;             //!< Earliest time of the next attempt
+    uint8_t                  retries;               //!< Attempts which found the channel busy or timed out
+} asfs_tx_frame_t;
+
+/*!
+ * @brief Transmit queue counters
+ */
+typedef struct asfs_tx_stats_s
+{
+    uint32_t enqueued;
+    uint32_t sent;
+    uint32_t busy;             //!< Attempts which found the channel busy
+    uint32_t timeouts;         //!< Attempts which did not end with TX_DONE in time
+    uint32_t dropped_full;     //!< Frames refused because the queue was full
+    uint32_t dropped_retries;  //!< Frames dropped after ASFS_TX_MAX_RETRIES attempts
+    uint32_t deferred;         //!< Attempts postponed by the caller, see asfs_tx_defer
+    uint32_t dropped_airtime;  //!< Frames dropped by the caller, see asfs_tx_drop
+    uint8_t  max_depth;        //!< Highest number of frames queued
+    uint64_t latency_in_ms;    //!< Sum of the times from enqueue to TX_DONE of the frames sent
+    uint32_t max_latency_in_ms;
+} asfs_tx_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Empty the queue and reset the counters
+ */
+void asfs_tx_init( void );
+
+/*!
+ * @brief Queue a frame
+ *
+ * @param [in] dst Address of the destination, ASFS_TX_BROADCAST for every neighbour
+ * @param [in] payload Payload, copied into the queue
+ * @param [in] size Payload size, at most ASFS_TX_MAX_PAYLOAD
+ * @param [in] now_in_ms Current time
+ *
+ * @returns false if the queue is full or the payload too long
+ */
+bool asfs_tx_enqueue( asfs_link_addr_t dst, const uint8_t* payload, uint8_t size, uint32_t now_in_ms );
+
+/*!
+ * @brief Tell whether the frame at the head of the queue can be attempted
+ *
+ * @param [in] now_in_ms Current time
+ *
+ * @returns true if a frame is queued, no attempt is in flight and its backoff is over
+ */
+bool asfs_tx_is_due( uint32_t now_in_ms );
+
+/*!
+ * @brief Get the time on air of the frame at the head of the queue
+ *
+ * The modulation is chosen from the link to the destination as asfs_tx_load would, so that the caller can check the
+ * airtime budget before the attempt.
+ *
+ * @returns The time on air in ms, 0 if the queue is empty
+ */
+uint32_t asfs_tx_get_time_on_air_in_ms( void );
+
+/*!
+ * @brief Postpone the frame at the head of the queue without counting a retry
+ *
+ * @param [in] due_in_ms Earliest time of the next attempt
+ */
+void asfs_tx_defer( uint32_t due_in_ms );
+
+/*!
+ * @brief Drop the frame at the head of the queue, which can never be sent
+ */
+void asfs_tx_drop( void );
+
+/*!
+ * @brief Start an attempt of the frame at the head of the queue, and load it into the radio
+ *
+ * The modulation is chosen from the link to the destination, see asfs_link_get_tx_mod_params. The payload is written
+ * at the start of the radio data buffer, along with the matching modulation and packet parameters. The caller then
+ * tunes the radio and runs the CAD with the SX126X_CAD_LBT exit mode, so that the radio transmits by itself on a clear
+ * channel.
+ *
+ * @param [in] context Pointer to the radio context
+ *
+ * @returns The frame in flight, NULL if the queue is empty
+ */
+const asfs_tx_frame_t* asfs_tx_load( const void* context );
+
+/*!
+ * @brief End the attempt in flight on a busy channel
+ *
+ * The next attempt is due after a random number of times on air of the frame, drawn from a window doubling with each
+ * retry. The frame is dropped after ASFS_TX_MAX_RETRIES attempts.
+ *
+ * @param [in] now_in_ms Current time
+ */
+void asfs_tx_on_busy( uint32_t now_in_ms );
+
+/*!
+ * @brief End the attempt in flight without TX_DONE, it is retried like a busy channel
+ *
+ * @param [in] now_in_ms Current time
+ */
+void asfs_tx_on_timeout( uint32_t now_in_ms );
+
+/*!
+ * @brief End the attempt in flight on TX_DONE and remove the frame from the queue
+ *
+ * @param [in] now_in_ms Current time
+ */
+void asfs_tx_on_done( uint32_t now_in_ms );
+
+/*!
+ * @brief Get the number of frames queued, the frame in flight included
+ */
+uint8_t asfs_tx_get_depth( void );
+
+/*!
+ * @brief Get the counters of the queue
+ *
+ * @param [out] stats Counters
+ */
+void asfs_tx_get_stats( asfs_tx_stats_t* stats );
+
+/*!
+ * @brief Print the depth, latency and retry counters of the queue
+ */
+void asfs_tx_print( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASFS_TX_H
+
+/* --- EOF ------------------------------------------------------------------ */
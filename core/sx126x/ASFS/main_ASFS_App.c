@@ -42,8 +42,25 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "apps_channel_plan.h"
 #include "apps_common.h"
+#include "apps_airtime.h"
 #include "apps_utilities.h"
+#include "apps_energy.h"
+#include "apps_rx_ring.h"
+#include "apps_spi_log.h"
+#include "apps_timer.h"
+#include "asfs_agg.h"
+#include "asfs_cad_cal.h"
+#include "asfs_cad_snr.h"
+#include "asfs_cell.h"
+#include "asfs_ed.h"
+#include "asfs_link.h"
+#include "asfs_predict.h"
+#include "asfs_preamble.h"
+#include "asfs_tx.h"
+#include "asfs_radio.h"
+#include "asfs_sniff.h"
 
 #include "sx126x.h"
 #include "main_ASFS_App.h"
@@ -54,7 +71,42 @@
 #include "stm32l4xx_ll_utils.h"
 
 
-static sx126x_hal_context_t* context;
+#if( APPS_COMMON_N_RADIOS > 1 ) && ( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+#error "Sniff mode drives a single radio"
+#endif
+#if( APPS_COMMON_N_RADIOS > 1 ) && ( RX_BUFFER_RING_MODE == true )
+#error "The radio buffer ring is only available with a single radio"
+#endif
+#if( ASFS_TX_QUEUE == true ) && ( ( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF ) || ( RX_BUFFER_RING_MODE == true ) )
+#error "The transmit queue is only available in CAD scan mode, without the radio buffer ring"
+#endif
+
+/* Context of the first radio, the only one used by sniff mode and the radio buffer ring */
+static const sx126x_hal_context_t* context;
+
+/* ASFS state of each radio, every radio sweeps its own range of spreading factors */
+static asfs_radio_t radios[APPS_COMMON_N_RADIOS];
+
+/* Channels scanned by the radios, converted to PLL steps once at start-up */
+static const uint32_t asfs_channels_in_hz[] = ASFS_CHANNELS_IN_HZ;
+
+/* Bandwidths scanned on every channel */
+static const sx126x_lora_bw_t asfs_bandwidths[] = ASFS_BANDWIDTHS;
+
+#define ASFS_N_BANDWIDTHS ( sizeof(asfs_bandwidths) / sizeof(asfs_bandwidths[0]) )
+
+/* Longest wait before a CAD of the sweep, the cell table and the preambles sent are sized for it */
+#if( ASFS_PREDICTIVE_SCAN == true )
+#define ASFS_SWEEP_DELAY_MS ASFS_PREDICT_BACKGROUND_DELAY_MS
+#else
+#define ASFS_SWEEP_DELAY_MS DELAY_MS_BEFORE_CAD
+#endif
+
+/* Regulatory sub-band of ASFS_TX_CHANNEL, looked up once at start-up */
+static uint8_t asfs_tx_band = APPS_AIRTIME_NO_BAND;
+
+/* Time on air of the frame in flight, charged to the sub-band once it has been sent */
+static uint32_t asfs_tx_time_on_air_in_ms;
 
 /* Definition of global variables for ASFS */
 sx126x_lora_sf_t LORA_SPREADING_FACTOR_t = SX126X_LORA_SF7;
@@ -87,19 +139,55 @@ void change_cad_params(sx126x_cad_exit_modes_t mode)
     cad_params.cad_timeout     = 0;
 }
 
-sx126x_lora_sf_t LORA_SF=SX126X_LORA_SF7;
-
-static uint8_t  buffer[PAYLOAD_LENGTH];
-static uint32_t iteration_number        = 0;
-static uint32_t detection_counter       = 0;
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
  */
 
-static void start_cad_after_delay( uint16_t delay_ms );
+static void init_radio( asfs_radio_t* radio, sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode );
+
+static void init_radio_with_delay( asfs_radio_t* radio, sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode,
+                                   uint16_t delay_ms );
+
+static asfs_radio_t* get_irq_radio( void );
+
+static void start_cad_after_delay( asfs_radio_t* radio, uint16_t delay_ms );
+
+static void on_cad_timer( void* context );
+
+static bool has_pending_work( void );
+
+static void start_cad( asfs_radio_t* radio );
+
+static void move_to_next_cell( asfs_radio_t* radio );
 
-static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_cad_params_t* cad_params );
+static bool admit_lbt_tx( void );
+
+static void start_lbt_tx( asfs_radio_t* radio );
+
+static void end_lbt_tx( asfs_radio_t* radio );
+
+static void queue_beacon( void );
+
+static void queue_telemetry( void );
+
+static void print_dispatch_stats( void );
+
+static void calibrate_cad_thresholds( asfs_radio_t* radio );
+
+static uint32_t get_sf_scan_cost_in_us( sx126x_lora_sf_t sf );
+
+static uint32_t get_cad_cost_in_us( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw );
+
+static void update_scan_costs( void );
+
+static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params );
+
+static void process_received_packets( void );
+
+static void rearm_rx( asfs_radio_t* radio );
+
+static void print_scan_budget( void );
 
 /*
  * -----------------------------------------------------------------------------
@@ -120,48 +208,222 @@ int main(void)
     smtc_hal_mcu_init();
     // Initialize UART (Universal Asynchronous Receiver-Transmitter)
     uart_init();
+    // Start the LPTIM time base used to timestamp the received packets and to schedule the CADs
+    apps_common_time_init();
+#if( APPS_SPI_LOG == true )
+    // Empty the ring of the SPI transactions recorded with APPS_SPI_LOG
+    apps_spi_log_init();
+#endif
+    // Start accounting the charge drawn by the radios and the MCU, from the commands sent to the radios
+    apps_energy_init(apps_timer_get_time_in_us());
+    // Release all the reception buffers
+    apps_rx_pool_init();
+    // Forget the neighbours, their links are learnt from the packets received
+    asfs_link_init();
+    // Run the CADs on the calibrated symbol count until packets are received
+    asfs_cad_snr_init();
+    // Forget the periods of the neighbours, they are learnt from the packets received
+    asfs_predict_init();
+    // Empty the transmit queue
+    asfs_tx_init();
+    // Send LORA_PREAMBLE_LENGTH until the scan of the receivers is known
+    asfs_preamble_init();
+    // Start an empty frame, the small messages share frames to save their preambles
+    asfs_agg_init(ASFS_NODE_ADDR);
     // Initialize the shield (hardware component that the system relies on)
     apps_common_shield_init();
-    // Get the context for the SX126x (radio chip for LoRa communication)
-    context = apps_common_sx126x_get_context();
-    // Initialize the SX126x with the retrieved context
-    apps_common_sx126x_init((void*)context);
-    // Set the IRQ (Interrupt Request) parameters for the SX126x.
-    // This configures which interrupts the chip will trigger, such as CAD (Channel Activity Detection),
-    // RX (Receive), TX (Transmit), and various error interrupts.
-    sx126x_set_dio_irq_params(context, 
-                              SX126X_IRQ_ALL,  // All possible IRQs are set
-                              SX126X_IRQ_CAD_DETECTED | SX126X_IRQ_CAD_DONE | SX126X_IRQ_TX_DONE | 
-                              SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT | SX126X_IRQ_HEADER_ERROR | 
-                              SX126X_IRQ_CRC_ERROR,  // IRQ sources being enabled
-                              SX126X_IRQ_NONE,  // No DIO1 interrupts are enabled
-                              SX126X_IRQ_NONE); // No DIO2 interrupts are enabled
-    // Clear all pending IRQs for the SX126x
-    sx126x_clear_irq_status(context, SX126X_IRQ_ALL);
-    // Initialize the application with specific parameters:
-    // SX126X_LORA_SF7 refers to spreading factor 7 for LoRa communication,
-    // and SX126X_CAD_RX indicates it's operating in CAD (Channel Activity Detection) mode.
-    init_app(SX126X_LORA_SF7, SX126X_CAD_RX);
+    // Bind the on_xxx callbacks below to their IRQ bit
+    apps_common_sx126x_irq_init();
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        // Get the context for each SX126x (radio chip for LoRa communication)
+        sx126x_hal_context_t* radio_context = apps_common_sx126x_get_radio_context(id);
+        // Initialize the SX126x with the retrieved context
+        apps_common_sx126x_init(radio_context);
+        // Attach the radio to its ASFS state
+        asfs_radio_init(&radios[id], id, radio_context);
+        // Bind the timer which starts the CADs of the radio
+        apps_timer_create(&radios[id].cad_timer, on_cad_timer, &radios[id]);
+    }
+    context = radios[0].context;
+#if( RX_BUFFER_RING_MODE == true )
+    // Receive the packets in rotating slots of the radio data buffer
+    apps_rx_ring_init((void*)context);
+#endif
+    // Convert the channels to PLL steps once and group them by image calibration band
+    if( apps_channel_plan_init(asfs_channels_in_hz,
+                               sizeof(asfs_channels_in_hz) / sizeof(asfs_channels_in_hz[0])) == false )
+    {
+        HAL_DBG_TRACE_ERROR("Invalid channel plan\n");
+        while( true )
+        {
+        }
+    }
+#if( ASFS_TX_QUEUE == true )
+    // Give every sub-band its full duty cycle budget and find the one of the transmit channel
+    if( apps_airtime_init(apps_common_get_time_in_ms()) == false )
+    {
+        HAL_DBG_TRACE_ERROR("Invalid sub-band table\n");
+        while( true )
+        {
+        }
+    }
+    asfs_tx_band = apps_airtime_find_band(apps_channel_plan_get_channel(ASFS_TX_CHANNEL)->freq_in_hz);
+    if( asfs_tx_band == APPS_AIRTIME_NO_BAND )
+    {
+        HAL_DBG_TRACE_WARNING("Transmit channel outside of the sub-band table, nothing will be sent\n");
+    }
+#endif
+    // Split SF7 to SF11 between the radios so that each one sweeps its range in about the same time
+    change_cad_params(SX126X_CAD_RX);
+    asfs_radio_assign_sf_ranges(radios, APPS_COMMON_N_RADIOS, SX126X_LORA_SF7, SX126X_LORA_SF11,
+                                get_sf_scan_cost_in_us);
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        const void* radio_context = radios[id].context;
+#if( ASFS_CAD_CALIBRATION == true ) && ( ASFS_SCAN_MODE == ASFS_SCAN_MODE_CAD )
+        // Tune the CAD thresholds of each SF of the range and each bandwidth to the local noise,
+        // the channel must be empty
+        calibrate_cad_thresholds(&radios[id]);
+#endif
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+        // The sniff windows are derived from the symbol time at LORA_BANDWIDTH
+        asfs_radio_set_bw(&radios[id], LORA_BANDWIDTH);
+#else
+        // Start on the first bandwidth
+        asfs_radio_set_bw(&radios[id], asfs_bandwidths[0]);
+#endif
+        // Set the IRQ (Interrupt Request) parameters for the SX126x.
+        // This configures which interrupts the chip will trigger, such as CAD (Channel Activity Detection),
+        // RX (Receive), TX (Transmit), and various error interrupts.
+        sx126x_set_dio_irq_params(radio_context, 
+                                  SX126X_IRQ_ALL,  // All possible IRQs are set
+                                  SX126X_IRQ_CAD_DETECTED | SX126X_IRQ_CAD_DONE | SX126X_IRQ_TX_DONE | 
+                                  SX126X_IRQ_RX_DONE | SX126X_IRQ_TIMEOUT | SX126X_IRQ_HEADER_ERROR | 
+                                  SX126X_IRQ_CRC_ERROR |
+                                  ( ( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF ) ? SX126X_IRQ_PREAMBLE_DETECTED : 0 ),
+                                  // IRQ sources being enabled - in sniff mode the MCU is woken up on preambles
+                                  SX126X_IRQ_NONE,  // No DIO1 interrupts are enabled
+                                  SX126X_IRQ_NONE); // No DIO2 interrupts are enabled
+        // Clear all pending IRQs for the SX126x
+        sx126x_clear_irq_status(radio_context, SX126X_IRQ_ALL);
+        // Pair every channel of the plan with every bandwidth and every SF of the range of the radio
+        if( asfs_cell_table_init(&radios[id].cells, asfs_bandwidths, ASFS_N_BANDWIDTHS, radios[id].sf_first,
+                                 radios[id].sf_last, get_cad_cost_in_us, ASFS_SWEEP_DELAY_MS * 1000,
+                                 apps_common_get_time_in_ms()) == false )
+        {
+            HAL_DBG_TRACE_ERROR("Too many (channel, bandwidth, SF) cells for radio %d\n", id);
+            while( true )
+            {
+            }
+        }
+#if( ASFS_TX_QUEUE == true )
+        // The receivers scan like this node, size the preamble of each SF for their CADs on the transmit channel
+        if( asfs_preamble_set_profiles_from_cells(&radios[id].cells, ASFS_TX_CHANNEL,
+                                                  ASFS_PREAMBLE_GUARANTEED) == false )
+        {
+            HAL_DBG_TRACE_WARNING("Too many preamble profiles, some frames use LORA_PREAMBLE_LENGTH\n");
+        }
+#endif
+        // Start the radio on the first channel and bandwidth, and the first SF of its range,
+        // SX126X_CAD_RX indicates it's operating in CAD (Channel Activity Detection) mode.
+        init_radio(&radios[id], radios[id].sf_first, SX126X_CAD_RX);
+    }
     // Print version information for the SX126x chip
     apps_common_sx126x_print_version_info();
     // Print current configuration of the SX126x chip
     apps_common_sx126x_print_config();
+    // Print the estimated energy and latency of both scan modes
+    print_scan_budget();
+#if( ASFS_TX_QUEUE == true )
+    // Print the preamble of the frames sent on each SF
+    asfs_preamble_print();
+#endif
+    uint32_t stats_time_in_ms = apps_common_get_time_in_ms();
+#if( ASFS_TX_QUEUE == true ) && ( ASFS_TX_BEACON_PERIOD_MS != 0 )
+    uint32_t beacon_time_in_ms = apps_common_get_time_in_ms();
+#endif
+#if( ASFS_TX_QUEUE == true ) && ( ASFS_TX_TELEMETRY_PERIOD_MS != 0 )
+    uint32_t telemetry_time_in_ms = apps_common_get_time_in_ms();
+#endif
     // Main loop: Continuously process interrupts from the SX126x
     while(1)
     {
-        apps_common_sx126x_irq_process((void*)context);  // Handle IRQs (interrupts) in an infinite loop
+        for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+        {
+            apps_common_sx126x_irq_process(radios[id].context);  // Handle IRQs (interrupts) of every radio
+        }
+        apps_timer_process();                             // Start the CADs whose delay elapsed
+        process_received_packets();                       // Drain the packets queued by on_rx_done
+        // A SF without recent packets is back to its calibrated CAD, the scan costs and preambles follow
+        if( asfs_cad_snr_process(apps_common_get_time_in_ms()) == true )
+        {
+            update_scan_costs();
+        }
+        if( ( apps_common_get_time_in_ms() - stats_time_in_ms ) >= ASFS_STATS_PERIOD_MS )
+        {
+            stats_time_in_ms += ASFS_STATS_PERIOD_MS;
+            print_dispatch_stats();                       // Show that each CAD was started only once
+        }
+#if( ASFS_TX_QUEUE == true ) && ( ASFS_TX_BEACON_PERIOD_MS != 0 )
+        if( ( apps_common_get_time_in_ms() - beacon_time_in_ms ) >= ASFS_TX_BEACON_PERIOD_MS )
+        {
+            beacon_time_in_ms += ASFS_TX_BEACON_PERIOD_MS;
+            queue_beacon();                               // Let the neighbours measure their link to this node
+        }
+#endif
+#if( ASFS_TX_QUEUE == true ) && ( ASFS_TX_TELEMETRY_PERIOD_MS != 0 )
+        if( ( apps_common_get_time_in_ms() - telemetry_time_in_ms ) >= ASFS_TX_TELEMETRY_PERIOD_MS )
+        {
+            telemetry_time_in_ms += ASFS_TX_TELEMETRY_PERIOD_MS;
+            queue_telemetry();                            // Report the activity seen by the node
+        }
+#endif
+#if( ASFS_TX_QUEUE == true )
+        asfs_agg_process(apps_common_get_time_in_ms());   // Queue the frame whose first message waited long enough
+#endif
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+        asfs_sniff_process((void*)context);               // Move the duty cycle to the next SF when due
+#endif
+#if( APPS_SPI_LOG == true )
+        apps_spi_log_flush();                             // Stream the SPI transactions out, for tools/spi_log
+#endif
+#if( ASFS_MCU_SLEEP == true )
+        apps_timer_sleep(ASFS_MCU_SLEEP_MAX_MS, has_pending_work);  // Sleep until the next CAD or radio IRQ
+#endif
     }
 }
 
 /*
  * @brief: Initializes the application with a specified LoRa spreading factor and CAD mode.
- *        Optimizes the CAD parameters and starts the CAD process after a defined delay.
+ *        Only the first radio is affected, see init_radio.
  */
 
 void init_app(sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode)
+{
+    init_radio(&radios[0], sf, mode);
+}
+
+/*
+ * @brief: Initializes one radio with a specified LoRa spreading factor and CAD mode.
+ *        Optimizes the CAD parameters and schedules the CAD process after a defined delay.
+ *        The global ASFS parameters follow the last radio reconfigured.
+ */
+static void init_radio(asfs_radio_t* radio, sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode)
+{
+    init_radio_with_delay(radio, sf, mode, DELAY_MS_BEFORE_CAD);
+}
+
+/*
+ * @brief: Same as init_radio, with the CAD scheduled after a given delay instead of DELAY_MS_BEFORE_CAD.
+ */
+static void init_radio_with_delay(asfs_radio_t* radio, sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode,
+                                  uint16_t delay_ms)
 {
     // Initialize the detection counter to 0
-    detection_counter = 0;
+    radio->detection_counter = 0;
+    // Adjust the LoRa modulation parameters of the radio to match the new spreading factor
+    asfs_radio_set_sf(radio, sf);
     // Change the LoRa spreading factor based on the provided value
     change_LORA_SPREADING_FACTOR_t(sf);
     // Adjust the LoRa modulation parameters to match the new spreading factor
@@ -170,50 +432,90 @@ void init_app(sx126x_lora_sf_t sf, sx126x_cad_exit_modes_t mode)
     change_CAD_EXIT_MODE(mode);
     // Adjust the CAD parameters according to the new exit mode
     change_cad_params(mode);
-    // Initialize the radio with the current context
-    apps_common_sx126x_radio_init((void*)context);
+    radio->cad_params = cad_params;
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+    // Initialize the radio with its own context and modulation parameters
+    apps_common_sx126x_radio_init_with_lora_mod_params(radio->context, &radio->lora_mod_params);
+    // Tune the radio on its channel, with the PLL steps computed once in the channel plan
+    apps_channel_plan_set_channel(radio->context, radio->channel);
+    // Let the radio duty-cycle RX and sleep by itself, the MCU only steps in on preambles and SF changes
+    asfs_sniff_start(radio->context, sf);
+    return;
+#endif
     // Optimize the CAD parameters based on the LoRa spreading factor
-    optimize_cad_parameters(LORA_SPREADING_FACTOR_t, &cad_params);
+    optimize_cad_parameters(radio->sf, radio->bw, &radio->cad_params);
+    // Use the thresholds tuned to the local noise instead, when available
+    asfs_cad_cal_apply(radio->sf, radio->bw, &radio->cad_params);
+    // Shorten the CAD on the SF received with a strong SNR, lengthen it on the weak ones
+    asfs_cad_snr_apply(radio->sf, radio->bw, &radio->cad_params, apps_common_get_time_in_ms());
     // If the CAD exit mode is set to switch to RX (receive mode) after detection
-    if(cad_params.cad_exit_mode == SX126X_CAD_RX)
+    if(radio->cad_params.cad_exit_mode == SX126X_CAD_RX)
     {
         // Convert the CAD timeout value from milliseconds to RTC (Real-Time Clock) steps
-        cad_params.cad_timeout = sx126x_convert_timeout_in_ms_to_rtc_step(CAD_TIMEOUT_MS);
+        radio->cad_params.cad_timeout = sx126x_convert_timeout_in_ms_to_rtc_step(CAD_TIMEOUT_MS);
+    }
+#if( ASFS_WARM_SLEEP == true )
+    // The radio keeps its configuration while asleep: after the first complete configuration,
+    // only the parameters changed here are sent, when the radio is woken up for its CAD
+    if( radio->is_configured == false )
+    {
+        asfs_radio_configure(radio);
     }
-    // Set the CAD parameters for the SX126x, ensuring no errors during the process
-    ASSERT_SX126X_RC(sx126x_set_cad_params(context, &cad_params));
+#else
+    // Initialize the radio with its own context, modulation and CAD parameters
+    asfs_radio_configure(radio);
+#endif
     // Start the CAD process after a specified delay in milliseconds
-    start_cad_after_delay(DELAY_MS_BEFORE_CAD);
+    start_cad_after_delay(radio, delay_ms);
 }
 
 	
 // Callback function triggered when CAD (Channel Activity Detection) detects activity
 void on_cad_done_detected(void)
 {
+    asfs_radio_t* radio = get_irq_radio();
     // Increment the detection counter
-    detection_counter++;
+    radio->detection_counter++;
+    radio->cad_done_count++;
+    // The scan bookkeeping only applies to the CADs of the cells, not to listening before talking
+    if( radio->cad_params.cad_exit_mode != SX126X_CAD_LBT )
+    {
+        // The cell was checked, it waits for its next turn from now on
+        asfs_cell_table_on_visit(&radio->cells, apps_common_get_time_in_ms());
+        // Count the CAD for the online re-tuning of the thresholds, the scan costs follow its symbol count
+        if( asfs_cad_cal_on_cad_done(radio->sf, radio->bw) == true )
+        {
+            update_scan_costs();
+        }
+        // Tell the energy detection its busy verdict was right, or its silent verdict audited wrong
+        asfs_ed_on_cad_result(&radio->ed, true);
+    }
     // Handle the CAD exit mode based on the current configuration
-    switch(cad_params.cad_exit_mode)
+    switch(radio->cad_params.cad_exit_mode)
     {
         // If CAD mode is set to only detect and stop (no RX mode)
         case SX126X_CAD_ONLY:
             // Restart CAD detection after a specified delay
-            start_cad_after_delay(DELAY_MS_BEFORE_CAD);
+            start_cad_after_delay(radio, DELAY_MS_BEFORE_CAD);
             break;
         // If CAD mode is set to switch to RX (receive mode) after detection
         case SX126X_CAD_RX:
+            // The detection turns out false if the RX times out without any packet
+            radio->is_cad_rx_ongoing = true;
             // Handle the pre-RX setup (ready the system for receiving data)
             apps_common_sx126x_handle_pre_rx();
             break;
-        // If CAD mode is set for LBT (Listen Before Talk), restart CAD after delay
+        // If CAD mode is set for LBT (Listen Before Talk), the channel is busy and nothing was sent
         case SX126X_CAD_LBT:
-            // Restart CAD detection after a specified delay
-            start_cad_after_delay(DELAY_MS_BEFORE_CAD);
+            // Retry the frame after a backoff scaled by its time on air
+            asfs_tx_on_busy(apps_common_get_time_in_ms());
+            // Go back to scanning meanwhile
+            end_lbt_tx(radio);
             break;
         // Handle unknown CAD exit modes (error logging)
         default:
             // Print an error message with the unknown CAD exit mode
-            HAL_DBG_TRACE_ERROR("Unknown CAD exit mode: 0x%02x\n", cad_params.cad_exit_mode);
+            HAL_DBG_TRACE_ERROR("Unknown CAD exit mode: 0x%02x\n", radio->cad_params.cad_exit_mode);
             break;
     }
 }
@@ -222,65 +524,186 @@ void on_cad_done_detected(void)
 void on_preamble_detected(void)
 {
     // Increment the detection counter
-    detection_counter++;
+    get_irq_radio()->detection_counter++;
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+    // Hold the current SF until the packet is received or lost
+    asfs_sniff_on_preamble_detected();
+#endif
+}
+
+// Callback function triggered when the radio left RX without receiving a packet
+void on_rx_timeout(void)
+{
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+    // The preamble was not followed by a packet, go back to duty cycling
+    asfs_sniff_restart((void*)context);
+#else
+    asfs_radio_t* radio = get_irq_radio();
+    // The frame sent after listening before talking did not complete in time
+    if( radio->is_tx_ongoing == true )
+    {
+        // The frame may have been on air anyway, count it against the duty cycle
+        apps_airtime_charge(asfs_tx_band, asfs_tx_time_on_air_in_ms, apps_common_get_time_in_ms());
+        asfs_tx_on_timeout(apps_common_get_time_in_ms());
+        end_lbt_tx(radio);
+        return;
+    }
+    // Nothing was received after the CAD detection, it was a false alarm
+    if( radio->is_cad_rx_ongoing == true )
+    {
+        radio->is_cad_rx_ongoing = false;
+        asfs_cad_cal_on_false_cad(radio->sf, radio->bw);
+    }
+    // The RX window is over, restart the CAD process on the same SF
+    start_cad(radio);
+#endif
 }
 
-// Callback function triggered when no preamble is detected
-void on_preamble_undetected(void)
+// Callback function triggered when the header of a packet is corrupted
+void on_header_error(void)
 {
-    // If no preamble is detected, restart the CAD process
-    ASSERT_SX126X_RC(sx126x_set_cad(context));
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+    asfs_sniff_restart((void*)context);
+#else
+    asfs_radio_t* radio = get_irq_radio();
+    // A LoRa packet was there, the CAD detection was right
+    radio->is_cad_rx_ongoing = false;
+    // A packet was seen on the current cell, even if it could not be received
+    asfs_cell_table_on_hit(&radio->cells);
+#endif
 }
 
 /*
  * @brief: This function is called when CAD (Channel Activity Detection) fails to detect activity.
- *        It adjusts the LoRa spreading factor (SF) based on the detection counter. If too many 
- *        undetected attempts occur, it resets or adjusts the spreading factor to improve signal sensitivity.
+ *        It moves the radio to the next (channel, SF) cell of its table: a cell left unchecked for
+ *        too long comes first, otherwise the one whose waiting time, weighted by its hit history, is
+ *        the highest for the time needed to check it, retune included (see asfs_cell.h).
  */
 void on_cad_done_undetected(void)
 {			
-    // If more than 5 unsuccessful detections, reset spreading factor to SF7
-    if(detection_counter > 5)
+    asfs_radio_t* radio = get_irq_radio();
+    radio->cad_done_count++;
+    // The channel is clear, the radio is now transmitting the queued frame by itself
+    if( radio->is_tx_ongoing == true )
     {
-        LORA_SF = SX126X_LORA_SF7;  // Set spreading factor to SF7 (default/lowest)
-        detection_counter = 0;      // Reset detection counter
-    } 
-    else 
+        return;
+    }
+    // Count the CAD for the online re-tuning of the thresholds, the scan costs follow its symbol count
+    if( asfs_cad_cal_on_cad_done(radio->sf, radio->bw) == true )
     {
-        // If detection failed fewer than 5 times, adjust the spreading factor
-        // If SF is currently SF11, reset to SF7 for faster transmission
-        if (LORA_SF == SX126X_LORA_SF11)
-        {
-            LORA_SF = SX126X_LORA_SF7;  // Reset to SF7 (lowest spreading factor)
-        }
-        else
-        {
-            // Otherwise, increase the spreading factor to improve sensitivity
-            LORA_SF++;  // Increment SF to next higher level (e.g., SF7 -> SF8, etc.)
-        }
+        update_scan_costs();
+    }
+    // Tell the energy detection its busy verdict was wrong, or its audit right
+    asfs_ed_on_cad_result(&radio->ed, false);
+    // Go on with the next cell
+    move_to_next_cell(radio);
+}
+
+/*
+ * @brief: Moves a radio to the next cell of its table after the current one was checked.
+ *        When a frame of a periodic neighbour is expected before the next CAD of the background sweep,
+ *        the radio waits for it on its cell, see asfs_predict.h. Otherwise the cell is chosen from the
+ *        hit history and the CAD and retune costs, see asfs_cell.h.
+ */
+static void move_to_next_cell(asfs_radio_t* radio)
+{
+    const uint32_t     now = apps_common_get_time_in_ms();
+    const asfs_cell_t* cell = NULL;
+    uint32_t           delay_ms = DELAY_MS_BEFORE_CAD;
+
+    // The cell was checked, it waits for its next turn from now on
+    asfs_cell_table_on_visit(&radio->cells, now);
+#if( ASFS_PREDICTIVE_SCAN == true )
+    asfs_predict_window_t window;
+    // Wait on the cell of the next predicted frame if it starts before the next background CAD would
+    if( ( asfs_predict_get_next_window(now, radio->sf_first, radio->sf_last, &window) == true ) &&
+        ( ( int32_t )( window.open_in_ms - now ) < ASFS_PREDICT_BACKGROUND_DELAY_MS ) )
+    {
+        cell = asfs_cell_table_select(&radio->cells, window.channel, window.bw, window.sf);
+        // Within the window, CADs follow each other until the frame is caught or the window closes
+        delay_ms = ( ( int32_t )( window.open_in_ms - now ) > 0 ) ? window.open_in_ms - now : 0;
+    }
+    // Outside the windows of the predicted neighbours, the other cells are only swept sparsely
+    if( ( cell == NULL ) && ( asfs_predict_get_n_locked() != 0 ) )
+    {
+        delay_ms = ASFS_PREDICT_BACKGROUND_DELAY_MS;
+    }
+#endif
+    if( cell == NULL )
+    {
+        // Choose the next cell from the hit history and the CAD and retune costs
+        cell = asfs_cell_table_select_next(&radio->cells, now);
     }
-    // Re-initialize the application with the adjusted spreading factor
-    init_app(LORA_SF, SX126X_CAD_RX);
+    // Tune the radio on the channel of the cell, only sent to the radio if it changed
+    asfs_radio_set_channel(radio, cell->channel);
+    // Move to the bandwidth of the cell, sent along with the SF
+    asfs_radio_set_bw(radio, cell->bw);
+    // Re-initialize the radio with the SF of the cell, which also resets the detection counter,
+    // the CAD waits for the predicted window or for the next step of the background sweep
+    init_radio_with_delay(radio, cell->sf, SX126X_CAD_RX, ( uint16_t ) delay_ms);
+}
+
+/*
+ * @brief: This function is called when the frame sent after listening before talking is on air.
+ *        The frame leaves the transmit queue and the radio goes back to scanning.
+ */
+void on_tx_done(void)
+{
+    asfs_radio_t* radio = get_irq_radio();
+    // Take the time on air of the frame from the duty cycle budget of its sub-band
+    apps_airtime_charge(asfs_tx_band, asfs_tx_time_on_air_in_ms, apps_common_get_time_in_ms());
+    // Account the frame as sent, with its latency since it was queued
+    asfs_tx_on_done(apps_common_get_time_in_ms());
+    // Go back to scanning
+    end_lbt_tx(radio);
 }
 
 /*
  * @brief: This function is called when the SX126x radio successfully receives a packet.
- *        It handles post-reception processing, reads the received data into a buffer,
- *        and prepares the radio to receive the next packet after a random delay.
+ *        It reads the packet status, sets the radio back to receive mode and only then drains
+ *        the payload into a pool slot, which is handed over to process_received_packets().
+ *        The next packet needs at least a preamble and a header before reaching the data buffer,
+ *        far longer than the SPI read of the previous payload, so re-arming first is safe.
  */
 void on_rx_done(void)
 {
-    uint8_t size;
-    // Clear the buffer to prepare for incoming data
-    memset(buffer, 0, PAYLOAD_LENGTH);
+#if( RX_BUFFER_RING_MODE == true )
+    // A packet was received, the CAD detection was right
+    radios[0].is_cad_rx_ongoing = false;
     // Handle post-reception processes such as clearing interrupts
     apps_common_sx126x_handle_post_rx();
-    // Retrieve the received data from the radio into the buffer
-    apps_common_sx126x_receive((void*)context, buffer, &size, PAYLOAD_LENGTH);
+    // Record the packet and its channel and let the next one land in another slot, the payload is drained later
+    apps_rx_ring_on_rx_done((void*)context, radios[0].channel);
+    // A packet was seen on the current cell
+    asfs_cell_table_on_hit(&radios[0].cells);
     // Prepare for the next reception
     apps_common_sx126x_handle_pre_rx();
-    // Set the radio to receive mode again, with a random delay
-    sx126x_set_rx(context, get_time_on_air_in_ms() + RX_TIMEOUT_VALUE + rand() % 500);
+    // Set the radio to receive mode again
+    rearm_rx(&radios[0]);
+#else
+    asfs_radio_t* radio = get_irq_radio();
+    apps_rx_pkt_desc_t* desc = apps_rx_pool_acquire();
+    // A packet was received, the CAD detection was right
+    radio->is_cad_rx_ongoing = false;
+    // A packet was seen on the current cell
+    asfs_cell_table_on_hit(&radio->cells);
+    // Handle post-reception processes such as clearing interrupts
+    apps_common_sx126x_handle_post_rx();
+    // Retrieve the packet status and location, the packet is dropped if no slot is left
+    const bool is_kept = ( desc != NULL ) &&
+                         apps_common_sx126x_get_rx_pkt_info(radio->context, desc, APPS_RX_POOL_SLOT_SIZE);
+    // Prepare for the next reception
+    apps_common_sx126x_handle_pre_rx();
+    // Set the radio to receive mode again
+    rearm_rx(radio);
+    // Drain the payload from the radio data buffer and publish it
+    if( is_kept == true )
+    {
+        desc->channel = radio->channel;
+        apps_common_sx126x_read_rx_payload(radio->context, desc);
+        apps_rx_pool_commit();
+    }
+#endif
 }
 
 /*
@@ -292,62 +715,509 @@ void on_rx_error(void)
 {
     // Handle post-reception processes such as clearing interrupts, even after an error
     apps_common_sx126x_handle_post_rx();
-    // Set the radio to receive mode again, with a random delay to avoid collisions
-    sx126x_set_rx(context, get_time_on_air_in_ms() + RX_TIMEOUT_VALUE + rand() % 500);
+    // Set the radio to receive mode again
+    rearm_rx(get_irq_radio());
+}
+
+/*
+ * @brief: Consumer side of the reception pool, called from the main loop.
+ *        In ring mode, the packets still waiting in the radio data buffer are drained first.
+ *        Every queued packet is reported then its slot is given back to the pool.
+ */
+static void process_received_packets(void)
+{
+    const apps_rx_pkt_desc_t* desc;
+
+#if( RX_BUFFER_RING_MODE == true )
+    apps_rx_pkt_desc_t* slot;
+
+    while( ( apps_rx_ring_get_pending() != 0 ) && ( ( slot = apps_rx_pool_acquire() ) != NULL ) )
+    {
+        if( apps_rx_ring_drain((void*)context, slot, APPS_RX_POOL_SLOT_SIZE) == true )
+        {
+            apps_rx_pool_commit();
+        }
+    }
+#endif
+
+    while( ( desc = apps_rx_pool_peek() ) != NULL )
+    {
+        HAL_DBG_TRACE_INFO("RX %d bytes on %s / %s at %u ms - RSSI %d dBm, SNR %d dB\n", desc->size,
+                           sx126x_lora_sf_to_str(desc->sf), sx126x_lora_bw_to_str(desc->bw), desc->timestamp_in_ms,
+                           desc->rssi_pkt_in_dbm, desc->snr_pkt_in_db);
+        // Update the link to the sender and the spreading factor to answer it with
+        asfs_link_on_rx(desc);
+        // Learn the period of the sender from the RX_DONE timestamps, to scan where its next frame is expected
+        asfs_predict_on_rx(desc);
+        // Adapt the CAD symbols of the SF and bandwidth to the SNR, the scan costs of the cells follow
+        if( asfs_cad_snr_on_rx(desc) == true )
+        {
+            update_scan_costs();
+        }
+        // Split the frame into the messages it carries
+        asfs_agg_reader_t reader;
+        const uint8_t*    msg;
+        uint8_t           msg_size;
+        if( asfs_agg_reader_init(&reader, desc->payload, desc->size) == true )
+        {
+            while( asfs_agg_reader_next(&reader, &msg, &msg_size) == true )
+            {
+                HAL_DBG_TRACE_INFO("  message of %u bytes from 0x%04x\n", msg_size, reader.src);
+            }
+        }
+        apps_rx_pool_release();
+    }
 }
 
 /*
- * @brief: This function starts the CAD (Channel Activity Detection) process after a delay.
- *        It waits for the specified time (in milliseconds) and then initiates CAD to check
- *        for channel activity.
+ * @brief: Sets the radio back to reception after a packet or an error.
+ *        The CAD loop listens with a random timeout to avoid collisions, sniff mode resumes duty cycling.
  */
-static void start_cad_after_delay(uint16_t delay_ms)
+static void rearm_rx(asfs_radio_t* radio)
 {
-    // Wait for the specified delay in milliseconds
-    LL_mDelay(delay_ms);
+#if( ASFS_SCAN_MODE == ASFS_SCAN_MODE_SNIFF )
+    asfs_sniff_restart(radio->context);
+#else
+    sx126x_set_rx(radio->context,
+                  apps_common_get_lora_time_on_air_in_ms(&radio->lora_mod_params) + RX_TIMEOUT_VALUE + rand() % 500);
+#endif
+}
+
+/*
+ * @brief: Returns the ASFS state of the radio whose interrupts are being processed.
+ */
+static asfs_radio_t* get_irq_radio(void)
+{
+    return &radios[apps_common_sx126x_get_radio_id(apps_common_sx126x_get_irq_context())];
+}
+
+/*
+ * @brief: Prints, for every scanned SF, the radio charge per hour and the worst-case detection latency
+ *        of the duty-cycled sniff mode next to the ones of the CAD loop.
+ */
+static void print_scan_budget(void)
+{
+    sx126x_cad_params_t budget_cad_params = radios[0].cad_params;
+
+    for( sx126x_lora_sf_t sf = SX126X_LORA_SF7; sf <= SX126X_LORA_SF11; sf++ )
+    {
+        optimize_cad_parameters(sf, LORA_BANDWIDTH, &budget_cad_params);
+        asfs_cad_cal_apply(sf, LORA_BANDWIDTH, &budget_cad_params);
+        asfs_sniff_print_budget(sf, budget_cad_params.cad_symb_nb, DELAY_MS_BEFORE_CAD);
+    }
+}
+
+/*
+ * @brief: Returns the time needed by a radio to check one spreading factor on every scanned bandwidth:
+ *        the delay before each CAD and the CAD itself.
+ */
+static uint32_t get_sf_scan_cost_in_us(sx126x_lora_sf_t sf)
+{
+    uint32_t cost_in_us = 0;
+
+    for( uint8_t i = 0; i < ASFS_N_BANDWIDTHS; i++ )
+    {
+        cost_in_us += ( DELAY_MS_BEFORE_CAD * 1000 ) + get_cad_cost_in_us(sf, asfs_bandwidths[i]);
+    }
+    return cost_in_us;
+}
+
+/*
+ * @brief: Returns the duration of a CAD on a spreading factor and bandwidth: the CAD symbols and
+ *        about one more symbol of processing. It is four times shorter at 500 kHz than at 125 kHz
+ *        for the same symbol count.
+ */
+static uint32_t get_cad_cost_in_us(sx126x_lora_sf_t sf, sx126x_lora_bw_t bw)
+{
+    sx126x_cad_params_t cell_cad_params = cad_params;
+    optimize_cad_parameters(sf, bw, &cell_cad_params);
+    asfs_cad_cal_apply(sf, bw, &cell_cad_params);
+    asfs_cad_snr_apply(sf, bw, &cell_cad_params, apps_common_get_time_in_ms());
+
+    const uint32_t symb_time_in_us = ( uint32_t )( ( ( uint64_t ) 1000000 << sf ) / sx126x_get_lora_bw_in_hz(bw) );
+
+    return symb_time_in_us * ( ( 1u << cell_cad_params.cad_symb_nb ) + 1 );
+}
+
+/*
+ * @brief: Sizes again the CAD time of every cell, the sweep time and the maximum age of every radio,
+ *        after the CAD symbols of a spreading factor and bandwidth changed. The preambles of the frames
+ *        sent are sized again for the new scan of the receivers.
+ */
+static void update_scan_costs(void)
+{
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        asfs_cell_table_update_costs(&radios[id].cells, get_cad_cost_in_us);
+#if( ASFS_TX_QUEUE == true )
+        if( asfs_preamble_set_profiles_from_cells(&radios[id].cells, ASFS_TX_CHANNEL,
+                                                  ASFS_PREAMBLE_GUARANTEED) == false )
+        {
+            HAL_DBG_TRACE_WARNING("Too many preamble profiles, some frames use LORA_PREAMBLE_LENGTH\n");
+        }
+#endif
+    }
+}
+
+/*
+ * @brief: Calibrates the CAD thresholds of every SF of the range of a radio, on every scanned bandwidth,
+ *        against the local noise. Any detection during the calibration counts as false, so no node may
+ *        transmit meanwhile.
+ */
+static void calibrate_cad_thresholds(asfs_radio_t* radio)
+{
+    for( uint8_t i = 0; i < ASFS_N_BANDWIDTHS; i++ )
+    {
+        asfs_radio_set_bw(radio, asfs_bandwidths[i]);
+        for( sx126x_lora_sf_t sf = radio->sf_first; sf <= radio->sf_last; sf++ )
+        {
+            sx126x_cad_params_t sf_cad_params = cad_params;
+
+            asfs_radio_set_sf(radio, sf);
+            apps_common_sx126x_radio_init_with_lora_mod_params(radio->context, &radio->lora_mod_params);
+            apps_channel_plan_set_channel(radio->context, radio->channel);
+            optimize_cad_parameters(sf, radio->bw, &sf_cad_params);
+            asfs_cad_cal_run(radio->context, &radio->lora_mod_params, &sf_cad_params);
+        }
+    }
+    asfs_radio_set_sf(radio, radio->sf_first);
+}
+
+/*
+ * @brief: This function schedules the CAD (Channel Activity Detection) process after a delay.
+ *        The CAD is started by on_cad_timer once the specified time (in milliseconds)
+ *        has elapsed, so the other radios keep being served in the meantime.
+ */
+static void start_cad_after_delay(asfs_radio_t* radio, uint16_t delay_ms)
+{
+    radio->wait_start_in_ms = apps_common_get_time_in_ms();
+    // At most one timer per radio is running, the list cannot be full
+    apps_timer_start(&radio->cad_timer, delay_ms);
+#if( ASFS_WARM_SLEEP == true )
+    // Sleep until the CAD is due, unless the radio could not even be woken up in time
+    if( delay_ms >= ASFS_WARM_SLEEP_MIN_MS )
+    {
+        asfs_radio_sleep(radio);
+    }
+#endif
+}
+
+/*
+ * @brief: Starts the CAD of a radio whose delay has elapsed, called by apps_timer_process from the main loop.
+ */
+static void on_cad_timer(void* context)
+{
+    asfs_radio_t*  radio        = (asfs_radio_t*)context;
+    const uint32_t waited_in_ms = apps_common_get_time_in_ms() - radio->wait_start_in_ms;
+
+    if( radio->is_asleep == true )
+    {
+        radio->power_stats.sleep_time_in_ms += waited_in_ms;
+    }
+    else
+    {
+        radio->power_stats.stdby_time_in_ms += waited_in_ms;
+    }
+    start_cad(radio);
+}
+
+/*
+ * @brief: Tells the MCU not to sleep while an interrupt or a packet waits for the main loop.
+ *        Called with the interrupts masked, so that nothing is raised between the check and the sleep.
+ */
+static bool has_pending_work(void)
+{
+#if( RX_BUFFER_RING_MODE == true )
+    if( apps_rx_ring_get_pending() != 0 )
+    {
+        return true;
+    }
+#endif
+    return ( apps_common_sx126x_is_irq_pending() == true ) || ( apps_rx_pool_peek() != NULL );
+}
+
+/*
+ * @brief: Starts a CAD right away, every CAD command sent to a radio goes through here.
+ *        A sleeping radio is woken up first and only gets the parameters which changed meanwhile.
+ */
+static void start_cad(asfs_radio_t* radio)
+{
+    const uint32_t start_cycles = apps_common_get_cycle_count();
+
+    asfs_radio_wake(radio);
+    asfs_radio_sync_config(radio);
+#if( ASFS_TX_QUEUE == true )
+    // The first radio sends the queued frames in between its CADs, the others keep scanning
+    if( ( radio->id == 0 ) && ( asfs_tx_is_due(apps_common_get_time_in_ms()) == true ) && ( admit_lbt_tx() == true ) )
+    {
+        start_lbt_tx(radio);
+        return;
+    }
+#endif
+#if( ASFS_ENERGY_PREFILTER == true )
+    const asfs_cell_t* cell = asfs_cell_table_get_current(&radio->cells);
+    // A short RX window is enough to tell that nothing is on air before a long CAD
+    if( ( cell->cost_in_us >= ASFS_ED_MIN_CAD_US ) &&
+        ( asfs_ed_check(&radio->ed, radio->context, radio->channel, radio->bw, cell->cost_in_us) == ASFS_ED_SILENT ) )
+    {
+        // The channel is silent, skip the CAD of this cell as if it had found nothing
+        move_to_next_cell(radio);
+        return;
+    }
+#endif
+    radio->cad_start_count++;
     // Start the CAD process and check for any errors during the setup
-    ASSERT_SX126X_RC(sx126x_set_cad(context));
+    ASSERT_SX126X_RC(sx126x_set_cad(radio->context));
+
+    radio->power_stats.last_wake_to_cad_in_us = apps_common_cycles_to_us(apps_common_get_cycle_count() - start_cycles);
+    if( radio->power_stats.last_wake_to_cad_in_us > radio->power_stats.max_wake_to_cad_in_us )
+    {
+        radio->power_stats.max_wake_to_cad_in_us = radio->power_stats.last_wake_to_cad_in_us;
+    }
+}
+
+/*
+ * @brief: Checks the frame at the head of the transmit queue against the duty cycle of its sub-band.
+ *        A frame the budget cannot afford yet is postponed until it can, one it can never afford is dropped.
+ */
+static bool admit_lbt_tx(void)
+{
+    const uint32_t now = apps_common_get_time_in_ms();
+    // The spreading factor, hence the time on air, depends on the destination of the frame
+    const uint32_t time_on_air_in_ms = asfs_tx_get_time_on_air_in_ms();
+
+    switch( apps_airtime_check(asfs_tx_band, time_on_air_in_ms, now) )
+    {
+        case APPS_AIRTIME_ADMIT:
+            return true;
+        case APPS_AIRTIME_DELAY:
+            // Keep scanning until enough airtime is back
+            asfs_tx_defer(apps_airtime_get_next_tx_in_ms(asfs_tx_band, time_on_air_in_ms, now));
+            return false;
+        default:
+            // Longer than the whole budget, or out of the sub-band table
+            asfs_tx_drop();
+            return false;
+    }
+}
+
+/*
+ * @brief: Sends the frame at the head of the transmit queue, if the channel is clear.
+ *        The CAD runs with the SX126X_CAD_LBT exit mode: on a clear channel the radio transmits the frame
+ *        by itself and raises TX_DONE, on a busy one CAD_DETECTED and nothing is sent.
+ */
+static void start_lbt_tx(asfs_radio_t* radio)
+{
+    // Tune the radio on the channel of the transmissions
+    apps_channel_plan_set_channel(radio->context, ASFS_TX_CHANNEL);
+    // Load the frame with the spreading factor chosen for its destination
+    const asfs_tx_frame_t* frame = asfs_tx_load(radio->context);
+    asfs_tx_time_on_air_in_ms = frame->time_on_air_in_ms;
+    // Listen with the CAD thresholds of the spreading factor and bandwidth of the frame
+    change_cad_params(SX126X_CAD_LBT);
+    radio->cad_params = cad_params;
+    optimize_cad_parameters(frame->mod_params.sf, frame->mod_params.bw, &radio->cad_params);
+    asfs_cad_cal_apply(frame->mod_params.sf, frame->mod_params.bw, &radio->cad_params);
+    // In LBT mode the CAD timeout bounds the transmission, give it twice the time on air
+    radio->cad_params.cad_timeout = sx126x_convert_timeout_in_ms_to_rtc_step(2 * frame->time_on_air_in_ms);
+    ASSERT_SX126X_RC(sx126x_set_cad_params(radio->context, &radio->cad_params));
+    // The modulation, packet and CAD parameters of the scan have to be sent again afterwards
+    radio->is_configured = false;
+    radio->is_tx_ongoing = true;
+    radio->cad_start_count++;
+    // Listen before talking
+    ASSERT_SX126X_RC(sx126x_set_cad(radio->context));
+}
+
+/*
+ * @brief: Puts a radio back to scanning after a frame was sent, or found the channel busy.
+ *        The whole scan configuration is sent again before the next CAD, on the same cell.
+ */
+static void end_lbt_tx(asfs_radio_t* radio)
+{
+    radio->is_tx_ongoing = false;
+    // Restore the CAD parameters of the cell and schedule its CAD
+    init_radio(radio, radio->sf, SX126X_CAD_RX);
+}
+
+/*
+ * @brief: Queues a broadcast beacon, a sequence number in a frame whose header carries the address of the node.
+ *        The address comes first, where asfs_link expects the source of a packet.
+ */
+static void queue_beacon(void)
+{
+    static uint16_t beacon_seq = 0;
+    const uint8_t   beacon[]   = { ( uint8_t )( beacon_seq >> 8 ), ( uint8_t )( beacon_seq & 0xFF ) };
+
+    // A beacon lost to a full queue is not sent again, the next one carries the following sequence number anyway
+    asfs_agg_push(ASFS_TX_BROADCAST, beacon, sizeof(beacon), apps_common_get_time_in_ms());
+    beacon_seq++;
+}
+
+/*
+ * @brief: Queues a broadcast telemetry message: the packets received and the CADs done by every radio.
+ *        It waits for other messages to share its frame, up to ASFS_AGG_MAX_DELAY_MS.
+ */
+static void queue_telemetry(void)
+{
+    apps_rx_pool_stats_t pool_stats;
+    uint32_t             cad_done_count = 0;
+
+    apps_rx_pool_get_stats(&pool_stats);
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        cad_done_count += radios[id].cad_done_count;
+    }
+    const uint8_t telemetry[] = { ( uint8_t )( pool_stats.committed >> 8 ), ( uint8_t )( pool_stats.committed & 0xFF ),
+                                  ( uint8_t )( cad_done_count >> 24 ), ( uint8_t )( cad_done_count >> 16 ),
+                                  ( uint8_t )( cad_done_count >> 8 ), ( uint8_t )( cad_done_count & 0xFF ) };
+
+    asfs_agg_push(ASFS_TX_BROADCAST, telemetry, sizeof(telemetry), apps_common_get_time_in_ms());
+}
+
+/*
+ * @brief: Prints the IRQ dispatch counters, and for each radio the CAD commands sent against the CADs done.
+ *        Both CAD counts match when no CAD is restarted needlessly.
+ */
+static void print_dispatch_stats(void)
+{
+    apps_common_irq_stats_t stats;
+
+    apps_common_sx126x_get_irq_stats(&stats);
+    HAL_DBG_TRACE_INFO("IRQs: %u - CAD done %u, RX done %u, timeout %u, header error %u, unhandled %u\n",
+                       stats.irq_count, stats.dispatch_count[__builtin_ctz(SX126X_IRQ_CAD_DONE)],
+                       stats.dispatch_count[__builtin_ctz(SX126X_IRQ_RX_DONE)],
+                       stats.dispatch_count[__builtin_ctz(SX126X_IRQ_TIMEOUT)],
+                       stats.dispatch_count[__builtin_ctz(SX126X_IRQ_HEADER_ERROR)], stats.unhandled_count);
+    apps_channel_plan_stats_t plan_stats;
+    apps_channel_plan_get_stats(&plan_stats);
+    HAL_DBG_TRACE_INFO("Channel plan: %u channel changes, %u image calibrations over %u bands\n",
+                       plan_stats.hop_count, plan_stats.cal_img_count, apps_channel_plan_get_n_bands());
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        const asfs_radio_power_stats_t* power = &radios[id].power_stats;
+        const uint32_t waited_in_ms = power->sleep_time_in_ms + power->stdby_time_in_ms;
+
+        HAL_DBG_TRACE_INFO("Radio %d: %u CAD commands for %u CADs done\n", id, radios[id].cad_start_count,
+                           radios[id].cad_done_count);
+        HAL_DBG_TRACE_INFO("Radio %d: waited %u ms asleep and %u ms in STDBY_RC, %u wake-ups, %u delta commands\n",
+                           id, power->sleep_time_in_ms, power->stdby_time_in_ms, power->wake_count,
+                           power->delta_commands);
+        HAL_DBG_TRACE_INFO("Radio %d: full configuration %u us (x%u), CAD start %u us (max %u us)\n", id,
+                           power->last_config_in_us, power->full_configs, power->last_wake_to_cad_in_us,
+                           power->max_wake_to_cad_in_us);
+        if( waited_in_ms != 0 )
+        {
+            // Average radio current between two CADs, from the datasheet figures of each state
+            const uint64_t charge = ( uint64_t ) power->sleep_time_in_ms * ASFS_SNIFF_CURRENT_SLEEP_WARM_NA +
+                                    ( uint64_t ) power->stdby_time_in_ms * ASFS_SNIFF_CURRENT_STDBY_RC_NA;
+            HAL_DBG_TRACE_INFO("Radio %d: %u nA between CADs, %u nA if always in STDBY_RC\n", id,
+                               ( uint32_t )( charge / waited_in_ms ), ASFS_SNIFF_CURRENT_STDBY_RC_NA);
+        }
+        asfs_cell_table_print(&radios[id].cells, id);
+        asfs_ed_print(&radios[id].ed, id);
+    }
+    // Show the spreading factor chosen for each neighbour and the time on air it saves
+    asfs_link_print();
+    // Show the period of the neighbours and the frames caught in their predicted windows
+    asfs_predict_print();
+    // The energy spent scanning for each packet received, which predictions should bring down
+    apps_rx_pool_stats_t pool_stats;
+    uint32_t             cad_done_count = 0;
+    apps_rx_pool_get_stats(&pool_stats);
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        cad_done_count += radios[id].cad_done_count;
+    }
+    HAL_DBG_TRACE_INFO("Scan: %u CADs for %u packets received\n", cad_done_count, pool_stats.committed);
+    // Show how long the MCU slept between the CADs, and how late the timers were served
+    apps_timer_stats_t timer_stats;
+    apps_timer_get_stats(&timer_stats);
+    HAL_DBG_TRACE_INFO("MCU: %u sleeps, %u ms asleep, %u timers at most, %u us late at most\n",
+                       timer_stats.n_sleeps, ( uint32_t )( timer_stats.sleep_time_in_us / 1000 ),
+                       timer_stats.max_running, timer_stats.max_lateness_in_us);
+#if( APPS_ENERGY == true )
+    // The charge drawn per hour and per packet received, to judge the scan settings on energy as well as latency
+    apps_energy_report_t energy;
+    apps_energy_get_report(apps_timer_get_time_in_us(), timer_stats.sleep_time_in_us, pool_stats.committed, &energy);
+    HAL_DBG_TRACE_INFO("Energy: %u.%03u uAh per hour, %u.%03u uAh per packet received\n",
+                       energy.avg_current_in_na / 1000, energy.avg_current_in_na % 1000,
+                       energy.charge_per_packet_in_nah / 1000, energy.charge_per_packet_in_nah % 1000);
+    HAL_DBG_TRACE_INFO("Energy: radios %u uC, MCU %u uC with %u ms asleep\n",
+                       ( uint32_t )( energy.radio_charge_in_pc / 1000000 ),
+                       ( uint32_t )( energy.mcu_charge_in_pc / 1000000 ), ( uint32_t )( energy.mcu_sleep_in_us / 1000 ));
+    for( uint8_t mode = 0; mode < APPS_ENERGY_N_MODES; mode++ )
+    {
+        if( energy.mode_time_in_us[mode] != 0 )
+        {
+            HAL_DBG_TRACE_INFO("Energy: %s %u ms, %u uC\n", apps_energy_mode_to_str(( apps_energy_mode_t ) mode),
+                               ( uint32_t )( energy.mode_time_in_us[mode] / 1000 ),
+                               ( uint32_t )( energy.mode_charge_in_pc[mode] / 1000000 ));
+        }
+    }
+#endif
+#if( APPS_SPI_LOG == true )
+    apps_spi_log_stats_t spi_log_stats;
+    apps_spi_log_get_stats(&spi_log_stats);
+    HAL_DBG_TRACE_INFO("SPI log: %u transactions, %u dropped\n", spi_log_stats.recorded, spi_log_stats.dropped);
+#endif
+    // Show the SNR received on each SF and the CAD length it leads to
+    asfs_cad_snr_print();
+    // Show the messages split from the frames received, and the airtime saved by sharing frames
+    asfs_agg_print();
+#if( ASFS_TX_QUEUE == true )
+    // Show the depth, latency and retries of the transmit queue
+    asfs_tx_print();
+    // Show the airtime spent on each sub-band and the budget left
+    apps_airtime_print(apps_common_get_time_in_ms());
+#endif
 }
 
 
 
 #if USER_PROVIDED_CAD_PARAMETERS == False
-static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_cad_params_t* cad_params )
+static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params )
 {
     switch( sf )
     {
     case SX126X_LORA_SF7:
         cad_params->cad_detect_min  = 10;
         cad_params->cad_detect_peak = 22;
-        cad_params->cad_symb_nb     = 2;
+        cad_params->cad_symb_nb     = SX126X_CAD_02_SYMB;
         break;
     case SX126X_LORA_SF8:
         cad_params->cad_detect_min  = 10;
         cad_params->cad_detect_peak = 22;
-        cad_params->cad_symb_nb     = 2;
+        cad_params->cad_symb_nb     = SX126X_CAD_02_SYMB;
         break;
     case SX126X_LORA_SF9:
         cad_params->cad_detect_min  = 10;
         cad_params->cad_detect_peak = 23;
-        cad_params->cad_symb_nb     = 4;
+        cad_params->cad_symb_nb     = SX126X_CAD_04_SYMB;
         break;
     case SX126X_LORA_SF10:
         cad_params->cad_detect_min  = 10;
         cad_params->cad_detect_peak = 24;
-        cad_params->cad_symb_nb     = 4;
+        cad_params->cad_symb_nb     = SX126X_CAD_04_SYMB;
         break;
     case SX126X_LORA_SF11:
         cad_params->cad_detect_min  = 10;
         cad_params->cad_detect_peak = 25;
-        cad_params->cad_symb_nb     = 4;
+        cad_params->cad_symb_nb     = SX126X_CAD_04_SYMB;
         break;
     default:
         HAL_DBG_TRACE_WARNING( "CAD may not function properly while using these radio parameters\n" );
         break;
     }
+    // The values above are the 125 kHz ones. Symbols are four times shorter at 500 kHz:
+    // twice as many still make a CAD twice as short as at 125 kHz
+    if( ( bw == SX126X_LORA_BW_500 ) && ( cad_params->cad_symb_nb < SX126X_CAD_16_SYMB ) )
+    {
+        cad_params->cad_symb_nb = ( sx126x_cad_symbs_t )( cad_params->cad_symb_nb + 1 );
+    }
 }
 #else
-static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_cad_params_t* cad_params )
+static void optimize_cad_parameters( sx126x_lora_sf_t sf, sx126x_lora_bw_t bw, sx126x_cad_params_t* cad_params )
 {
 }
 #endif
\ No newline at end of file
@@ -74,7 +74,7 @@ extern "C" {
 #endif
 
 #ifndef CAD_SYMBOL_NUM
-#define CAD_SYMBOL_NUM 2
+#define CAD_SYMBOL_NUM SX126X_CAD_02_SYMB
 #endif
 
 /*!
@@ -130,6 +130,168 @@ extern void change_cad_params (sx126x_cad_exit_modes_t mode);
 #ifndef DELAY_MS_BEFORE_CAD
 #define DELAY_MS_BEFORE_CAD 500
 #endif
+
+/*!
+ *  @brief RF frequencies of the channel plan - in Hz
+ *  Brace-enclosed list, the channels are converted to PLL steps once and grouped into
+ *  image calibration bands, see apps_channel_plan.h. Every radio scans each channel on each bandwidth
+ *  and SF of its range, see asfs_cell.h for the order in which these cells are checked.
+ */
+#ifndef ASFS_CHANNELS_IN_HZ
+#define ASFS_CHANNELS_IN_HZ { RF_FREQ_IN_HZ }
+#endif
+
+/*!
+ *  @brief LoRa bandwidths scanned on every channel and spreading factor
+ *  Brace-enclosed list of sx126x_lora_bw_t values. The CAD thresholds are tuned per spreading
+ *  factor and bandwidth; sniff mode only uses LORA_BANDWIDTH.
+ */
+#ifndef ASFS_BANDWIDTHS
+#define ASFS_BANDWIDTHS { LORA_BANDWIDTH }
+#endif
+
+/*!
+ *  @brief Check the energy on the channel before the long CADs
+ *  Set to true to skip the CAD of a cell when a short RX window shows nothing above the noise
+ *  floor, see asfs_ed.h. LoRa is received below the noise, so this trades the detection of the
+ *  weakest packets for energy; the audit counters show how many would have been missed.
+ */
+#ifndef ASFS_ENERGY_PREFILTER
+#define ASFS_ENERGY_PREFILTER false
+#endif
+
+/*!
+ *  @brief Scan where and when the periodic neighbours are expected to send
+ *  Set to true to learn the period of each neighbour from the RX_DONE timestamps, see asfs_predict.h.
+ *  The radio waits for the next predicted frame on its cell, and only sweeps the other cells every
+ *  ASFS_PREDICT_BACKGROUND_DELAY_MS while some neighbours are predicted.
+ */
+#ifndef ASFS_PREDICTIVE_SCAN
+#define ASFS_PREDICTIVE_SCAN true
+#endif
+
+/*!
+ *  @brief Delay before each CAD of the background sweep, while some neighbours are predicted - in milliseconds
+ */
+#ifndef ASFS_PREDICT_BACKGROUND_DELAY_MS
+#define ASFS_PREDICT_BACKGROUND_DELAY_MS ( 4 * DELAY_MS_BEFORE_CAD )
+#endif
+
+/*!
+ *  @brief Put the radios in warm-start sleep while they wait for their next CAD
+ *  Set to true to sleep instead of staying in STDBY_RC. The configuration and calibrations are
+ *  retained, so only the parameters changed since the last CAD are sent on wake-up.
+ */
+#ifndef ASFS_WARM_SLEEP
+#define ASFS_WARM_SLEEP false
+#endif
+
+/*!
+ *  @brief Shortest wait before a CAD for which the radio is put to sleep - in milliseconds
+ */
+#ifndef ASFS_WARM_SLEEP_MIN_MS
+#define ASFS_WARM_SLEEP_MIN_MS 5
+#endif
+
+/*!
+ *  @brief Put the MCU to sleep in the main loop until the next CAD is due or a radio interrupt is raised
+ *  Set to false to keep polling. The CADs are started from virtual timers on the LPTIM, see apps_timer.h,
+ *  which keeps counting in STOP2 (APPS_TIMER_STOP2).
+ */
+#ifndef ASFS_MCU_SLEEP
+#define ASFS_MCU_SLEEP true
+#endif
+
+/*!
+ *  @brief Longest MCU sleep - in milliseconds
+ *  Bounds the latency of the tasks still polled by the main loop: printouts, frames to send, sniff dwell.
+ */
+#ifndef ASFS_MCU_SLEEP_MAX_MS
+#define ASFS_MCU_SLEEP_MAX_MS 10
+#endif
+
+/*!
+ *  @brief Period of the IRQ dispatch and CAD counters printout - in milliseconds
+ */
+#ifndef ASFS_STATS_PERIOD_MS
+#define ASFS_STATS_PERIOD_MS 60000
+#endif
+
+/*!
+ *  @brief Calibrate the CAD thresholds of each spreading factor at start-up
+ *  Set to true to tune cad_detect_peak, cad_detect_min and the symbol count to the local noise
+ *  before scanning, see asfs_cad_cal.h. The channel must be empty during the calibration.
+ *  The thresholds are re-tuned online from the false CADs in any case.
+ */
+#ifndef ASFS_CAD_CALIBRATION
+#define ASFS_CAD_CALIBRATION true
+#endif
+
+/*!
+ *  @brief Spreading factor scan modes
+ */
+#define ASFS_SCAN_MODE_CAD 0    //!< The MCU sweeps the spreading factors with one CAD at a time
+#define ASFS_SCAN_MODE_SNIFF 1  //!< The radio duty-cycles RX/sleep on each spreading factor by itself
+
+/*!
+ *  @brief Defines how the spreading factors are scanned
+ *  In sniff mode, the RX and sleep windows are derived from LORA_PREAMBLE_LENGTH and the symbol time,
+ *  see asfs_sniff.h for the related parameters.
+ */
+#ifndef ASFS_SCAN_MODE
+#define ASFS_SCAN_MODE ASFS_SCAN_MODE_CAD
+#endif
+
+
+/*!
+ *  @brief Receive in rotating slots of the radio data buffer
+ *  Set to true to move the RX base address after each packet, so back-to-back packets
+ *  are received while the previous ones are still drained by the MCU.
+ *  The number of slots is 256 / APPS_RX_RING_SLOT_SIZE (PAYLOAD_LENGTH by default).
+ */
+#ifndef RX_BUFFER_RING_MODE
+#define RX_BUFFER_RING_MODE false
+#endif
+
+/*!
+ *  @brief Send the frames of the transmit queue in between the CADs of the first radio
+ *  Set to true to run a listen-before-talk CAD with the SX126X_CAD_LBT exit mode when a frame is due:
+ *  the radio transmits by itself on a clear channel, a busy one delays the frame, see asfs_tx.h.
+ *  Only available in CAD scan mode, without the radio buffer ring which uses the whole data buffer.
+ */
+#ifndef ASFS_TX_QUEUE
+#define ASFS_TX_QUEUE false
+#endif
+
+/*!
+ *  @brief Address of the node, sent at the start of its frames
+ */
+#ifndef ASFS_NODE_ADDR
+#define ASFS_NODE_ADDR 0x0001
+#endif
+
+/*!
+ *  @brief Period of the beacons queued for transmission, 0 for none - in milliseconds
+ *  The beacons let the neighbours measure their link to this node, see asfs_link.h.
+ */
+#ifndef ASFS_TX_BEACON_PERIOD_MS
+#define ASFS_TX_BEACON_PERIOD_MS 30000
+#endif
+
+/*!
+ *  @brief Period of the telemetry messages queued for transmission, 0 for none - in milliseconds
+ *  The messages are small, they share frames with the beacons and each other, see asfs_agg.h.
+ */
+#ifndef ASFS_TX_TELEMETRY_PERIOD_MS
+#define ASFS_TX_TELEMETRY_PERIOD_MS 5000
+#endif
+
+/*!
+ *  @brief Index in ASFS_CHANNELS_IN_HZ of the channel the frames are sent on
+ */
+#ifndef ASFS_TX_CHANNEL
+#define ASFS_TX_CHANNEL 0
+#endif
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC CONSTANTS --------------------------------------------------------
@@ -0,0 +1,253 @@
+/*!
+ * @file      apps_airtime.c
+ *
+ * @brief     Regulatory duty-cycle ledger, with one airtime token bucket per sub-band
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <string.h>
+#include "apps_airtime.h"
+#include "smtc_hal_dbg_trace.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+static const apps_airtime_sub_band_t airtime_sub_bands[] = APPS_AIRTIME_SUB_BANDS;
+
+#define APPS_AIRTIME_N_SUB_BANDS ( sizeof( airtime_sub_bands ) / sizeof( airtime_sub_bands[0] ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Token bucket of a sub-band
+ *
+ * The credit is counted in microseconds of time on air: each millisecond brings back duty_cycle_permille of them,
+ * which keeps the refill an integer multiplication.
+ */
+typedef struct apps_airtime_bucket_s
+{
+    int32_t  credit_in_us;    //!< Time on air available, negative while a debt is paid back
+    int32_t  capacity_in_us;  //!< Share of a whole window
+    uint32_t update_in_ms;    //!< Time of the last refill
+} apps_airtime_bucket_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static apps_airtime_bucket_t airtime_buckets[APPS_AIRTIME_MAX_SUB_BANDS];
+
+static apps_airtime_stats_t airtime_stats[APPS_AIRTIME_MAX_SUB_BANDS];
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Bring back the credit earned since the last refill, up to the capacity
+ */
+static void apps_airtime_refill( uint8_t band, uint32_t now_in_ms );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+bool apps_airtime_init( uint32_t now_in_ms )
+{
+    if( APPS_AIRTIME_N_SUB_BANDS > APPS_AIRTIME_MAX_SUB_BANDS )
+    {
+        return false;
+    }
+
+    memset( airtime_stats, 0, sizeof( airtime_stats ) );
+    for( uint8_t band = 0; band < APPS_AIRTIME_N_SUB_BANDS; band++ )
+    {
+        apps_airtime_bucket_t* bucket = &airtime_buckets[band];
+
+        bucket->capacity_in_us = ( int32_t )( APPS_AIRTIME_WINDOW_MS * airtime_sub_bands[band].duty_cycle_permille );
+        bucket->credit_in_us   = bucket->capacity_in_us;
+        bucket->update_in_ms   = now_in_ms;
+    }
+    return true;
+}
+
+uint8_t apps_airtime_find_band( uint32_t freq_in_hz )
+{
+    for( uint8_t band = 0; band < APPS_AIRTIME_N_SUB_BANDS; band++ )
+    {
+        if( ( freq_in_hz >= airtime_sub_bands[band].freq_min_in_hz ) &&
+            ( freq_in_hz < airtime_sub_bands[band].freq_max_in_hz ) )
+        {
+            return band;
+        }
+    }
+    return APPS_AIRTIME_NO_BAND;
+}
+
+apps_airtime_verdict_t apps_airtime_check( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms )
+{
+    if( band >= APPS_AIRTIME_N_SUB_BANDS )
+    {
+        return APPS_AIRTIME_REJECT;
+    }
+
+    const apps_airtime_bucket_t* bucket = &airtime_buckets[band];
+    const int64_t                cost   = ( int64_t ) time_on_air_in_ms * 1000;
+
+    if( cost > bucket->capacity_in_us )
+    {
+        airtime_stats[band].rejected++;
+        return APPS_AIRTIME_REJECT;
+    }
+    apps_airtime_refill( band, now_in_ms );
+    if( cost > bucket->credit_in_us )
+    {
+        airtime_stats[band].delayed++;
+        return APPS_AIRTIME_DELAY;
+    }
+    return APPS_AIRTIME_ADMIT;
+}
+
+uint32_t apps_airtime_get_next_tx_in_ms( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms )
+{
+    if( band >= APPS_AIRTIME_N_SUB_BANDS )
+    {
+        return now_in_ms + APPS_AIRTIME_WINDOW_MS;
+    }
+
+    const apps_airtime_bucket_t* bucket   = &airtime_buckets[band];
+    const uint16_t               permille = airtime_sub_bands[band].duty_cycle_permille;
+    const int64_t                cost     = ( int64_t ) time_on_air_in_ms * 1000;
+
+    if( ( cost > bucket->capacity_in_us ) || ( permille == 0 ) )
+    {
+        return now_in_ms + APPS_AIRTIME_WINDOW_MS;
+    }
+    apps_airtime_refill( band, now_in_ms );
+    if( cost <= bucket->credit_in_us )
+    {
+        return now_in_ms;
+    }
+    // Rounded up, the credit is then enough for sure
+    return now_in_ms + ( uint32_t )( ( cost - bucket->credit_in_us + permille - 1 ) / permille );
+}
+
+void apps_airtime_charge( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms )
+{
+    if( band >= APPS_AIRTIME_N_SUB_BANDS )
+    {
+        return;
+    }
+
+    apps_airtime_refill( band, now_in_ms );
+    airtime_buckets[band].credit_in_us -= ( int32_t )( time_on_air_in_ms * 1000 );
+    airtime_stats[band].tx_count++;
+    airtime_stats[band].airtime_in_ms += time_on_air_in_ms;
+}
+
+void apps_airtime_get_stats( uint8_t band, apps_airtime_stats_t* stats )
+{
+    if( band >= APPS_AIRTIME_N_SUB_BANDS )
+    {
+        memset( stats, 0, sizeof( apps_airtime_stats_t ) );
+        return;
+    }
+    *stats = airtime_stats[band];
+}
+
+void apps_airtime_print( uint32_t now_in_ms )
+{
+    for( uint8_t band = 0; band < APPS_AIRTIME_N_SUB_BANDS; band++ )
+    {
+        const apps_airtime_stats_t* stats = &airtime_stats[band];
+
+        if( ( stats->tx_count == 0 ) && ( stats->delayed == 0 ) && ( stats->rejected == 0 ) )
+        {
+            continue;
+        }
+        apps_airtime_refill( band, now_in_ms );
+        HAL_DBG_TRACE_INFO( "Airtime %u-%u kHz (%u.%u %%): %u TX, %u ms on air, %d ms left, %u delayed, %u rejected\n",
+                            airtime_sub_bands[band].freq_min_in_hz / 1000,
+                            airtime_sub_bands[band].freq_max_in_hz / 1000,
+                            airtime_sub_bands[band].duty_cycle_permille / 10,
+                            airtime_sub_bands[band].duty_cycle_permille % 10, stats->tx_count,
+                            ( uint32_t ) stats->airtime_in_ms, airtime_buckets[band].credit_in_us / 1000,
+                            stats->delayed, stats->rejected );
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void apps_airtime_refill( uint8_t band, uint32_t now_in_ms )
+{
+    apps_airtime_bucket_t* bucket     = &airtime_buckets[band];
+    uint32_t               elapsed_ms = now_in_ms - bucket->update_in_ms;
+
+    // A time before the last refill brings nothing back
+    if( ( int32_t ) elapsed_ms <= 0 )
+    {
+        return;
+    }
+    // A whole window refills any bucket, this also keeps the product below from overflowing
+    if( elapsed_ms > APPS_AIRTIME_WINDOW_MS )
+    {
+        elapsed_ms = APPS_AIRTIME_WINDOW_MS;
+    }
+    bucket->update_in_ms = now_in_ms;
+
+    const int64_t credit =
+        ( int64_t ) bucket->credit_in_us + ( int64_t ) elapsed_ms * airtime_sub_bands[band].duty_cycle_permille;
+
+    bucket->credit_in_us = ( credit > bucket->capacity_in_us ) ? bucket->capacity_in_us : ( int32_t ) credit;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
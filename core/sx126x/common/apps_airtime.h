@@ -0,0 +1,215 @@
+/*!
+ * @file      apps_airtime.h
+ *
+ * @brief     Regulatory duty-cycle ledger, with one airtime token bucket per sub-band
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_AIRTIME_H
+#define APPS_AIRTIME_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Sub-bands with their duty cycle, as { lowest frequency in Hz, highest frequency in Hz, duty cycle in 0.1 % }
+ *
+ * The default is the EU868 split of ETSI EN 300 220 used by LoRaWAN: 0.1 % on 863-865 MHz and 868.7-869.2 MHz,
+ * 10 % on 869.4-869.65 MHz and 1 % elsewhere. Any frequency out of the list is never admitted.
+ */
+#ifndef APPS_AIRTIME_SUB_BANDS
+#define APPS_AIRTIME_SUB_BANDS         \
+    {                                  \
+        { 863000000, 865000000, 1 },   \
+        { 865000000, 868000000, 10 },  \
+        { 868000000, 868600000, 10 },  \
+        { 868700000, 869200000, 1 },   \
+        { 869400000, 869650000, 100 }, \
+        { 869700000, 870000000, 10 },  \
+    }
+#endif
+
+/*!
+ * @brief Highest number of sub-bands
+ */
+#ifndef APPS_AIRTIME_MAX_SUB_BANDS
+#define APPS_AIRTIME_MAX_SUB_BANDS 8
+#endif
+
+/*!
+ * @brief Observation window of the duty cycle - in milliseconds
+ *
+ * A sub-band may transmit its whole share of the window in a burst, 36 s for 1 % of an hour, then the credit comes
+ * back at the duty cycle rate. A shorter window spreads the transmissions more evenly.
+ */
+#ifndef APPS_AIRTIME_WINDOW_MS
+#define APPS_AIRTIME_WINDOW_MS 3600000
+#endif
+
+/*!
+ * @brief Value returned when a frequency is in no sub-band
+ */
+#define APPS_AIRTIME_NO_BAND 0xFF
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Sub-band and its duty cycle
+ */
+typedef struct apps_airtime_sub_band_s
+{
+    uint32_t freq_min_in_hz;
+    uint32_t freq_max_in_hz;
+    uint16_t duty_cycle_permille;  //!< Share of the time the sub-band may be transmitted on - in 0.1 %
+} apps_airtime_sub_band_t;
+
+/*!
+ * @brief Admission of a transmission
+ */
+typedef enum apps_airtime_verdict_e
+{
+    APPS_AIRTIME_ADMIT,   //!< Enough credit, transmit now
+    APPS_AIRTIME_DELAY,   //!< Not enough credit yet, see apps_airtime_get_next_tx_in_ms
+    APPS_AIRTIME_REJECT,  //!< Never possible: no sub-band, or longer than the share of a whole window
+} apps_airtime_verdict_t;
+
+/*!
+ * @brief Counters of a sub-band
+ */
+typedef struct apps_airtime_stats_s
+{
+    uint32_t tx_count;       //!< Transmissions charged
+    uint64_t airtime_in_ms;  //!< Time on air charged
+    uint32_t delayed;        //!< Checks answered APPS_AIRTIME_DELAY
+    uint32_t rejected;       //!< Checks answered APPS_AIRTIME_REJECT
+} apps_airtime_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Load the sub-bands of APPS_AIRTIME_SUB_BANDS, each one with a full window of credit, and reset the counters
+ *
+ * @param [in] now_in_ms Current time
+ *
+ * @returns false if there are more than APPS_AIRTIME_MAX_SUB_BANDS sub-bands
+ */
+bool apps_airtime_init( uint32_t now_in_ms );
+
+/*!
+ * @brief Find the sub-band of a frequency, meant to be done once per channel
+ *
+ * @param [in] freq_in_hz RF frequency
+ *
+ * @returns Index of the sub-band, APPS_AIRTIME_NO_BAND if the frequency is in none
+ */
+uint8_t apps_airtime_find_band( uint32_t freq_in_hz );
+
+/*!
+ * @brief Check whether a transmission can start now on a sub-band, without charging it
+ *
+ * @param [in] band Index of the sub-band
+ * @param [in] time_on_air_in_ms Time on air of the transmission, see sx126x_get_lora_time_on_air_in_ms
+ * @param [in] now_in_ms Current time
+ *
+ * @returns The admission of the transmission
+ */
+apps_airtime_verdict_t apps_airtime_check( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms );
+
+/*!
+ * @brief Get the earliest time a transmission can start on a sub-band, so that the caller sleeps until then
+ *
+ * @param [in] band Index of the sub-band
+ * @param [in] time_on_air_in_ms Time on air of the transmission
+ * @param [in] now_in_ms Current time
+ *
+ * @returns The time the credit is enough, now_in_ms if it already is. A rejected transmission never is, and gets
+ * now_in_ms + APPS_AIRTIME_WINDOW_MS
+ */
+uint32_t apps_airtime_get_next_tx_in_ms( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms );
+
+/*!
+ * @brief Charge a transmission to a sub-band
+ *
+ * The credit may go below zero if the transmission was not admitted, the next ones wait for the debt to be paid back.
+ *
+ * @param [in] band Index of the sub-band
+ * @param [in] time_on_air_in_ms Time on air of the transmission
+ * @param [in] now_in_ms Current time
+ */
+void apps_airtime_charge( uint8_t band, uint32_t time_on_air_in_ms, uint32_t now_in_ms );
+
+/*!
+ * @brief Get the counters of a sub-band
+ *
+ * @param [in] band Index of the sub-band
+ * @param [out] stats Counters
+ */
+void apps_airtime_get_stats( uint8_t band, apps_airtime_stats_t* stats );
+
+/*!
+ * @brief Print the credit and counters of every sub-band used
+ *
+ * @param [in] now_in_ms Current time
+ */
+void apps_airtime_print( uint32_t now_in_ms );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_AIRTIME_H
+
+/* --- EOF ------------------------------------------------------------------ */
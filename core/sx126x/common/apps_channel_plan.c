@@ -0,0 +1,259 @@
+/*!
+ * @file      apps_channel_plan.c
+ *
+ * @brief     Channel plan: precomputed PLL steps and image calibration bands
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_channel_plan.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+#include "sx126x.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( APPS_CHANNEL_PLAN_MAX_CHANNELS >= APPS_CHANNEL_PLAN_NONE ) || \
+    ( APPS_CHANNEL_PLAN_MAX_BANDS >= APPS_CHANNEL_PLAN_NONE )
+#error "APPS_CHANNEL_PLAN_MAX_CHANNELS and APPS_CHANNEL_PLAN_MAX_BANDS must be lower than 255"
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+#define APPS_CHANNEL_PLAN_HZ_PER_MHZ 1000000
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static apps_channel_t      plan_channels[APPS_CHANNEL_PLAN_MAX_CHANNELS];
+static uint8_t             plan_n_channels = 0;
+static apps_channel_band_t plan_bands[APPS_CHANNEL_PLAN_MAX_BANDS];
+static uint8_t             plan_n_bands = 0;
+
+/*!
+ * @brief Band each radio was last image-calibrated for, and channel it is tuned on
+ */
+static uint8_t calibrated_bands[APPS_COMMON_N_RADIOS];
+static uint8_t current_channels[APPS_COMMON_N_RADIOS];
+
+static apps_channel_plan_stats_t channel_plan_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Group the channels into image calibration bands
+ *
+ * @returns false if more than @ref APPS_CHANNEL_PLAN_MAX_BANDS bands are needed
+ */
+static bool apps_channel_plan_build_bands( void );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+bool apps_channel_plan_init( const uint32_t* freqs_in_hz, uint8_t n_channels )
+{
+    plan_n_channels = 0;
+    plan_n_bands    = 0;
+
+    for( uint8_t i = 0; i < APPS_COMMON_N_RADIOS; i++ )
+    {
+        calibrated_bands[i] = APPS_CHANNEL_PLAN_NONE;
+        current_channels[i] = APPS_CHANNEL_PLAN_NONE;
+    }
+
+    channel_plan_stats.hop_count     = 0;
+    channel_plan_stats.cal_img_count = 0;
+
+    if( ( freqs_in_hz == NULL ) || ( n_channels == 0 ) || ( n_channels > APPS_CHANNEL_PLAN_MAX_CHANNELS ) )
+    {
+        return false;
+    }
+
+    for( uint8_t i = 0; i < n_channels; i++ )
+    {
+        plan_channels[i].freq_in_hz        = freqs_in_hz[i];
+        plan_channels[i].freq_in_pll_steps = sx126x_convert_freq_in_hz_to_pll_step( freqs_in_hz[i] );
+        plan_channels[i].band              = APPS_CHANNEL_PLAN_NONE;
+    }
+    plan_n_channels = n_channels;
+
+    if( apps_channel_plan_build_bands( ) == false )
+    {
+        plan_n_channels = 0;
+        plan_n_bands    = 0;
+        return false;
+    }
+
+    return true;
+}
+
+uint8_t apps_channel_plan_get_n_channels( void )
+{
+    return plan_n_channels;
+}
+
+uint8_t apps_channel_plan_get_n_bands( void )
+{
+    return plan_n_bands;
+}
+
+const apps_channel_t* apps_channel_plan_get_channel( uint8_t index )
+{
+    return ( index < plan_n_channels ) ? &plan_channels[index] : NULL;
+}
+
+const apps_channel_band_t* apps_channel_plan_get_band( uint8_t index )
+{
+    return ( index < plan_n_bands ) ? &plan_bands[index] : NULL;
+}
+
+void apps_channel_plan_set_channel( const void* context, uint8_t index )
+{
+    if( index >= plan_n_channels )
+    {
+        return;
+    }
+
+    const uint8_t         id      = apps_common_sx126x_get_radio_id( context );
+    const apps_channel_t* channel = &plan_channels[index];
+
+    if( calibrated_bands[id] != channel->band )
+    {
+        const apps_channel_band_t* band = &plan_bands[channel->band];
+
+        ASSERT_SX126X_RC( sx126x_cal_img_in_mhz( context, band->freq1_in_mhz, band->freq2_in_mhz ) );
+        calibrated_bands[id] = channel->band;
+        channel_plan_stats.cal_img_count++;
+    }
+
+    ASSERT_SX126X_RC( sx126x_set_rf_freq_in_pll_steps( context, channel->freq_in_pll_steps ) );
+    current_channels[id] = index;
+    channel_plan_stats.hop_count++;
+}
+
+void apps_channel_plan_invalidate( const void* context )
+{
+    const uint8_t id = apps_common_sx126x_get_radio_id( context );
+
+    calibrated_bands[id] = APPS_CHANNEL_PLAN_NONE;
+    current_channels[id] = APPS_CHANNEL_PLAN_NONE;
+}
+
+uint8_t apps_channel_plan_get_current_channel( const void* context )
+{
+    return current_channels[apps_common_sx126x_get_radio_id( context )];
+}
+
+void apps_channel_plan_get_stats( apps_channel_plan_stats_t* stats )
+{
+    *stats = channel_plan_stats;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static bool apps_channel_plan_build_bands( void )
+{
+    uint8_t sorted[APPS_CHANNEL_PLAN_MAX_CHANNELS];
+
+    // Insertion sort of the channel indexes by frequency, the plan is short and built once
+    for( uint8_t i = 0; i < plan_n_channels; i++ )
+    {
+        uint8_t j = i;
+        while( ( j > 0 ) && ( plan_channels[sorted[j - 1]].freq_in_hz > plan_channels[i].freq_in_hz ) )
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = i;
+    }
+
+    for( uint8_t i = 0; i < plan_n_channels; i++ )
+    {
+        apps_channel_t* channel = &plan_channels[sorted[i]];
+        const uint16_t  f_low   = ( uint16_t )( channel->freq_in_hz / APPS_CHANNEL_PLAN_HZ_PER_MHZ );
+        const uint16_t  f_high =
+            ( uint16_t )( ( channel->freq_in_hz + APPS_CHANNEL_PLAN_HZ_PER_MHZ - 1 ) / APPS_CHANNEL_PLAN_HZ_PER_MHZ );
+
+        if( ( plan_n_bands == 0 ) ||
+            ( ( f_high - plan_bands[plan_n_bands - 1].freq1_in_mhz ) > APPS_CHANNEL_PLAN_BAND_SPAN_IN_MHZ ) )
+        {
+            if( plan_n_bands >= APPS_CHANNEL_PLAN_MAX_BANDS )
+            {
+                return false;
+            }
+            plan_bands[plan_n_bands].freq1_in_mhz = f_low;
+            plan_n_bands++;
+        }
+
+        plan_bands[plan_n_bands - 1].freq2_in_mhz = f_high;
+        channel->band                             = plan_n_bands - 1;
+    }
+
+    // A lone channel gives an empty range, widen it to at least one calibration step
+    for( uint8_t i = 0; i < plan_n_bands; i++ )
+    {
+        if( ( plan_bands[i].freq2_in_mhz - plan_bands[i].freq1_in_mhz ) < SX126X_IMAGE_CALIBRATION_STEP_IN_MHZ )
+        {
+            plan_bands[i].freq2_in_mhz = plan_bands[i].freq1_in_mhz + SX126X_IMAGE_CALIBRATION_STEP_IN_MHZ;
+        }
+    }
+
+    return true;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,214 @@
+/*!
+ * @file      apps_channel_plan.h
+ *
+ * @brief     Channel plan: precomputed PLL steps and image calibration bands
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_CHANNEL_PLAN_H
+#define APPS_CHANNEL_PLAN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "apps_configuration.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Highest number of channels in a plan
+ */
+#ifndef APPS_CHANNEL_PLAN_MAX_CHANNELS
+#define APPS_CHANNEL_PLAN_MAX_CHANNELS 16
+#endif
+
+/*!
+ * @brief Highest number of image calibration bands in a plan
+ */
+#ifndef APPS_CHANNEL_PLAN_MAX_BANDS
+#define APPS_CHANNEL_PLAN_MAX_BANDS 4
+#endif
+
+/*!
+ * @brief Widest frequency range covered by one image calibration - in MHz
+ *
+ * The default is the 902-928 MHz range calibrated by the radio at power-on, which is the widest range
+ * given by Semtech for a single image calibration.
+ */
+#ifndef APPS_CHANNEL_PLAN_BAND_SPAN_IN_MHZ
+#define APPS_CHANNEL_PLAN_BAND_SPAN_IN_MHZ 26
+#endif
+
+/*!
+ * @brief Value returned when no channel or band applies
+ */
+#define APPS_CHANNEL_PLAN_NONE 0xFF
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Channel of the plan, ready to be sent to the radio
+ */
+typedef struct apps_channel_s
+{
+    uint32_t freq_in_hz;         //!< RF frequency
+    uint32_t freq_in_pll_steps;  //!< RF frequency converted once for SetRfFrequency
+    uint8_t  band;               //!< Index of the image calibration band holding the channel
+} apps_channel_t;
+
+/*!
+ * @brief Frequency range sharing one image calibration
+ */
+typedef struct apps_channel_band_s
+{
+    uint16_t freq1_in_mhz;  //!< Lower bound, rounded down
+    uint16_t freq2_in_mhz;  //!< Upper bound, rounded up
+} apps_channel_band_t;
+
+/*!
+ * @brief Channel plan counters
+ */
+typedef struct apps_channel_plan_stats_s
+{
+    uint32_t hop_count;      //!< Number of channel changes sent to the radios
+    uint32_t cal_img_count;  //!< Number of image calibrations triggered by a change of band
+} apps_channel_plan_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Build the channel plan: convert each frequency to PLL steps and group them into image calibration bands
+ *
+ * The channels keep the order of the given list. Bands are built over the sorted frequencies, each one
+ * spanning at most @ref APPS_CHANNEL_PLAN_BAND_SPAN_IN_MHZ. The image calibration state of every radio is reset.
+ *
+ * @param [in] freqs_in_hz List of RF frequencies
+ * @param [in] n_channels Number of frequencies in the list
+ *
+ * @returns true if the plan was built, false if the list is empty or exceeds the plan capacity
+ */
+bool apps_channel_plan_init( const uint32_t* freqs_in_hz, uint8_t n_channels );
+
+/*!
+ * @brief Get the number of channels in the plan
+ */
+uint8_t apps_channel_plan_get_n_channels( void );
+
+/*!
+ * @brief Get the number of image calibration bands in the plan
+ */
+uint8_t apps_channel_plan_get_n_bands( void );
+
+/*!
+ * @brief Get a channel of the plan
+ *
+ * @param [in] index Index of the channel in the list given to @ref apps_channel_plan_init
+ *
+ * @returns Pointer to the channel, NULL if the index is out of the plan
+ */
+const apps_channel_t* apps_channel_plan_get_channel( uint8_t index );
+
+/*!
+ * @brief Get an image calibration band of the plan
+ *
+ * @param [in] index Index of the band
+ *
+ * @returns Pointer to the band, NULL if the index is out of the plan
+ */
+const apps_channel_band_t* apps_channel_plan_get_band( uint8_t index );
+
+/*!
+ * @brief Tune a radio on a channel of the plan
+ *
+ * The image calibration is only run when the channel is in another band than the one the radio was last
+ * calibrated for. Otherwise this is a single SetRfFrequency with the precomputed PLL steps.
+ *
+ * @param [in] context Radio context
+ * @param [in] index Index of the channel
+ *
+ * @warning The radio must be in STDBY_RC, as required by the image calibration
+ */
+void apps_channel_plan_set_channel( const void* context, uint8_t index );
+
+/*!
+ * @brief Forget the image calibration of a radio, the next channel change calibrates again
+ *
+ * @remark To be called after a reset or a cold-start sleep of the radio
+ *
+ * @param [in] context Radio context
+ */
+void apps_channel_plan_invalidate( const void* context );
+
+/*!
+ * @brief Get the channel a radio is tuned on
+ *
+ * @param [in] context Radio context
+ *
+ * @returns Index of the channel, @ref APPS_CHANNEL_PLAN_NONE if the radio was not tuned through the plan
+ */
+uint8_t apps_channel_plan_get_current_channel( const void* context );
+
+/*!
+ * @brief Get a copy of the channel plan counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_channel_plan_get_stats( apps_channel_plan_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_CHANNEL_PLAN_H
+
+/* --- EOF ------------------------------------------------------------------ */
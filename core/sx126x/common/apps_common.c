@@ -44,6 +44,9 @@
 #include "apps_common.h"
 #include "common_version.h"
 #include "apps_utilities.h"
+#include "apps_timer.h"
+#include "apps_energy.h"
+#include "apps_channel_plan.h"
 #include "sx126x_str.h"
 #include "smtc_hal_dbg_trace.h"
 #include "smtc_shield_pinout_mapping.h"
@@ -66,6 +69,27 @@
  * --- PRIVATE MACROS-----------------------------------------------------------
  */
 
+/*!
+ * @brief Arduino pins of the second radio, the first one keeps the shield pinout (D3/D5/D7/A0)
+ *
+ * Both radios share SPI1, the second shield has to be rewired to these pins
+ */
+#ifndef APPS_COMMON_RADIO_1_BUSY
+#define APPS_COMMON_RADIO_1_BUSY SMTC_SHIELD_PINOUT_D4
+#endif
+
+#ifndef APPS_COMMON_RADIO_1_IRQ
+#define APPS_COMMON_RADIO_1_IRQ SMTC_SHIELD_PINOUT_D6
+#endif
+
+#ifndef APPS_COMMON_RADIO_1_NSS
+#define APPS_COMMON_RADIO_1_NSS SMTC_SHIELD_PINOUT_D9
+#endif
+
+#ifndef APPS_COMMON_RADIO_1_RESET
+#define APPS_COMMON_RADIO_1_RESET SMTC_SHIELD_PINOUT_A1
+#endif
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE CONSTANTS -------------------------------------------------------
@@ -143,14 +167,63 @@ static sx126x_pkt_params_bpsk_t bpsk_pkt_params = {
  * --- PRIVATE TYPES -----------------------------------------------------------
  */
 
+/*!
+ * @brief Per-radio state, the HAL context must stay the first field
+ */
+typedef struct apps_common_radio_s
+{
+    sx126x_hal_context_t context;
+    volatile bool        irq_fired;
+    volatile uint32_t    irq_timestamp_in_ms;  //!< Time at which the IRQ line rose, in milliseconds
+    volatile uint64_t    irq_timestamp_in_us;  //!< Time at which the IRQ line rose, for apps_energy_on_irq
+    sx126x_lora_sf_t     sf;                   //!< Spreading factor last programmed in the radio
+    sx126x_lora_bw_t     bw;                   //!< Bandwidth last programmed in the radio
+} apps_common_radio_t;
+
+/*!
+ * @brief Arduino pins wired to a radio
+ */
+typedef struct apps_common_radio_pinout_s
+{
+    smtc_shield_pinout_t busy;
+    smtc_shield_pinout_t irq;
+    smtc_shield_pinout_t nss;
+    smtc_shield_pinout_t reset;
+} apps_common_radio_pinout_t;
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE VARIABLES -------------------------------------------------------
  */
 
-static sx126x_hal_context_t context;
+static apps_common_radio_t radios[APPS_COMMON_N_RADIOS];
+
+static const apps_common_radio_pinout_t radio_pinouts[] = {
+    {
+        .busy  = SMTC_SHIELD_PINOUT_D3,
+        .irq   = SMTC_SHIELD_PINOUT_D5,
+        .nss   = SMTC_SHIELD_PINOUT_D7,
+        .reset = SMTC_SHIELD_PINOUT_A0,
+    },
+    {
+        .busy  = APPS_COMMON_RADIO_1_BUSY,
+        .irq   = APPS_COMMON_RADIO_1_IRQ,
+        .nss   = APPS_COMMON_RADIO_1_NSS,
+        .reset = APPS_COMMON_RADIO_1_RESET,
+    },
+};
+
+/*!
+ * @brief Radio whose interrupts are being dispatched by apps_common_sx126x_irq_process
+ */
+static const void* irq_context = NULL;
+
+/*!
+ * @brief Handler bound to each bit of the IRQ register, NULL when the bit is not dispatched
+ */
+static apps_common_irq_handler_t irq_handlers[APPS_COMMON_IRQ_N_BITS];
 
-static volatile bool irq_fired = false;
+static apps_common_irq_stats_t irq_stats;
 
 static const smtc_shield_sx126x_pinout_t* shield_pinout = 0;
 
@@ -180,10 +253,10 @@ struct
  * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
  */
 void radio_on_dio_irq( void* context );
+static apps_common_radio_t* apps_common_get_radio( const void* context );
 void on_tx_done( void ) __attribute__( ( weak ) );
 void on_rx_done( void ) __attribute__( ( weak ) );
 void on_preamble_detected( void ) __attribute__( ( weak ) );
-void on_preamble_undetected( void ) __attribute__( ( weak ) );
 void on_syncword_valid( void ) __attribute__( ( weak ) );
 void on_header_valid( ) __attribute__( ( weak ) );
 void on_header_error( void ) __attribute__( ( weak ) );
@@ -194,6 +267,17 @@ void on_cad_done_undetected( void ) __attribute__( ( weak ) );
 void on_cad_done_detected( void ) __attribute__( ( weak ) );
 void on_fhss_hop_done( void ) __attribute__( ( weak ) );
 
+static void apps_common_irq_on_tx_done( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_rx_done( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_preamble_detected( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_syncword_valid( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_header_valid( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_header_error( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_crc_error( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_cad_done( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_timeout( const void* context, sx126x_irq_mask_t irq_regs );
+static void apps_common_irq_on_fhss_hop( const void* context, sx126x_irq_mask_t irq_regs );
+
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC VARIABLES --------------------------------------------------------
@@ -206,42 +290,76 @@ void on_fhss_hop_done( void ) __attribute__( ( weak ) );
 
 sx126x_hal_context_t* apps_common_sx126x_get_context( )
 {
-    context.busy.cfg                 = smtc_shield_pinout_mapping_get_gpio_cfg( SMTC_SHIELD_PINOUT_D3 );
-    context.busy.cfg_input.pull_mode = SMTC_HAL_MCU_GPIO_PULL_MODE_NONE;
-    context.busy.cfg_input.irq_mode  = SMTC_HAL_MCU_GPIO_IRQ_MODE_OFF;
-    context.busy.cfg_input.callback  = NULL;
+    return apps_common_sx126x_get_radio_context( 0 );
+}
 
-    context.irq.cfg                 = smtc_shield_pinout_mapping_get_gpio_cfg( SMTC_SHIELD_PINOUT_D5 );
-    context.irq.cfg_input.pull_mode = SMTC_HAL_MCU_GPIO_PULL_MODE_NONE;
-    context.irq.cfg_input.irq_mode  = SMTC_HAL_MCU_GPIO_IRQ_MODE_RISING;
-    context.irq.cfg_input.callback  = radio_on_dio_irq;
-    context.irq.cfg_input.context   = NULL;
+sx126x_hal_context_t* apps_common_sx126x_get_radio_context( uint8_t radio_id )
+{
+    if( radio_id >= APPS_COMMON_N_RADIOS )
+    {
+        return NULL;
+    }
+
+    apps_common_radio_t*              radio   = &radios[radio_id];
+    sx126x_hal_context_t*             context = &( radio->context );
+    const apps_common_radio_pinout_t* pinout  = &radio_pinouts[radio_id];
+
+    radio->irq_fired           = false;
+    radio->irq_timestamp_in_ms = 0;
+    radio->sf                  = LORA_SPREADING_FACTOR_t;
+    radio->bw                  = LORA_BANDWIDTH;
+
+    context->busy.cfg                 = smtc_shield_pinout_mapping_get_gpio_cfg( pinout->busy );
+    context->busy.cfg_input.pull_mode = SMTC_HAL_MCU_GPIO_PULL_MODE_NONE;
+    context->busy.cfg_input.irq_mode  = SMTC_HAL_MCU_GPIO_IRQ_MODE_OFF;
+    context->busy.cfg_input.callback  = NULL;
 
-    context.nss.cfg                      = smtc_shield_pinout_mapping_get_gpio_cfg( SMTC_SHIELD_PINOUT_D7 );
-    context.nss.cfg_output.initial_state = SMTC_HAL_MCU_GPIO_STATE_HIGH;
-    context.nss.cfg_output.mode          = SMTC_HAL_MCU_GPIO_OUTPUT_MODE_PUSH_PULL;
+    context->irq.cfg                 = smtc_shield_pinout_mapping_get_gpio_cfg( pinout->irq );
+    context->irq.cfg_input.pull_mode = SMTC_HAL_MCU_GPIO_PULL_MODE_NONE;
+    context->irq.cfg_input.irq_mode  = SMTC_HAL_MCU_GPIO_IRQ_MODE_RISING;
+    context->irq.cfg_input.callback  = radio_on_dio_irq;
+    context->irq.cfg_input.context   = radio;
 
-    context.reset.cfg                      = smtc_shield_pinout_mapping_get_gpio_cfg( SMTC_SHIELD_PINOUT_A0 );
-    context.reset.cfg_output.initial_state = SMTC_HAL_MCU_GPIO_STATE_HIGH;
-    context.reset.cfg_output.mode          = SMTC_HAL_MCU_GPIO_OUTPUT_MODE_PUSH_PULL;
+    context->nss.cfg                      = smtc_shield_pinout_mapping_get_gpio_cfg( pinout->nss );
+    context->nss.cfg_output.initial_state = SMTC_HAL_MCU_GPIO_STATE_HIGH;
+    context->nss.cfg_output.mode          = SMTC_HAL_MCU_GPIO_OUTPUT_MODE_PUSH_PULL;
 
-    context.spi.cfg.spi = SPI1;
+    context->reset.cfg                      = smtc_shield_pinout_mapping_get_gpio_cfg( pinout->reset );
+    context->reset.cfg_output.initial_state = SMTC_HAL_MCU_GPIO_STATE_HIGH;
+    context->reset.cfg_output.mode          = SMTC_HAL_MCU_GPIO_OUTPUT_MODE_PUSH_PULL;
 
-    smtc_hal_mcu_gpio_init_input( context.busy.cfg, &( context.busy.cfg_input ), &( context.busy.inst ) );
-    smtc_hal_mcu_gpio_init_input( context.irq.cfg, &( context.irq.cfg_input ), &( context.irq.inst ) );
-    smtc_hal_mcu_gpio_init_output( context.nss.cfg, &( context.nss.cfg_output ), &( context.nss.inst ) );
-    smtc_hal_mcu_gpio_init_output( context.reset.cfg, &( context.reset.cfg_output ), &( context.reset.inst ) );
+    context->spi.cfg.spi = SPI1;
 
-    smtc_hal_mcu_gpio_enable_irq( context.irq.inst );
+    smtc_hal_mcu_gpio_init_input( context->busy.cfg, &( context->busy.cfg_input ), &( context->busy.inst ) );
+    smtc_hal_mcu_gpio_init_input( context->irq.cfg, &( context->irq.cfg_input ), &( context->irq.inst ) );
+    smtc_hal_mcu_gpio_init_output( context->nss.cfg, &( context->nss.cfg_output ), &( context->nss.inst ) );
+    smtc_hal_mcu_gpio_init_output( context->reset.cfg, &( context->reset.cfg_output ), &( context->reset.inst ) );
 
-    smtc_hal_mcu_spi_init( &( context.spi.cfg ), &( context.spi.inst ) );
+    smtc_hal_mcu_gpio_enable_irq( context->irq.inst );
+
+    smtc_hal_mcu_spi_init( &( context->spi.cfg ), &( context->spi.inst ) );
+
+    return context;
+}
+
+uint8_t apps_common_sx126x_get_radio_id( const void* context )
+{
+    return ( uint8_t ) ( apps_common_get_radio( context ) - radios );
+}
 
-    return &context;
+const void* apps_common_sx126x_get_irq_context( void )
+{
+    return irq_context;
 }
 
 void apps_common_shield_init( void )
 {
     shield_pinout = smtc_shield_sx126x_get_pinout( &shield );
+#if( APPS_ENERGY == true )
+    apps_energy_set_currents( smtc_shield_sx126x_get_current_cfg( &shield ),
+                              smtc_shield_sx126x_get_tx_current_in_ua( &shield, TX_OUTPUT_POWER_DBM ),
+                              ENABLE_RX_BOOST_MODE );
+#endif
 
     if( shield_pinout->led_tx != SMTC_SHIELD_PINOUT_NONE )
     {
@@ -324,6 +442,7 @@ void apps_common_sx126x_print_version_info( void )
 void apps_common_sx126x_init( const sx126x_hal_context_t* context )
 {
     ASSERT_SX126X_RC( sx126x_reset( ( void* ) context ) );
+    apps_channel_plan_invalidate( context );
 
     ASSERT_SX126X_RC( sx126x_init_retention_list( ( void* ) context ) );
 
@@ -343,6 +462,11 @@ void apps_common_sx126x_init( const sx126x_hal_context_t* context )
 }
 
 void apps_common_sx126x_radio_init( const void* context )
+{
+    apps_common_sx126x_radio_init_with_lora_mod_params( context, &lora_mod_params );
+}
+
+void apps_common_sx126x_radio_init_with_lora_mod_params( const void* context, sx126x_mod_params_lora_t* params )
 {
     const smtc_shield_sx126x_pa_pwr_cfg_t* pa_pwr_cfg =
         smtc_shield_sx126x_get_pa_pwr_cfg( &shield, RF_FREQ_IN_HZ, TX_OUTPUT_POWER_DBM );
@@ -356,7 +480,11 @@ void apps_common_sx126x_radio_init( const void* context )
     }
     ASSERT_SX126X_RC( sx126x_set_standby( context, SX126X_STANDBY_CFG_RC ) );
     ASSERT_SX126X_RC( sx126x_set_pkt_type( context, PACKET_TYPE ) );
-    ASSERT_SX126X_RC( sx126x_set_rf_freq( context, RF_FREQ_IN_HZ ) );
+    // Once the channel plan is built, the caller tunes the radio with the precomputed PLL steps of its channel
+    if( apps_channel_plan_get_n_channels( ) == 0 )
+    {
+        ASSERT_SX126X_RC( sx126x_set_rf_freq( context, RF_FREQ_IN_HZ ) );
+    }
 
     ASSERT_SX126X_RC( sx126x_set_pa_cfg( context, &( pa_pwr_cfg->pa_config ) ) );
     ASSERT_SX126X_RC( sx126x_set_tx_params( context, pa_pwr_cfg->power, PA_RAMP_TIME ) );
@@ -366,8 +494,8 @@ void apps_common_sx126x_radio_init( const void* context )
 
     if( PACKET_TYPE == SX126X_PKT_TYPE_LORA )
     {
-        lora_mod_params.ldro = apps_common_compute_lora_ldro( LORA_SPREADING_FACTOR_t, LORA_BANDWIDTH );
-        ASSERT_SX126X_RC( sx126x_set_lora_mod_params( context, &lora_mod_params ) );
+        params->ldro = apps_common_compute_lora_ldro( params->sf, params->bw );
+        apps_common_sx126x_set_lora_mod_params( context, params );
         ASSERT_SX126X_RC( sx126x_set_lora_pkt_params( context, &lora_pkt_params ) );
         ASSERT_SX126X_RC( sx126x_set_lora_sync_word( context, LORA_SYNCWORD ) );
     }
@@ -471,8 +599,6 @@ void apps_common_sx126x_radio_dbpsk_init( const void* context, const uint8_t pay
 void apps_common_sx126x_receive( const void* context, uint8_t* buffer, uint8_t* size, uint8_t max_size )
 {
     sx126x_rx_buffer_status_t rx_buffer_status;
-    sx126x_pkt_status_lora_t  pkt_status_lora;
-    sx126x_pkt_status_gfsk_t  pkt_status_gfsk;
 		received_packet_counter++;
 
     sx126x_get_rx_buffer_status( context, &rx_buffer_status );
@@ -485,57 +611,127 @@ void apps_common_sx126x_receive( const void* context, uint8_t* buffer, uint8_t*
     }
     else
     {
-        sx126x_read_buffer( context, 0, buffer, rx_buffer_status.pld_len_in_bytes );
+        sx126x_read_buffer( context, rx_buffer_status.buffer_start_pointer, buffer,
+                            rx_buffer_status.pld_len_in_bytes );
         *size = rx_buffer_status.pld_len_in_bytes;
     }
 		HAL_DBG_TRACE_INFO("Received  packet number : %d \n\r" ,received_packet_counter);
 }
 
+bool apps_common_sx126x_get_rx_pkt_info( const void* context, apps_rx_pkt_desc_t* desc, uint8_t max_size )
+{
+    sx126x_rx_buffer_status_t rx_buffer_status;
+    sx126x_pkt_status_lora_t  pkt_status_lora;
+
+    received_packet_counter++;
+
+    ASSERT_SX126X_RC( sx126x_get_rx_buffer_status( context, &rx_buffer_status ) );
+    ASSERT_SX126X_RC( sx126x_get_lora_pkt_status( context, &pkt_status_lora ) );
+
+    desc->buffer_offset          = rx_buffer_status.buffer_start_pointer;
+    desc->rssi_pkt_in_dbm        = pkt_status_lora.rssi_pkt_in_dbm;
+    desc->snr_pkt_in_db          = pkt_status_lora.snr_pkt_in_db;
+    desc->signal_rssi_pkt_in_dbm = pkt_status_lora.signal_rssi_pkt_in_dbm;
+    desc->sf                     = apps_common_get_radio( context )->sf;
+    desc->bw                     = apps_common_get_radio( context )->bw;
+    desc->timestamp_in_ms        = apps_common_get_radio( context )->irq_timestamp_in_ms;
+
+    if( max_size < rx_buffer_status.pld_len_in_bytes )
+    {
+        HAL_DBG_TRACE_ERROR( "Received more bytes than expected (%d vs %d), reception in buffer cancelled.\n",
+                             rx_buffer_status.pld_len_in_bytes, max_size );
+        desc->size = 0;
+        return false;
+    }
+
+    desc->size = rx_buffer_status.pld_len_in_bytes;
+    return true;
+}
+
+void apps_common_sx126x_read_rx_payload( const void* context, apps_rx_pkt_desc_t* desc )
+{
+    if( desc->size != 0 )
+    {
+        ASSERT_SX126X_RC( sx126x_read_buffer( context, desc->buffer_offset, desc->payload, desc->size ) );
+    }
+}
+
+void apps_common_sx126x_set_lora_mod_params( const void* context, const sx126x_mod_params_lora_t* params )
+{
+    ASSERT_SX126X_RC( sx126x_set_lora_mod_params( context, params ) );
+    apps_common_get_radio( context )->sf = params->sf;
+    apps_common_get_radio( context )->bw = params->bw;
+}
+
+void apps_common_sx126x_irq_init( void )
+{
+    memset( irq_handlers, 0, sizeof( irq_handlers ) );
+    memset( &irq_stats, 0, sizeof( irq_stats ) );
+
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_TX_DONE, apps_common_irq_on_tx_done );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_RX_DONE, apps_common_irq_on_rx_done );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_PREAMBLE_DETECTED, apps_common_irq_on_preamble_detected );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_SYNC_WORD_VALID, apps_common_irq_on_syncword_valid );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_HEADER_VALID, apps_common_irq_on_header_valid );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_HEADER_ERROR, apps_common_irq_on_header_error );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_CRC_ERROR, apps_common_irq_on_crc_error );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_CAD_DONE, apps_common_irq_on_cad_done );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_TIMEOUT, apps_common_irq_on_timeout );
+    apps_common_sx126x_register_irq_handler( SX126X_IRQ_LR_FHSS_HOP, apps_common_irq_on_fhss_hop );
+}
+
+void apps_common_sx126x_register_irq_handler( sx126x_irq_mask_t irq, apps_common_irq_handler_t handler )
+{
+    while( irq != 0 )
+    {
+        irq_handlers[__builtin_ctz( irq )] = handler;
+        irq &= irq - 1;
+    }
+}
+
 void apps_common_sx126x_irq_process( const void* context )
 {
-    if( irq_fired == true )
+    apps_common_radio_t* radio = apps_common_get_radio( context );
+
+    if( radio->irq_fired == true )
     {
-        irq_fired = false;
+        radio->irq_fired = false;
+        irq_context      = context;
 
         sx126x_irq_mask_t irq_regs;
-        sx126x_get_and_clear_irq_status( context, &irq_regs );
-
-        if( ( irq_regs & SX126X_IRQ_TX_DONE ) == SX126X_IRQ_TX_DONE )
-        {
-            on_tx_done( );
-        }
+        ASSERT_SX126X_RC( sx126x_get_and_clear_irq_status( context, &irq_regs ) );
 
-        if( ( irq_regs & SX126X_IRQ_RX_DONE ) == SX126X_IRQ_RX_DONE )
-        {
-            ASSERT_SX126X_RC( sx126x_handle_rx_done( context ) );
-            on_rx_done( );
-        }
+        irq_stats.irq_count++;
+#if( APPS_ENERGY == true )
+        // The mode reached at the end of the operation, before the handlers start the next one
+        apps_energy_on_irq( context, irq_regs, radio->irq_timestamp_in_us );
+#endif
 
-        if( ( irq_regs & SX126X_IRQ_PREAMBLE_DETECTED ) == SX126X_IRQ_PREAMBLE_DETECTED )
+        // Only the bits set are visited, lowest first
+        uint32_t pending = irq_regs;
+        while( pending != 0 )
         {
-            on_preamble_detected( );
-        }
-				else
-				{
-						on_preamble_undetected( );
-				}
+            const uint8_t bit = __builtin_ctz( pending );
+            pending &= pending - 1;
 
-        if( ( irq_regs & SX126X_IRQ_CAD_DONE ) == SX126X_IRQ_CAD_DONE )
-        {
-            if( ( irq_regs & SX126X_IRQ_CAD_DETECTED ) == SX126X_IRQ_CAD_DETECTED )
+            if( irq_handlers[bit] != NULL )
             {
-								HAL_DBG_TRACE_INFO( "1 : %d \n\r" , LORA_SPREADING_FACTOR_t );
-                on_cad_done_detected( );
+                irq_stats.dispatch_count[bit]++;
+                irq_handlers[bit]( context, irq_regs );
             }
             else
             {
-								HAL_DBG_TRACE_ERROR( "0: %d \n\r", LORA_SPREADING_FACTOR_t );
-                on_cad_done_undetected( );
+                irq_stats.unhandled_count++;
             }
         }
     }
 }
 
+void apps_common_sx126x_get_irq_stats( apps_common_irq_stats_t* stats )
+{
+    *stats = irq_stats;
+}
+
 void apps_common_sx126x_handle_pre_tx( void )
 {
     if( shield_pinout->led_tx != SMTC_SHIELD_PINOUT_NONE )
@@ -568,13 +764,55 @@ void apps_common_sx126x_handle_post_rx( void )
     }
 }
 
+void apps_common_time_init( void )
+{
+    // The LPTIM keeps counting in STOP2, unlike SysTick which is left without interrupt for LL_mDelay
+    apps_timer_init( );
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t apps_common_get_time_in_ms( void )
+{
+    return ( uint32_t ) apps_timer_get_time_in_ms( );
+}
+
+uint32_t apps_common_get_cycle_count( void )
+{
+    return DWT->CYCCNT;
+}
+
+uint32_t apps_common_cycles_to_us( uint32_t cycles )
+{
+    return ( uint32_t )( ( ( uint64_t ) cycles * 1000000 ) / SystemCoreClock );
+}
+
+bool apps_common_sx126x_is_irq_pending( void )
+{
+    for( uint8_t id = 0; id < APPS_COMMON_N_RADIOS; id++ )
+    {
+        if( radios[id].irq_fired == true )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t apps_common_sx126x_get_irq_timestamp_in_ms( const void* context )
+{
+    return apps_common_get_radio( context )->irq_timestamp_in_ms;
+}
+
 uint32_t get_time_on_air_in_ms( void )
 {
     switch( PACKET_TYPE )
     {
     case SX126X_PKT_TYPE_LORA:
     {
-        return sx126x_get_lora_time_on_air_in_ms( &lora_pkt_params, &lora_mod_params );
+        return apps_common_get_lora_time_on_air_in_ms( &lora_mod_params );
     }
     case SX126X_PKT_TYPE_GFSK:
     {
@@ -588,6 +826,11 @@ uint32_t get_time_on_air_in_ms( void )
     }
 }
 
+uint32_t apps_common_get_lora_time_on_air_in_ms( const sx126x_mod_params_lora_t* params )
+{
+    return sx126x_get_lora_time_on_air_in_ms( &lora_pkt_params, params );
+}
+
 /*
  * -----------------------------------------------------------------------------
  * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
@@ -595,8 +838,23 @@ uint32_t get_time_on_air_in_ms( void )
 
 void radio_on_dio_irq( void* context )
 {
-    irq_fired = true;
+    apps_common_radio_t* radio = ( apps_common_radio_t* ) context;
+
+    radio->irq_timestamp_in_us = apps_timer_get_time_in_us( );
+    radio->irq_timestamp_in_ms = ( uint32_t )( radio->irq_timestamp_in_us / 1000 );
+    radio->irq_fired           = true;
+}
+
+/*!
+ * @brief Get the radio owning a HAL context
+ *
+ * @remark The context is the first field of the radio structure, so both share the same address
+ */
+static apps_common_radio_t* apps_common_get_radio( const void* context )
+{
+    return ( apps_common_radio_t* ) context;
 }
+
 void on_tx_done( void )
 {
     
@@ -608,10 +866,6 @@ void on_rx_done( void )
 void on_preamble_detected( void )
 {
     
-}
-void on_preamble_undetected( void )
-{
-    
 }
 void on_syncword_valid( void )
 {
@@ -650,4 +904,65 @@ void on_fhss_hop_done( void )
     
 }
 
+static void apps_common_irq_on_tx_done( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_tx_done( );
+}
+
+static void apps_common_irq_on_rx_done( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    ASSERT_SX126X_RC( sx126x_handle_rx_done( context ) );
+    on_rx_done( );
+}
+
+static void apps_common_irq_on_preamble_detected( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_preamble_detected( );
+}
+
+static void apps_common_irq_on_syncword_valid( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_syncword_valid( );
+}
+
+static void apps_common_irq_on_header_valid( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_header_valid( );
+}
+
+static void apps_common_irq_on_header_error( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_header_error( );
+}
+
+static void apps_common_irq_on_crc_error( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_crc_error( );
+}
+
+/*!
+ * @brief CAD_DETECTED is only meaningful along with CAD_DONE, so it has no handler of its own
+ */
+static void apps_common_irq_on_cad_done( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    if( ( irq_regs & SX126X_IRQ_CAD_DETECTED ) == SX126X_IRQ_CAD_DETECTED )
+    {
+        on_cad_done_detected( );
+    }
+    else
+    {
+        on_cad_done_undetected( );
+    }
+}
+
+static void apps_common_irq_on_timeout( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_rx_timeout( );
+}
+
+static void apps_common_irq_on_fhss_hop( const void* context, sx126x_irq_mask_t irq_regs )
+{
+    on_fhss_hop_done( );
+}
+
 /* --- EOF ------------------------------------------------------------------ */
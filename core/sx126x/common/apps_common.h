@@ -54,6 +54,7 @@ extern "C" {
 #include "apps_configuration.h"
 #include "sx126x_hal_context.h"
 #include "sx126x.h"
+#include "apps_rx_pool.h"
 
 /*
  * -----------------------------------------------------------------------------
@@ -61,6 +62,24 @@ extern "C" {
  */
 #define RX_CONTINUOUS 0xFFFFFF
 
+/*!
+ * @brief Number of SX126x radios sharing SPI1, each one with its own control pins and IRQ line
+ *
+ * @remark Up to 2 radios are supported, see apps_common.c for the pins of the second one
+ */
+#ifndef APPS_COMMON_N_RADIOS
+#define APPS_COMMON_N_RADIOS 1
+#endif
+
+#if( APPS_COMMON_N_RADIOS < 1 ) || ( APPS_COMMON_N_RADIOS > 2 )
+#error "APPS_COMMON_N_RADIOS must be 1 or 2"
+#endif
+
+/*!
+ * @brief Number of bits of the IRQ register
+ */
+#define APPS_COMMON_IRQ_N_BITS 16
+
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC CONSTANTS --------------------------------------------------------
@@ -71,6 +90,24 @@ extern "C" {
  * --- PUBLIC TYPES ------------------------------------------------------------
  */
 
+/*!
+ * @brief Handler of one IRQ bit
+ *
+ * @param [in] context Pointer to the context of the radio which raised the IRQ
+ * @param [in] irq_regs Whole IRQ register, for the bits which only make sense together
+ */
+typedef void ( *apps_common_irq_handler_t )( const void* context, sx126x_irq_mask_t irq_regs );
+
+/*!
+ * @brief IRQ dispatch counters
+ */
+typedef struct apps_common_irq_stats_s
+{
+    uint32_t irq_count;                               //!< Number of IRQ register reads
+    uint32_t dispatch_count[APPS_COMMON_IRQ_N_BITS];  //!< Number of handler calls per IRQ bit
+    uint32_t unhandled_count;                         //!< Number of bits set without any handler bound
+} apps_common_irq_stats_t;
+
 /*
  * -----------------------------------------------------------------------------
  * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
@@ -85,6 +122,29 @@ extern "C" {
  * @returns Pointer to the sx126x_hal_context_t object of the board
  */
 sx126x_hal_context_t* apps_common_sx126x_get_context( );
+
+/*!
+ * @brief Initialise and return the sx126x_hal_context_t object of one of the radios
+ *
+ * @param [in] radio_id  Index of the radio, lower than APPS_COMMON_N_RADIOS
+ *
+ * @returns Pointer to the sx126x_hal_context_t object of the radio, NULL if the index is out of range
+ */
+sx126x_hal_context_t* apps_common_sx126x_get_radio_context( uint8_t radio_id );
+
+/*!
+ * @brief Get the index of the radio driven through a context
+ *
+ * @param [in] context  Pointer to a radio context returned by @ref apps_common_sx126x_get_radio_context
+ */
+uint8_t apps_common_sx126x_get_radio_id( const void* context );
+
+/*!
+ * @brief Get the context of the radio whose interrupts are being dispatched
+ *
+ * @remark Meant to be called from the on_xxx callbacks, which do not take any parameter
+ */
+const void* apps_common_sx126x_get_irq_context( void );
 static uint32_t received_packet_counter = 0;
 
 /*!
@@ -106,6 +166,24 @@ void apps_common_sx126x_init( const sx126x_hal_context_t* context );
  */
 void apps_common_sx126x_radio_init( const void* context );
 
+/*!
+ * @brief Initialize the radio configuration of the transceiver with its own LoRa modulation parameters
+ *
+ * @remark The low data rate optimization field of the parameters is computed here
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [in,out] params LoRa modulation parameters of this radio
+ */
+void apps_common_sx126x_radio_init_with_lora_mod_params( const void* context, sx126x_mod_params_lora_t* params );
+
+/*!
+ * @brief Program new LoRa modulation parameters and remember the spreading factor and bandwidth of the radio
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [in] params LoRa modulation parameters
+ */
+void apps_common_sx126x_set_lora_mod_params( const void* context, const sx126x_mod_params_lora_t* params );
+
 /*!
  * @brief Initialize the radio configuration of the transceiver for dbpsk only
  *
@@ -125,15 +203,78 @@ void apps_common_sx126x_radio_dbpsk_init( const void* context, const uint8_t pay
  */
 void apps_common_sx126x_receive( const void* context, uint8_t* buffer, uint8_t* size, uint8_t max_size );
 
+/*!
+ * @brief Fill a reception descriptor with the status of the last LoRa packet, without reading its payload
+ *
+ * @remark The payload location in the radio data buffer is stored in the descriptor, so the radio can be set back
+ * to RX before @ref apps_common_sx126x_read_rx_payload drains it
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [out] desc Descriptor to be filled
+ * @param [in] max_size Size of the payload area pointed by the descriptor
+ *
+ * @returns true if the payload fits in the descriptor, false otherwise (size is then set to 0)
+ */
+bool apps_common_sx126x_get_rx_pkt_info( const void* context, apps_rx_pkt_desc_t* desc, uint8_t max_size );
+
+/*!
+ * @brief Read the payload described by a descriptor straight into its payload area
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [in,out] desc Descriptor previously filled by @ref apps_common_sx126x_get_rx_pkt_info
+ */
+void apps_common_sx126x_read_rx_payload( const void* context, apps_rx_pkt_desc_t* desc );
+
+/*!
+ * @brief Bind the on_xxx callbacks to their IRQ bit and reset the dispatch counters
+ *
+ * Each callback is only called when its own bit is set:
+ * - TX_DONE: on_tx_done
+ * - RX_DONE: on_rx_done, after the RX done workaround of the driver
+ * - PREAMBLE_DETECTED: on_preamble_detected
+ * - SYNC_WORD_VALID: on_syncword_valid
+ * - HEADER_VALID: on_header_valid
+ * - HEADER_ERROR: on_header_error
+ * - CRC_ERROR: on_crc_error, RX_DONE is set along with it
+ * - CAD_DONE: on_cad_done_detected or on_cad_done_undetected, depending on CAD_DETECTED
+ * - TIMEOUT: on_rx_timeout
+ * - LR_FHSS_HOP: on_fhss_hop_done
+ */
+void apps_common_sx126x_irq_init( void );
+
+/*!
+ * @brief Bind a handler to one or several IRQ bits, replacing the previous one
+ *
+ * @param [in] irq IRQ bits to bind
+ * @param [in] handler Handler to be called, NULL to ignore these bits
+ */
+void apps_common_sx126x_register_irq_handler( sx126x_irq_mask_t irq, apps_common_irq_handler_t handler );
+
 /*!
  * @brief Interface to sx126x interrupt processing routine
  *
+ * The handlers of the bits set in the IRQ register are called in increasing bit order
+ *
  * @warning This function must be called from the main loop of project to dispense all the sx126x interrupt routine
  *
  * @param [in] context  Pointer to the radio context
  */
 void apps_common_sx126x_irq_process( const void* context );
 
+/*!
+ * @brief Check whether a radio raised an interrupt not processed yet by @ref apps_common_sx126x_irq_process
+ *
+ * @remark Meant to be checked with the interrupts masked before the MCU goes to sleep
+ */
+bool apps_common_sx126x_is_irq_pending( void );
+
+/*!
+ * @brief Get a copy of the IRQ dispatch counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_common_sx126x_get_irq_stats( apps_common_irq_stats_t* stats );
+
 /*!
  * @brief Prints all RF parameters
  */
@@ -149,11 +290,47 @@ void apps_common_sx126x_handle_post_tx( void );
 void apps_common_sx126x_handle_pre_rx( void );
 void apps_common_sx126x_handle_post_rx( void );
 
+/*!
+ * @brief Start the time base used to timestamp radio events, see apps_timer.h
+ */
+void apps_common_time_init( void );
+
+/*!
+ * @brief Get the number of milliseconds elapsed since @ref apps_common_time_init
+ */
+uint32_t apps_common_get_time_in_ms( void );
+
+/*!
+ * @brief Get the CPU cycle counter, started by @ref apps_common_time_init
+ *
+ * @remark Wraps around every 53 s at 80 MHz, only meant to time short sequences
+ */
+uint32_t apps_common_get_cycle_count( void );
+
+/*!
+ * @brief Convert a number of CPU cycles to microseconds
+ */
+uint32_t apps_common_cycles_to_us( uint32_t cycles );
+
+/*!
+ * @brief Get the time at which the last interrupt of a radio was raised, in milliseconds
+ *
+ * @param [in] context  Pointer to the radio context
+ */
+uint32_t apps_common_sx126x_get_irq_timestamp_in_ms( const void* context );
+
 /*!
  * @brief Computes time on air, packet type agnostic
  */
 uint32_t get_time_on_air_in_ms( void );
 
+/*!
+ * @brief Computes the time on air of a LoRa packet with the given modulation parameters
+ *
+ * @param [in] params LoRa modulation parameters
+ */
+uint32_t apps_common_get_lora_time_on_air_in_ms( const sx126x_mod_params_lora_t* params );
+
 /*!
  * @brief A function to get the value for low data rate optimization setting
  *
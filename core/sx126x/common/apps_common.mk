@@ -91,6 +91,14 @@ include $(SMTC_HAL_MCU_MAKEFILE)
 
 C_SOURCES +=  \
 $(TOP_DIR)/sx126x/common/apps_common.c \
+$(TOP_DIR)/sx126x/common/apps_energy.c \
+$(TOP_DIR)/sx126x/common/apps_spi_log.c \
+$(TOP_DIR)/sx126x/common/apps_timer.c \
+$(TOP_DIR)/sx126x/common/apps_compress.c \
+$(TOP_DIR)/sx126x/common/apps_airtime.c \
+$(TOP_DIR)/sx126x/common/apps_channel_plan.c \
+$(TOP_DIR)/sx126x/common/apps_rx_ring.c \
+$(TOP_DIR)/sx126x/common/apps_rx_pool.c \
 $(TOP_DIR)/sx126x/common/sx126x_hal.c \
 $(TOP_DIR)/common/src/smtc_hal_dbg_trace.c \
 $(TOP_DIR)/common/src/common_version.c \
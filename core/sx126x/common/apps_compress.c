@@ -0,0 +1,258 @@
+/*!
+ * @file      apps_compress.c
+ *
+ * @brief     Allocation-free payload compression: byte-oriented LZ with a small window, optionally after a delta filter
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "apps_compress.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Hash of the APPS_COMPRESS_MIN_MATCH bytes at p
+ */
+#define APPS_COMPRESS_HASH( p )                                                          \
+    ( ( ( ( uint32_t )( p )[0] << 16 | ( uint32_t )( p )[1] << 8 | ( p )[2] ) * 0x9E3779B1u ) >> \
+      ( 32 - APPS_COMPRESS_HASH_LOG2 ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*!
+ * @brief First token byte of a match
+ */
+#define APPS_COMPRESS_MATCH_TOKEN 0x80
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static const apps_compress_codec_t apps_compress_codecs[APPS_COMPRESS_N_CODECS] = {
+    [APPS_COMPRESS_CODEC_NONE]     = { NULL, NULL, NULL },
+    [APPS_COMPRESS_CODEC_LZ]       = { "LZ", apps_compress_lz, apps_decompress_lz },
+    [APPS_COMPRESS_CODEC_DELTA_LZ] = { "delta+LZ", apps_compress_delta_lz, apps_decompress_delta_lz },
+};
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Append literals to the output, in runs of at most APPS_COMPRESS_MAX_LITERALS
+ *
+ * @returns false if the literals do not fit
+ */
+static bool apps_compress_put_literals( const uint8_t* in, uint16_t n_literals, uint8_t* out, uint16_t* out_size,
+                                        uint8_t out_max );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+const apps_compress_codec_t* apps_compress_get_codec( uint8_t id )
+{
+    if( ( id == APPS_COMPRESS_CODEC_NONE ) || ( id >= APPS_COMPRESS_N_CODECS ) )
+    {
+        return NULL;
+    }
+    return &apps_compress_codecs[id];
+}
+
+uint8_t apps_compress_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max )
+{
+    // Last position of each hash, positions fit in a byte as the input is at most 255 bytes long
+    uint8_t  table[1 << APPS_COMPRESS_HASH_LOG2];
+    uint16_t pos           = 0;
+    uint16_t literal_start = 0;
+    uint16_t out_size      = 0;
+
+    memset( table, 0, sizeof( table ) );
+    while( ( pos + APPS_COMPRESS_MIN_MATCH ) <= in_size )
+    {
+        const uint32_t hash      = APPS_COMPRESS_HASH( &in[pos] );
+        const uint16_t candidate = table[hash];
+
+        table[hash] = ( uint8_t ) pos;
+        // A single candidate, checked in full since the hash may collide
+        if( ( candidate >= pos ) || ( memcmp( &in[candidate], &in[pos], APPS_COMPRESS_MIN_MATCH ) != 0 ) )
+        {
+            pos++;
+            continue;
+        }
+
+        uint16_t length = APPS_COMPRESS_MIN_MATCH;
+
+        // The match may overlap the bytes it copies, which repeats them
+        while( ( ( pos + length ) < in_size ) && ( length < APPS_COMPRESS_MAX_MATCH ) &&
+               ( in[candidate + length] == in[pos + length] ) )
+        {
+            length++;
+        }
+
+        // The literals since the previous match, then the match itself
+        const bool is_written = apps_compress_put_literals( &in[literal_start], pos - literal_start, out, &out_size,
+                                                            out_max );
+        if( ( is_written == false ) || ( ( out_size + 2 ) > out_max ) )
+        {
+            return 0;
+        }
+        out[out_size++] = ( uint8_t )( APPS_COMPRESS_MATCH_TOKEN | ( length - APPS_COMPRESS_MIN_MATCH ) );
+        out[out_size++] = ( uint8_t )( pos - candidate - 1 );
+
+        pos += length;
+        literal_start = pos;
+    }
+
+    if( apps_compress_put_literals( &in[literal_start], in_size - literal_start, out, &out_size, out_max ) == false )
+    {
+        return 0;
+    }
+    return ( uint8_t ) out_size;
+}
+
+uint8_t apps_decompress_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max )
+{
+    uint16_t in_pos   = 0;
+    uint16_t out_size = 0;
+
+    while( in_pos < in_size )
+    {
+        const uint8_t token = in[in_pos++];
+
+        if( token < APPS_COMPRESS_MATCH_TOKEN )
+        {
+            const uint16_t n_literals = token + 1;
+
+            if( ( ( in_pos + n_literals ) > in_size ) || ( ( out_size + n_literals ) > out_max ) )
+            {
+                return 0;
+            }
+            memcpy( &out[out_size], &in[in_pos], n_literals );
+            in_pos += n_literals;
+            out_size += n_literals;
+        }
+        else
+        {
+            const uint16_t length = ( token - APPS_COMPRESS_MATCH_TOKEN ) + APPS_COMPRESS_MIN_MATCH;
+
+            if( in_pos >= in_size )
+            {
+                return 0;
+            }
+
+            const uint16_t distance = in[in_pos++] + 1;
+
+            if( ( distance > out_size ) || ( ( out_size + length ) > out_max ) )
+            {
+                return 0;
+            }
+            // Byte by byte, an overlapping copy repeats the bytes it has just written
+            for( uint16_t i = 0; i < length; i++ )
+            {
+                out[out_size + i] = out[out_size - distance + i];
+            }
+            out_size += length;
+        }
+    }
+    return ( uint8_t ) out_size;
+}
+
+uint8_t apps_compress_delta_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max )
+{
+    uint8_t delta[255];
+
+    for( uint16_t i = 0; i < in_size; i++ )
+    {
+        delta[i] = ( i < APPS_COMPRESS_DELTA_STRIDE ) ? in[i]
+                                                      : ( uint8_t )( in[i] - in[i - APPS_COMPRESS_DELTA_STRIDE] );
+    }
+    return apps_compress_lz( delta, in_size, out, out_max );
+}
+
+uint8_t apps_decompress_delta_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max )
+{
+    const uint8_t out_size = apps_decompress_lz( in, in_size, out, out_max );
+
+    // In place, each byte only depends on bytes already restored
+    for( uint16_t i = APPS_COMPRESS_DELTA_STRIDE; i < out_size; i++ )
+    {
+        out[i] = ( uint8_t )( out[i] + out[i - APPS_COMPRESS_DELTA_STRIDE] );
+    }
+    return out_size;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static bool apps_compress_put_literals( const uint8_t* in, uint16_t n_literals, uint8_t* out, uint16_t* out_size,
+                                        uint8_t out_max )
+{
+    while( n_literals != 0 )
+    {
+        const uint16_t run = ( n_literals > APPS_COMPRESS_MAX_LITERALS ) ? APPS_COMPRESS_MAX_LITERALS : n_literals;
+
+        if( ( *out_size + 1 + run ) > out_max )
+        {
+            return false;
+        }
+        out[*out_size] = ( uint8_t )( run - 1 );
+        memcpy( &out[*out_size + 1], in, run );
+        *out_size += 1 + run;
+        in += run;
+        n_literals -= run;
+    }
+    return true;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
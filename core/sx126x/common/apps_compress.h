@@ -0,0 +1,189 @@
+/*!
+ * @file      apps_compress.h
+ *
+ * @brief     Allocation-free payload compression: byte-oriented LZ with a small window, optionally after a delta filter
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_COMPRESS_H
+#define APPS_COMPRESS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of entries of the match finder hash table, as a power of two
+ *
+ * The table lives on the stack of the compressor, one byte per entry.
+ */
+#ifndef APPS_COMPRESS_HASH_LOG2
+#define APPS_COMPRESS_HASH_LOG2 7
+#endif
+
+/*!
+ * @brief Distance, in bytes, between the two bytes subtracted by the delta filter
+ *
+ * 1 suits slowly varying byte streams, the size of a record suits a sequence of records of the same layout.
+ */
+#ifndef APPS_COMPRESS_DELTA_STRIDE
+#define APPS_COMPRESS_DELTA_STRIDE 1
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Shortest match encoded, shorter repeats are sent as literals
+ */
+#define APPS_COMPRESS_MIN_MATCH 3
+
+/*!
+ * @brief Longest match encoded by a single token
+ */
+#define APPS_COMPRESS_MAX_MATCH ( APPS_COMPRESS_MIN_MATCH + 0x7F )
+
+/*!
+ * @brief Longest run of literals behind a single token
+ */
+#define APPS_COMPRESS_MAX_LITERALS 0x80
+
+/*!
+ * @brief Identifiers of the codecs, as sent along the compressed data
+ */
+#define APPS_COMPRESS_CODEC_NONE 0
+#define APPS_COMPRESS_CODEC_LZ 1
+#define APPS_COMPRESS_CODEC_DELTA_LZ 2
+
+/*!
+ * @brief Number of codec identifiers, APPS_COMPRESS_CODEC_NONE included
+ */
+#define APPS_COMPRESS_N_CODECS 3
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Compress or decompress a buffer
+ *
+ * @param [in] in Data to transform
+ * @param [in] in_size Size of the data, 1 to 255 bytes
+ * @param [out] out Transformed data, it must not overlap the input
+ * @param [in] out_max Size of the output buffer
+ *
+ * @returns The size of the transformed data, 0 if it does not fit in out_max bytes, or if the input is invalid
+ */
+typedef uint8_t ( *apps_compress_fn_t )( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max );
+
+/*!
+ * @brief A codec, a pair of functions undoing each other
+ */
+typedef struct apps_compress_codec_s
+{
+    const char*        name;
+    apps_compress_fn_t compress;
+    apps_compress_fn_t decompress;
+} apps_compress_codec_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Get a codec from its identifier
+ *
+ * @param [in] id Identifier, APPS_COMPRESS_CODEC_xxx
+ *
+ * @returns The codec, NULL for APPS_COMPRESS_CODEC_NONE and unknown identifiers
+ */
+const apps_compress_codec_t* apps_compress_get_codec( uint8_t id );
+
+/*!
+ * @brief Compress with a byte-oriented LZ77, whose window is the data already compressed
+ *
+ * The output is a sequence of tokens: a byte below 0x80 is followed by that number plus one of literals, a byte from
+ * 0x80 is a copy of (byte - 0x80 + APPS_COMPRESS_MIN_MATCH) bytes from the distance given by the next byte, plus one.
+ * Every position is hashed once and checked against a single candidate, and the bytes of a match are skipped, so the
+ * cost is linear in the input size whatever the data: no search, no chain to follow. Incompressible data grows by one
+ * byte every APPS_COMPRESS_MAX_LITERALS.
+ *
+ * @see apps_compress_fn_t
+ */
+uint8_t apps_compress_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max );
+
+/*!
+ * @brief Decompress the output of apps_compress_lz, every copy is checked against both buffers
+ *
+ * @see apps_compress_fn_t
+ */
+uint8_t apps_decompress_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max );
+
+/*!
+ * @brief Replace each byte by its difference with the byte APPS_COMPRESS_DELTA_STRIDE before, then compress with LZ
+ *
+ * Counters and slowly varying readings turn into runs of small, repeated values.
+ *
+ * @see apps_compress_fn_t
+ */
+uint8_t apps_compress_delta_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max );
+
+/*!
+ * @brief Decompress the output of apps_compress_delta_lz
+ *
+ * @see apps_compress_fn_t
+ */
+uint8_t apps_decompress_delta_lz( const uint8_t* in, uint8_t in_size, uint8_t* out, uint8_t out_max );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_COMPRESS_H
+
+/* --- EOF ------------------------------------------------------------------ */
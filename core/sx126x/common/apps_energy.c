@@ -0,0 +1,453 @@
+/*!
+ * @file      apps_energy.c
+ *
+ * @brief     Energy accounting of the radios and of the MCU, from the chip modes they go through
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_energy.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Opcodes of the commands which change the mode of the chip, or the mode it reaches on its own
+ */
+#define APPS_ENERGY_OPCODE_SET_STANDBY 0x80
+#define APPS_ENERGY_OPCODE_SET_RX 0x82
+#define APPS_ENERGY_OPCODE_SET_TX 0x83
+#define APPS_ENERGY_OPCODE_SET_SLEEP 0x84
+#define APPS_ENERGY_OPCODE_SET_CAD_PARAMS 0x88
+#define APPS_ENERGY_OPCODE_SET_RX_TX_FALLBACK_MODE 0x93
+#define APPS_ENERGY_OPCODE_SET_RX_DUTY_CYCLE 0x94
+#define APPS_ENERGY_OPCODE_SET_FS 0xC1
+#define APPS_ENERGY_OPCODE_SET_CAD 0xC5
+#define APPS_ENERGY_OPCODE_SET_TX_CW 0xD1
+#define APPS_ENERGY_OPCODE_SET_TX_INFINITE_PREAMBLE 0xD2
+
+/*!
+ * @brief Bit of the SetSleep argument which retains the configuration
+ */
+#define APPS_ENERGY_SLEEP_WARM_START 0x04
+
+/*!
+ * @brief Position of the exit mode in the SetCadParams command
+ */
+#define APPS_ENERGY_CAD_EXIT_MODE_INDEX 4
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Mode of a radio and what was accounted for it
+ */
+typedef struct apps_energy_radio_s
+{
+    const void*        context;                           //!< Radio context, NULL while the slot is free
+    apps_energy_mode_t mode;                              //!< Mode the radio is in
+    uint64_t           since_in_us;                       //!< Time at which the radio entered the mode
+    apps_energy_mode_t fallback_mode;                     //!< Mode reached at the end of TX and RX
+    uint8_t            cad_exit_mode;                     //!< Exit mode of the CADs, see sx126x_cad_exit_modes_t
+    bool               rx_is_continuous;                  //!< The RX goes on after a packet is received
+    uint32_t           duty_cycle_in_na;                  //!< Average current of the RX duty cycle last started
+    uint64_t           time_in_us[APPS_ENERGY_N_MODES];   //!< Time spent in each mode, the current one excepted
+    uint64_t           charge_in_fc[APPS_ENERGY_N_MODES];  //!< Charge drawn in each mode, in nA x us
+} apps_energy_radio_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static apps_energy_radio_t energy_radios[APPS_ENERGY_N_RADIOS];
+
+/*!
+ * @brief Current drawn in each mode - in nanoampere, the one of APPS_ENERGY_MODE_RX_DUTY_CYCLE is per radio
+ */
+static uint32_t energy_mode_in_na[APPS_ENERGY_N_MODES];
+
+static uint64_t energy_start_in_us;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the slot of a radio, a free slot is taken on the first call with a new context
+ *
+ * @returns NULL when all the slots are taken by other radios
+ */
+static apps_energy_radio_t* apps_energy_get_radio( const void* context, uint64_t now_in_us );
+
+/*!
+ * @brief Account for the time spent in the current mode and enter a new one
+ *
+ * @remark A time earlier than the last change is taken as the time of the last change
+ */
+static void apps_energy_set_mode( apps_energy_radio_t* radio, apps_energy_mode_t mode, uint64_t now_in_us );
+
+static uint32_t apps_energy_get_mode_in_na( const apps_energy_radio_t* radio, apps_energy_mode_t mode );
+
+static uint32_t apps_energy_get_uint24( const uint8_t* buffer );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC VARIABLES --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void apps_energy_init( uint64_t now_in_us )
+{
+    for( uint8_t i = 0; i < APPS_ENERGY_N_RADIOS; i++ )
+    {
+        energy_radios[i] = ( apps_energy_radio_t ){ 0 };
+    }
+    energy_start_in_us = now_in_us;
+}
+
+void apps_energy_set_currents( const smtc_shield_sx126x_current_cfg_t* currents, uint32_t tx_in_ua,
+                               bool rx_is_boosted )
+{
+    const uint32_t rx_in_ua = ( rx_is_boosted == true ) ? currents->rx_boosted_in_ua : currents->rx_in_ua;
+
+    energy_mode_in_na[APPS_ENERGY_MODE_SLEEP_COLD] = currents->sleep_cold_in_na;
+    energy_mode_in_na[APPS_ENERGY_MODE_SLEEP_WARM] = currents->sleep_warm_in_na;
+    energy_mode_in_na[APPS_ENERGY_MODE_STDBY_RC]   = currents->stdby_rc_in_ua * 1000;
+    energy_mode_in_na[APPS_ENERGY_MODE_STDBY_XOSC] = currents->stdby_xosc_in_ua * 1000;
+    energy_mode_in_na[APPS_ENERGY_MODE_FS]         = currents->fs_in_ua * 1000;
+    energy_mode_in_na[APPS_ENERGY_MODE_RX]         = rx_in_ua * 1000;
+    energy_mode_in_na[APPS_ENERGY_MODE_CAD]        = rx_in_ua * 1000;
+    energy_mode_in_na[APPS_ENERGY_MODE_TX]         = tx_in_ua * 1000;
+}
+
+void apps_energy_on_command( const void* context, const uint8_t* command, uint16_t command_length,
+                             uint64_t now_in_us )
+{
+    apps_energy_radio_t* radio = apps_energy_get_radio( context, now_in_us );
+
+    if( ( radio == NULL ) || ( command_length == 0 ) )
+    {
+        return;
+    }
+
+    // The falling edge of NSS wakes the chip up, whatever the command
+    if( ( radio->mode == APPS_ENERGY_MODE_SLEEP_COLD ) || ( radio->mode == APPS_ENERGY_MODE_SLEEP_WARM ) )
+    {
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_STDBY_RC, now_in_us );
+    }
+
+    switch( command[0] )
+    {
+    case APPS_ENERGY_OPCODE_SET_SLEEP:
+        if( command_length >= 2 )
+        {
+            apps_energy_set_mode( radio,
+                                  ( ( command[1] & APPS_ENERGY_SLEEP_WARM_START ) != 0 ) ? APPS_ENERGY_MODE_SLEEP_WARM
+                                                                                         : APPS_ENERGY_MODE_SLEEP_COLD,
+                                  now_in_us );
+        }
+        break;
+    case APPS_ENERGY_OPCODE_SET_STANDBY:
+        if( command_length >= 2 )
+        {
+            apps_energy_set_mode( radio, ( command[1] == 0 ) ? APPS_ENERGY_MODE_STDBY_RC : APPS_ENERGY_MODE_STDBY_XOSC,
+                                  now_in_us );
+        }
+        break;
+    case APPS_ENERGY_OPCODE_SET_FS:
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_FS, now_in_us );
+        break;
+    case APPS_ENERGY_OPCODE_SET_TX:
+    case APPS_ENERGY_OPCODE_SET_TX_CW:
+    case APPS_ENERGY_OPCODE_SET_TX_INFINITE_PREAMBLE:
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_TX, now_in_us );
+        break;
+    case APPS_ENERGY_OPCODE_SET_RX:
+        if( command_length >= 4 )
+        {
+            radio->rx_is_continuous = ( apps_energy_get_uint24( &command[1] ) == SX126X_RX_CONTINUOUS );
+            apps_energy_set_mode( radio, APPS_ENERGY_MODE_RX, now_in_us );
+        }
+        break;
+    case APPS_ENERGY_OPCODE_SET_RX_DUTY_CYCLE:
+        if( command_length >= 7 )
+        {
+            const uint64_t rx_period    = apps_energy_get_uint24( &command[1] );
+            const uint64_t sleep_period = apps_energy_get_uint24( &command[4] );
+
+            if( ( rx_period + sleep_period ) != 0 )
+            {
+                // The chip sleeps warm between its RX windows
+                const uint64_t charge = rx_period * energy_mode_in_na[APPS_ENERGY_MODE_RX] +
+                                        sleep_period * energy_mode_in_na[APPS_ENERGY_MODE_SLEEP_WARM];
+
+                radio->duty_cycle_in_na = ( uint32_t )( charge / ( rx_period + sleep_period ) );
+            }
+            radio->rx_is_continuous = false;
+            apps_energy_set_mode( radio, APPS_ENERGY_MODE_RX_DUTY_CYCLE, now_in_us );
+        }
+        break;
+    case APPS_ENERGY_OPCODE_SET_CAD:
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_CAD, now_in_us );
+        break;
+    case APPS_ENERGY_OPCODE_SET_CAD_PARAMS:
+        if( command_length > APPS_ENERGY_CAD_EXIT_MODE_INDEX )
+        {
+            radio->cad_exit_mode = command[APPS_ENERGY_CAD_EXIT_MODE_INDEX];
+        }
+        break;
+    case APPS_ENERGY_OPCODE_SET_RX_TX_FALLBACK_MODE:
+        if( command_length >= 2 )
+        {
+            switch( command[1] )
+            {
+            case SX126X_FALLBACK_STDBY_XOSC:
+                radio->fallback_mode = APPS_ENERGY_MODE_STDBY_XOSC;
+                break;
+            case SX126X_FALLBACK_FS:
+                radio->fallback_mode = APPS_ENERGY_MODE_FS;
+                break;
+            default:
+                radio->fallback_mode = APPS_ENERGY_MODE_STDBY_RC;
+                break;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void apps_energy_on_wakeup( const void* context, uint64_t now_in_us )
+{
+    apps_energy_radio_t* radio = apps_energy_get_radio( context, now_in_us );
+
+    if( radio != NULL )
+    {
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_STDBY_RC, now_in_us );
+    }
+}
+
+void apps_energy_on_irq( const void* context, uint16_t irq_regs, uint64_t irq_in_us )
+{
+    apps_energy_radio_t* radio = apps_energy_get_radio( context, irq_in_us );
+
+    if( radio == NULL )
+    {
+        return;
+    }
+
+    // The steps follow each other, a CAD which detected a preamble can be reported with the end of its RX
+    if( ( radio->mode == APPS_ENERGY_MODE_CAD ) && ( ( irq_regs & SX126X_IRQ_CAD_DONE ) != 0 ) )
+    {
+        const bool         is_detected = ( ( irq_regs & SX126X_IRQ_CAD_DETECTED ) != 0 );
+        apps_energy_mode_t mode        = APPS_ENERGY_MODE_STDBY_RC;
+
+        if( ( is_detected == true ) && ( radio->cad_exit_mode == SX126X_CAD_RX ) )
+        {
+            radio->rx_is_continuous = false;
+            mode                    = APPS_ENERGY_MODE_RX;
+        }
+        else if( ( is_detected == false ) && ( radio->cad_exit_mode == SX126X_CAD_LBT ) )
+        {
+            mode = APPS_ENERGY_MODE_TX;
+        }
+        apps_energy_set_mode( radio, mode, irq_in_us );
+    }
+    if( ( radio->mode == APPS_ENERGY_MODE_RX_DUTY_CYCLE ) && ( ( irq_regs & SX126X_IRQ_PREAMBLE_DETECTED ) != 0 ) )
+    {
+        apps_energy_set_mode( radio, APPS_ENERGY_MODE_RX, irq_in_us );
+    }
+    if( ( radio->mode == APPS_ENERGY_MODE_RX ) &&
+        ( ( ( ( irq_regs & SX126X_IRQ_RX_DONE ) != 0 ) && ( radio->rx_is_continuous == false ) ) ||
+          ( ( irq_regs & SX126X_IRQ_TIMEOUT ) != 0 ) ) )
+    {
+        apps_energy_set_mode( radio, radio->fallback_mode, irq_in_us );
+    }
+    if( ( radio->mode == APPS_ENERGY_MODE_TX ) && ( ( irq_regs & ( SX126X_IRQ_TX_DONE | SX126X_IRQ_TIMEOUT ) ) != 0 ) )
+    {
+        apps_energy_set_mode( radio, radio->fallback_mode, irq_in_us );
+    }
+}
+
+void apps_energy_get_report( uint64_t now_in_us, uint64_t mcu_sleep_in_us, uint32_t n_packets,
+                             apps_energy_report_t* report )
+{
+    uint64_t mode_charge_in_fc[APPS_ENERGY_N_MODES] = { 0 };
+
+    *report               = ( apps_energy_report_t ){ 0 };
+    report->elapsed_in_us = ( now_in_us > energy_start_in_us ) ? ( now_in_us - energy_start_in_us ) : 0;
+
+    for( uint8_t i = 0; i < APPS_ENERGY_N_RADIOS; i++ )
+    {
+        const apps_energy_radio_t* radio = &energy_radios[i];
+
+        if( radio->context == NULL )
+        {
+            continue;
+        }
+        for( uint8_t mode = 0; mode < APPS_ENERGY_N_MODES; mode++ )
+        {
+            report->mode_time_in_us[mode] += radio->time_in_us[mode];
+            mode_charge_in_fc[mode] += radio->charge_in_fc[mode];
+        }
+        // The current mode is accounted until now, without leaving it
+        if( now_in_us > radio->since_in_us )
+        {
+            const uint64_t spent_in_us = now_in_us - radio->since_in_us;
+
+            report->mode_time_in_us[radio->mode] += spent_in_us;
+            mode_charge_in_fc[radio->mode] += spent_in_us * apps_energy_get_mode_in_na( radio, radio->mode );
+        }
+    }
+    for( uint8_t mode = 0; mode < APPS_ENERGY_N_MODES; mode++ )
+    {
+        report->mode_charge_in_pc[mode] = mode_charge_in_fc[mode] / 1000;
+        report->radio_charge_in_pc += report->mode_charge_in_pc[mode];
+    }
+
+    report->mcu_sleep_in_us  = ( mcu_sleep_in_us < report->elapsed_in_us ) ? mcu_sleep_in_us : report->elapsed_in_us;
+    report->mcu_charge_in_pc = ( report->elapsed_in_us - report->mcu_sleep_in_us ) * APPS_ENERGY_MCU_RUN_UA +
+                               report->mcu_sleep_in_us * APPS_ENERGY_MCU_SLEEP_UA;
+
+    const uint64_t charge_in_pc = report->radio_charge_in_pc + report->mcu_charge_in_pc;
+
+    if( report->elapsed_in_us != 0 )
+    {
+        // Microampere is picocoulomb per microsecond
+        report->avg_current_in_na = ( uint32_t )( ( charge_in_pc * 1000 ) / report->elapsed_in_us );
+    }
+    if( n_packets != 0 )
+    {
+        // One nanoampere-hour is 3.6 microcoulomb
+        report->charge_per_packet_in_nah = ( uint32_t )( charge_in_pc / ( ( uint64_t ) n_packets * 3600000 ) );
+    }
+}
+
+const char* apps_energy_mode_to_str( apps_energy_mode_t mode )
+{
+    switch( mode )
+    {
+    case APPS_ENERGY_MODE_SLEEP_COLD:
+        return "sleep cold";
+    case APPS_ENERGY_MODE_SLEEP_WARM:
+        return "sleep warm";
+    case APPS_ENERGY_MODE_STDBY_RC:
+        return "STDBY_RC";
+    case APPS_ENERGY_MODE_STDBY_XOSC:
+        return "STDBY_XOSC";
+    case APPS_ENERGY_MODE_FS:
+        return "FS";
+    case APPS_ENERGY_MODE_RX:
+        return "RX";
+    case APPS_ENERGY_MODE_CAD:
+        return "CAD";
+    case APPS_ENERGY_MODE_TX:
+        return "TX";
+    case APPS_ENERGY_MODE_RX_DUTY_CYCLE:
+        return "RX duty cycle";
+    default:
+        return "unknown";
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static apps_energy_radio_t* apps_energy_get_radio( const void* context, uint64_t now_in_us )
+{
+    for( uint8_t i = 0; i < APPS_ENERGY_N_RADIOS; i++ )
+    {
+        apps_energy_radio_t* radio = &energy_radios[i];
+
+        if( radio->context == NULL )
+        {
+            // First transaction seen, the radio is taken as just reset
+            radio->context       = context;
+            radio->mode          = APPS_ENERGY_MODE_STDBY_RC;
+            radio->since_in_us   = now_in_us;
+            radio->fallback_mode = APPS_ENERGY_MODE_STDBY_RC;
+            radio->cad_exit_mode = SX126X_CAD_ONLY;
+        }
+        if( radio->context == context )
+        {
+            return radio;
+        }
+    }
+    return NULL;
+}
+
+static void apps_energy_set_mode( apps_energy_radio_t* radio, apps_energy_mode_t mode, uint64_t now_in_us )
+{
+    if( now_in_us > radio->since_in_us )
+    {
+        const uint64_t spent_in_us = now_in_us - radio->since_in_us;
+
+        radio->time_in_us[radio->mode] += spent_in_us;
+        radio->charge_in_fc[radio->mode] += spent_in_us * apps_energy_get_mode_in_na( radio, radio->mode );
+        radio->since_in_us = now_in_us;
+    }
+    radio->mode = mode;
+}
+
+static uint32_t apps_energy_get_mode_in_na( const apps_energy_radio_t* radio, apps_energy_mode_t mode )
+{
+    return ( mode == APPS_ENERGY_MODE_RX_DUTY_CYCLE ) ? radio->duty_cycle_in_na : energy_mode_in_na[mode];
+}
+
+static uint32_t apps_energy_get_uint24( const uint8_t* buffer )
+{
+    return ( ( uint32_t ) buffer[0] << 16 ) | ( ( uint32_t ) buffer[1] << 8 ) | ( uint32_t ) buffer[2];
+}
+
+/* --- EOF ------------------------------------------------------------------ */
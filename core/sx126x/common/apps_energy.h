@@ -0,0 +1,215 @@
+/*!
+ * @file      apps_energy.h
+ *
+ * @brief     Energy accounting of the radios and of the MCU, from the chip modes they go through
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_ENERGY_H
+#define APPS_ENERGY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "smtc_shield_sx126x_types.h"
+#include "apps_timer.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Follow the mode of the radios from the commands sent by sx126x_hal.c and the interrupts they raise
+ */
+#ifndef APPS_ENERGY
+#define APPS_ENERGY true
+#endif
+
+/*!
+ * @brief Number of radio contexts accounted for, the others are ignored
+ */
+#ifndef APPS_ENERGY_N_RADIOS
+#define APPS_ENERGY_N_RADIOS 2
+#endif
+
+/*!
+ * @brief Current drawn by the MCU while running, STM32L476 at 80 MHz from flash - in microampere
+ */
+#ifndef APPS_ENERGY_MCU_RUN_UA
+#define APPS_ENERGY_MCU_RUN_UA 8500
+#endif
+
+/*!
+ * @brief Current drawn by the MCU while waiting for an interrupt - in microampere
+ *
+ * @remark Sleep keeps the clocks running, STOP2 only keeps the LPTIM and the EXTI lines
+ */
+#ifndef APPS_ENERGY_MCU_SLEEP_UA
+#if( APPS_TIMER_STOP2 == true )
+#define APPS_ENERGY_MCU_SLEEP_UA 2
+#else
+#define APPS_ENERGY_MCU_SLEEP_UA 2800
+#endif
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Modes of the chip told apart by the accounting
+ */
+typedef enum apps_energy_mode_e
+{
+    APPS_ENERGY_MODE_SLEEP_COLD,     //!< Sleep, configuration lost
+    APPS_ENERGY_MODE_SLEEP_WARM,     //!< Sleep, configuration retained
+    APPS_ENERGY_MODE_STDBY_RC,       //!< Standby on the RC oscillator, mode after a reset or a wake-up
+    APPS_ENERGY_MODE_STDBY_XOSC,     //!< Standby on the crystal oscillator
+    APPS_ENERGY_MODE_FS,             //!< Frequency synthesis
+    APPS_ENERGY_MODE_RX,             //!< Reception, including the RX started by a CAD which detected a preamble
+    APPS_ENERGY_MODE_CAD,            //!< Channel activity detection
+    APPS_ENERGY_MODE_TX,             //!< Transmission, at the output power given to @ref apps_energy_set_currents
+    APPS_ENERGY_MODE_RX_DUTY_CYCLE,  //!< Reception duty cycle, at the average current of its RX and sleep periods
+    APPS_ENERGY_N_MODES,
+} apps_energy_mode_t;
+
+/*!
+ * @brief Time and charge accounted since @ref apps_energy_init
+ *
+ * @remark A charge in picocoulomb is a current in microampere times a time in microsecond. The average current in
+ * nanoampere is the charge in nanoampere-hour drawn each hour
+ */
+typedef struct apps_energy_report_s
+{
+    uint64_t elapsed_in_us;                           //!< Time since @ref apps_energy_init
+    uint64_t mode_time_in_us[APPS_ENERGY_N_MODES];    //!< Time spent in each mode, summed over the radios
+    uint64_t mode_charge_in_pc[APPS_ENERGY_N_MODES];  //!< Charge drawn in each mode, summed over the radios
+    uint64_t radio_charge_in_pc;                      //!< Charge drawn by the radios
+    uint64_t mcu_sleep_in_us;                         //!< Time the MCU spent waiting for an interrupt
+    uint64_t mcu_charge_in_pc;                        //!< Charge drawn by the MCU, running and asleep
+    uint32_t avg_current_in_na;                       //!< Average current of the radios and the MCU
+    uint32_t charge_per_packet_in_nah;                //!< Charge drawn for each packet received, 0 without any
+} apps_energy_report_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Forget the radios and the charge accounted so far
+ *
+ * @param [in] now_in_us Time at which the accounting starts
+ */
+void apps_energy_init( uint64_t now_in_us );
+
+/*!
+ * @brief Set the currents of each mode, the radios are then all accounted with them
+ *
+ * @param [in] currents      Currents of the shield, see smtc_shield_sx126x_get_current_cfg
+ * @param [in] tx_in_ua      Current drawn in TX at the configured output power
+ * @param [in] rx_is_boosted true if the RX boosted gain is enabled
+ */
+void apps_energy_set_currents( const smtc_shield_sx126x_current_cfg_t* currents, uint32_t tx_in_ua,
+                               bool rx_is_boosted );
+
+/*!
+ * @brief Follow a transaction sent to a radio, called by sx126x_hal.c once NSS is released
+ *
+ * @remark Only the command bytes are looked at: the commands changing the mode or the mode reached at the end of
+ * an operation. Any transaction wakes a sleeping radio up into STDBY_RC
+ *
+ * @param [in] context        Radio context, the radios are told apart in the order they are first seen
+ * @param [in] command        Command bytes, the opcode first
+ * @param [in] command_length Number of command bytes
+ * @param [in] now_in_us      Time of the transaction
+ */
+void apps_energy_on_command( const void* context, const uint8_t* command, uint16_t command_length,
+                             uint64_t now_in_us );
+
+/*!
+ * @brief Follow a reset or a wake-up of a radio, which then is in STDBY_RC
+ *
+ * @param [in] context   Radio context
+ * @param [in] now_in_us Time at which the radio is ready
+ */
+void apps_energy_on_wakeup( const void* context, uint64_t now_in_us );
+
+/*!
+ * @brief Follow the end of an operation, called with the interrupts read before they are dispatched
+ *
+ * @remark The radio leaves TX, RX and CAD on its own: the mode it reaches follows from the fallback mode, the CAD
+ * exit mode and the RX timeout last sent
+ *
+ * @param [in] context   Radio context
+ * @param [in] irq_regs  Interrupts read from the radio
+ * @param [in] irq_in_us Time at which the IRQ line rose
+ */
+void apps_energy_on_irq( const void* context, uint16_t irq_regs, uint64_t irq_in_us );
+
+/*!
+ * @brief Get the time and charge accounted until now
+ *
+ * @param [in]  now_in_us       Time at which the report is drawn
+ * @param [in]  mcu_sleep_in_us Time the MCU spent asleep since @ref apps_energy_init
+ * @param [in]  n_packets       Packets received since @ref apps_energy_init
+ * @param [out] report          Pointer to the structure to be filled
+ */
+void apps_energy_get_report( uint64_t now_in_us, uint64_t mcu_sleep_in_us, uint32_t n_packets,
+                             apps_energy_report_t* report );
+
+/*!
+ * @brief Get the name of a mode, for the traces
+ */
+const char* apps_energy_mode_to_str( apps_energy_mode_t mode );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_ENERGY_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,182 @@
+/*!
+ * @file      apps_rx_pool.c
+ *
+ * @brief     Fixed-size pool of reception buffers handed over through a single-producer/single-consumer queue
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_rx_pool.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( ( APPS_RX_POOL_N_SLOTS & ( APPS_RX_POOL_N_SLOTS - 1 ) ) != 0 ) || ( APPS_RX_POOL_N_SLOTS > 128 )
+#error "APPS_RX_POOL_N_SLOTS must be a power of two lower than or equal to 128"
+#endif
+
+#define APPS_RX_POOL_MASK ( APPS_RX_POOL_N_SLOTS - 1 )
+
+/*!
+ * @brief Compiler barrier ordering the slot accesses against the index update
+ *
+ * @remark Enough on a single-core Cortex-M where producer and consumer only differ by their execution context
+ */
+#define APPS_RX_POOL_BARRIER( ) __asm volatile( "" ::: "memory" )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static uint8_t            rx_pool_payloads[APPS_RX_POOL_N_SLOTS][APPS_RX_POOL_SLOT_SIZE];
+static apps_rx_pkt_desc_t rx_pool_descs[APPS_RX_POOL_N_SLOTS];
+
+/*!
+ * @brief Free-running indexes - head is only written by the producer, tail only by the consumer
+ */
+static volatile uint8_t rx_pool_head = 0;
+static volatile uint8_t rx_pool_tail = 0;
+
+static apps_rx_pool_stats_t rx_pool_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void apps_rx_pool_init( void )
+{
+    for( uint8_t i = 0; i < APPS_RX_POOL_N_SLOTS; i++ )
+    {
+        rx_pool_descs[i].payload = rx_pool_payloads[i];
+        rx_pool_descs[i].size    = 0;
+    }
+
+    rx_pool_head = 0;
+    rx_pool_tail = 0;
+
+    rx_pool_stats.committed = 0;
+    rx_pool_stats.dropped   = 0;
+    rx_pool_stats.max_depth = 0;
+}
+
+apps_rx_pkt_desc_t* apps_rx_pool_acquire( void )
+{
+    const uint8_t head = rx_pool_head;
+
+    if( ( uint8_t )( head - rx_pool_tail ) >= APPS_RX_POOL_N_SLOTS )
+    {
+        rx_pool_stats.dropped++;
+        return NULL;
+    }
+
+    apps_rx_pkt_desc_t* desc = &rx_pool_descs[head & APPS_RX_POOL_MASK];
+    desc->payload            = rx_pool_payloads[head & APPS_RX_POOL_MASK];
+    desc->size               = 0;
+
+    return desc;
+}
+
+void apps_rx_pool_commit( void )
+{
+    APPS_RX_POOL_BARRIER( );
+    rx_pool_head = ( uint8_t )( rx_pool_head + 1 );
+
+    rx_pool_stats.committed++;
+
+    const uint8_t depth = apps_rx_pool_get_depth( );
+    if( depth > rx_pool_stats.max_depth )
+    {
+        rx_pool_stats.max_depth = depth;
+    }
+}
+
+const apps_rx_pkt_desc_t* apps_rx_pool_peek( void )
+{
+    const uint8_t tail = rx_pool_tail;
+
+    if( tail == rx_pool_head )
+    {
+        return NULL;
+    }
+    APPS_RX_POOL_BARRIER( );
+
+    return &rx_pool_descs[tail & APPS_RX_POOL_MASK];
+}
+
+void apps_rx_pool_release( void )
+{
+    if( rx_pool_tail != rx_pool_head )
+    {
+        APPS_RX_POOL_BARRIER( );
+        rx_pool_tail = ( uint8_t )( rx_pool_tail + 1 );
+    }
+}
+
+uint8_t apps_rx_pool_get_depth( void )
+{
+    return ( uint8_t )( rx_pool_head - rx_pool_tail );
+}
+
+void apps_rx_pool_get_stats( apps_rx_pool_stats_t* stats )
+{
+    *stats = rx_pool_stats;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,165 @@
+/*!
+ * @file      apps_rx_pool.h
+ *
+ * @brief     Fixed-size pool of reception buffers handed over through a single-producer/single-consumer queue
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_RX_POOL_H
+#define APPS_RX_POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "apps_configuration.h"
+#include "sx126x.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of reception slots in the pool
+ *
+ * @warning Must be a power of two, the queue indexes are wrapped with a mask
+ */
+#ifndef APPS_RX_POOL_N_SLOTS
+#define APPS_RX_POOL_N_SLOTS 4
+#endif
+
+/*!
+ * @brief Size of the payload area of each slot, in bytes
+ */
+#ifndef APPS_RX_POOL_SLOT_SIZE
+#define APPS_RX_POOL_SLOT_SIZE PAYLOAD_LENGTH
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Descriptor of a received packet, owned by a pool slot
+ */
+typedef struct apps_rx_pkt_desc_s
+{
+    uint8_t*         payload;                  //!< Points to the payload area of the slot (no extra copy)
+    uint8_t          size;                     //!< Number of valid bytes in payload
+    uint8_t          buffer_offset;            //!< Offset of the payload in the radio data buffer
+    int8_t           rssi_pkt_in_dbm;          //!< Average RSSI over the packet
+    int8_t           snr_pkt_in_db;            //!< SNR estimation of the packet
+    int8_t           signal_rssi_pkt_in_dbm;   //!< RSSI of the LoRa signal after despreading
+    sx126x_lora_sf_t sf;                       //!< Spreading factor the packet was received on
+    sx126x_lora_bw_t bw;                       //!< Bandwidth the packet was received on
+    uint32_t         timestamp_in_ms;          //!< Time of the RX_DONE interrupt
+    uint8_t          channel;                  //!< Index in the channel plan of the channel, set by the application
+} apps_rx_pkt_desc_t;
+
+/*!
+ * @brief Pool and queue counters
+ */
+typedef struct apps_rx_pool_stats_s
+{
+    uint32_t committed;  //!< Packets handed over to the consumer
+    uint32_t dropped;    //!< Packets lost because every slot was in use
+    uint8_t  max_depth;  //!< Highest number of slots simultaneously in use
+} apps_rx_pool_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Reset the pool: all slots are released and counters are cleared
+ */
+void apps_rx_pool_init( void );
+
+/*!
+ * @brief Producer side - reserve the next free slot
+ *
+ * @remark The returned descriptor stays private to the producer until @ref apps_rx_pool_commit is called
+ *
+ * @returns Pointer to the descriptor of the reserved slot, NULL if the pool is full (the drop is accounted)
+ */
+apps_rx_pkt_desc_t* apps_rx_pool_acquire( void );
+
+/*!
+ * @brief Producer side - publish the slot previously returned by @ref apps_rx_pool_acquire
+ */
+void apps_rx_pool_commit( void );
+
+/*!
+ * @brief Consumer side - get the oldest published packet without removing it
+ *
+ * @returns Pointer to the descriptor, NULL if the queue is empty
+ */
+const apps_rx_pkt_desc_t* apps_rx_pool_peek( void );
+
+/*!
+ * @brief Consumer side - give the slot returned by @ref apps_rx_pool_peek back to the pool
+ */
+void apps_rx_pool_release( void );
+
+/*!
+ * @brief Get the number of packets waiting for the consumer
+ */
+uint8_t apps_rx_pool_get_depth( void );
+
+/*!
+ * @brief Get a copy of the pool counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_rx_pool_get_stats( apps_rx_pool_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_RX_POOL_H
+
+/* --- EOF ------------------------------------------------------------------ */
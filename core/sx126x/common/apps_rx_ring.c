@@ -0,0 +1,218 @@
+/*!
+ * @file      apps_rx_ring.c
+ *
+ * @brief     Reception in rotating slots of the radio data buffer, drained lazily by the MCU
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_rx_ring.h"
+#include "apps_common.h"
+#include "apps_utilities.h"
+#include "smtc_hal_dbg_trace.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( APPS_RX_RING_N_SLOTS < 1 )
+#error "APPS_RX_RING_SLOT_SIZE does not fit in the radio data buffer"
+#endif
+
+/*!
+ * @brief Radio data buffer offset of a slot
+ */
+#define APPS_RX_RING_SLOT_BASE( slot ) ( ( uint8_t )( ( slot ) * APPS_RX_RING_SLOT_SIZE ) )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*!
+ * @brief Status of the packet held by each slot - payload is not used, the bytes stay in the radio
+ */
+static apps_rx_pkt_desc_t rx_ring_slots[APPS_RX_RING_N_SLOTS];
+
+static uint8_t rx_ring_armed   = 0;  //!< Slot the radio writes the next packet to
+static uint8_t rx_ring_oldest  = 0;  //!< Oldest slot not yet drained
+static uint8_t rx_ring_pending = 0;  //!< Number of slots waiting to be drained
+
+static apps_rx_ring_stats_t rx_ring_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the slot following the one given as parameter
+ */
+static uint8_t apps_rx_ring_next( uint8_t slot );
+
+/*!
+ * @brief Forget the oldest pending packet
+ */
+static void apps_rx_ring_discard_oldest( void );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void apps_rx_ring_init( const void* context )
+{
+    rx_ring_armed   = 0;
+    rx_ring_oldest  = 0;
+    rx_ring_pending = 0;
+
+    rx_ring_stats.received    = 0;
+    rx_ring_stats.drained     = 0;
+    rx_ring_stats.overflows   = 0;
+    rx_ring_stats.overruns    = 0;
+    rx_ring_stats.misplaced   = 0;
+    rx_ring_stats.max_pending = 0;
+
+    ASSERT_SX126X_RC( sx126x_set_buffer_base_address( context, 0x00, APPS_RX_RING_SLOT_BASE( rx_ring_armed ) ) );
+}
+
+void apps_rx_ring_on_rx_done( const void* context, uint8_t channel )
+{
+    apps_rx_pkt_desc_t* slot = &rx_ring_slots[rx_ring_armed];
+
+    if( rx_ring_pending == APPS_RX_RING_N_SLOTS )
+    {
+        // The armed slot still held the oldest packet, which has just been overwritten
+        apps_rx_ring_discard_oldest( );
+        rx_ring_stats.overflows++;
+    }
+
+    slot->payload = NULL;
+    if( apps_common_sx126x_get_rx_pkt_info( context, slot, APPS_RX_RING_SLOT_SIZE ) == false )
+    {
+        // The payload spilled over the next slot, whose content is lost as well
+        if( ( rx_ring_pending != 0 ) && ( rx_ring_oldest == apps_rx_ring_next( rx_ring_armed ) ) )
+        {
+            apps_rx_ring_discard_oldest( );
+            rx_ring_stats.overflows++;
+        }
+        rx_ring_stats.overruns++;
+    }
+    else if( slot->buffer_offset != APPS_RX_RING_SLOT_BASE( rx_ring_armed ) )
+    {
+        rx_ring_stats.misplaced++;
+    }
+    else
+    {
+        // Stamped now, the radio may have moved to another cell by the time the packet is drained
+        slot->channel = channel;
+        rx_ring_pending++;
+        rx_ring_stats.received++;
+        if( rx_ring_pending > rx_ring_stats.max_pending )
+        {
+            rx_ring_stats.max_pending = rx_ring_pending;
+        }
+
+        rx_ring_armed = apps_rx_ring_next( rx_ring_armed );
+        ASSERT_SX126X_RC(
+            sx126x_set_buffer_base_address( context, 0x00, APPS_RX_RING_SLOT_BASE( rx_ring_armed ) ) );
+    }
+}
+
+uint8_t apps_rx_ring_get_pending( void )
+{
+    return rx_ring_pending;
+}
+
+bool apps_rx_ring_drain( const void* context, apps_rx_pkt_desc_t* desc, uint8_t max_size )
+{
+    if( rx_ring_pending == 0 )
+    {
+        return false;
+    }
+
+    const apps_rx_pkt_desc_t* slot    = &rx_ring_slots[rx_ring_oldest];
+    uint8_t*                  payload = desc->payload;
+
+    *desc         = *slot;
+    desc->payload = payload;
+    apps_rx_ring_discard_oldest( );
+
+    if( desc->size > max_size )
+    {
+        desc->size = 0;
+        return false;
+    }
+
+    apps_common_sx126x_read_rx_payload( context, desc );
+    rx_ring_stats.drained++;
+
+    return true;
+}
+
+void apps_rx_ring_get_stats( apps_rx_ring_stats_t* stats )
+{
+    *stats = rx_ring_stats;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint8_t apps_rx_ring_next( uint8_t slot )
+{
+    return ( uint8_t )( ( slot + 1 ) % APPS_RX_RING_N_SLOTS );
+}
+
+static void apps_rx_ring_discard_oldest( void )
+{
+    rx_ring_oldest = apps_rx_ring_next( rx_ring_oldest );
+    rx_ring_pending--;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,152 @@
+/*!
+ * @file      apps_rx_ring.h
+ *
+ * @brief     Reception in rotating slots of the radio data buffer, drained lazily by the MCU
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_RX_RING_H
+#define APPS_RX_RING_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "apps_configuration.h"
+#include "apps_rx_pool.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Size of the SX126x data buffer shared by RX and TX, in bytes
+ */
+#define APPS_RX_RING_RADIO_BUFFER_SIZE 256
+
+/*!
+ * @brief Size of one reception slot in the radio data buffer, in bytes
+ */
+#ifndef APPS_RX_RING_SLOT_SIZE
+#define APPS_RX_RING_SLOT_SIZE PAYLOAD_LENGTH
+#endif
+
+/*!
+ * @brief Number of reception slots fitting in the radio data buffer
+ */
+#define APPS_RX_RING_N_SLOTS ( APPS_RX_RING_RADIO_BUFFER_SIZE / APPS_RX_RING_SLOT_SIZE )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Ring counters
+ */
+typedef struct apps_rx_ring_stats_s
+{
+    uint32_t received;    //!< Packets recorded in a slot
+    uint32_t drained;     //!< Packets read out of the radio data buffer
+    uint32_t overflows;   //!< Pending packets overwritten because the MCU did not drain them in time
+    uint32_t overruns;    //!< Packets longer than a slot, dropped
+    uint32_t misplaced;   //!< Packets not found at the base address of the armed slot, dropped
+    uint8_t  max_pending; //!< Highest number of packets simultaneously waiting in the radio
+} apps_rx_ring_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Reset the ring and point the radio RX base address to the first slot
+ *
+ * @remark Must be called after the radio is initialised, before the first reception
+ *
+ * @param [in] context  Pointer to the radio context
+ */
+void apps_rx_ring_init( const void* context );
+
+/*!
+ * @brief Record the packet that just completed and move the RX base address to the next slot
+ *
+ * @remark Only the packet status is read here - the payload stays in the radio until @ref apps_rx_ring_drain.
+ * The caller sets the radio back to RX right after this call.
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [in] channel  Index in the channel plan of the channel the packet was received on
+ */
+void apps_rx_ring_on_rx_done( const void* context, uint8_t channel );
+
+/*!
+ * @brief Get the number of packets waiting in the radio data buffer
+ */
+uint8_t apps_rx_ring_get_pending( void );
+
+/*!
+ * @brief Read the oldest pending packet out of the radio data buffer
+ *
+ * @param [in] context  Pointer to the radio context
+ * @param [in,out] desc Descriptor filled with the packet status, its payload area receives the bytes
+ * @param [in] max_size Size of the payload area pointed by the descriptor
+ *
+ * @returns true if a packet was drained, false if none was pending or it did not fit
+ */
+bool apps_rx_ring_drain( const void* context, apps_rx_pkt_desc_t* desc, uint8_t max_size );
+
+/*!
+ * @brief Get a copy of the ring counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_rx_ring_get_stats( apps_rx_ring_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_RX_RING_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,221 @@
+/*!
+ * @file      apps_spi_log.c
+ *
+ * @brief     Recorder of the SPI transactions sent to the radios, streamed out on the debug trace
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_spi_log.h"
+#include "apps_common.h"
+#include "apps_timer.h"
+#include "smtc_hal_dbg_trace.h"
+
+// Without the log, neither the ring nor the recorder is built
+#if( APPS_SPI_LOG == true )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( ( APPS_SPI_LOG_N_RECORDS & ( APPS_SPI_LOG_N_RECORDS - 1 ) ) != 0 )
+#error "APPS_SPI_LOG_N_RECORDS must be a power of two"
+#endif
+
+#define APPS_SPI_LOG_MASK ( APPS_SPI_LOG_N_RECORDS - 1 )
+
+/*!
+ * @brief Number of radio contexts told apart, the others share the last number
+ */
+#define APPS_SPI_LOG_N_RADIOS 4
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef struct apps_spi_log_entry_s
+{
+    uint32_t seq;                            //!< Number of the transaction since apps_spi_log_init
+    uint32_t time_in_us;                     //!< Time of the end of the transaction, on the LPTIM time base
+    uint32_t busy_in_cycles;                 //!< Time waited for BUSY to go low
+    uint32_t transfer_in_cycles;             //!< Time from the BUSY wait to the release of NSS
+    uint16_t length;                         //!< Number of bytes of the transaction, command and data
+    uint8_t  radio;                          //!< Number of the radio, in the order they were first seen
+    bool     is_read;                        //!< sx126x_hal_read, or sx126x_hal_write
+    uint8_t  n_bytes;                        //!< Number of bytes kept
+    uint8_t  bytes[APPS_SPI_LOG_MAX_BYTES];  //!< First bytes of the transaction
+} apps_spi_log_entry_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static apps_spi_log_entry_t spi_log_entries[APPS_SPI_LOG_N_RECORDS];
+static uint32_t             spi_log_head;  //!< Next entry to write out
+static uint32_t             spi_log_tail;  //!< Next entry to record
+
+static const void* spi_log_contexts[APPS_SPI_LOG_N_RADIOS];
+
+static apps_spi_log_stats_t spi_log_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Get the number of a radio, the contexts are numbered in the order they are first seen
+ */
+static uint8_t apps_spi_log_get_radio( const void* context );
+
+/*!
+ * @brief Convert a number of CPU cycles to nanoseconds
+ */
+static uint32_t apps_spi_log_cycles_to_ns( uint32_t cycles );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void apps_spi_log_init( void )
+{
+    spi_log_head  = 0;
+    spi_log_tail  = 0;
+    spi_log_stats = ( apps_spi_log_stats_t ){ 0 };
+    for( uint8_t i = 0; i < APPS_SPI_LOG_N_RADIOS; i++ )
+    {
+        spi_log_contexts[i] = NULL;
+    }
+}
+
+void apps_spi_log_record( const void* context, bool is_read, const uint8_t* command, uint16_t command_length,
+                          const uint8_t* data, uint16_t data_length, uint32_t start_cycles, uint32_t busy_end_cycles )
+{
+    const uint32_t end_cycles = apps_common_get_cycle_count( );
+    const uint32_t seq        = spi_log_stats.recorded++;
+
+    if( ( spi_log_tail - spi_log_head ) >= APPS_SPI_LOG_N_RECORDS )
+    {
+        spi_log_stats.dropped++;
+        return;
+    }
+
+    apps_spi_log_entry_t* entry = &spi_log_entries[spi_log_tail & APPS_SPI_LOG_MASK];
+
+    entry->seq                = seq;
+    entry->time_in_us         = ( uint32_t ) apps_timer_get_time_in_us( );
+    entry->busy_in_cycles     = busy_end_cycles - start_cycles;
+    entry->transfer_in_cycles = end_cycles - busy_end_cycles;
+    entry->length             = command_length + data_length;
+    entry->radio              = apps_spi_log_get_radio( context );
+    entry->is_read            = is_read;
+    entry->n_bytes            = 0;
+    for( uint16_t i = 0; ( i < command_length ) && ( entry->n_bytes < APPS_SPI_LOG_MAX_BYTES ); i++ )
+    {
+        entry->bytes[entry->n_bytes++] = command[i];
+    }
+    for( uint16_t i = 0; ( data != NULL ) && ( i < data_length ) && ( entry->n_bytes < APPS_SPI_LOG_MAX_BYTES ); i++ )
+    {
+        entry->bytes[entry->n_bytes++] = data[i];
+    }
+    spi_log_tail++;
+}
+
+void apps_spi_log_flush( void )
+{
+    while( spi_log_head != spi_log_tail )
+    {
+        const apps_spi_log_entry_t* entry = &spi_log_entries[spi_log_head & APPS_SPI_LOG_MASK];
+
+        // SPI <seq> <time us> <radio> <W|R> <BUSY wait ns> <transfer ns> <length> <bytes>
+        HAL_DBG_TRACE_PRINTF( "SPI %u %u %u %c %u %u %u ", entry->seq, entry->time_in_us, entry->radio,
+                              ( entry->is_read == true ) ? 'R' : 'W',
+                              apps_spi_log_cycles_to_ns( entry->busy_in_cycles ),
+                              apps_spi_log_cycles_to_ns( entry->transfer_in_cycles ), entry->length );
+        for( uint8_t i = 0; i < entry->n_bytes; i++ )
+        {
+            HAL_DBG_TRACE_PRINTF( "%02X", entry->bytes[i] );
+        }
+        HAL_DBG_TRACE_PRINTF( "\n" );
+        spi_log_head++;
+    }
+}
+
+void apps_spi_log_get_stats( apps_spi_log_stats_t* stats )
+{
+    *stats = spi_log_stats;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint8_t apps_spi_log_get_radio( const void* context )
+{
+    uint8_t radio;
+
+    for( radio = 0; radio < ( APPS_SPI_LOG_N_RADIOS - 1 ); radio++ )
+    {
+        if( spi_log_contexts[radio] == NULL )
+        {
+            spi_log_contexts[radio] = context;
+        }
+        if( spi_log_contexts[radio] == context )
+        {
+            break;
+        }
+    }
+    return radio;
+}
+
+static uint32_t apps_spi_log_cycles_to_ns( uint32_t cycles )
+{
+    return ( uint32_t )( ( ( uint64_t ) cycles * 1000000000 ) / SystemCoreClock );
+}
+
+#endif  // APPS_SPI_LOG == true
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,148 @@
+/*!
+ * @file      apps_spi_log.h
+ *
+ * @brief     Recorder of the SPI transactions sent to the radios, streamed out on the debug trace
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_SPI_LOG_H
+#define APPS_SPI_LOG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Record every sx126x_hal_write and sx126x_hal_read, see tools/spi_log.c for the decoder
+ *
+ * The functions below are only built when it is true.
+ */
+#ifndef APPS_SPI_LOG
+#define APPS_SPI_LOG false
+#endif
+
+/*!
+ * @brief Number of transactions waiting to be streamed out
+ *
+ * @warning Must be a power of two, the ring indexes are wrapped with a mask
+ */
+#ifndef APPS_SPI_LOG_N_RECORDS
+#define APPS_SPI_LOG_N_RECORDS 128
+#endif
+
+/*!
+ * @brief Number of bytes kept for each transaction, command first then data
+ */
+#ifndef APPS_SPI_LOG_MAX_BYTES
+#define APPS_SPI_LOG_MAX_BYTES 16
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Recorder counters
+ */
+typedef struct apps_spi_log_stats_s
+{
+    uint32_t recorded;  //!< Transactions recorded, including the dropped ones
+    uint32_t dropped;   //!< Transactions lost because the ring was full
+} apps_spi_log_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Empty the ring and clear the counters, the time base of apps_timer.h must be started
+ */
+void apps_spi_log_init( void );
+
+/*!
+ * @brief Record a transaction, called by sx126x_hal.c once NSS is released
+ *
+ * @remark When the ring is full, the transaction is dropped: the sequence number written out shows the gap
+ *
+ * @param [in] context         Radio context, the radios are numbered in the order they are first seen
+ * @param [in] is_read         true for sx126x_hal_read, the data bytes are then the ones read
+ * @param [in] command         Command bytes, the opcode first
+ * @param [in] command_length  Number of command bytes
+ * @param [in] data            Data bytes
+ * @param [in] data_length     Number of data bytes
+ * @param [in] start_cycles    CPU cycle count before waiting for BUSY
+ * @param [in] busy_end_cycles CPU cycle count once BUSY was low, the transfer starts
+ */
+void apps_spi_log_record( const void* context, bool is_read, const uint8_t* command, uint16_t command_length,
+                          const uint8_t* data, uint16_t data_length, uint32_t start_cycles, uint32_t busy_end_cycles );
+
+/*!
+ * @brief Write the recorded transactions out on the debug trace, one line each, and free their slots
+ *
+ * @remark Called from the main loop, never from sx126x_hal.c, so that the trace does not stretch the
+ * transactions. The line format is described in tools/README.md
+ */
+void apps_spi_log_flush( void );
+
+/*!
+ * @brief Get a copy of the recorder counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_spi_log_get_stats( apps_spi_log_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_SPI_LOG_H
+
+/* --- EOF ------------------------------------------------------------------ */
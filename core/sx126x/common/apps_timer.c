@@ -0,0 +1,369 @@
+/*!
+ * @file      apps_timer.c
+ *
+ * @brief     Monotonic 64-bit time base and virtual timers, built on the LPTIM which keeps counting in STOP2
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stddef.h>
+#include "apps_timer.h"
+#include "smtc_hal_mcu.h"
+#include "smtc_hal_mcu_timer.h"
+#include "smtc_hal_mcu_timer_stm32l4.h"
+#include "stm32l4xx_ll_cortex.h"
+#include "stm32l4xx_ll_pwr.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( APPS_TIMER_MAX_TIMERS >= APPS_TIMER_NOT_RUNNING )
+#error "APPS_TIMER_MAX_TIMERS must be lower than APPS_TIMER_NOT_RUNNING"
+#endif
+
+#define APPS_TIMER_TICKS_PER_S SMTC_HAL_MCU_TIMER_STM32L4_TICKS_PER_S
+
+#define APPS_TIMER_MS_TO_TICKS( ms ) ( ( ( uint64_t )( ms ) * APPS_TIMER_TICKS_PER_S ) / 1000 )
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static struct smtc_hal_mcu_timer_cfg_s timer_cfg = { .tim = LPTIM1 };
+
+static smtc_hal_mcu_timer_inst_t timer_inst = NULL;
+
+/*!
+ * @brief Running timers, as a binary min-heap on their deadline: the next one to expire is always first
+ */
+static apps_timer_t* timer_heap[APPS_TIMER_MAX_TIMERS];
+static uint8_t       timer_heap_size;
+
+static apps_timer_stats_t timer_stats;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Expiry of the hardware timer, it only wakes the MCU up: the callbacks run from @ref apps_timer_process
+ */
+static void apps_timer_on_alarm( void );
+
+/*!
+ * @brief Store a timer at a position of the heap and keep its index up to date
+ */
+static void apps_timer_heap_set( uint8_t index, apps_timer_t* timer );
+
+/*!
+ * @brief Move a timer towards the top of the heap while its deadline is earlier than its parent's
+ */
+static void apps_timer_heap_sift_up( uint8_t index );
+
+/*!
+ * @brief Move a timer towards the bottom of the heap while its deadline is later than one of its children's
+ */
+static void apps_timer_heap_sift_down( uint8_t index );
+
+/*!
+ * @brief Remove the timer at a position of the heap
+ */
+static void apps_timer_heap_remove( uint8_t index );
+
+/*!
+ * @brief Convert a number of ticks to milliseconds, rounded up so that a sleep never ends before the deadline
+ */
+static uint32_t apps_timer_ticks_to_ms_ceil( uint64_t ticks );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+void apps_timer_init( void )
+{
+    const smtc_hal_mcu_timer_cfg_app_t cfg_app = {
+        .expiry_func = apps_timer_on_alarm,
+    };
+
+    if( timer_inst == NULL )
+    {
+        smtc_hal_mcu_timer_init( &timer_cfg, &cfg_app, &timer_inst );
+    }
+
+    timer_heap_size = 0;
+    timer_stats     = ( apps_timer_stats_t ){ 0 };
+}
+
+uint64_t apps_timer_get_ticks( void )
+{
+    return smtc_hal_mcu_timer_stm32l4_get_ticks( timer_inst );
+}
+
+uint64_t apps_timer_get_time_in_us( void )
+{
+    return ( apps_timer_get_ticks( ) * 1000000 ) / APPS_TIMER_TICKS_PER_S;
+}
+
+uint64_t apps_timer_get_time_in_ms( void )
+{
+    return ( apps_timer_get_ticks( ) * 1000 ) / APPS_TIMER_TICKS_PER_S;
+}
+
+void apps_timer_create( apps_timer_t* timer, void ( *callback )( void* context ), void* context )
+{
+    timer->deadline_in_ticks = 0;
+    timer->callback          = callback;
+    timer->context           = context;
+    timer->heap_index        = APPS_TIMER_NOT_RUNNING;
+}
+
+bool apps_timer_start( apps_timer_t* timer, uint32_t timeout_in_ms )
+{
+    apps_timer_stop( timer );
+
+    if( timer_heap_size >= APPS_TIMER_MAX_TIMERS )
+    {
+        return false;
+    }
+
+    timer->deadline_in_ticks = apps_timer_get_ticks( ) + APPS_TIMER_MS_TO_TICKS( timeout_in_ms );
+
+    apps_timer_heap_set( timer_heap_size, timer );
+    timer_heap_size++;
+    apps_timer_heap_sift_up( timer->heap_index );
+
+    if( timer_heap_size > timer_stats.max_running )
+    {
+        timer_stats.max_running = timer_heap_size;
+    }
+
+    return true;
+}
+
+void apps_timer_stop( apps_timer_t* timer )
+{
+    if( timer->heap_index != APPS_TIMER_NOT_RUNNING )
+    {
+        apps_timer_heap_remove( timer->heap_index );
+    }
+}
+
+bool apps_timer_is_running( const apps_timer_t* timer )
+{
+    return timer->heap_index != APPS_TIMER_NOT_RUNNING;
+}
+
+uint8_t apps_timer_process( void )
+{
+    uint8_t n_expired = 0;
+
+    while( timer_heap_size > 0 )
+    {
+        apps_timer_t*  timer        = timer_heap[0];
+        const uint64_t now_in_ticks = apps_timer_get_ticks( );
+
+        if( timer->deadline_in_ticks > now_in_ticks )
+        {
+            break;
+        }
+
+        const uint32_t lateness_in_us =
+            ( uint32_t )( ( ( now_in_ticks - timer->deadline_in_ticks ) * 1000000 ) / APPS_TIMER_TICKS_PER_S );
+        if( lateness_in_us > timer_stats.max_lateness_in_us )
+        {
+            timer_stats.max_lateness_in_us = lateness_in_us;
+        }
+
+        // Out of the heap before the callback, which may start it again
+        apps_timer_heap_remove( 0 );
+        timer->callback( timer->context );
+        n_expired++;
+    }
+
+    return n_expired;
+}
+
+bool apps_timer_sleep( uint32_t max_sleep_in_ms, bool ( *has_pending_work )( void ) )
+{
+    __disable_irq( );
+
+    const uint64_t start_in_ticks = apps_timer_get_ticks( );
+    uint64_t       wake_in_ticks  = start_in_ticks + APPS_TIMER_MS_TO_TICKS( max_sleep_in_ms );
+
+    if( timer_heap_size > 0 )
+    {
+        if( timer_heap[0]->deadline_in_ticks < wake_in_ticks )
+        {
+            wake_in_ticks = timer_heap[0]->deadline_in_ticks;
+        }
+    }
+
+    if( ( wake_in_ticks <= start_in_ticks ) || ( ( has_pending_work != NULL ) && ( has_pending_work( ) == true ) ) )
+    {
+        __enable_irq( );
+        return false;
+    }
+
+    smtc_hal_mcu_timer_start( timer_inst, apps_timer_ticks_to_ms_ceil( wake_in_ticks - start_in_ticks ) );
+
+#if( APPS_TIMER_STOP2 == true )
+    LL_PWR_SetPowerMode( LL_PWR_MODE_STOP2 );
+    LL_LPM_EnableDeepSleep( );
+#endif
+
+    // With the interrupts masked, a pending interrupt still wakes the MCU up, it is served by __enable_irq
+    __DSB( );
+    __WFI( );
+
+#if( APPS_TIMER_STOP2 == true )
+    LL_LPM_EnableSleep( );
+    // The MCU wakes up from STOP2 on MSI, the PLL has to be started again
+    smtc_hal_mcu_init( );
+#endif
+
+    smtc_hal_mcu_timer_stop( timer_inst );
+
+    timer_stats.n_sleeps++;
+    timer_stats.sleep_time_in_us += ( ( apps_timer_get_ticks( ) - start_in_ticks ) * 1000000 ) / APPS_TIMER_TICKS_PER_S;
+
+    __enable_irq( );
+
+    return true;
+}
+
+void apps_timer_get_stats( apps_timer_stats_t* stats )
+{
+    *stats = timer_stats;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static void apps_timer_on_alarm( void )
+{
+}
+
+static void apps_timer_heap_set( uint8_t index, apps_timer_t* timer )
+{
+    timer_heap[index] = timer;
+    timer->heap_index = index;
+}
+
+static void apps_timer_heap_sift_up( uint8_t index )
+{
+    apps_timer_t* timer = timer_heap[index];
+
+    while( index > 0 )
+    {
+        const uint8_t parent = ( index - 1 ) / 2;
+
+        if( timer_heap[parent]->deadline_in_ticks <= timer->deadline_in_ticks )
+        {
+            break;
+        }
+        apps_timer_heap_set( index, timer_heap[parent] );
+        index = parent;
+    }
+    apps_timer_heap_set( index, timer );
+}
+
+static void apps_timer_heap_sift_down( uint8_t index )
+{
+    apps_timer_t* timer = timer_heap[index];
+
+    for( ;; )
+    {
+        uint8_t child = 2 * index + 1;
+
+        if( child >= timer_heap_size )
+        {
+            break;
+        }
+        if( ( ( child + 1 ) < timer_heap_size ) &&
+            ( timer_heap[child + 1]->deadline_in_ticks < timer_heap[child]->deadline_in_ticks ) )
+        {
+            child++;
+        }
+        if( timer->deadline_in_ticks <= timer_heap[child]->deadline_in_ticks )
+        {
+            break;
+        }
+        apps_timer_heap_set( index, timer_heap[child] );
+        index = child;
+    }
+    apps_timer_heap_set( index, timer );
+}
+
+static void apps_timer_heap_remove( uint8_t index )
+{
+    apps_timer_t* timer = timer_heap[index];
+
+    timer->heap_index = APPS_TIMER_NOT_RUNNING;
+    timer_heap_size--;
+
+    if( index < timer_heap_size )
+    {
+        apps_timer_t* last = timer_heap[timer_heap_size];
+
+        // The last timer fills the hole, then goes up or down to its place
+        apps_timer_heap_set( index, last );
+        apps_timer_heap_sift_up( index );
+        apps_timer_heap_sift_down( last->heap_index );
+    }
+}
+
+static uint32_t apps_timer_ticks_to_ms_ceil( uint64_t ticks )
+{
+    return ( uint32_t )( ( ticks * 1000 + APPS_TIMER_TICKS_PER_S - 1 ) / APPS_TIMER_TICKS_PER_S );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
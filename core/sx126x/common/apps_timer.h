@@ -0,0 +1,205 @@
+/*!
+ * @file      apps_timer.h
+ *
+ * @brief     Monotonic 64-bit time base and virtual timers, built on the LPTIM which keeps counting in STOP2
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef APPS_TIMER_H
+#define APPS_TIMER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Maximum number of virtual timers running at the same time
+ */
+#ifndef APPS_TIMER_MAX_TIMERS
+#define APPS_TIMER_MAX_TIMERS 16
+#endif
+
+/*!
+ * @brief Enter STOP2 instead of sleep while waiting for the next deadline
+ *
+ * @remark The LPTIM and the EXTI lines of the radios keep running in STOP2 but the clocks are restored on each
+ * wake-up, and the UART loses the characters received meanwhile
+ */
+#ifndef APPS_TIMER_STOP2
+#define APPS_TIMER_STOP2 false
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*!
+ * @brief Value of @ref apps_timer_t::heap_index while the timer is not running
+ */
+#define APPS_TIMER_NOT_RUNNING 0xFF
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Virtual timer, its storage is owned by the client
+ */
+typedef struct apps_timer_s
+{
+    uint64_t deadline_in_ticks;           //!< Time at which the callback is due
+    void ( *callback )( void* context );  //!< Called from @ref apps_timer_process once the deadline is reached
+    void*    context;                     //!< Given back to the callback
+    uint8_t  heap_index;                  //!< Position in the list of running timers
+} apps_timer_t;
+
+/*!
+ * @brief Timer and sleep counters
+ */
+typedef struct apps_timer_stats_s
+{
+    uint32_t n_sleeps;            //!< Times the MCU went to sleep
+    uint64_t sleep_time_in_us;    //!< Total time spent asleep, to the LPTIM tick
+    uint8_t  max_running;         //!< Highest number of timers running at the same time
+    uint32_t max_lateness_in_us;  //!< Longest delay between a deadline and its callback
+} apps_timer_stats_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Start the time base on LPTIM1 and clear the list of running timers
+ */
+void apps_timer_init( void );
+
+/*!
+ * @brief Get the time elapsed since @ref apps_timer_init, in ticks of the LPTIM
+ *
+ * @remark 64-bit and monotonic, it never wraps around and keeps counting in STOP2. Can be called from interrupts
+ */
+uint64_t apps_timer_get_ticks( void );
+
+/*!
+ * @brief Get the time elapsed since @ref apps_timer_init, in microseconds
+ *
+ * @remark The resolution is the LPTIM tick, 31.25 us
+ */
+uint64_t apps_timer_get_time_in_us( void );
+
+/*!
+ * @brief Get the time elapsed since @ref apps_timer_init, in milliseconds
+ */
+uint64_t apps_timer_get_time_in_ms( void );
+
+/*!
+ * @brief Bind a callback to a timer, the timer is not running
+ *
+ * @param [out] timer    Timer to initialise
+ * @param [in]  callback Function called once the timer expires
+ * @param [in]  context  Given back to the callback
+ */
+void apps_timer_create( apps_timer_t* timer, void ( *callback )( void* context ), void* context );
+
+/*!
+ * @brief Start a timer, it is restarted if already running
+ *
+ * @warning The timers are only meant to be handled from the main loop, as are their callbacks
+ *
+ * @param [in] timer         Timer created by @ref apps_timer_create
+ * @param [in] timeout_in_ms Delay before the callback is called
+ *
+ * @returns false if @ref APPS_TIMER_MAX_TIMERS timers are already running
+ */
+bool apps_timer_start( apps_timer_t* timer, uint32_t timeout_in_ms );
+
+/*!
+ * @brief Stop a timer, nothing is done if it is not running
+ */
+void apps_timer_stop( apps_timer_t* timer );
+
+/*!
+ * @brief Check whether a timer is waiting for its deadline
+ */
+bool apps_timer_is_running( const apps_timer_t* timer );
+
+/*!
+ * @brief Call the callbacks of the timers whose deadline is reached, in deadline order
+ *
+ * @remark A callback may start timers again, including its own
+ *
+ * @returns Number of callbacks called
+ */
+uint8_t apps_timer_process( void );
+
+/*!
+ * @brief Sleep until the next deadline, an interrupt or the maximum sleep time, whichever comes first
+ *
+ * @remark The work check and the sleep are done with the interrupts masked, so that an interrupt raised between
+ * both is not missed: it wakes the MCU up at once and is served on return
+ *
+ * @param [in] max_sleep_in_ms  Longest sleep when no timer is running
+ * @param [in] has_pending_work Returns true if the main loop has work to do, the MCU then does not sleep. Can be NULL
+ *
+ * @returns true if the MCU slept
+ */
+bool apps_timer_sleep( uint32_t max_sleep_in_ms, bool ( *has_pending_work )( void ) );
+
+/*!
+ * @brief Get a copy of the timer and sleep counters
+ *
+ * @param [out] stats Pointer to the structure to be filled
+ */
+void apps_timer_get_stats( apps_timer_stats_t* stats );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // APPS_TIMER_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -46,6 +46,14 @@
 #include "smtc_hal_mcu_spi.h"
 #include "smtc_hal_mcu_gpio.h"
 #include "stm32l4xx_ll_utils.h"
+#include "apps_spi_log.h"
+#if( APPS_SPI_LOG == true )
+#include "apps_common.h"
+#endif
+#include "apps_energy.h"
+#if( APPS_ENERGY == true )
+#include "apps_timer.h"
+#endif
 
 /*
  * -----------------------------------------------------------------------------
@@ -84,6 +92,9 @@ sx126x_hal_status_t sx126x_hal_reset( const void* context )
     smtc_hal_mcu_gpio_set_state( sx126x_context->reset.inst, SMTC_HAL_MCU_GPIO_STATE_LOW );
     LL_mDelay( 1 );
     smtc_hal_mcu_gpio_set_state( sx126x_context->reset.inst, SMTC_HAL_MCU_GPIO_STATE_HIGH );
+#if( APPS_ENERGY == true )
+    apps_energy_on_wakeup( context, apps_timer_get_time_in_us( ) );
+#endif
 
     return SX126X_HAL_STATUS_OK;
 }
@@ -92,9 +103,13 @@ sx126x_hal_status_t sx126x_hal_wakeup( const void* context )
 {
     const sx126x_hal_context_t* sx126x_context = ( const sx126x_hal_context_t* ) context;
 
+    // The falling edge wakes the chip up, BUSY goes low once it is ready (about 340 us from warm start)
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_LOW );
-    LL_mDelay( 1 );
+    sx126x_hal_wait_on_busy( sx126x_context );
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_HIGH );
+#if( APPS_ENERGY == true )
+    apps_energy_on_wakeup( context, apps_timer_get_time_in_us( ) );
+#endif
 
     return SX126X_HAL_STATUS_OK;
 }
@@ -104,13 +119,25 @@ sx126x_hal_status_t sx126x_hal_write( const void* context, const uint8_t* comman
 
 {
     const sx126x_hal_context_t* sx126x_context = ( const sx126x_hal_context_t* ) context;
+#if( APPS_SPI_LOG == true )
+    const uint32_t start_cycles = apps_common_get_cycle_count( );
+#endif
 
     sx126x_hal_wait_on_busy( sx126x_context );
+#if( APPS_SPI_LOG == true )
+    const uint32_t busy_end_cycles = apps_common_get_cycle_count( );
+#endif
 
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_LOW );
     smtc_hal_mcu_spi_rw_buffer( sx126x_context->spi.inst, command, NULL, command_length );
     smtc_hal_mcu_spi_rw_buffer( sx126x_context->spi.inst, data, NULL, data_length );
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_HIGH );
+#if( APPS_SPI_LOG == true )
+    apps_spi_log_record( context, false, command, command_length, data, data_length, start_cycles, busy_end_cycles );
+#endif
+#if( APPS_ENERGY == true )
+    apps_energy_on_command( context, command, command_length, apps_timer_get_time_in_us( ) );
+#endif
 
     return SX126X_HAL_STATUS_OK;
 }
@@ -119,13 +146,25 @@ sx126x_hal_status_t sx126x_hal_read( const void* context, const uint8_t* command
                                      uint8_t* data, const uint16_t data_length )
 {
     const sx126x_hal_context_t* sx126x_context = ( const sx126x_hal_context_t* ) context;
+#if( APPS_SPI_LOG == true )
+    const uint32_t start_cycles = apps_common_get_cycle_count( );
+#endif
 
     sx126x_hal_wait_on_busy( sx126x_context );
+#if( APPS_SPI_LOG == true )
+    const uint32_t busy_end_cycles = apps_common_get_cycle_count( );
+#endif
 
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_LOW );
     smtc_hal_mcu_spi_rw_buffer( sx126x_context->spi.inst, command, NULL, command_length );
     smtc_hal_mcu_spi_rw_buffer( sx126x_context->spi.inst, NULL, data, data_length );
     smtc_hal_mcu_gpio_set_state( sx126x_context->nss.inst, SMTC_HAL_MCU_GPIO_STATE_HIGH );
+#if( APPS_SPI_LOG == true )
+    apps_spi_log_record( context, true, command, command_length, data, data_length, start_cycles, busy_end_cycles );
+#endif
+#if( APPS_ENERGY == true )
+    apps_energy_on_command( context, command, command_length, apps_timer_get_time_in_us( ) );
+#endif
 
     return SX126X_HAL_STATUS_OK;
 }
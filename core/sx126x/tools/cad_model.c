@@ -0,0 +1,278 @@
+/*!
+ * @file      cad_model.c
+ *
+ * @brief     Host model of the LoRa CAD: preambles through a noisy channel, dechirp-and-FFT detector
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cad_model.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE CONSTANTS -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DECLARATION -------------------------------------------
+ */
+
+/*!
+ * @brief Draw a uniform number in ]0, 1]
+ */
+static float get_uniform( cad_model_t* model );
+
+/*!
+ * @brief Add the chirps of a preamble of another spreading factor to the window, at a random time and phase
+ */
+static void add_interferer( cad_model_t* model, const cad_model_channel_t* channel );
+
+/*!
+ * @brief Convert a power ratio to a metric, clamped to [0, CAD_MODEL_MAX_METRIC]
+ */
+static uint8_t get_metric( float ratio, float units_per_db );
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+bool cad_model_init( cad_model_t* model, uint8_t sf, uint8_t n_symbs, uint64_t seed )
+{
+    memset( model, 0, sizeof( cad_model_t ) );
+    model->sf      = sf;
+    model->n_symbs = n_symbs;
+    model->n       = ( uint32_t ) 1 << sf;
+    // xorshift does not leave the zero state
+    model->rng = ( seed != 0 ) ? seed : 1;
+
+    if( lora_dsp_fft_init( &model->fft, sf ) == false )
+    {
+        return false;
+    }
+    model->chirp_re = lora_dsp_alloc( model->n );
+    model->chirp_im = lora_dsp_alloc( model->n );
+    model->symb_re  = lora_dsp_alloc( model->n );
+    model->symb_im  = lora_dsp_alloc( model->n );
+    model->re       = lora_dsp_alloc( model->n * n_symbs );
+    model->im       = lora_dsp_alloc( model->n * n_symbs );
+    model->acc      = lora_dsp_alloc( model->n );
+    if( ( model->chirp_re == NULL ) || ( model->chirp_im == NULL ) || ( model->symb_re == NULL ) ||
+        ( model->symb_im == NULL ) || ( model->re == NULL ) || ( model->im == NULL ) || ( model->acc == NULL ) )
+    {
+        cad_model_deinit( model );
+        return false;
+    }
+    lora_dsp_make_upchirp( sf, model->chirp_re, model->chirp_im );
+    return true;
+}
+
+void cad_model_deinit( cad_model_t* model )
+{
+    lora_dsp_fft_deinit( &model->fft );
+    free( model->chirp_re );
+    free( model->chirp_im );
+    free( model->symb_re );
+    free( model->symb_im );
+    free( model->re );
+    free( model->im );
+    free( model->acc );
+    memset( model, 0, sizeof( cad_model_t ) );
+}
+
+void cad_model_synthesize( cad_model_t* model, const cad_model_channel_t* channel )
+{
+    const uint32_t n         = model->n;
+    const uint32_t n_samples = n * model->n_symbs;
+
+    if( channel->has_preamble == true )
+    {
+        const float  amplitude = sqrtf( powf( 10.0f, channel->snr_db / 10.0f ) );
+        const double offset    = ( double ) get_uniform( model ) * n;
+        const double phase     = 2.0 * M_PI * get_uniform( model );
+        const double cfo_in_hz = channel->cfo_max_in_hz * ( 2.0 * get_uniform( model ) - 1.0 );
+        const double step      = 2.0 * M_PI * cfo_in_hz / channel->bw_in_hz;
+
+        // The window starts anywhere in a symbol, and the preamble repeats the same symbol
+        for( uint32_t i = 0; i < n; i++ )
+        {
+            const double t = fmod( i + offset, ( double ) n );
+            const double p = M_PI * ( t * t / n - t ) + phase;
+
+            model->symb_re[i] = amplitude * ( float ) cos( p );
+            model->symb_im[i] = amplitude * ( float ) sin( p );
+        }
+
+        // The carrier offset turns the samples by a constant step, renormalised once per symbol
+        const double step_re = cos( step );
+        const double step_im = sin( step );
+        double       rot_re  = 1.0;
+        double       rot_im  = 0.0;
+        for( uint32_t i = 0; i < n_samples; i++ )
+        {
+            const uint32_t k = i & ( n - 1 );
+
+            if( k == 0 )
+            {
+                rot_re = cos( step * i );
+                rot_im = sin( step * i );
+            }
+            model->re[i] = ( float ) ( model->symb_re[k] * rot_re - model->symb_im[k] * rot_im );
+            model->im[i] = ( float ) ( model->symb_re[k] * rot_im + model->symb_im[k] * rot_re );
+
+            const double next_re = rot_re * step_re - rot_im * step_im;
+            rot_im               = rot_re * step_im + rot_im * step_re;
+            rot_re               = next_re;
+        }
+    }
+    else
+    {
+        memset( model->re, 0, n_samples * sizeof( float ) );
+        memset( model->im, 0, n_samples * sizeof( float ) );
+    }
+
+    if( channel->interferer_sf != 0 )
+    {
+        add_interferer( model, channel );
+    }
+
+    // Complex white noise of unit power, by pairs of Box-Muller draws
+    for( uint32_t i = 0; i < n_samples; i++ )
+    {
+        const float r     = sqrtf( -logf( get_uniform( model ) ) );
+        const float theta = 2.0f * ( float ) M_PI * get_uniform( model );
+
+        model->re[i] += r * cosf( theta );
+        model->im[i] += r * sinf( theta );
+    }
+}
+
+void cad_model_detect( cad_model_t* model, cad_model_metrics_t* metrics )
+{
+    const uint32_t n = model->n;
+
+    memset( model->acc, 0, n * sizeof( float ) );
+    for( uint8_t symb = 0; symb < model->n_symbs; symb++ )
+    {
+        float* re = &model->re[symb * n];
+        float* im = &model->im[symb * n];
+
+        lora_dsp_mul_conj( re, im, model->chirp_re, model->chirp_im, n );
+        lora_dsp_fft( &model->fft, re, im );
+        lora_dsp_add_power( model->acc, re, im, n );
+    }
+
+    float  peak = 0.0f;
+    double sum  = 0.0;
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        peak = ( model->acc[i] > peak ) ? model->acc[i] : peak;
+        sum += model->acc[i];
+    }
+
+    // A noise bin holds n per symbol, as the noise has a unit power
+    metrics->peak = get_metric( ( float ) ( peak * n / sum ), CAD_MODEL_PEAK_UNITS_PER_DB );
+    metrics->min  = get_metric( peak / ( ( float ) n * model->n_symbs ), 1.0f / CAD_MODEL_MIN_DB_PER_UNIT );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static float get_uniform( cad_model_t* model )
+{
+    // xorshift64*, the 24 upper bits fill the mantissa
+    model->rng ^= model->rng >> 12;
+    model->rng ^= model->rng << 25;
+    model->rng ^= model->rng >> 27;
+    return ( float ) ( ( ( model->rng * 2685821657736338717ULL ) >> 40 ) + 1 ) * ( 1.0f / 16777216.0f );
+}
+
+static void add_interferer( cad_model_t* model, const cad_model_channel_t* channel )
+{
+    const uint32_t n         = ( uint32_t ) 1 << channel->interferer_sf;
+    const uint32_t n_samples = model->n * model->n_symbs;
+    const float    amplitude = sqrtf( powf( 10.0f, channel->interferer_snr_db / 10.0f ) );
+    const double   offset    = ( double ) get_uniform( model ) * n;
+    const double   phase     = 2.0 * M_PI * get_uniform( model );
+    const double   cfo_in_hz = channel->cfo_max_in_hz * ( 2.0 * get_uniform( model ) - 1.0 );
+    const double   step      = 2.0 * M_PI * cfo_in_hz / channel->bw_in_hz;
+
+    for( uint32_t i = 0; i < n_samples; i++ )
+    {
+        const double t = fmod( i + offset, ( double ) n );
+        const double p = M_PI * ( t * t / n - t ) + phase + step * i;
+
+        model->re[i] += amplitude * ( float ) cos( p );
+        model->im[i] += amplitude * ( float ) sin( p );
+    }
+}
+
+static uint8_t get_metric( float ratio, float units_per_db )
+{
+    const float metric = ( ratio > 0.0f ) ? units_per_db * 10.0f * log10f( ratio ) : 0.0f;
+
+    if( metric <= 0.0f )
+    {
+        return 0;
+    }
+    if( metric >= CAD_MODEL_MAX_METRIC )
+    {
+        return CAD_MODEL_MAX_METRIC;
+    }
+    return ( uint8_t ) lrintf( metric );
+}
+
+/* --- EOF ------------------------------------------------------------------ */
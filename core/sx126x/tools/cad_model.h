@@ -0,0 +1,169 @@
+/*!
+ * @file      cad_model.h
+ *
+ * @brief     Host model of the LoRa CAD: preambles through a noisy channel, dechirp-and-FFT detector
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CAD_MODEL_H
+#define CAD_MODEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lora_dsp.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Step of the peak metric, in units per dB of peak-to-average ratio of the correlation
+ *
+ * Chosen so that the noise-only peaks of SF7 land near the default cad_detect_peak of the radio
+ */
+#define CAD_MODEL_PEAK_UNITS_PER_DB 3
+
+/*!
+ * @brief Step of the minimum metric, in dB of correlation peak above the noise, as asfs_cad_cal steps cad_detect_min
+ */
+#define CAD_MODEL_MIN_DB_PER_UNIT 2
+
+/*!
+ * @brief Highest value of both metrics, the higher ones are clamped
+ */
+#define CAD_MODEL_MAX_METRIC 63
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Channel the CAD listens to: a preamble or not, noise, carrier offset and a preamble of another SF
+ *
+ * @remark The noise power in the bandwidth is 1, the powers are given relative to it
+ */
+typedef struct cad_model_channel_s
+{
+    bool     has_preamble;       //!< false to measure the false detections
+    float    snr_db;             //!< Power of the preamble over the noise
+    uint32_t bw_in_hz;           //!< Bandwidth, one sample per chip
+    float    cfo_max_in_hz;      //!< Carrier offset of the transmitters, drawn uniformly in [-max, max]
+    uint8_t  interferer_sf;      //!< Spreading factor of an interfering preamble, 0 for none
+    float    interferer_snr_db;  //!< Power of the interfering preamble over the noise
+} cad_model_channel_t;
+
+/*!
+ * @brief Outcome of a CAD, to compare with cad_detect_peak and cad_detect_min
+ */
+typedef struct cad_model_metrics_s
+{
+    uint8_t peak;  //!< Peak-to-average ratio of the correlation, see @ref CAD_MODEL_PEAK_UNITS_PER_DB
+    uint8_t min;   //!< Correlation peak above the noise, see @ref CAD_MODEL_MIN_DB_PER_UNIT
+} cad_model_metrics_t;
+
+/*!
+ * @brief Buffers and random state of a CAD model, one per thread
+ */
+typedef struct cad_model_s
+{
+    uint8_t        sf;
+    uint8_t        n_symbs;   //!< Symbols of a CAD
+    uint32_t       n;         //!< Samples of a symbol
+    lora_dsp_fft_t fft;
+    float*         chirp_re;  //!< Base up-chirp
+    float*         chirp_im;
+    float*         symb_re;   //!< Preamble symbol as received, before the carrier offset and the noise
+    float*         symb_im;
+    float*         re;        //!< Samples of the CAD window, n_symbs symbols
+    float*         im;
+    float*         acc;       //!< Power of each bin, summed over the symbols
+    uint64_t       rng;
+} cad_model_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Allocate the buffers of a CAD model
+ *
+ * @param [out] model   Model to prepare
+ * @param [in]  sf      Spreading factor, SF5 to SF12
+ * @param [in]  n_symbs Symbols of a CAD: 1, 2, 4, 8 or 16
+ * @param [in]  seed    Seed of the random draws, one per thread
+ *
+ * @returns false when out of memory
+ */
+bool cad_model_init( cad_model_t* model, uint8_t sf, uint8_t n_symbs, uint64_t seed );
+
+/*!
+ * @brief Release the buffers of a CAD model
+ */
+void cad_model_deinit( cad_model_t* model );
+
+/*!
+ * @brief Draw the samples of a CAD window into the model buffers
+ *
+ * @remark The window starts at a random time of the preamble, with a random carrier offset and phase
+ */
+void cad_model_synthesize( cad_model_t* model, const cad_model_channel_t* channel );
+
+/*!
+ * @brief Run the detector on the samples of the model buffers, which are overwritten
+ *
+ * @remark Each symbol is dechirped and transformed, and the power of the bins is summed over the symbols
+ */
+void cad_model_detect( cad_model_t* model, cad_model_metrics_t* metrics );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // CAD_MODEL_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,533 @@
+/*!
+ * @file      cad_roc.c
+ *
+ * @brief     Detection and false-alarm curves of the CAD thresholds, from the host model of the CAD
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "cad_model.h"
+#include "lora_dsp.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Values taken by each metric
+ */
+#define ROC_N_METRICS ( CAD_MODEL_MAX_METRIC + 1 )
+
+/*!
+ * @brief Most signal-to-noise ratios swept per spreading factor
+ */
+#define ROC_MAX_SNRS 8
+
+/*!
+ * @brief Most threads sharing the trials
+ */
+#define ROC_MAX_THREADS 64
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef struct roc_config_s
+{
+    uint8_t     sf_first;
+    uint8_t     sf_last;
+    uint32_t    bw_in_hz;
+    uint8_t     n_symbs;  //!< Symbols of a CAD, 0 for the ones of optimize_cad_parameters
+    uint32_t    n_trials;  //!< Trials per point: without preamble, then at each SNR
+    float       snr_offsets_in_db[ROC_MAX_SNRS];  //!< SNRs, relative to the demodulation floor of each SF
+    uint8_t     n_snrs;
+    float       cfo_max_in_hz;
+    uint8_t     interferer_sf;
+    float       interferer_snr_db;
+    double      pfa_target;  //!< Highest rate of false detections of the thresholds proposed
+    uint8_t     n_threads;
+    const char* csv_path;
+    int         peak_offset;  //!< Offset from the peak metric of the model to cad_detect_peak
+    int         min_offset;   //!< Offset from the minimum metric of the model to cad_detect_min
+} roc_config_t;
+
+/*!
+ * @brief Trials of a CAD, counted by value of (peak, min)
+ */
+typedef struct roc_hist_s
+{
+    uint64_t counts[ROC_N_METRICS][ROC_N_METRICS];
+} roc_hist_t;
+
+/*!
+ * @brief Share of the trials of a spreading factor run by one thread
+ */
+typedef struct roc_job_s
+{
+    const roc_config_t* config;
+    uint8_t             sf;
+    uint8_t             n_symbs;
+    uint32_t            n_trials;
+    uint64_t            seed;
+    bool                failed;
+    roc_hist_t          noise;
+    roc_hist_t          signal[ROC_MAX_SNRS];
+} roc_job_t;
+
+/*!
+ * @brief Thresholds proposed for a spreading factor
+ */
+typedef struct roc_choice_s
+{
+    uint8_t det_peak;
+    uint8_t det_min;
+    uint8_t n_symbs;
+    double  pfa;
+    double  pd[ROC_MAX_SNRS];
+} roc_choice_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*!
+ * @brief Lowest SNR at which a packet is demodulated, SF5 to SF12 - in dB
+ */
+static const float roc_demod_floors_in_db[] = { -2.5f, -5.0f, -7.5f, -10.0f, -12.5f, -15.0f, -17.5f, -20.0f };
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static float get_snr_db( const roc_config_t* config, uint8_t sf, uint8_t snr )
+{
+    return roc_demod_floors_in_db[sf - 5] + config->snr_offsets_in_db[snr];
+}
+
+/*!
+ * @brief Symbols of a CAD as optimize_cad_parameters sets them at 125 kHz
+ */
+static uint8_t get_default_n_symbs( uint8_t sf )
+{
+    return ( sf <= 8 ) ? 2 : 4;
+}
+
+static double get_time_in_s( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void* run_job( void* arg )
+{
+    roc_job_t*          job    = arg;
+    const roc_config_t* config = job->config;
+    cad_model_t         model;
+    cad_model_metrics_t metrics;
+    cad_model_channel_t channel = {
+        .has_preamble      = false,
+        .bw_in_hz          = config->bw_in_hz,
+        .cfo_max_in_hz     = config->cfo_max_in_hz,
+        .interferer_sf     = config->interferer_sf,
+        .interferer_snr_db = config->interferer_snr_db,
+    };
+
+    if( cad_model_init( &model, job->sf, job->n_symbs, job->seed ) == false )
+    {
+        job->failed = true;
+        return NULL;
+    }
+    for( uint32_t i = 0; i < job->n_trials; i++ )
+    {
+        cad_model_synthesize( &model, &channel );
+        cad_model_detect( &model, &metrics );
+        job->noise.counts[metrics.peak][metrics.min]++;
+    }
+    channel.has_preamble = true;
+    for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+    {
+        channel.snr_db = get_snr_db( config, job->sf, snr );
+        for( uint32_t i = 0; i < job->n_trials; i++ )
+        {
+            cad_model_synthesize( &model, &channel );
+            cad_model_detect( &model, &metrics );
+            job->signal[snr].counts[metrics.peak][metrics.min]++;
+        }
+    }
+    cad_model_deinit( &model );
+    return NULL;
+}
+
+/*!
+ * @brief Turn the counts into the trials detected with each pair of thresholds, peak >= p and min >= m
+ */
+static void accumulate( roc_hist_t* hist )
+{
+    for( int p = ROC_N_METRICS - 1; p >= 0; p-- )
+    {
+        for( int m = ROC_N_METRICS - 1; m >= 0; m-- )
+        {
+            if( p < ( ROC_N_METRICS - 1 ) )
+            {
+                hist->counts[p][m] += hist->counts[p + 1][m];
+            }
+            if( m < ( ROC_N_METRICS - 1 ) )
+            {
+                hist->counts[p][m] += hist->counts[p][m + 1];
+            }
+            if( ( p < ( ROC_N_METRICS - 1 ) ) && ( m < ( ROC_N_METRICS - 1 ) ) )
+            {
+                hist->counts[p][m] -= hist->counts[p + 1][m + 1];
+            }
+        }
+    }
+}
+
+/*!
+ * @brief Pick the thresholds detecting the most preambles over the SNRs swept, within the false detection target
+ *
+ * @remark On a tie, the pair with the fewest false detections is kept
+ */
+static void choose( const roc_config_t* config, const roc_hist_t* noise, const roc_hist_t* signal, uint32_t n_trials,
+                    roc_choice_t* choice )
+{
+    double best_score = -1.0;
+
+    for( int p = 0; p < ROC_N_METRICS; p++ )
+    {
+        for( int m = 0; m < ROC_N_METRICS; m++ )
+        {
+            const double pfa   = ( double ) noise->counts[p][m] / n_trials;
+            double       score = 0.0;
+
+            if( pfa > config->pfa_target )
+            {
+                continue;
+            }
+            for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+            {
+                score += ( double ) signal[snr].counts[p][m] / n_trials;
+            }
+            if( ( score > best_score ) || ( ( score == best_score ) && ( pfa < choice->pfa ) ) )
+            {
+                best_score       = score;
+                choice->det_peak = ( uint8_t ) p;
+                choice->det_min  = ( uint8_t ) m;
+                choice->pfa      = pfa;
+                for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+                {
+                    choice->pd[snr] = ( double ) signal[snr].counts[p][m] / n_trials;
+                }
+            }
+        }
+    }
+}
+
+static void write_csv( FILE* csv, const roc_config_t* config, uint8_t sf, uint8_t n_symbs, const roc_hist_t* noise,
+                       const roc_hist_t* signal, uint32_t n_trials )
+{
+    for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+    {
+        for( int p = 0; p < ROC_N_METRICS; p++ )
+        {
+            for( int m = 0; m < ROC_N_METRICS; m++ )
+            {
+                fprintf( csv, "%u,%u,%.1f,%d,%d,%.6f,%.6f\n", sf, n_symbs, get_snr_db( config, sf, snr ),
+                         p + config->peak_offset, m + config->min_offset,
+                         ( double ) signal[snr].counts[p][m] / n_trials, ( double ) noise->counts[p][m] / n_trials );
+            }
+        }
+    }
+}
+
+/*!
+ * @brief Run the trials of a spreading factor on all the threads and propose its thresholds
+ *
+ * @returns false when out of memory
+ */
+static bool sweep_sf( const roc_config_t* config, uint8_t sf, FILE* csv, roc_choice_t* choice )
+{
+    const uint8_t n_symbs = ( config->n_symbs != 0 ) ? config->n_symbs : get_default_n_symbs( sf );
+    roc_job_t*    jobs    = calloc( config->n_threads, sizeof( roc_job_t ) );
+    pthread_t     threads[ROC_MAX_THREADS];
+    bool          failed = ( jobs == NULL );
+
+    if( failed == true )
+    {
+        return false;
+    }
+
+    const double start = get_time_in_s( );
+    for( uint8_t t = 0; t < config->n_threads; t++ )
+    {
+        jobs[t].config   = config;
+        jobs[t].sf       = sf;
+        jobs[t].n_symbs  = n_symbs;
+        jobs[t].n_trials = config->n_trials / config->n_threads;
+        jobs[t].n_trials += ( t < ( config->n_trials % config->n_threads ) ) ? 1 : 0;
+        // Each thread draws its own trials, the same ones from one run to the next
+        jobs[t].seed = ( ( uint64_t ) sf << 32 ) ^ ( ( t + 1ULL ) * 0x9E3779B97F4A7C15ULL );
+        if( pthread_create( &threads[t], NULL, run_job, &jobs[t] ) != 0 )
+        {
+            run_job( &jobs[t] );
+            threads[t] = pthread_self( );
+        }
+    }
+    for( uint8_t t = 0; t < config->n_threads; t++ )
+    {
+        if( pthread_equal( threads[t], pthread_self( ) ) == 0 )
+        {
+            pthread_join( threads[t], NULL );
+        }
+        failed = failed || jobs[t].failed;
+    }
+    const double elapsed_in_s = get_time_in_s( ) - start;
+
+    // The first job collects the counts of the others
+    for( uint8_t t = 1; t < config->n_threads; t++ )
+    {
+        for( int p = 0; p < ROC_N_METRICS; p++ )
+        {
+            for( int m = 0; m < ROC_N_METRICS; m++ )
+            {
+                jobs[0].noise.counts[p][m] += jobs[t].noise.counts[p][m];
+                for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+                {
+                    jobs[0].signal[snr].counts[p][m] += jobs[t].signal[snr].counts[p][m];
+                }
+            }
+        }
+    }
+    accumulate( &jobs[0].noise );
+    for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+    {
+        accumulate( &jobs[0].signal[snr] );
+    }
+
+    memset( choice, 0, sizeof( roc_choice_t ) );
+    choice->n_symbs = n_symbs;
+    choose( config, &jobs[0].noise, jobs[0].signal, config->n_trials, choice );
+    if( csv != NULL )
+    {
+        write_csv( csv, config, sf, n_symbs, &jobs[0].noise, jobs[0].signal, config->n_trials );
+    }
+
+    const double n_cads = ( double ) config->n_trials * ( config->n_snrs + 1 );
+    printf( "SF%u, %u symbols: %.0f CADs in %.2f s, %.0f CADs/s\n", sf, n_symbs, n_cads, elapsed_in_s,
+            n_cads / elapsed_in_s );
+    printf( "  cad_detect_peak %d, cad_detect_min %d: false detections %.2f %%\n",
+            choice->det_peak + config->peak_offset, choice->det_min + config->min_offset, 100.0 * choice->pfa );
+    for( uint8_t snr = 0; snr < config->n_snrs; snr++ )
+    {
+        printf( "    SNR %6.1f dB: detections %6.2f %%\n", get_snr_db( config, sf, snr ), 100.0 * choice->pd[snr] );
+    }
+
+    free( jobs );
+    return !failed;
+}
+
+static void print_cases( const roc_config_t* config, const roc_choice_t* choices )
+{
+    printf( "\nThresholds for optimize_cad_parameters, at %u kHz:\n", config->bw_in_hz / 1000 );
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        const roc_choice_t* choice = &choices[sf];
+
+        printf( "    case SX126X_LORA_SF%u:\n", sf );
+        printf( "        cad_params->cad_detect_min  = %d;\n", choice->det_min + config->min_offset );
+        printf( "        cad_params->cad_detect_peak = %d;\n", choice->det_peak + config->peak_offset );
+        printf( "        cad_params->cad_symb_nb     = SX126X_CAD_%02u_SYMB;\n", choice->n_symbs );
+        printf( "        break;\n" );
+    }
+}
+
+/*!
+ * @brief Parse a comma separated list of SNR offsets
+ */
+static bool parse_snrs( roc_config_t* config, const char* value )
+{
+    char* end;
+
+    config->n_snrs = 0;
+    do
+    {
+        if( config->n_snrs == ROC_MAX_SNRS )
+        {
+            return false;
+        }
+        config->snr_offsets_in_db[config->n_snrs++] = strtof( value, &end );
+        if( end == value )
+        {
+            return false;
+        }
+        value = end + 1;
+    } while( *end == ',' );
+    return *end == '\0';
+}
+
+static void print_usage( const char* name )
+{
+    fprintf( stderr, "usage: %s [-s first_sf] [-S last_sf] [-b bw_khz] [-n cad_symbols] [-t trials] [-r snr_offsets]\n",
+             name );
+    fprintf( stderr, "          [-c cfo_max_hz] [-i interferer_sf] [-I interferer_snr_db] [-f false_detections]\n" );
+    fprintf( stderr, "          [-j threads] [-o roc.csv] [-P peak_offset] [-M min_offset]\n" );
+    fprintf( stderr, "  snr_offsets are comma separated, in dB from the demodulation floor of each SF, e.g. -3,0,3\n" );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( int argc, char** argv )
+{
+    roc_config_t config = {
+        .sf_first          = 7,
+        .sf_last           = 12,
+        .bw_in_hz          = 125000,
+        .n_symbs           = 0,
+        .n_trials          = 20000,
+        .snr_offsets_in_db = { -3.0f, 0.0f, 3.0f },
+        .n_snrs            = 3,
+        .cfo_max_in_hz     = 0.0f,
+        .interferer_sf     = 0,
+        .interferer_snr_db = 0.0f,
+        .pfa_target        = 0.01,
+        .n_threads         = 1,
+        .csv_path          = NULL,
+        .peak_offset       = 0,
+        .min_offset        = 0,
+    };
+    roc_choice_t choices[13];
+
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* value = ( ( i + 1 ) < argc ) ? argv[i + 1] : NULL;
+
+        if( ( argv[i][0] != '-' ) || ( argv[i][1] == '\0' ) || ( argv[i][2] != '\0' ) || ( value == NULL ) )
+        {
+            print_usage( argv[0] );
+            return 2;
+        }
+        i++;
+        switch( argv[i - 1][1] )
+        {
+        case 's': config.sf_first = ( uint8_t ) atoi( value ); break;
+        case 'S': config.sf_last = ( uint8_t ) atoi( value ); break;
+        case 'b': config.bw_in_hz = ( uint32_t ) atoi( value ) * 1000; break;
+        case 'n': config.n_symbs = ( uint8_t ) atoi( value ); break;
+        case 't': config.n_trials = ( uint32_t ) atoi( value ); break;
+        case 'r':
+            if( parse_snrs( &config, value ) == false )
+            {
+                print_usage( argv[0] );
+                return 2;
+            }
+            break;
+        case 'c': config.cfo_max_in_hz = strtof( value, NULL ); break;
+        case 'i': config.interferer_sf = ( uint8_t ) atoi( value ); break;
+        case 'I': config.interferer_snr_db = strtof( value, NULL ); break;
+        case 'f': config.pfa_target = strtod( value, NULL ); break;
+        case 'j': config.n_threads = ( uint8_t ) atoi( value ); break;
+        case 'o': config.csv_path = value; break;
+        case 'P': config.peak_offset = atoi( value ); break;
+        case 'M': config.min_offset = atoi( value ); break;
+        default:
+            print_usage( argv[0] );
+            return 2;
+        }
+    }
+    if( ( config.sf_first < 5 ) || ( config.sf_last > 12 ) || ( config.sf_first > config.sf_last ) ||
+        ( config.bw_in_hz == 0 ) || ( config.n_trials == 0 ) || ( config.n_threads == 0 ) ||
+        ( config.n_threads > ROC_MAX_THREADS ) ||
+        ( ( config.n_symbs > 16 ) || ( ( config.n_symbs & ( config.n_symbs - 1 ) ) != 0 ) ) ||
+        ( ( config.interferer_sf != 0 ) && ( ( config.interferer_sf < 5 ) || ( config.interferer_sf > 12 ) ) ) )
+    {
+        print_usage( argv[0] );
+        return 2;
+    }
+
+    FILE* csv = NULL;
+    if( config.csv_path != NULL )
+    {
+        csv = fopen( config.csv_path, "w" );
+        if( csv == NULL )
+        {
+            perror( config.csv_path );
+            return 1;
+        }
+        fprintf( csv, "sf,symbols,snr_db,det_peak,det_min,pd,pfa\n" );
+    }
+
+    printf( "CAD model: %u kHz, CFO up to %.0f Hz, %u threads, %s kernels\n", config.bw_in_hz / 1000,
+            config.cfo_max_in_hz, config.n_threads, lora_dsp_get_kernels( ) );
+    if( config.interferer_sf != 0 )
+    {
+        printf( "Interferer: SF%u at %.1f dB\n", config.interferer_sf, config.interferer_snr_db );
+    }
+    for( uint8_t sf = config.sf_first; sf <= config.sf_last; sf++ )
+    {
+        if( sweep_sf( &config, sf, csv, &choices[sf] ) == false )
+        {
+            fprintf( stderr, "out of memory\n" );
+            return 1;
+        }
+    }
+    print_cases( &config, choices );
+
+    if( csv != NULL )
+    {
+        fclose( csv );
+    }
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
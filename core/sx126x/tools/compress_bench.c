@@ -0,0 +1,330 @@
+/*!
+ * @file      compress_bench.c
+ *
+ * @brief     Host benchmark of the payload codecs: compression ratio and time per byte over payload corpora
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "apps_compress.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Highest number of payloads in a corpus
+ */
+#ifndef COMPRESS_BENCH_MAX_PAYLOADS
+#define COMPRESS_BENCH_MAX_PAYLOADS 4096
+#endif
+
+/*!
+ * @brief Number of bytes compressed, then decompressed, for each timing
+ */
+#ifndef COMPRESS_BENCH_N_BYTES
+#define COMPRESS_BENCH_N_BYTES 20000000
+#endif
+
+/*!
+ * @brief Size of the payloads of the built-in corpora, the body of a 64-byte frame behind its 3-byte header
+ */
+#define COMPRESS_BENCH_PAYLOAD_SIZE 61
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef struct corpus_s
+{
+    const char* name;
+    uint16_t    n_payloads;
+    uint8_t     sizes[COMPRESS_BENCH_MAX_PAYLOADS];
+    uint8_t     payloads[COMPRESS_BENCH_MAX_PAYLOADS][255];
+} corpus_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static corpus_t corpus;
+
+/*!
+ * @brief Sink of the output sizes, so that the compiler keeps the calls
+ */
+static volatile uint32_t sink;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static double get_time_in_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double ) ts.tv_sec * 1e9 + ( double ) ts.tv_nsec;
+}
+
+static void put_u16( uint8_t* p, uint16_t value )
+{
+    p[0] = ( uint8_t )( value >> 8 );
+    p[1] = ( uint8_t )( value & 0xFF );
+}
+
+static void put_u32( uint8_t* p, uint32_t value )
+{
+    put_u16( p, ( uint16_t )( value >> 16 ) );
+    put_u16( p + 2, ( uint16_t )( value & 0xFFFF ) );
+}
+
+/*!
+ * @brief Frames of the application, as packed by asfs_agg: a beacon then telemetry messages, each behind its length
+ */
+static void make_telemetry_corpus( void )
+{
+    uint16_t seq      = 0;
+    uint16_t packets  = 0;
+    uint32_t cad_done = 123456;
+
+    corpus.name = "telemetry (built-in)";
+    for( corpus.n_payloads = 0; corpus.n_payloads < 1000; corpus.n_payloads++ )
+    {
+        uint8_t* p    = corpus.payloads[corpus.n_payloads];
+        uint8_t  size = 0;
+
+        p[size++] = 2;
+        put_u16( &p[size], seq++ );
+        size += 2;
+        while( ( size + 7 ) <= COMPRESS_BENCH_PAYLOAD_SIZE )
+        {
+            packets += ( uint16_t )( rand( ) % 3 );
+            cad_done += 1400 + ( uint32_t ) rand( ) % 50;
+            p[size++] = 6;
+            put_u16( &p[size], packets );
+            put_u32( &p[size + 2], cad_done );
+            size += 6;
+        }
+        corpus.sizes[corpus.n_payloads] = size;
+    }
+}
+
+/*!
+ * @brief Payloads of random bytes, the worst case of every codec
+ */
+static void make_random_corpus( void )
+{
+    corpus.name = "random (built-in)";
+    for( corpus.n_payloads = 0; corpus.n_payloads < 1000; corpus.n_payloads++ )
+    {
+        for( uint8_t i = 0; i < COMPRESS_BENCH_PAYLOAD_SIZE; i++ )
+        {
+            corpus.payloads[corpus.n_payloads][i] = ( uint8_t ) rand( );
+        }
+        corpus.sizes[corpus.n_payloads] = COMPRESS_BENCH_PAYLOAD_SIZE;
+    }
+}
+
+/*!
+ * @brief Read a corpus file, one payload per line written in hexadecimal, the lines starting with # are skipped
+ *
+ * @returns false if the file cannot be read or holds no payload
+ */
+static bool load_corpus( const char* path )
+{
+    FILE* file = fopen( path, "r" );
+    char  line[1024];
+
+    if( file == NULL )
+    {
+        perror( path );
+        return false;
+    }
+    corpus.name       = path;
+    corpus.n_payloads = 0;
+    while( ( corpus.n_payloads < COMPRESS_BENCH_MAX_PAYLOADS ) && ( fgets( line, sizeof( line ), file ) != NULL ) )
+    {
+        uint8_t* p    = corpus.payloads[corpus.n_payloads];
+        uint16_t size = 0;
+        unsigned byte;
+
+        if( line[0] == '#' )
+        {
+            continue;
+        }
+        for( const char* c = line; ( size < 255 ) && ( sscanf( c, "%2x", &byte ) == 1 ); c += 2 )
+        {
+            p[size++] = ( uint8_t ) byte;
+        }
+        if( size != 0 )
+        {
+            corpus.sizes[corpus.n_payloads++] = ( uint8_t ) size;
+        }
+    }
+    fclose( file );
+    return corpus.n_payloads != 0;
+}
+
+/*!
+ * @brief Compress the corpus with a codec, check the round trip and time both ways
+ */
+static void run_codec( const apps_compress_codec_t* codec )
+{
+    static uint8_t packed[COMPRESS_BENCH_MAX_PAYLOADS][255];
+    static uint8_t packed_sizes[COMPRESS_BENCH_MAX_PAYLOADS];
+    uint8_t        plain[255];
+    uint8_t        scratch[255];
+    uint32_t       in_bytes   = 0;
+    uint32_t       sent_bytes = 0;
+    uint32_t       n_smaller  = 0;
+    uint32_t       n_errors   = 0;
+
+    // Ratio and round trip, a payload which does not shrink is sent as is
+    for( uint16_t i = 0; i < corpus.n_payloads; i++ )
+    {
+        const uint8_t size = corpus.sizes[i];
+
+        packed_sizes[i] = codec->compress( corpus.payloads[i], size, packed[i], size - 1 );
+        in_bytes += size;
+        if( packed_sizes[i] == 0 )
+        {
+            sent_bytes += size;
+            continue;
+        }
+        n_smaller++;
+        sent_bytes += packed_sizes[i];
+        if( ( codec->decompress( packed[i], packed_sizes[i], plain, sizeof( plain ) ) != size ) ||
+            ( memcmp( plain, corpus.payloads[i], size ) != 0 ) )
+        {
+            n_errors++;
+        }
+    }
+
+    // Times, the whole corpus again and again
+    const uint32_t n_rounds = COMPRESS_BENCH_N_BYTES / in_bytes + 1;
+    uint64_t       n_bytes  = 0;
+    double         start    = get_time_in_ns( );
+
+    for( uint32_t round = 0; round < n_rounds; round++ )
+    {
+        for( uint16_t i = 0; i < corpus.n_payloads; i++ )
+        {
+            sink += codec->compress( corpus.payloads[i], corpus.sizes[i], scratch, sizeof( scratch ) );
+        }
+    }
+
+    const double compress_in_ns = ( get_time_in_ns( ) - start ) / ( ( double ) n_rounds * in_bytes );
+
+    // Only the payloads which shrank are decompressed, the time is per byte restored
+    start = get_time_in_ns( );
+    for( uint32_t round = 0; round < n_rounds; round++ )
+    {
+        for( uint16_t i = 0; i < corpus.n_payloads; i++ )
+        {
+            if( packed_sizes[i] != 0 )
+            {
+                n_bytes += codec->decompress( packed[i], packed_sizes[i], plain, sizeof( plain ) );
+            }
+        }
+    }
+
+    const double decompress_in_ns = ( n_bytes != 0 ) ? ( get_time_in_ns( ) - start ) / ( double ) n_bytes : 0;
+
+    printf( "  %-9s ratio %.3f (%5.1f %% of the bytes sent), %u/%u payloads smaller, %u round-trip errors\n",
+            codec->name, ( double ) in_bytes / sent_bytes, 100.0 * sent_bytes / in_bytes, n_smaller, corpus.n_payloads,
+            n_errors );
+    printf( "  %-9s %.4f us/byte compressing, %.4f us/byte decompressing\n", "", compress_in_ns / 1000,
+            decompress_in_ns / 1000 );
+}
+
+static void run_corpus( void )
+{
+    uint32_t in_bytes = 0;
+
+    for( uint16_t i = 0; i < corpus.n_payloads; i++ )
+    {
+        in_bytes += corpus.sizes[i];
+    }
+    printf( "%s: %u payloads, %.1f bytes on average\n", corpus.name, corpus.n_payloads,
+            ( double ) in_bytes / corpus.n_payloads );
+    for( uint8_t id = 0; id < APPS_COMPRESS_N_CODECS; id++ )
+    {
+        const apps_compress_codec_t* codec = apps_compress_get_codec( id );
+
+        if( codec != NULL )
+        {
+            run_codec( codec );
+        }
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( int argc, char** argv )
+{
+    if( argc == 1 )
+    {
+        srand( 1 );
+        make_telemetry_corpus( );
+        run_corpus( );
+        make_random_corpus( );
+        run_corpus( );
+        return 0;
+    }
+    for( int i = 1; i < argc; i++ )
+    {
+        if( load_corpus( argv[i] ) == true )
+        {
+            run_corpus( );
+        }
+    }
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
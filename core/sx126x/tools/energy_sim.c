@@ -0,0 +1,475 @@
+/*!
+ * @file      energy_sim.c
+ *
+ * @brief     Host simulation of the charge drawn by an ASFS scan, from the energy accounting of apps_energy
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "apps_energy.h"
+#include "smtc_shield_sx126x.h"
+#include "smtc_shield_sx1261mb1bas.h"
+#include "smtc_shield_sx1261mb1cas.h"
+#include "smtc_shield_sx1261mb2bas.h"
+#include "smtc_shield_sx1262mb1cas.h"
+#include "smtc_shield_sx1262mb1cbs.h"
+#include "smtc_shield_sx1262mb1das.h"
+#include "smtc_shield_sx1262mb1pas.h"
+#include "smtc_shield_sx1262mb2cas.h"
+#include "smtc_shield_sx1268mb1gas.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Time for a radio to leave warm-start sleep and take the parameters changed meanwhile - in microseconds
+ */
+#define SIM_WAKE_US 340
+
+/*!
+ * @brief Shortest wait for which a radio is put to sleep, see ASFS_WARM_SLEEP_MIN_MS
+ */
+#define SIM_WARM_SLEEP_MIN_MS 5
+
+/*!
+ * @brief Time the MCU runs to start a CAD and to serve its interrupt - in microseconds
+ */
+#define SIM_MCU_PER_CAD_US 150
+
+/*!
+ * @brief Time the MCU runs to read, check and forward a packet - in microseconds
+ */
+#define SIM_MCU_PER_PACKET_US 2000
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef struct sim_shield_s
+{
+    const char*          name;
+    smtc_shield_sx126x_t shield;
+} sim_shield_t;
+
+typedef struct sim_config_s
+{
+    sim_shield_t*       shield;
+    uint8_t             sf_first;
+    uint8_t             sf_last;
+    uint32_t            bw_in_hz;
+    uint8_t             cad_symb;  //!< Symbols of a CAD: 1, 2, 4, 8 or 16
+    uint32_t            delay_in_ms;
+    bool                warm_sleep;
+    uint32_t            packets_per_hour;
+    uint8_t             payload_length;
+    uint16_t            preamble_length;
+    uint32_t            hours;
+    uint8_t             n_radios;
+    int8_t              tx_power_in_dbm;
+} sim_config_t;
+
+/*!
+ * @brief Packets sent on one spreading factor, by increasing time of arrival
+ */
+typedef struct sim_sf_packets_s
+{
+    uint64_t* arrivals_in_us;
+    uint32_t  count;
+    uint32_t  next;  //!< First packet not received nor missed yet
+} sim_sf_packets_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static sim_shield_t sim_shields[] = {
+    { "sx1261mb1bas", SMTC_SHIELD_SX1261MB1BAS_INSTANTIATE }, { "sx1261mb1cas", SMTC_SHIELD_SX1261MB1CAS_INSTANTIATE },
+    { "sx1261mb2bas", SMTC_SHIELD_SX1261MB2BAS_INSTANTIATE }, { "sx1262mb1cas", SMTC_SHIELD_SX1262MB1CAS_INSTANTIATE },
+    { "sx1262mb1cbs", SMTC_SHIELD_SX1262MB1CBS_INSTANTIATE }, { "sx1262mb1das", SMTC_SHIELD_SX1262MB1DAS_INSTANTIATE },
+    { "sx1262mb1pas", SMTC_SHIELD_SX1262MB1PAS_INSTANTIATE }, { "sx1262mb2cas", SMTC_SHIELD_SX1262MB2CAS_INSTANTIATE },
+    { "sx1268mb1gas", SMTC_SHIELD_SX1268MB1GAS_INSTANTIATE },
+};
+
+static sim_sf_packets_t sim_packets[13];
+
+/*!
+ * @brief Radio contexts, only their addresses matter to apps_energy
+ */
+static uint8_t sim_contexts[APPS_ENERGY_N_RADIOS];
+
+static uint64_t sim_mcu_run_in_us;
+static uint32_t sim_n_received;
+static uint32_t sim_n_missed;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint32_t get_symb_time_in_us( const sim_config_t* config, uint8_t sf )
+{
+    return ( uint32_t )( ( ( uint64_t ) 1000000 << sf ) / config->bw_in_hz );
+}
+
+/*!
+ * @brief Time on air of a frame, explicit header, CRC on and coding rate 4/5
+ */
+static uint32_t get_time_on_air_in_us( const sim_config_t* config, uint8_t sf )
+{
+    const bool    ldro    = ( get_symb_time_in_us( config, sf ) >= 16000 );
+    const int32_t num     = 8 * config->payload_length - 4 * sf + 28 + 16;
+    const int32_t den     = 4 * ( sf - ( ldro ? 2 : 0 ) );
+    int32_t       n_symbs = 8;
+
+    if( num > 0 )
+    {
+        n_symbs += ( ( num + den - 1 ) / den ) * 5;
+    }
+    // The preamble lasts 4.25 symbols more than its length
+    const uint32_t n_quarter_symbs = 4 * ( config->preamble_length + n_symbs ) + 17;
+
+    return ( uint32_t )( ( ( uint64_t ) get_symb_time_in_us( config, sf ) * n_quarter_symbs ) / 4 );
+}
+
+static uint32_t get_cad_time_in_us( const sim_config_t* config, uint8_t sf )
+{
+    return get_symb_time_in_us( config, sf ) * ( config->cad_symb + 1 );
+}
+
+/*!
+ * @brief Get the last spreading factor swept by a radio, the CAD time is split as asfs_radio_assign_sf_ranges does
+ */
+static uint8_t get_sf_last( const sim_config_t* config, uint8_t radio, uint8_t sf_first )
+{
+    const uint8_t sf_max         = config->sf_last - ( config->n_radios - 1 - radio );
+    uint32_t      remaining_cost = 0;
+    uint32_t      sweep_cost     = get_cad_time_in_us( config, sf_first );
+    uint8_t       sf             = sf_first;
+
+    for( uint8_t i = sf_first; i <= config->sf_last; i++ )
+    {
+        remaining_cost += get_cad_time_in_us( config, i );
+    }
+
+    const uint32_t target = remaining_cost / ( config->n_radios - radio );
+
+    // Take one more SF as long as it brings the sweep closer to the target, the last radio takes them all
+    while( sf < sf_max )
+    {
+        const uint32_t next_cost = get_cad_time_in_us( config, sf + 1 );
+
+        if( ( radio != ( config->n_radios - 1 ) ) && ( ( sweep_cost + next_cost / 2 ) > target ) )
+        {
+            break;
+        }
+        sweep_cost += next_cost;
+        sf++;
+    }
+    return sf;
+}
+
+static uint64_t get_random( uint64_t* state )
+{
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return *state >> 33;
+}
+
+static int compare_arrivals( const void* a, const void* b )
+{
+    const uint64_t x = *( const uint64_t* ) a;
+    const uint64_t y = *( const uint64_t* ) b;
+
+    return ( x > y ) - ( x < y );
+}
+
+/*!
+ * @brief Draw the packets sent during the simulation, at uniform times and on uniform spreading factors
+ */
+static void draw_packets( const sim_config_t* config, uint64_t end_in_us )
+{
+    const uint32_t n_packets = config->packets_per_hour * config->hours;
+    uint64_t       state     = 1;
+
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        sim_packets[sf].arrivals_in_us = malloc( ( n_packets + 1 ) * sizeof( uint64_t ) );
+    }
+    for( uint32_t i = 0; i < n_packets; i++ )
+    {
+        const uint8_t sf = config->sf_first + get_random( &state ) % ( config->sf_last - config->sf_first + 1 );
+        const uint64_t at = get_random( &state ) % end_in_us;
+
+        sim_packets[sf].arrivals_in_us[sim_packets[sf].count++] = at;
+    }
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        qsort( sim_packets[sf].arrivals_in_us, sim_packets[sf].count, sizeof( uint64_t ), compare_arrivals );
+    }
+}
+
+static void send_command( uint8_t radio, const uint8_t* command, uint16_t length, uint64_t now_in_us )
+{
+    apps_energy_on_command( &sim_contexts[radio], command, length, now_in_us );
+}
+
+/*!
+ * @brief Sweep the spreading factors of a radio until the end of the simulation, as the ASFS main loop does
+ *
+ * @remark A packet is caught by the first CAD started on its spreading factor after it was sent, the preamble being
+ * sized for the sweep. The radio then receives the whole frame, which overestimates the RX time by the preamble
+ * already elapsed. The packets sent meanwhile on the same spreading factor are missed
+ */
+static void sweep_radio( const sim_config_t* config, uint8_t radio, uint8_t sf_first, uint8_t sf_last,
+                         uint64_t end_in_us )
+{
+    const uint8_t fallback[]   = { 0x93, SX126X_FALLBACK_STDBY_RC };
+    const uint8_t cad_params[] = { 0x88, 0, 0, 0, SX126X_CAD_RX, 0, 0, 0 };
+    const uint8_t set_cad[]    = { 0xC5 };
+    const uint8_t sleep_warm[] = { 0x84, SX126X_SLEEP_CFG_WARM_START };
+    uint64_t      now_in_us    = 0;
+    bool          is_asleep    = false;
+    uint8_t       sf           = sf_first;
+
+    apps_energy_on_wakeup( &sim_contexts[radio], now_in_us );
+    send_command( radio, fallback, sizeof( fallback ), now_in_us );
+    send_command( radio, cad_params, sizeof( cad_params ), now_in_us );
+
+    while( now_in_us < end_in_us )
+    {
+        sim_sf_packets_t* packets = &sim_packets[sf];
+
+        if( is_asleep == true )
+        {
+            apps_energy_on_wakeup( &sim_contexts[radio], now_in_us );
+            now_in_us += SIM_WAKE_US;
+            is_asleep = false;
+        }
+        send_command( radio, set_cad, sizeof( set_cad ), now_in_us );
+        sim_mcu_run_in_us += SIM_MCU_PER_CAD_US;
+        now_in_us += get_cad_time_in_us( config, sf );
+
+        if( ( packets->next < packets->count ) && ( packets->arrivals_in_us[packets->next] <= now_in_us ) )
+        {
+            apps_energy_on_irq( &sim_contexts[radio], SX126X_IRQ_CAD_DONE | SX126X_IRQ_CAD_DETECTED, now_in_us );
+            now_in_us += get_time_on_air_in_us( config, sf );
+            apps_energy_on_irq( &sim_contexts[radio], SX126X_IRQ_RX_DONE, now_in_us );
+            sim_mcu_run_in_us += SIM_MCU_PER_PACKET_US;
+            sim_n_received++;
+            packets->next++;
+            while( ( packets->next < packets->count ) && ( packets->arrivals_in_us[packets->next] <= now_in_us ) )
+            {
+                sim_n_missed++;
+                packets->next++;
+            }
+        }
+        else
+        {
+            apps_energy_on_irq( &sim_contexts[radio], SX126X_IRQ_CAD_DONE, now_in_us );
+        }
+
+        if( ( config->warm_sleep == true ) && ( config->delay_in_ms >= SIM_WARM_SLEEP_MIN_MS ) )
+        {
+            send_command( radio, sleep_warm, sizeof( sleep_warm ), now_in_us );
+            is_asleep = true;
+        }
+        now_in_us += ( uint64_t ) config->delay_in_ms * 1000;
+        sf = ( sf == sf_last ) ? sf_first : sf + 1;
+    }
+}
+
+static void print_report( const sim_config_t* config, uint64_t end_in_us )
+{
+    apps_energy_report_t report;
+
+    // The radios run side by side, the MCU serves all of them
+    const uint64_t mcu_sleep_in_us = ( sim_mcu_run_in_us < end_in_us ) ? ( end_in_us - sim_mcu_run_in_us ) : 0;
+
+    apps_energy_get_report( end_in_us, mcu_sleep_in_us, sim_n_received, &report );
+
+    const uint64_t total_in_pc = report.radio_charge_in_pc + report.mcu_charge_in_pc;
+
+    printf( "Shield %s, SF%u to SF%u on %u radios, %u kHz, %u CAD symbols, %u ms between CADs, warm sleep %s\n",
+            config->shield->name, config->sf_first, config->sf_last, config->n_radios, config->bw_in_hz / 1000,
+            config->cad_symb, config->delay_in_ms, ( config->warm_sleep == true ) ? "on" : "off" );
+    printf( "%u h simulated, %u packets of %u bytes sent, %u received, %u missed\n", config->hours,
+            config->packets_per_hour * config->hours, config->payload_length, sim_n_received, sim_n_missed );
+    printf( "%u.%03u uAh per hour, %u.%03u uAh per packet received\n", report.avg_current_in_na / 1000,
+            report.avg_current_in_na % 1000, report.charge_per_packet_in_nah / 1000,
+            report.charge_per_packet_in_nah % 1000 );
+    printf( "%-14s %12s %12s %7s\n", "mode", "time (ms)", "charge (uC)", "share" );
+    for( uint8_t mode = 0; mode < APPS_ENERGY_N_MODES; mode++ )
+    {
+        if( report.mode_time_in_us[mode] != 0 )
+        {
+            printf( "%-14s %12llu %12llu %6.1f%%\n", apps_energy_mode_to_str( ( apps_energy_mode_t ) mode ),
+                    ( unsigned long long ) ( report.mode_time_in_us[mode] / 1000 ),
+                    ( unsigned long long ) ( report.mode_charge_in_pc[mode] / 1000000 ),
+                    100.0 * report.mode_charge_in_pc[mode] / total_in_pc );
+        }
+    }
+    // The MCU charge is split with the currents apps_energy_get_report uses
+    const uint64_t run_in_us = end_in_us - report.mcu_sleep_in_us;
+
+    printf( "%-14s %12llu %12llu %6.1f%%\n", "MCU run", ( unsigned long long ) ( run_in_us / 1000 ),
+            ( unsigned long long ) ( run_in_us * APPS_ENERGY_MCU_RUN_UA / 1000000 ),
+            100.0 * run_in_us * APPS_ENERGY_MCU_RUN_UA / total_in_pc );
+    printf( "%-14s %12llu %12llu %6.1f%%\n", "MCU sleep", ( unsigned long long ) ( report.mcu_sleep_in_us / 1000 ),
+            ( unsigned long long ) ( report.mcu_sleep_in_us * APPS_ENERGY_MCU_SLEEP_UA / 1000000 ),
+            100.0 * report.mcu_sleep_in_us * APPS_ENERGY_MCU_SLEEP_UA / total_in_pc );
+}
+
+static void print_usage( const char* name )
+{
+    fprintf( stderr, "usage: %s [-x shield] [-s first_sf] [-S last_sf] [-b bw_khz] [-n cad_symbols] [-d delay_ms]\n",
+             name );
+    fprintf( stderr, "          [-w 0|1] [-p packets_per_hour] [-l payload] [-L preamble] [-H hours] [-R radios]\n" );
+    fprintf( stderr, "          [-P tx_power_dbm]\n" );
+    fprintf( stderr, "  the shields are:" );
+    for( size_t i = 0; i < ( sizeof( sim_shields ) / sizeof( sim_shields[0] ) ); i++ )
+    {
+        fprintf( stderr, " %s", sim_shields[i].name );
+    }
+    fprintf( stderr, "\n" );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( int argc, char** argv )
+{
+    sim_config_t config = {
+        .shield           = &sim_shields[2],
+        .sf_first         = 7,
+        .sf_last          = 12,
+        .bw_in_hz         = 125000,
+        .cad_symb         = 2,
+        .delay_in_ms      = 20,
+        .warm_sleep       = true,
+        .packets_per_hour = 60,
+        .payload_length   = 20,
+        .preamble_length  = 16,
+        .hours            = 24,
+        .n_radios         = 2,
+        .tx_power_in_dbm  = 14,
+    };
+
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* value = ( ( i + 1 ) < argc ) ? argv[i + 1] : NULL;
+
+        if( ( argv[i][0] != '-' ) || ( argv[i][1] == '\0' ) || ( argv[i][2] != '\0' ) || ( value == NULL ) )
+        {
+            print_usage( argv[0] );
+            return 2;
+        }
+        i++;
+        switch( argv[i - 1][1] )
+        {
+        case 'x':
+            config.shield = NULL;
+            for( size_t j = 0; j < ( sizeof( sim_shields ) / sizeof( sim_shields[0] ) ); j++ )
+            {
+                if( strcmp( value, sim_shields[j].name ) == 0 )
+                {
+                    config.shield = &sim_shields[j];
+                }
+            }
+            break;
+        case 's': config.sf_first = ( uint8_t ) atoi( value ); break;
+        case 'S': config.sf_last = ( uint8_t ) atoi( value ); break;
+        case 'b': config.bw_in_hz = ( uint32_t ) atoi( value ) * 1000; break;
+        case 'n': config.cad_symb = ( uint8_t ) atoi( value ); break;
+        case 'd': config.delay_in_ms = ( uint32_t ) atoi( value ); break;
+        case 'w': config.warm_sleep = ( atoi( value ) != 0 ); break;
+        case 'p': config.packets_per_hour = ( uint32_t ) atoi( value ); break;
+        case 'l': config.payload_length = ( uint8_t ) atoi( value ); break;
+        case 'L': config.preamble_length = ( uint16_t ) atoi( value ); break;
+        case 'H': config.hours = ( uint32_t ) atoi( value ); break;
+        case 'R': config.n_radios = ( uint8_t ) atoi( value ); break;
+        case 'P': config.tx_power_in_dbm = ( int8_t ) atoi( value ); break;
+        default:
+            print_usage( argv[0] );
+            return 2;
+        }
+    }
+    if( ( config.shield == NULL ) || ( config.sf_first < 5 ) || ( config.sf_last > 12 ) ||
+        ( config.sf_first > config.sf_last ) || ( config.bw_in_hz == 0 ) || ( config.hours == 0 ) ||
+        ( config.n_radios == 0 ) || ( config.n_radios > APPS_ENERGY_N_RADIOS ) ||
+        ( config.n_radios > ( config.sf_last - config.sf_first + 1 ) ) )
+    {
+        print_usage( argv[0] );
+        return 2;
+    }
+
+    const uint64_t end_in_us = ( uint64_t ) config.hours * 3600000000ULL;
+
+    apps_energy_init( 0 );
+    // The TX current only matters to the transmissions, none is simulated: it is set as the firmware does
+    apps_energy_set_currents( smtc_shield_sx126x_get_current_cfg( &config.shield->shield ),
+                              smtc_shield_sx126x_get_tx_current_in_ua( &config.shield->shield, config.tx_power_in_dbm ),
+                              false );
+    draw_packets( &config, end_in_us );
+
+    // Each radio sweeps its own contiguous range of spreading factors, of about the same CAD time
+    uint8_t sf = config.sf_first;
+    for( uint8_t radio = 0; radio < config.n_radios; radio++ )
+    {
+        const uint8_t first = sf;
+
+        sf = get_sf_last( &config, radio, first );
+        sweep_radio( &config, radio, first, sf, end_in_us );
+        sf++;
+    }
+    print_report( &config, end_in_us );
+
+    for( uint8_t sf = config.sf_first; sf <= config.sf_last; sf++ )
+    {
+        free( sim_packets[sf].arrivals_in_us );
+    }
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,357 @@
+/*!
+ * @file      lora_dsp.c
+ *
+ * @brief     Host DSP kernels of the LoRa models: chirps, dechirp, FFT and power, in AVX2, NEON or plain C
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#define _ISOC11_SOURCE
+
+#include <stdlib.h>
+#include <math.h>
+#include "lora_dsp.h"
+
+#if( LORA_DSP_SIMD == true ) && defined( __AVX2__ )
+#include <immintrin.h>
+#elif( LORA_DSP_SIMD == true ) && defined( __ARM_NEON )
+#include <arm_neon.h>
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#if( LORA_DSP_SIMD == true ) && defined( __AVX2__ )
+#define LORA_DSP_KERNELS "AVX2"
+#define LORA_DSP_WIDTH 8
+#elif( LORA_DSP_SIMD == true ) && defined( __ARM_NEON )
+#define LORA_DSP_KERNELS "NEON"
+#define LORA_DSP_WIDTH 4
+#else
+#define LORA_DSP_KERNELS "C"
+#define LORA_DSP_WIDTH 1
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+/*!
+ * @brief Radix-2 butterflies of one block: a += b x w and b = a - b x w, for count pairs
+ */
+static void lora_dsp_butterflies( float* a_re, float* a_im, float* b_re, float* b_im, const float* w_re,
+                                  const float* w_im, uint32_t count )
+{
+    uint32_t k = 0;
+
+#if( LORA_DSP_WIDTH == 8 )
+    for( ; ( k + 8 ) <= count; k += 8 )
+    {
+        const __m256 wr = _mm256_loadu_ps( &w_re[k] );
+        const __m256 wi = _mm256_loadu_ps( &w_im[k] );
+        const __m256 br = _mm256_loadu_ps( &b_re[k] );
+        const __m256 bi = _mm256_loadu_ps( &b_im[k] );
+        const __m256 ar = _mm256_loadu_ps( &a_re[k] );
+        const __m256 ai = _mm256_loadu_ps( &a_im[k] );
+        const __m256 tr = _mm256_sub_ps( _mm256_mul_ps( br, wr ), _mm256_mul_ps( bi, wi ) );
+        const __m256 ti = _mm256_add_ps( _mm256_mul_ps( br, wi ), _mm256_mul_ps( bi, wr ) );
+
+        _mm256_storeu_ps( &a_re[k], _mm256_add_ps( ar, tr ) );
+        _mm256_storeu_ps( &a_im[k], _mm256_add_ps( ai, ti ) );
+        _mm256_storeu_ps( &b_re[k], _mm256_sub_ps( ar, tr ) );
+        _mm256_storeu_ps( &b_im[k], _mm256_sub_ps( ai, ti ) );
+    }
+#elif( LORA_DSP_WIDTH == 4 )
+    for( ; ( k + 4 ) <= count; k += 4 )
+    {
+        const float32x4_t wr = vld1q_f32( &w_re[k] );
+        const float32x4_t wi = vld1q_f32( &w_im[k] );
+        const float32x4_t br = vld1q_f32( &b_re[k] );
+        const float32x4_t bi = vld1q_f32( &b_im[k] );
+        const float32x4_t ar = vld1q_f32( &a_re[k] );
+        const float32x4_t ai = vld1q_f32( &a_im[k] );
+        const float32x4_t tr = vmlsq_f32( vmulq_f32( br, wr ), bi, wi );
+        const float32x4_t ti = vmlaq_f32( vmulq_f32( br, wi ), bi, wr );
+
+        vst1q_f32( &a_re[k], vaddq_f32( ar, tr ) );
+        vst1q_f32( &a_im[k], vaddq_f32( ai, ti ) );
+        vst1q_f32( &b_re[k], vsubq_f32( ar, tr ) );
+        vst1q_f32( &b_im[k], vsubq_f32( ai, ti ) );
+    }
+#endif
+    for( ; k < count; k++ )
+    {
+        const float tr = b_re[k] * w_re[k] - b_im[k] * w_im[k];
+        const float ti = b_re[k] * w_im[k] + b_im[k] * w_re[k];
+
+        b_re[k] = a_re[k] - tr;
+        b_im[k] = a_im[k] - ti;
+        a_re[k] += tr;
+        a_im[k] += ti;
+    }
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+float* lora_dsp_alloc( uint32_t n )
+{
+    // aligned_alloc wants a size multiple of the alignment
+    const size_t size = ( ( ( size_t ) n * sizeof( float ) + LORA_DSP_ALIGN - 1 ) / LORA_DSP_ALIGN ) * LORA_DSP_ALIGN;
+
+    return aligned_alloc( LORA_DSP_ALIGN, ( size != 0 ) ? size : LORA_DSP_ALIGN );
+}
+
+bool lora_dsp_fft_init( lora_dsp_fft_t* fft, uint8_t log2_n )
+{
+    const uint32_t n = ( uint32_t ) 1 << log2_n;
+
+    fft->n      = n;
+    fft->bitrev = malloc( n * sizeof( uint32_t ) );
+    fft->tw_re  = lora_dsp_alloc( n );
+    fft->tw_im  = lora_dsp_alloc( n );
+    if( ( fft->bitrev == NULL ) || ( fft->tw_re == NULL ) || ( fft->tw_im == NULL ) )
+    {
+        lora_dsp_fft_deinit( fft );
+        return false;
+    }
+
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        uint32_t rev = 0;
+
+        for( uint8_t bit = 0; bit < log2_n; bit++ )
+        {
+            rev |= ( ( i >> bit ) & 1 ) << ( log2_n - 1 - bit );
+        }
+        fft->bitrev[i] = rev;
+    }
+    // Stored stage by stage so that the butterflies of a block read their twiddles contiguously
+    for( uint32_t half = 1; half < n; half <<= 1 )
+    {
+        for( uint32_t k = 0; k < half; k++ )
+        {
+            const double angle = -M_PI * ( double ) k / ( double ) half;
+
+            fft->tw_re[half + k] = ( float ) cos( angle );
+            fft->tw_im[half + k] = ( float ) sin( angle );
+        }
+    }
+    return true;
+}
+
+void lora_dsp_fft_deinit( lora_dsp_fft_t* fft )
+{
+    free( fft->bitrev );
+    free( fft->tw_re );
+    free( fft->tw_im );
+    fft->bitrev = NULL;
+    fft->tw_re  = NULL;
+    fft->tw_im  = NULL;
+}
+
+void lora_dsp_fft( const lora_dsp_fft_t* fft, float* re, float* im )
+{
+    lora_dsp_fft_sub( fft, fft->n, re, im );
+}
+
+void lora_dsp_fft_sub( const lora_dsp_fft_t* fft, uint32_t n, float* re, float* im )
+{
+    // Reversed on log2(fft->n) bits, an index below n has its log2(n) reversed bits at the top
+    const uint32_t shift = ( uint32_t ) ( __builtin_ctz( fft->n ) - __builtin_ctz( n ) );
+
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        const uint32_t j = fft->bitrev[i] >> shift;
+
+        if( j > i )
+        {
+            const float tr = re[i];
+            const float ti = im[i];
+
+            re[i] = re[j];
+            im[i] = im[j];
+            re[j] = tr;
+            im[j] = ti;
+        }
+    }
+
+    // The first stage only adds and subtracts
+    for( uint32_t i = 0; ( i + 1 ) < n; i += 2 )
+    {
+        const float tr = re[i + 1];
+        const float ti = im[i + 1];
+
+        re[i + 1] = re[i] - tr;
+        im[i + 1] = im[i] - ti;
+        re[i] += tr;
+        im[i] += ti;
+    }
+    for( uint32_t half = 2; half < n; half <<= 1 )
+    {
+        for( uint32_t start = 0; start < n; start += 2 * half )
+        {
+            lora_dsp_butterflies( &re[start], &im[start], &re[start + half], &im[start + half], &fft->tw_re[half],
+                                  &fft->tw_im[half], half );
+        }
+    }
+}
+
+void lora_dsp_make_upchirp( uint8_t sf, float* re, float* im )
+{
+    const uint32_t n = ( uint32_t ) 1 << sf;
+
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        // The frequency sweeps from -BW/2 to +BW/2 over the symbol
+        const double phase = M_PI * ( ( double ) i * i / n - ( double ) i );
+
+        re[i] = ( float ) cos( phase );
+        im[i] = ( float ) sin( phase );
+    }
+}
+
+void lora_dsp_mul_conj( float* re, float* im, const float* ref_re, const float* ref_im, uint32_t n )
+{
+    uint32_t i = 0;
+
+#if( LORA_DSP_WIDTH == 8 )
+    for( ; ( i + 8 ) <= n; i += 8 )
+    {
+        const __m256 xr = _mm256_loadu_ps( &re[i] );
+        const __m256 xi = _mm256_loadu_ps( &im[i] );
+        const __m256 rr = _mm256_loadu_ps( &ref_re[i] );
+        const __m256 ri = _mm256_loadu_ps( &ref_im[i] );
+
+        _mm256_storeu_ps( &re[i], _mm256_add_ps( _mm256_mul_ps( xr, rr ), _mm256_mul_ps( xi, ri ) ) );
+        _mm256_storeu_ps( &im[i], _mm256_sub_ps( _mm256_mul_ps( xi, rr ), _mm256_mul_ps( xr, ri ) ) );
+    }
+#elif( LORA_DSP_WIDTH == 4 )
+    for( ; ( i + 4 ) <= n; i += 4 )
+    {
+        const float32x4_t xr = vld1q_f32( &re[i] );
+        const float32x4_t xi = vld1q_f32( &im[i] );
+        const float32x4_t rr = vld1q_f32( &ref_re[i] );
+        const float32x4_t ri = vld1q_f32( &ref_im[i] );
+
+        vst1q_f32( &re[i], vmlaq_f32( vmulq_f32( xr, rr ), xi, ri ) );
+        vst1q_f32( &im[i], vmlsq_f32( vmulq_f32( xi, rr ), xr, ri ) );
+    }
+#endif
+    for( ; i < n; i++ )
+    {
+        const float xr = re[i];
+        const float xi = im[i];
+
+        re[i] = xr * ref_re[i] + xi * ref_im[i];
+        im[i] = xi * ref_re[i] - xr * ref_im[i];
+    }
+}
+
+void lora_dsp_add_power( float* acc, const float* re, const float* im, uint32_t n )
+{
+    uint32_t i = 0;
+
+#if( LORA_DSP_WIDTH == 8 )
+    for( ; ( i + 8 ) <= n; i += 8 )
+    {
+        const __m256 xr = _mm256_loadu_ps( &re[i] );
+        const __m256 xi = _mm256_loadu_ps( &im[i] );
+        const __m256 p  = _mm256_add_ps( _mm256_mul_ps( xr, xr ), _mm256_mul_ps( xi, xi ) );
+
+        _mm256_storeu_ps( &acc[i], _mm256_add_ps( _mm256_loadu_ps( &acc[i] ), p ) );
+    }
+#elif( LORA_DSP_WIDTH == 4 )
+    for( ; ( i + 4 ) <= n; i += 4 )
+    {
+        const float32x4_t xr = vld1q_f32( &re[i] );
+        const float32x4_t xi = vld1q_f32( &im[i] );
+
+        vst1q_f32( &acc[i], vmlaq_f32( vmlaq_f32( vld1q_f32( &acc[i] ), xr, xr ), xi, xi ) );
+    }
+#endif
+    for( ; i < n; i++ )
+    {
+        acc[i] += re[i] * re[i] + im[i] * im[i];
+    }
+}
+
+float lora_dsp_dot( const float* a, const float* b, uint32_t n )
+{
+    uint32_t i   = 0;
+    float    sum = 0.0f;
+
+#if( LORA_DSP_WIDTH == 8 )
+    __m256 acc = _mm256_setzero_ps( );
+
+    for( ; ( i + 8 ) <= n; i += 8 )
+    {
+        acc = _mm256_add_ps( acc, _mm256_mul_ps( _mm256_loadu_ps( &a[i] ), _mm256_loadu_ps( &b[i] ) ) );
+    }
+    const __m128 half = _mm_add_ps( _mm256_castps256_ps128( acc ), _mm256_extractf128_ps( acc, 1 ) );
+    const __m128 pair = _mm_add_ps( half, _mm_movehl_ps( half, half ) );
+
+    sum = _mm_cvtss_f32( _mm_add_ss( pair, _mm_shuffle_ps( pair, pair, 1 ) ) );
+#elif( LORA_DSP_WIDTH == 4 )
+    float32x4_t acc = vdupq_n_f32( 0.0f );
+
+    for( ; ( i + 4 ) <= n; i += 4 )
+    {
+        acc = vmlaq_f32( acc, vld1q_f32( &a[i] ), vld1q_f32( &b[i] ) );
+    }
+    sum = vgetq_lane_f32( acc, 0 ) + vgetq_lane_f32( acc, 1 ) + vgetq_lane_f32( acc, 2 ) + vgetq_lane_f32( acc, 3 );
+#endif
+    for( ; i < n; i++ )
+    {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+const char* lora_dsp_get_kernels( void )
+{
+    return LORA_DSP_KERNELS;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
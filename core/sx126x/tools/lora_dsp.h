@@ -0,0 +1,168 @@
+/*!
+ * @file      lora_dsp.h
+ *
+ * @brief     Host DSP kernels of the LoRa models: chirps, dechirp, FFT and power, in AVX2, NEON or plain C
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef LORA_DSP_H
+#define LORA_DSP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC MACROS -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Use the AVX2 or NEON kernels when the compiler targets them, set to false to time the plain C ones
+ */
+#ifndef LORA_DSP_SIMD
+#define LORA_DSP_SIMD true
+#endif
+
+/*!
+ * @brief Alignment of the sample buffers, one AVX2 register
+ */
+#define LORA_DSP_ALIGN 32
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC CONSTANTS --------------------------------------------------------
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC TYPES ------------------------------------------------------------
+ */
+
+/*!
+ * @brief Radix-2 FFT of a given size, the complex samples are split in real and imaginary arrays
+ */
+typedef struct lora_dsp_fft_s
+{
+    uint32_t  n;       //!< Number of points, a power of two
+    uint32_t* bitrev;  //!< Bit-reversed index of each point
+    float*    tw_re;   //!< Twiddles of each stage, the ones of the stage of span half start at index half
+    float*    tw_im;
+} lora_dsp_fft_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS PROTOTYPES ---------------------------------------------
+ */
+
+/*!
+ * @brief Allocate an array of floats aligned on @ref LORA_DSP_ALIGN, to be released with free
+ *
+ * @returns NULL when out of memory
+ */
+float* lora_dsp_alloc( uint32_t n );
+
+/*!
+ * @brief Prepare the twiddles and the permutation of an FFT
+ *
+ * @param [out] fft    FFT to prepare
+ * @param [in]  log2_n Base-2 logarithm of the number of points, at least 1
+ *
+ * @returns false when out of memory
+ */
+bool lora_dsp_fft_init( lora_dsp_fft_t* fft, uint8_t log2_n );
+
+/*!
+ * @brief Release the memory of an FFT
+ */
+void lora_dsp_fft_deinit( lora_dsp_fft_t* fft );
+
+/*!
+ * @brief Compute a forward FFT in place, the input and output are in natural order
+ */
+void lora_dsp_fft( const lora_dsp_fft_t* fft, float* re, float* im );
+
+/*!
+ * @brief Compute a forward FFT of fewer points in place, with the twiddles and the permutation of a larger FFT
+ *
+ * @remark One FFT of the largest spreading factor serves all the smaller ones
+ *
+ * @param [in]    fft FFT prepared for at least n points
+ * @param [in]    n   Number of points, a power of two
+ * @param [inout] re  Real parts
+ * @param [inout] im  Imaginary parts
+ */
+void lora_dsp_fft_sub( const lora_dsp_fft_t* fft, uint32_t n, float* re, float* im );
+
+/*!
+ * @brief Write the base up-chirp of a spreading factor, one sample per chip
+ *
+ * @param [in]  sf Spreading factor, the chirp has 2^sf samples
+ * @param [out] re Real parts
+ * @param [out] im Imaginary parts
+ */
+void lora_dsp_make_upchirp( uint8_t sf, float* re, float* im );
+
+/*!
+ * @brief Multiply samples by the conjugate of a reference in place, which dechirps them by the up-chirp
+ */
+void lora_dsp_mul_conj( float* re, float* im, const float* ref_re, const float* ref_im, uint32_t n );
+
+/*!
+ * @brief Add the power of each sample to an accumulator
+ */
+void lora_dsp_add_power( float* acc, const float* re, const float* im, uint32_t n );
+
+/*!
+ * @brief Get the dot product of two arrays, e.g. for the taps of a filter
+ */
+float lora_dsp_dot( const float* a, const float* b, uint32_t n );
+
+/*!
+ * @brief Get the name of the kernels compiled in: "AVX2", "NEON" or "C"
+ */
+const char* lora_dsp_get_kernels( void );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // LORA_DSP_H
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -0,0 +1,168 @@
+/*!
+ * @file      nbr_bench.c
+ *
+ * @brief     Host microbenchmark of the neighbour table lookups and insertions
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "asfs_nbr.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of operations timed in each test
+ */
+#ifndef NBR_BENCH_N_OPS
+#define NBR_BENCH_N_OPS 4000000
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static asfs_nbr_table_t table;
+
+/*!
+ * @brief Sink of the lookup results, so that the compiler keeps the lookups
+ */
+static volatile uint32_t sink;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static double get_time_in_ns( void )
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ( double ) ts.tv_sec * 1e9 + ( double ) ts.tv_nsec;
+}
+
+/*!
+ * @brief Identifier number i, distinct for every i below 65536 and not sequential
+ */
+static asfs_nbr_id_t get_id( uint32_t i )
+{
+    return ( asfs_nbr_id_t )( ( i * 0x6D2Bu + 0x1234u ) & 0xFFFF );
+}
+
+/*!
+ * @brief Fill the table with the identifiers 0 to ASFS_NBR_MAX_ENTRIES - 1
+ */
+static void fill( void )
+{
+    asfs_nbr_init( &table );
+    for( uint32_t i = 0; i < ASFS_NBR_MAX_ENTRIES; i++ )
+    {
+        asfs_nbr_insert( &table, get_id( i ), NULL );
+    }
+}
+
+static void print_result( const char* name, double elapsed_in_ns, uint32_t n_ops )
+{
+    const double probes = ( table.stats.lookups != 0 ) ? ( double ) table.stats.probes / table.stats.lookups : 0;
+
+    printf( "  %-22s %7.1f ns/op %7.1f Mop/s  %.2f probes/lookup (max %u)\n", name, elapsed_in_ns / n_ops,
+            n_ops * 1e3 / elapsed_in_ns, probes, table.stats.max_probes );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( void )
+{
+    double   start;
+    uint32_t n_ops;
+
+    printf( "Neighbour table: %u slots, %u entries, %u bytes\n", ASFS_NBR_CAPACITY, ASFS_NBR_MAX_ENTRIES,
+            ( unsigned ) sizeof( asfs_nbr_table_t ) );
+
+    // Insertions into an empty table, repeated to time enough of them
+    n_ops = 0;
+    start = get_time_in_ns( );
+    while( n_ops < NBR_BENCH_N_OPS )
+    {
+        fill( );
+        n_ops += ASFS_NBR_MAX_ENTRIES;
+    }
+    print_result( "insert (filling)", get_time_in_ns( ) - start, n_ops );
+
+    // Lookups of neighbours in a full table
+    fill( );
+    table.stats = ( asfs_nbr_stats_t ){ 0 };
+    start       = get_time_in_ns( );
+    for( uint32_t i = 0; i < NBR_BENCH_N_OPS; i++ )
+    {
+        sink += asfs_nbr_find( &table, get_id( i % ASFS_NBR_MAX_ENTRIES ) );
+    }
+    print_result( "find (hit)", get_time_in_ns( ) - start, NBR_BENCH_N_OPS );
+
+    // Lookups of unknown nodes in a full table
+    table.stats = ( asfs_nbr_stats_t ){ 0 };
+    start       = get_time_in_ns( );
+    for( uint32_t i = 0; i < NBR_BENCH_N_OPS; i++ )
+    {
+        sink += asfs_nbr_find( &table, get_id( ASFS_NBR_MAX_ENTRIES + i % ASFS_NBR_MAX_ENTRIES ) );
+    }
+    print_result( "find (miss)", get_time_in_ns( ) - start, NBR_BENCH_N_OPS );
+
+    // New nodes in a full table, each one evicts another through the clock
+    table.stats = ( asfs_nbr_stats_t ){ 0 };
+    start       = get_time_in_ns( );
+    for( uint32_t i = 0; i < NBR_BENCH_N_OPS; i++ )
+    {
+        sink += asfs_nbr_insert( &table, get_id( ASFS_NBR_MAX_ENTRIES + i % ( 65536 - ASFS_NBR_MAX_ENTRIES ) ), NULL );
+    }
+    print_result( "insert (evicting)", get_time_in_ns( ) - start, NBR_BENCH_N_OPS );
+    printf( "  %u evictions, %u entries left\n", table.stats.evictions, table.n_entries );
+
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
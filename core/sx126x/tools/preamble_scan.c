@@ -0,0 +1,1046 @@
+/*!
+ * @file      preamble_scan.c
+ *
+ * @brief     Software scan of the LoRa preambles of SF7 to SF12 in an IQ capture, all at once
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lora_dsp.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+#define SCAN_SF_MIN 7
+#define SCAN_SF_MAX 12
+
+/*!
+ * @brief Chips of a symbol of the largest spreading factor
+ *
+ * The chunks and the blocks start on multiples of it, so the windows of every spreading factor fall on the same grid
+ * whatever the split of the capture between the threads
+ */
+#define SCAN_GRID ( ( uint32_t ) 1 << SCAN_SF_MAX )
+
+/*!
+ * @brief Chips decimated at once, then read by the detectors of all the spreading factors while in cache
+ */
+#define SCAN_BLOCK_CHIPS ( 8 * SCAN_GRID )
+
+/*!
+ * @brief Half length of the decimation filter, in chips
+ */
+#define SCAN_FIR_HALF_CHIPS 8
+
+/*!
+ * @brief Most threads sharing the chunks
+ */
+#define SCAN_MAX_THREADS 64
+
+/*!
+ * @brief Chirps of the preambles synthesized by the self-check
+ */
+#define SCAN_CHECK_SYMBS 12
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef enum scan_format_e
+{
+    SCAN_FORMAT_CU8,
+    SCAN_FORMAT_CS8,
+    SCAN_FORMAT_CS16,
+    SCAN_FORMAT_CF32,
+} scan_format_t;
+
+typedef struct scan_config_s
+{
+    const char*    path;  //!< Capture, "-" for the standard input
+    scan_format_t  format;
+    uint32_t       bw_in_hz;
+    uint32_t       rate_in_hz;
+    uint32_t       os;  //!< Samples per chip, a power of two
+    uint8_t        sf_first;
+    uint8_t        sf_last;
+    uint16_t       min_symbs;  //!< Symbols of a preamble detected in a row to report it
+    float          margin;     //!< Threshold of a symbol over the noise, see get_threshold
+    uint8_t        n_threads;
+    uint32_t       chunk_chips;    //!< Chips of a thread per batch, when streaming
+    uint32_t       overlap_chips;  //!< Chips scanned on both sides of a chunk, longer than a preamble
+    float*         taps;           //!< Decimation filter, shared by the threads
+    uint32_t       n_taps;
+    lora_dsp_fft_t fft;  //!< FFT of the largest spreading factor, serving all of them
+    float*         chirps_re[SCAN_SF_MAX + 1];
+    float*         chirps_im[SCAN_SF_MAX + 1];
+} scan_config_t;
+
+/*!
+ * @brief Samples of the capture in memory, at the sample rate
+ */
+typedef struct scan_input_s
+{
+    const uint8_t* data;
+    uint64_t       first;  //!< Index in the capture of the first sample in memory
+    uint64_t       count;
+} scan_input_t;
+
+typedef struct scan_detection_s
+{
+    uint64_t chip;     //!< Start of the preamble, in chips from the start of the capture
+    uint8_t  sf;
+    uint16_t n_symbs;  //!< Chirps of the preamble
+    float    snr_db;
+} scan_detection_t;
+
+/*!
+ * @brief Detector of one spreading factor: its last two windows and the run of windows detected in a row on the same
+ * bin
+ *
+ * A preamble not aligned on the windows spans one window more than its chirps, the first and the last ones holding
+ * only a part of a chirp each: the run keeps what it needs to tell them from whole chirps.
+ */
+typedef struct scan_detector_s
+{
+    float*   acc[2];       //!< Power of the bins of the current window and of the previous one
+    double   noise[2];     //!< Mean power of the bins out of the peak
+    uint8_t  cur;
+    bool     has_prev;     //!< false on the first window of the job
+    uint64_t first_chip;   //!< Start of the first window of the run
+    uint32_t first_bin;
+    uint32_t bin;
+    uint16_t n_windows;
+    double   ratio_sum;
+    double   first_ratio;  //!< Peak over noise of the first window of the run
+    double   last_ratio;   //!< Peak over noise of the last window of the run
+    bool     has_head;     //!< The first window was only found on the bin of the run, it holds a part of a chirp
+    bool     has_tail;     //!< The last window was only found on the bin of the run, it holds a part of a chirp
+} scan_detector_t;
+
+/*!
+ * @brief Chunk of the capture scanned by one thread
+ */
+typedef struct scan_job_s
+{
+    const scan_config_t* config;
+    const scan_input_t*  input;
+    uint64_t             own_first;  //!< The preambles starting in [own_first, own_end[ are reported by this job
+    uint64_t             own_end;
+    uint64_t             scan_first;
+    uint64_t             scan_end;
+    scan_detection_t*    detections;
+    uint32_t             n_detections;
+    uint32_t             capacity;
+    bool                 failed;
+} scan_job_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static const struct
+{
+    const char* name;
+    uint8_t     bytes;  //!< Bytes of a complex sample
+} scan_formats[] = {
+    [SCAN_FORMAT_CU8] = { "cu8", 2 },
+    [SCAN_FORMAT_CS8] = { "cs8", 2 },
+    [SCAN_FORMAT_CS16] = { "cs16", 4 },
+    [SCAN_FORMAT_CF32] = { "cf32", 8 },
+};
+
+static uint32_t scan_counts[SCAN_SF_MAX + 1];
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static double get_time_in_s( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*!
+ * @brief Get the ratio of a correlation peak to the mean of the other bins above which a symbol is detected
+ *
+ * @remark The highest of n noise bins exceeds ln(n) + margin times their mean with a probability of about e^-margin
+ */
+static float get_threshold( const scan_config_t* config, uint32_t n )
+{
+    return logf( ( float ) n ) + config->margin;
+}
+
+/*!
+ * @brief Prepare what the threads share: the decimation filter, the FFT and the chirps
+ *
+ * @returns false when out of memory
+ */
+static bool prepare( scan_config_t* config )
+{
+    const uint32_t half = SCAN_FIR_HALF_CHIPS * config->os;
+
+    // A windowed sinc cutting at half the bandwidth, a single tap without decimation
+    config->n_taps = ( config->os > 1 ) ? ( 2 * half + 1 ) : 1;
+    config->taps   = lora_dsp_alloc( config->n_taps );
+    if( ( config->taps == NULL ) || ( lora_dsp_fft_init( &config->fft, config->sf_last ) == false ) )
+    {
+        return false;
+    }
+    double sum = 0.0;
+    for( uint32_t k = 0; k < config->n_taps; k++ )
+    {
+        const double t      = ( double ) k - ( double ) ( config->n_taps - 1 ) / 2;
+        const double sinc   = ( t == 0.0 ) ? 1.0 : sin( M_PI * t / config->os ) / ( M_PI * t / config->os );
+        const double window = ( config->n_taps > 1 ) ? 0.42 - 0.5 * cos( 2 * M_PI * k / ( config->n_taps - 1 ) ) +
+                                                           0.08 * cos( 4 * M_PI * k / ( config->n_taps - 1 ) )
+                                                     : 1.0;
+
+        config->taps[k] = ( float ) ( sinc * window );
+        sum += config->taps[k];
+    }
+    for( uint32_t k = 0; k < config->n_taps; k++ )
+    {
+        config->taps[k] = ( float ) ( config->taps[k] / sum );
+    }
+
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        config->chirps_re[sf] = lora_dsp_alloc( ( uint32_t ) 1 << sf );
+        config->chirps_im[sf] = lora_dsp_alloc( ( uint32_t ) 1 << sf );
+        if( ( config->chirps_re[sf] == NULL ) || ( config->chirps_im[sf] == NULL ) )
+        {
+            return false;
+        }
+        lora_dsp_make_upchirp( sf, config->chirps_re[sf], config->chirps_im[sf] );
+    }
+    return true;
+}
+
+/*!
+ * @brief Convert samples of the capture to floats, the ones outside of the memory read as 0
+ */
+static void convert( const scan_config_t* config, const scan_input_t* input, int64_t first, uint32_t count, float* re,
+                     float* im )
+{
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        const int64_t index = first + i - ( int64_t ) input->first;
+
+        if( ( index < 0 ) || ( ( uint64_t ) index >= input->count ) )
+        {
+            re[i] = 0.0f;
+            im[i] = 0.0f;
+            continue;
+        }
+        const uint8_t* sample = &input->data[( uint64_t ) index * scan_formats[config->format].bytes];
+        switch( config->format )
+        {
+        case SCAN_FORMAT_CU8:
+            re[i] = ( sample[0] - 127.5f ) / 128.0f;
+            im[i] = ( sample[1] - 127.5f ) / 128.0f;
+            break;
+        case SCAN_FORMAT_CS8:
+            re[i] = ( int8_t ) sample[0] / 128.0f;
+            im[i] = ( int8_t ) sample[1] / 128.0f;
+            break;
+        case SCAN_FORMAT_CS16:
+        {
+            int16_t iq[2];
+
+            memcpy( iq, sample, sizeof( iq ) );
+            re[i] = iq[0] / 32768.0f;
+            im[i] = iq[1] / 32768.0f;
+            break;
+        }
+        case SCAN_FORMAT_CF32:
+            memcpy( &re[i], &sample[0], sizeof( float ) );
+            memcpy( &im[i], &sample[4], sizeof( float ) );
+            break;
+        }
+    }
+}
+
+static bool add_detection( scan_job_t* job, const scan_detection_t* detection )
+{
+    if( job->n_detections == job->capacity )
+    {
+        const uint32_t    capacity   = ( job->capacity != 0 ) ? 2 * job->capacity : 64;
+        scan_detection_t* detections = realloc( job->detections, capacity * sizeof( scan_detection_t ) );
+
+        if( detections == NULL )
+        {
+            return false;
+        }
+        job->detections = detections;
+        job->capacity   = capacity;
+    }
+    job->detections[job->n_detections++] = *detection;
+    return true;
+}
+
+/*!
+ * @brief Get the highest power of one of the two windows on a bin and its neighbours, over its noise
+ */
+static double get_ratio( const scan_detector_t* det, uint8_t window, uint32_t n, uint32_t bin )
+{
+    const float* acc  = det->acc[window];
+    float        peak = acc[bin];
+
+    peak = ( acc[( bin + 1 ) & ( n - 1 )] > peak ) ? acc[( bin + 1 ) & ( n - 1 )] : peak;
+    peak = ( acc[( bin - 1 ) & ( n - 1 )] > peak ) ? acc[( bin - 1 ) & ( n - 1 )] : peak;
+    return ( det->noise[window] > 0.0 ) ? peak / det->noise[window] : 0.0;
+}
+
+/*!
+ * @brief Tell whether the window at one end of a run holds a whole chirp rather than the part of it expected there
+ *
+ * The part would have been found on the bin of the run when standing out of the noise by the margin, in the next
+ * window or the previous one, so the end window can only be whole when it would not, and when closer to the power of
+ * the whole chirps than to the one of the part.
+ *
+ * @param [in] part  Part of a chirp expected in the end window, from 0 to 1
+ * @param [in] full  Peak over noise of the whole chirps
+ * @param [in] ratio Peak over noise of the end window
+ * @param [in] margin Peak over noise finding a part on the bin of the run
+ */
+static bool is_end_whole( double part, double full, double ratio, double margin )
+{
+    // The power of a chirp seen by a window grows as the square of the part of it inside
+    const double expected = 1.0 + part * part * ( full - 1.0 );
+
+    return ( expected < margin ) && ( ratio > ( ( expected + full ) / 2.0 ) );
+}
+
+/*!
+ * @brief End a run of windows, and report it as a preamble when long enough and owned by the job
+ */
+static void close_run( scan_job_t* job, uint8_t sf, scan_detector_t* det )
+{
+    if( det->n_windows == 0 )
+    {
+        return;
+    }
+
+    const uint32_t n = ( uint32_t ) 1 << sf;
+    // A chirp starting d chips into the window dechirps to the bin n - d
+    const uint32_t offset  = ( n - det->first_bin ) & ( n - 1 );
+    uint64_t       chip    = det->first_chip + offset;
+    uint32_t       n_symbs = det->n_windows;
+    // The whole chirps are the windows out of the ends when there are some
+    const double full = ( det->n_windows > 2 )
+                            ? ( det->ratio_sum - det->first_ratio - det->last_ratio ) / ( det->n_windows - 2 )
+                            : det->ratio_sum / det->n_windows;
+
+    if( offset != 0 )
+    {
+        // Out of the windows, the preamble starts in the first one and ends in the one after the last, but an end
+        // window holding too little of a chirp to be found is not in the run
+        n_symbs--;
+        if( ( det->has_head == false ) &&
+            ( is_end_whole( ( double ) ( n - offset ) / n, full, det->first_ratio, job->config->margin ) == true ) )
+        {
+            chip -= n;
+            n_symbs++;
+        }
+        if( ( det->has_tail == false ) &&
+            ( is_end_whole( ( double ) offset / n, full, det->last_ratio, job->config->margin ) == true ) )
+        {
+            n_symbs++;
+        }
+    }
+    if( ( n_symbs >= job->config->min_symbs ) && ( det->first_chip >= job->own_first ) &&
+        ( det->first_chip < job->own_end ) )
+    {
+        const double           snr       = ( full - 1.0 ) / n;
+        const scan_detection_t detection = {
+            .chip    = chip,
+            .sf      = sf,
+            .n_symbs = ( uint16_t ) n_symbs,
+            .snr_db  = ( snr > 0.0 ) ? ( float ) ( 10.0 * log10( snr ) ) : -99.0f,
+        };
+
+        if( add_detection( job, &detection ) == false )
+        {
+            job->failed = true;
+        }
+    }
+    det->n_windows = 0;
+}
+
+/*!
+ * @brief Dechirp and transform one window, and extend or end the run of its spreading factor
+ */
+static void detect( scan_job_t* job, uint8_t sf, const float* chip_re, const float* chip_im, uint64_t chip,
+                    float* re, float* im, scan_detector_t* det )
+{
+    const scan_config_t* config = job->config;
+    const uint32_t       n      = ( uint32_t ) 1 << sf;
+    float*               acc    = det->acc[det->cur];
+
+    memcpy( re, chip_re, n * sizeof( float ) );
+    memcpy( im, chip_im, n * sizeof( float ) );
+    lora_dsp_mul_conj( re, im, config->chirps_re[sf], config->chirps_im[sf], n );
+    lora_dsp_fft_sub( &config->fft, n, re, im );
+    memset( acc, 0, n * sizeof( float ) );
+    lora_dsp_add_power( acc, re, im, n );
+
+    uint32_t bin = 0;
+    double   sum = 0.0;
+    for( uint32_t i = 0; i < n; i++ )
+    {
+        bin = ( acc[i] > acc[bin] ) ? i : bin;
+        sum += acc[i];
+    }
+    const double noise    = ( sum - acc[bin] ) / ( n - 1 );
+    const double ratio    = ( noise > 0.0 ) ? acc[bin] / noise : 0.0;
+    const bool   detected = ratio >= get_threshold( config, n );
+    // The symbols of a preamble peak on the same bin, give or take one for the drift of the clocks
+    const uint32_t distance = ( bin - det->bin ) & ( n - 1 );
+
+    det->noise[det->cur] = noise;
+    if( ( detected == true ) && ( det->n_windows > 0 ) && ( ( distance <= 1 ) || ( distance == ( n - 1 ) ) ) )
+    {
+        det->bin = bin;
+        det->n_windows++;
+        det->ratio_sum += ratio;
+        det->last_ratio = ratio;
+    }
+    else
+    {
+        // A preamble ending early in this window covers too little of it to stand out of all the bins, but enough to
+        // stand out on the bin of the run
+        const double tail = ( ( det->n_windows > 0 ) && ( det->first_bin != 0 ) ) ? get_ratio( det, det->cur, n, det->bin )
+                                                                                   : 0.0;
+
+        det->has_tail = tail >= config->margin;
+        if( det->has_tail == true )
+        {
+            det->n_windows++;
+            det->ratio_sum += tail;
+            det->last_ratio = tail;
+        }
+        close_run( job, sf, det );
+        if( detected == true )
+        {
+            // The same for a preamble starting late in the previous window
+            const double head = ( ( det->has_prev == true ) && ( bin != 0 ) ) ? get_ratio( det, det->cur ^ 1, n, bin )
+                                                                               : 0.0;
+
+            det->has_head    = head >= config->margin;
+            det->has_tail    = false;
+            det->first_chip  = chip;
+            det->first_bin   = bin;
+            det->bin         = bin;
+            det->n_windows   = 1;
+            det->ratio_sum   = ratio;
+            det->first_ratio = ratio;
+            det->last_ratio  = ratio;
+            if( det->has_head == true )
+            {
+                det->first_chip -= n;
+                det->n_windows++;
+                det->ratio_sum += head;
+                det->first_ratio = head;
+            }
+        }
+    }
+    det->cur ^= 1;
+    det->has_prev = true;
+}
+
+static void* run_job( void* arg )
+{
+    scan_job_t*          job     = arg;
+    const scan_config_t* config  = job->config;
+    const uint32_t       n_in    = ( SCAN_BLOCK_CHIPS - 1 ) * config->os + config->n_taps;
+    const int64_t        delay   = ( config->n_taps - 1 ) / 2;
+    float*               in_re   = lora_dsp_alloc( n_in );
+    float*               in_im   = lora_dsp_alloc( n_in );
+    float*               chip_re = lora_dsp_alloc( SCAN_BLOCK_CHIPS );
+    float*               chip_im = lora_dsp_alloc( SCAN_BLOCK_CHIPS );
+    float*               re      = lora_dsp_alloc( SCAN_GRID );
+    float*               im      = lora_dsp_alloc( SCAN_GRID );
+    scan_detector_t      dets[SCAN_SF_MAX + 1] = { 0 };
+
+    if( ( in_re == NULL ) || ( in_im == NULL ) || ( chip_re == NULL ) || ( chip_im == NULL ) || ( re == NULL ) ||
+        ( im == NULL ) )
+    {
+        job->failed = true;
+    }
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        dets[sf].acc[0] = lora_dsp_alloc( ( uint32_t ) 1 << sf );
+        dets[sf].acc[1] = lora_dsp_alloc( ( uint32_t ) 1 << sf );
+        job->failed     = job->failed || ( dets[sf].acc[0] == NULL ) || ( dets[sf].acc[1] == NULL );
+    }
+    for( uint64_t block = job->scan_first; ( job->failed == false ) && ( block < job->scan_end );
+         block += SCAN_BLOCK_CHIPS )
+    {
+        const uint64_t left    = job->scan_end - block;
+        const uint32_t n_chips = ( uint32_t ) ( ( left < SCAN_BLOCK_CHIPS ) ? left : SCAN_BLOCK_CHIPS );
+
+        // Decimated once to a sample per chip for all the spreading factors
+        convert( config, job->input, ( int64_t ) ( block * config->os ) - delay,
+                 ( n_chips - 1 ) * config->os + config->n_taps, in_re, in_im );
+        for( uint32_t i = 0; i < n_chips; i++ )
+        {
+            chip_re[i] = lora_dsp_dot( config->taps, &in_re[i * config->os], config->n_taps );
+            chip_im[i] = lora_dsp_dot( config->taps, &in_im[i * config->os], config->n_taps );
+        }
+
+        for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+        {
+            const uint32_t n = ( uint32_t ) 1 << sf;
+
+            for( uint32_t i = 0; ( i + n ) <= n_chips; i += n )
+            {
+                detect( job, sf, &chip_re[i], &chip_im[i], block + i, re, im, &dets[sf] );
+            }
+        }
+    }
+    for( uint8_t sf = config->sf_first; sf <= config->sf_last; sf++ )
+    {
+        close_run( job, sf, &dets[sf] );
+        free( dets[sf].acc[0] );
+        free( dets[sf].acc[1] );
+    }
+
+    free( in_re );
+    free( in_im );
+    free( chip_re );
+    free( chip_im );
+    free( re );
+    free( im );
+    return NULL;
+}
+
+static int compare_detections( const void* a, const void* b )
+{
+    const scan_detection_t* x = a;
+    const scan_detection_t* y = b;
+
+    if( x->chip != y->chip )
+    {
+        return ( x->chip > y->chip ) - ( x->chip < y->chip );
+    }
+    return x->sf - y->sf;
+}
+
+/*!
+ * @brief Scan the chips [first, end[ of the capture on all the threads
+ *
+ * @param [in] available Chips of the capture which can be scanned after end, at most the overlap
+ * @param [out] n_found Number of preambles found
+ *
+ * @returns the preambles found in time order, to be freed, NULL when out of memory
+ */
+static scan_detection_t* collect_batch( const scan_config_t* config, const scan_input_t* input, uint64_t first,
+                                        uint64_t end, uint64_t available, uint32_t* n_found )
+{
+    scan_job_t jobs[SCAN_MAX_THREADS] = { 0 };
+    pthread_t  threads[SCAN_MAX_THREADS];
+    uint64_t   chunk        = ( end - first + config->n_threads - 1 ) / config->n_threads;
+    bool       failed       = false;
+    uint32_t   n_detections = 0;
+
+    chunk = ( ( chunk + SCAN_GRID - 1 ) / SCAN_GRID ) * SCAN_GRID;
+    for( uint8_t t = 0; t < config->n_threads; t++ )
+    {
+        scan_job_t* job = &jobs[t];
+
+        job->config     = config;
+        job->input      = input;
+        job->own_first  = first + t * chunk;
+        job->own_end    = ( ( job->own_first + chunk ) < end ) ? ( job->own_first + chunk ) : end;
+        job->scan_first = ( job->own_first > config->overlap_chips ) ? ( job->own_first - config->overlap_chips ) : 0;
+        job->scan_end   = job->own_end + config->overlap_chips;
+        if( job->scan_end > ( end + available ) )
+        {
+            job->scan_end = end + available;
+        }
+        if( job->own_first >= end )
+        {
+            job->scan_end = job->scan_first;
+        }
+        if( pthread_create( &threads[t], NULL, run_job, job ) != 0 )
+        {
+            run_job( job );
+            threads[t] = pthread_self( );
+        }
+    }
+    for( uint8_t t = 0; t < config->n_threads; t++ )
+    {
+        if( pthread_equal( threads[t], pthread_self( ) ) == 0 )
+        {
+            pthread_join( threads[t], NULL );
+        }
+        failed = failed || jobs[t].failed;
+        n_detections += jobs[t].n_detections;
+    }
+
+    scan_detection_t* detections = malloc( ( n_detections + 1 ) * sizeof( scan_detection_t ) );
+    if( detections != NULL )
+    {
+        n_detections = 0;
+        for( uint8_t t = 0; t < config->n_threads; t++ )
+        {
+            memcpy( &detections[n_detections], jobs[t].detections, jobs[t].n_detections * sizeof( scan_detection_t ) );
+            n_detections += jobs[t].n_detections;
+        }
+        qsort( detections, n_detections, sizeof( scan_detection_t ), compare_detections );
+    }
+    for( uint8_t t = 0; t < config->n_threads; t++ )
+    {
+        free( jobs[t].detections );
+    }
+    if( failed == true )
+    {
+        free( detections );
+        return NULL;
+    }
+    *n_found = n_detections;
+    return detections;
+}
+
+/*!
+ * @brief Scan the chips [first, end[ of the capture on all the threads, and print the preambles found in time order
+ *
+ * @param [in] available Chips of the capture which can be scanned after end, at most the overlap
+ *
+ * @returns false when out of memory
+ */
+static bool scan_batch( const scan_config_t* config, const scan_input_t* input, uint64_t first, uint64_t end,
+                        uint64_t available )
+{
+    uint32_t          n_detections = 0;
+    scan_detection_t* detections   = collect_batch( config, input, first, end, available, &n_detections );
+
+    if( detections == NULL )
+    {
+        return false;
+    }
+    for( uint32_t i = 0; i < n_detections; i++ )
+    {
+        printf( "PREAMBLE %.6f SF%u %u %.1f\n", ( double ) detections[i].chip / config->bw_in_hz, detections[i].sf,
+                detections[i].n_symbs, detections[i].snr_db );
+        scan_counts[detections[i].sf]++;
+    }
+    free( detections );
+    return true;
+}
+
+/*!
+ * @brief Scan a capture mapped in memory, split in as many chunks as threads
+ *
+ * @returns the samples scanned, or -1 on error
+ */
+static int64_t scan_mapped( const scan_config_t* config, int fd, uint64_t size )
+{
+    const uint64_t n_samples = size / scan_formats[config->format].bytes;
+    void*          data      = ( size != 0 ) ? mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 ) : NULL;
+
+    if( data == MAP_FAILED )
+    {
+        return -1;
+    }
+    if( data != NULL )
+    {
+        // Read once, from start to end
+        posix_madvise( data, size, POSIX_MADV_SEQUENTIAL );
+    }
+
+    const scan_input_t input = { .data = data, .first = 0, .count = n_samples };
+    const bool         done  = scan_batch( config, &input, 0, n_samples / config->os, 0 );
+
+    if( data != NULL )
+    {
+        munmap( data, size );
+    }
+    return done ? ( int64_t ) n_samples : -1;
+}
+
+/*!
+ * @brief Scan a streamed capture, by batches of a chunk per thread which keep the overlap of the previous batch
+ *
+ * @returns the samples scanned, or -1 on error
+ */
+static int64_t scan_stream( const scan_config_t* config, FILE* stream )
+{
+    const uint32_t bytes    = scan_formats[config->format].bytes;
+    const uint64_t batch    = ( uint64_t ) config->chunk_chips * config->n_threads;
+    const uint64_t margin   = ( uint64_t ) config->overlap_chips * config->os + config->n_taps;
+    const uint64_t capacity = batch * config->os + 2 * margin;
+    uint8_t*       data     = malloc( capacity * bytes );
+    scan_input_t   input    = { .data = data, .first = 0, .count = 0 };
+    uint64_t       first    = 0;
+    bool           eof      = false;
+
+    if( data == NULL )
+    {
+        return -1;
+    }
+    while( eof == false )
+    {
+        // Filled up to the end of the overlap after the batch
+        const uint64_t wanted = ( first + batch ) * config->os + margin - input.first;
+
+        while( ( input.count < wanted ) && ( eof == false ) )
+        {
+            const size_t read = fread( &data[input.count * bytes], bytes, wanted - input.count, stream );
+
+            input.count += read;
+            eof = ( read == 0 );
+        }
+
+        const uint64_t last_chip = ( input.first + input.count ) / config->os;
+        const uint64_t end       = ( eof == true ) ? last_chip : ( first + batch );
+
+        if( ( end > first ) && ( scan_batch( config, &input, first, end, last_chip - end ) == false ) )
+        {
+            free( data );
+            return -1;
+        }
+        fflush( stdout );
+        first = end;
+
+        // Keep what the next batch scans before its first chip
+        const uint64_t keep_from = ( first * config->os > margin ) ? ( first * config->os - margin ) : 0;
+        if( keep_from > input.first )
+        {
+            const uint64_t dropped = keep_from - input.first;
+
+            memmove( data, &data[dropped * bytes], ( input.count - dropped ) * bytes );
+            input.first = keep_from;
+            input.count -= dropped;
+        }
+    }
+    free( data );
+    return ( int64_t ) ( input.first + input.count );
+}
+
+/*!
+ * @brief Get a random number uniform in ]0, 1], from a xorshift64* state
+ */
+static double get_uniform( uint64_t* state )
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return ( ( ( *state * 0x2545F4914F6CDD1DULL ) >> 11 ) + 1 ) / 9007199254740992.0;
+}
+
+/*!
+ * @brief Scan synthetic captures of one preamble of SCAN_CHECK_SYMBS chirps, on a few spreading factors and at a few
+ * offsets from the windows, and check that each is found once with its spreading factor, start and length
+ *
+ * @remark The configuration must read cf32 at one sample per chip
+ *
+ * @returns true if every preamble was found as sent
+ */
+static bool self_check( const scan_config_t* config )
+{
+    static const uint8_t sfs[] = { 7, 10, 12 };
+    const uint32_t       lead  = 2 * SCAN_GRID;
+    bool                 is_ok = true;
+
+    printf( "%-6s %8s %8s %8s %8s %8s\n", "SF", "offset", "start", "found", "symbols", "result" );
+    for( size_t i = 0; i < ( sizeof( sfs ) / sizeof( sfs[0] ) ); i++ )
+    {
+        const uint8_t  sf        = sfs[i];
+        const uint32_t n         = ( uint32_t ) 1 << sf;
+        const uint32_t offsets[] = { 0, 1, n / 4, n / 2, 3 * n / 4, n - 1 };
+
+        for( size_t j = 0; j < ( sizeof( offsets ) / sizeof( offsets[0] ) ); j++ )
+        {
+            const uint64_t start     = lead + offsets[j];
+            const uint64_t n_samples = start + SCAN_CHECK_SYMBS * n + lead;
+            float*         samples   = malloc( n_samples * 2 * sizeof( float ) );
+            uint64_t       state     = 0x9E3779B97F4A7C15ULL + sf * 4096 + j;
+
+            if( samples == NULL )
+            {
+                return false;
+            }
+            for( uint64_t k = 0; k < n_samples; k++ )
+            {
+                // Complex noise of unit power, with chirps of the same power, SNR 0 dB
+                const double r     = sqrt( -log( get_uniform( &state ) ) / 2.0 );
+                const double theta = 2.0 * M_PI * get_uniform( &state );
+                double       re    = r * cos( theta );
+                double       im    = r * sin( theta );
+
+                if( ( k >= start ) && ( k < ( start + SCAN_CHECK_SYMBS * n ) ) )
+                {
+                    const double t     = ( double ) ( ( k - start ) & ( n - 1 ) );
+                    const double phase = M_PI * ( t * t / n - t );
+
+                    re += cos( phase );
+                    im += sin( phase );
+                }
+                samples[2 * k]     = ( float ) re;
+                samples[2 * k + 1] = ( float ) im;
+            }
+
+            const scan_input_t input        = { .data = ( const uint8_t* ) samples, .first = 0, .count = n_samples };
+            uint32_t           n_detections = 0;
+            scan_detection_t*  detections   = collect_batch( config, &input, 0, n_samples, 0, &n_detections );
+            const bool         is_found =
+                ( detections != NULL ) && ( n_detections == 1 ) && ( detections[0].sf == sf ) &&
+                ( detections[0].n_symbs == SCAN_CHECK_SYMBS ) &&
+                ( ( detections[0].chip + 1 ) >= start ) && ( detections[0].chip <= ( start + 1 ) );
+
+            printf( "SF%-4u %8u %8llu %8u %8u %8s\n", sf, offsets[j], ( unsigned long long ) start, n_detections,
+                    ( n_detections != 0 ) ? detections[0].n_symbs : 0, is_found ? "ok" : "FAIL" );
+            for( uint32_t k = 0; ( is_found == false ) && ( detections != NULL ) && ( k < n_detections ); k++ )
+            {
+                printf( "       found SF%u at %llu, %u symbols\n", detections[k].sf,
+                        ( unsigned long long ) detections[k].chip, detections[k].n_symbs );
+            }
+            is_ok = is_ok && is_found;
+            free( detections );
+            free( samples );
+        }
+    }
+    return is_ok;
+}
+
+static void print_usage( const char* name )
+{
+    fprintf( stderr, "usage: %s [-f cu8|cs8|cs16|cf32] [-b bw_khz] [-r sample_rate_hz] [-s first_sf] [-S last_sf]\n",
+             name );
+    fprintf( stderr, "          [-k min_symbols] [-m margin] [-j threads] [-c chunk_chips] [-L max_preamble]\n" );
+    fprintf( stderr, "          capture\n" );
+    fprintf( stderr, "       %s -t\n", name );
+    fprintf( stderr, "       %s -h\n", name );
+    fprintf( stderr, "  the capture is \"-\" for the standard input\n" );
+    fprintf( stderr, "  the sample rate is the bandwidth times a power of 2, the bandwidth by default\n" );
+    fprintf( stderr, "  -t scans synthetic preambles and checks their start and length\n" );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( int argc, char** argv )
+{
+    scan_config_t config = {
+        .path          = NULL,
+        .format        = SCAN_FORMAT_CS16,
+        .bw_in_hz      = 125000,
+        .rate_in_hz    = 0,
+        .sf_first      = SCAN_SF_MIN,
+        .sf_last       = SCAN_SF_MAX,
+        .min_symbs     = 5,
+        .margin        = 6.0f,
+        .n_threads     = 1,
+        .chunk_chips   = 1 << 20,
+        .overlap_chips = 0,
+    };
+    uint32_t max_preamble = 32;
+    bool     is_check     = false;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        const char* value = ( ( i + 1 ) < argc ) ? argv[i + 1] : NULL;
+
+        if( strcmp( argv[i], "-h" ) == 0 )
+        {
+            print_usage( argv[0] );
+            return 0;
+        }
+        if( strcmp( argv[i], "-t" ) == 0 )
+        {
+            is_check = true;
+            continue;
+        }
+        // The capture comes last, "-" being the standard input
+        if( ( ( i + 1 ) == argc ) && ( ( argv[i][0] != '-' ) || ( argv[i][1] == '\0' ) ) )
+        {
+            config.path = argv[i];
+            break;
+        }
+        if( ( argv[i][0] != '-' ) || ( argv[i][1] == '\0' ) || ( argv[i][2] != '\0' ) || ( value == NULL ) )
+        {
+            print_usage( argv[0] );
+            return 2;
+        }
+        i++;
+        switch( argv[i - 1][1] )
+        {
+        case 'f':
+            config.format = ( scan_format_t ) -1;
+            for( size_t j = 0; j < ( sizeof( scan_formats ) / sizeof( scan_formats[0] ) ); j++ )
+            {
+                if( strcmp( value, scan_formats[j].name ) == 0 )
+                {
+                    config.format = ( scan_format_t ) j;
+                }
+            }
+            break;
+        case 'b':
+            config.bw_in_hz = ( uint32_t ) atoi( value ) * 1000;
+            break;
+        case 'r':
+            config.rate_in_hz = ( uint32_t ) atoi( value );
+            break;
+        case 's':
+            config.sf_first = ( uint8_t ) atoi( value );
+            break;
+        case 'S':
+            config.sf_last = ( uint8_t ) atoi( value );
+            break;
+        case 'k':
+            config.min_symbs = ( uint16_t ) atoi( value );
+            break;
+        case 'm':
+            config.margin = strtof( value, NULL );
+            break;
+        case 'j':
+            config.n_threads = ( uint8_t ) atoi( value );
+            break;
+        case 'c':
+            config.chunk_chips = ( uint32_t ) atoi( value );
+            break;
+        case 'L':
+            max_preamble = ( uint32_t ) atoi( value );
+            break;
+        default:
+            print_usage( argv[0] );
+            return 2;
+        }
+    }
+    if( is_check == true )
+    {
+        config.path       = "self-check";
+        config.format     = SCAN_FORMAT_CF32;
+        config.rate_in_hz = config.bw_in_hz;
+    }
+    if( config.rate_in_hz == 0 )
+    {
+        config.rate_in_hz = config.bw_in_hz;
+    }
+    config.os = ( config.bw_in_hz != 0 ) ? config.rate_in_hz / config.bw_in_hz : 0;
+    if( ( config.path == NULL ) || ( ( uint32_t ) config.format > SCAN_FORMAT_CF32 ) ||
+        ( config.sf_first < SCAN_SF_MIN ) || ( config.sf_last > SCAN_SF_MAX ) || ( config.sf_first > config.sf_last ) ||
+        ( config.os == 0 ) || ( ( config.os * config.bw_in_hz ) != config.rate_in_hz ) ||
+        ( ( config.os & ( config.os - 1 ) ) != 0 ) || ( config.min_symbs == 0 ) || ( config.n_threads == 0 ) ||
+        ( config.n_threads > SCAN_MAX_THREADS ) || ( config.chunk_chips == 0 ) )
+    {
+        print_usage( argv[0] );
+        return 2;
+    }
+    // A preamble ends, and is reported, within the overlap of the chunk where it starts
+    config.chunk_chips   = ( ( config.chunk_chips + SCAN_GRID - 1 ) / SCAN_GRID ) * SCAN_GRID;
+    config.overlap_chips = ( max_preamble + 1 ) * SCAN_GRID;
+
+    if( prepare( &config ) == false )
+    {
+        fprintf( stderr, "out of memory\n" );
+        return 1;
+    }
+    if( is_check == true )
+    {
+        return ( self_check( &config ) == true ) ? 0 : 1;
+    }
+
+    struct stat info;
+    const bool  from_stdin = ( strcmp( config.path, "-" ) == 0 );
+    const int   fd         = from_stdin ? STDIN_FILENO : open( config.path, O_RDONLY );
+
+    if( ( fd < 0 ) || ( fstat( fd, &info ) != 0 ) )
+    {
+        perror( config.path );
+        return 1;
+    }
+    printf( "Preambles of SF%u to SF%u at %u kHz, %u samples per chip of %s, %u threads, %s kernels\n",
+            config.sf_first, config.sf_last, config.bw_in_hz / 1000, config.os, scan_formats[config.format].name,
+            config.n_threads, lora_dsp_get_kernels( ) );
+
+    const double start     = get_time_in_s( );
+    int64_t      n_samples = -1;
+    if( S_ISREG( info.st_mode ) )
+    {
+        n_samples = scan_mapped( &config, fd, ( uint64_t ) info.st_size );
+    }
+    else
+    {
+        FILE* stream = from_stdin ? stdin : fdopen( fd, "rb" );
+
+        n_samples = ( stream != NULL ) ? scan_stream( &config, stream ) : -1;
+    }
+    const double elapsed_in_s = get_time_in_s( ) - start;
+
+    if( n_samples < 0 )
+    {
+        fprintf( stderr, "%s: scan failed\n", config.path );
+        return 1;
+    }
+    printf( "Scanned %lld samples, %.3f s of capture, in %.3f s: %.2f Msamples/s\n", ( long long ) n_samples,
+            ( double ) n_samples / config.rate_in_hz, elapsed_in_s, n_samples / elapsed_in_s / 1e6 );
+    for( uint8_t sf = config.sf_first; sf <= config.sf_last; sf++ )
+    {
+        printf( "SF%u: %u preambles\n", sf, scan_counts[sf] );
+    }
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
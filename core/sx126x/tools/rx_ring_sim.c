@@ -0,0 +1,339 @@
+/*!
+ * @file      rx_ring_sim.c
+ *
+ * @brief     Host simulation of back-to-back receptions through the radio-buffer ring
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <string.h>
+#include "apps_rx_ring.h"
+#include "apps_common.h"
+#include "smtc_hal_dbg_trace.h"
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Bursts of each length in the burst scenario
+ */
+#define SIM_N_BURSTS 1000
+
+/*!
+ * @brief Channels the packets are received on, in turn
+ */
+#define SIM_N_CHANNELS 8
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+/*!
+ * @brief Outcome of a scenario, from the sender side and from the drained packets
+ */
+typedef struct sim_result_s
+{
+    uint32_t sent;
+    uint32_t drained;
+    uint32_t lost;       //!< Sequence numbers skipped between two drained packets, and after the last one
+    uint32_t reordered;  //!< Packets drained with a sequence number not above the previous one
+    uint32_t corrupted;  //!< Packets drained with bytes not matching their sequence number
+    uint32_t mislabeled; //!< Packets drained with the channel of another packet
+    uint32_t last_seq;
+} sim_result_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+/*!
+ * @brief Data buffer of the simulated radio, written from the RX base address and wrapping around
+ */
+static uint8_t sim_buffer[APPS_RX_RING_RADIO_BUFFER_SIZE];
+
+static uint8_t sim_rx_base;
+static uint8_t sim_last_offset;
+static uint8_t sim_last_length;
+
+/*!
+ * @brief Only the address of the context matters to the ring
+ */
+static uint8_t sim_context;
+
+static bool sim_failed;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION: RADIO AND HAL STUBS ------------------------
+ */
+
+sx126x_status_t sx126x_set_buffer_base_address( const void* context, const uint8_t tx_base_address,
+                                                const uint8_t rx_base_address )
+{
+    ( void ) context;
+    ( void ) tx_base_address;
+    sim_rx_base = rx_base_address;
+    return SX126X_STATUS_OK;
+}
+
+bool apps_common_sx126x_get_rx_pkt_info( const void* context, apps_rx_pkt_desc_t* desc, uint8_t max_size )
+{
+    ( void ) context;
+    desc->buffer_offset = sim_last_offset;
+    if( max_size < sim_last_length )
+    {
+        desc->size = 0;
+        return false;
+    }
+    desc->size = sim_last_length;
+    return true;
+}
+
+void apps_common_sx126x_read_rx_payload( const void* context, apps_rx_pkt_desc_t* desc )
+{
+    ( void ) context;
+    for( uint8_t i = 0; i < desc->size; i++ )
+    {
+        desc->payload[i] = sim_buffer[( uint8_t )( desc->buffer_offset + i )];
+    }
+}
+
+void hal_mcu_trace_print( const char* fmt, ... )
+{
+    ( void ) fmt;
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static uint8_t get_byte( uint32_t seq, uint8_t i )
+{
+    return ( uint8_t )( seq * 31 + i * 7 + ( seq >> 8 ) );
+}
+
+/*!
+ * @brief Receive a packet as the radio does: write it from the RX base address, then raise RX_DONE
+ */
+static void receive( sim_result_t* result, uint8_t length )
+{
+    const uint32_t seq = result->sent++;
+
+    for( uint8_t i = 0; i < length; i++ )
+    {
+        sim_buffer[( uint8_t )( sim_rx_base + i )] = get_byte( seq, i );
+    }
+    sim_last_offset = sim_rx_base;
+    sim_last_length = length;
+    apps_rx_ring_on_rx_done( &sim_context, ( uint8_t )( seq % SIM_N_CHANNELS ) );
+}
+
+/*!
+ * @brief Find the sequence number of a packet from its first bytes, and check the others
+ */
+static bool identify( const apps_rx_pkt_desc_t* desc, uint32_t from, uint32_t to, uint32_t* seq )
+{
+    for( uint32_t candidate = from; candidate < to; candidate++ )
+    {
+        bool match = ( desc->size != 0 );
+
+        for( uint8_t i = 0; match && ( i < desc->size ); i++ )
+        {
+            match = ( desc->payload[i] == get_byte( candidate, i ) );
+        }
+        if( match == true )
+        {
+            *seq = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * @brief Drain up to max packets, as the main loop does between two interrupts
+ */
+static void drain( sim_result_t* result, uint32_t max )
+{
+    uint8_t            payload[APPS_RX_RING_RADIO_BUFFER_SIZE];
+    apps_rx_pkt_desc_t desc;
+
+    for( uint32_t n = 0; ( n < max ) && ( apps_rx_ring_get_pending( ) != 0 ); n++ )
+    {
+        uint32_t seq;
+
+        desc.payload = payload;
+        if( apps_rx_ring_drain( &sim_context, &desc, APPS_RX_RING_SLOT_SIZE ) == false )
+        {
+            continue;
+        }
+        result->drained++;
+        // The packet is still in the buffer unless it was overwritten, which the ring must have accounted
+        if( identify( &desc, result->last_seq, result->sent, &seq ) == false )
+        {
+            result->corrupted++;
+            continue;
+        }
+        if( ( result->drained > 1 ) && ( seq <= result->last_seq ) )
+        {
+            result->reordered++;
+        }
+        result->lost += seq - ( ( result->drained > 1 ) ? ( result->last_seq + 1 ) : 0 );
+        result->mislabeled += ( desc.channel != ( seq % SIM_N_CHANNELS ) ) ? 1 : 0;
+        result->last_seq = seq;
+    }
+}
+
+/*!
+ * @brief Check the counters of the ring against what was sent and drained
+ *
+ * @param [in] overflows Overflows expected, -1 when the scenario does not tell
+ * @param [in] overruns  Overruns expected
+ */
+static void check( const char* name, sim_result_t* result, int32_t overflows, uint32_t overruns )
+{
+    apps_rx_ring_stats_t stats;
+    bool                 ok;
+
+    apps_rx_ring_get_stats( &stats );
+    if( result->drained != 0 )
+    {
+        result->lost += result->sent - 1 - result->last_seq;
+    }
+    else
+    {
+        result->lost = result->sent;
+    }
+
+    // Each packet sent is either drained or dropped once, by one counter of the ring
+    ok = ( apps_rx_ring_get_pending( ) == 0 ) && ( result->reordered == 0 ) && ( result->corrupted == 0 ) &&
+         ( result->mislabeled == 0 ) && ( stats.drained == result->drained ) &&
+         ( result->lost == ( stats.overflows + stats.overruns + stats.misplaced ) ) &&
+         ( result->sent == ( stats.drained + stats.overflows + stats.overruns + stats.misplaced ) ) &&
+         ( stats.overruns == overruns ) && ( ( overflows < 0 ) || ( stats.overflows == ( uint32_t ) overflows ) ) &&
+         ( stats.misplaced == 0 ) && ( stats.max_pending <= APPS_RX_RING_N_SLOTS );
+
+    printf( "%-28s %8u %8u %8u %8u %8u %8u %8u %5s\n", name, result->sent, stats.drained, stats.overflows,
+            stats.overruns, result->reordered, result->corrupted, result->mislabeled, ok ? "ok" : "FAIL" );
+    sim_failed = sim_failed || !ok;
+}
+
+static void start( sim_result_t* result )
+{
+    memset( result, 0, sizeof( sim_result_t ) );
+    memset( sim_buffer, 0, sizeof( sim_buffer ) );
+    apps_rx_ring_init( &sim_context );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( void )
+{
+    sim_result_t result;
+    char         name[32];
+
+    printf( "%u slots of %u bytes\n", APPS_RX_RING_N_SLOTS, APPS_RX_RING_SLOT_SIZE );
+    printf( "%-28s %8s %8s %8s %8s %8s %8s %8s\n", "scenario", "sent", "drained", "overflow", "overrun", "reorder",
+            "corrupt", "channel" );
+
+    // Bursts of back-to-back RX_DONE, drained between two bursts: all but the last N_SLOTS of a burst are lost
+    for( uint32_t burst = 1; burst <= ( 2 * APPS_RX_RING_N_SLOTS + 1 ); burst++ )
+    {
+        start( &result );
+        for( uint32_t i = 0; i < SIM_N_BURSTS; i++ )
+        {
+            for( uint32_t j = 0; j < burst; j++ )
+            {
+                receive( &result, ( uint8_t )( APPS_RX_RING_SLOT_SIZE - ( ( i + j ) % 3 ) ) );
+            }
+            drain( &result, UINT32_MAX );
+        }
+        snprintf( name, sizeof( name ), "burst of %u", burst );
+        check( name, &result, ( burst > APPS_RX_RING_N_SLOTS ) ? SIM_N_BURSTS * ( burst - APPS_RX_RING_N_SLOTS ) : 0,
+               0 );
+    }
+
+    // The main loop drains one packet per reception: the ring never fills
+    start( &result );
+    for( uint32_t i = 0; i < ( SIM_N_BURSTS * APPS_RX_RING_N_SLOTS ); i++ )
+    {
+        receive( &result, ( uint8_t )( 1 + ( i % APPS_RX_RING_SLOT_SIZE ) ) );
+        drain( &result, 1 );
+    }
+    check( "one drain per reception", &result, 0, 0 );
+
+    // The main loop lags: two receptions per drain, the ring fills then drops the oldest packets
+    start( &result );
+    for( uint32_t i = 0; i < ( SIM_N_BURSTS * APPS_RX_RING_N_SLOTS ); i++ )
+    {
+        receive( &result, APPS_RX_RING_SLOT_SIZE );
+        receive( &result, APPS_RX_RING_SLOT_SIZE );
+        drain( &result, 1 );
+    }
+    drain( &result, UINT32_MAX );
+    check( "one drain per two receptions", &result, -1, 0 );
+
+    // Packets longer than a slot spill over the next one, whose pending packet must be dropped too
+    start( &result );
+    uint32_t n_long = 0;
+    for( uint32_t i = 0; i < SIM_N_BURSTS; i++ )
+    {
+        for( uint32_t j = 0; j < APPS_RX_RING_N_SLOTS; j++ )
+        {
+            const bool is_long = ( ( i + j ) % 5 ) == 0;
+
+            n_long += is_long ? 1 : 0;
+            receive( &result, ( uint8_t )( is_long ? ( APPS_RX_RING_SLOT_SIZE + 1 ) : APPS_RX_RING_SLOT_SIZE ) );
+        }
+        drain( &result, UINT32_MAX );
+    }
+    check( "long packets in bursts", &result, -1, n_long );
+
+    return sim_failed ? 1 : 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */
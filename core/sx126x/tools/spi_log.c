@@ -0,0 +1,477 @@
+/*!
+ * @file      spi_log.c
+ *
+ * @brief     Host decoder of the SPI captures of APPS_SPI_LOG: per-opcode counts and timing, diff of two captures
+ *
+ * @copyright
+ * The Clear BSD License
+ * Copyright IRISA Corporation 2024. All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted (subject to the limitations in the disclaimer
+ * below) provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the copyright holder nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * NO EXPRESS OR IMPLIED LICENSES TO ANY PARTY'S PATENT RIGHTS ARE GRANTED BY
+ * THIS LICENSE. THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- DEPENDENCIES ------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE MACROS-----------------------------------------------------------
+ */
+
+/*!
+ * @brief Number of bytes of a transaction the capture holds at most, see APPS_SPI_LOG_MAX_BYTES
+ */
+#define SPI_LOG_MAX_BYTES 64
+
+/*!
+ * @brief Opcode of SetCad, the default reference the counts are divided by
+ */
+#define SPI_LOG_SET_CAD 0xC5
+
+/*!
+ * @brief Number of write keys remembered to spot the redundant writes: opcodes, and registers by address
+ */
+#define SPI_LOG_N_KEYS 1024
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE TYPES -----------------------------------------------------------
+ */
+
+typedef struct opcode_stats_s
+{
+    uint32_t count;            //!< Transactions
+    uint32_t redundant;        //!< Writes identical to the previous write of the same opcode, or register
+    uint64_t bytes;            //!< Bytes clocked, command and data
+    uint64_t busy_in_ns;       //!< Time waited for BUSY
+    uint32_t max_busy_in_ns;   //!< Longest wait for BUSY
+    uint64_t transfer_in_ns;   //!< Time with NSS low
+} opcode_stats_t;
+
+typedef struct capture_s
+{
+    const char*    path;
+    opcode_stats_t opcodes[256];
+    uint32_t       n_transactions;
+    uint32_t       n_lost;           //!< Gaps in the sequence numbers, the ring of the recorder was full
+    uint64_t       first_time_in_us;
+    uint64_t       last_time_in_us;  //!< Unwrapped, the recorder writes 32-bit microseconds
+} capture_t;
+
+/*!
+ * @brief Last write seen for a key, to spot the writes which change nothing
+ */
+typedef struct last_write_s
+{
+    uint32_t key;
+    uint8_t  n_bytes;
+    uint8_t  bytes[SPI_LOG_MAX_BYTES];
+} last_write_t;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE VARIABLES -------------------------------------------------------
+ */
+
+static capture_t captures[2];
+
+static last_write_t last_writes[SPI_LOG_N_KEYS];
+static uint16_t     n_last_writes;
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PRIVATE FUNCTIONS DEFINITION --------------------------------------------
+ */
+
+static const char* get_opcode_name( uint8_t opcode )
+{
+    switch( opcode )
+    {
+    case 0x84: return "SetSleep";
+    case 0x80: return "SetStandby";
+    case 0xC1: return "SetFs";
+    case 0x83: return "SetTx";
+    case 0x82: return "SetRx";
+    case 0x9F: return "StopTimerOnPreamble";
+    case 0x94: return "SetRxDutyCycle";
+    case 0xC5: return "SetCad";
+    case 0xD1: return "SetTxContinuousWave";
+    case 0xD2: return "SetTxInfinitePreamble";
+    case 0x96: return "SetRegulatorMode";
+    case 0x89: return "Calibrate";
+    case 0x98: return "CalibrateImage";
+    case 0x95: return "SetPaConfig";
+    case 0x93: return "SetRxTxFallbackMode";
+    case 0x0D: return "WriteRegister";
+    case 0x1D: return "ReadRegister";
+    case 0x0E: return "WriteBuffer";
+    case 0x1E: return "ReadBuffer";
+    case 0x08: return "SetDioIrqParams";
+    case 0x12: return "GetIrqStatus";
+    case 0x02: return "ClearIrqStatus";
+    case 0x9D: return "SetDio2AsRfSwitchCtrl";
+    case 0x97: return "SetDio3AsTcxoCtrl";
+    case 0x86: return "SetRfFrequency";
+    case 0x8A: return "SetPacketType";
+    case 0x11: return "GetPacketType";
+    case 0x8E: return "SetTxParams";
+    case 0x8B: return "SetModulationParams";
+    case 0x8C: return "SetPacketParams";
+    case 0x88: return "SetCadParams";
+    case 0x8F: return "SetBufferBaseAddress";
+    case 0xA0: return "SetLoRaSymbNumTimeout";
+    case 0xC0: return "GetStatus";
+    case 0x13: return "GetRxBufferStatus";
+    case 0x14: return "GetPacketStatus";
+    case 0x15: return "GetRssiInst";
+    case 0x10: return "GetStats";
+    case 0x00: return "ResetStats";
+    case 0x17: return "GetDeviceErrors";
+    case 0x07: return "ClearDeviceErrors";
+    default: return "?";
+    }
+}
+
+/*!
+ * @brief Get the key of a write: the register address for WriteRegister, the opcode otherwise
+ *
+ * @returns -1 for the writes which are not compared: the buffer contents, and the commands whose effect
+ * does not depend on the previous one (modes, IRQ clearing, calibrations)
+ */
+static int32_t get_write_key( uint8_t radio, const uint8_t* bytes, uint8_t n_bytes )
+{
+    switch( bytes[0] )
+    {
+    case 0x0D:
+        if( n_bytes < 3 )
+        {
+            return -1;
+        }
+        return ( int32_t )( ( ( uint32_t ) radio << 24 ) | 0x10000 | ( ( uint32_t ) bytes[1] << 8 ) | bytes[2] );
+    case 0x08:
+    case 0x96:
+    case 0x95:
+    case 0x93:
+    case 0x9D:
+    case 0x97:
+    case 0x86:
+    case 0x8A:
+    case 0x8E:
+    case 0x8B:
+    case 0x8C:
+    case 0x88:
+    case 0x8F:
+    case 0xA0:
+    case 0x9F:
+        return ( int32_t )( ( ( uint32_t ) radio << 24 ) | bytes[0] );
+    default:
+        return -1;
+    }
+}
+
+/*!
+ * @brief Get the last write of a key, a new one is added when the key is seen for the first time
+ *
+ * @returns NULL if too many keys are seen
+ */
+static last_write_t* get_last_write( uint32_t key )
+{
+    for( uint16_t i = 0; i < n_last_writes; i++ )
+    {
+        if( last_writes[i].key == key )
+        {
+            return &last_writes[i];
+        }
+    }
+    if( n_last_writes == SPI_LOG_N_KEYS )
+    {
+        return NULL;
+    }
+    last_writes[n_last_writes].key     = key;
+    last_writes[n_last_writes].n_bytes = 0;
+    return &last_writes[n_last_writes++];
+}
+
+/*!
+ * @brief Read a capture: the lines "SPI <seq> <time us> <radio> <W|R> <busy ns> <transfer ns> <length> <bytes>"
+ * written by apps_spi_log_flush, the other lines of the trace are skipped
+ *
+ * @returns false if the file cannot be read or holds no transaction
+ */
+static bool load_capture( capture_t* capture, const char* path )
+{
+    FILE*    file = fopen( path, "r" );
+    char     line[1024];
+    bool     is_first = true;
+    uint32_t last_seq = 0;
+    uint32_t last_time_in_us = 0;
+
+    if( file == NULL )
+    {
+        perror( path );
+        return false;
+    }
+    memset( capture, 0, sizeof( *capture ) );
+    n_last_writes = 0;
+    capture->path = path;
+    while( fgets( line, sizeof( line ), file ) != NULL )
+    {
+        const char* record = strstr( line, "SPI " );
+        unsigned    seq, time_in_us, radio, busy_in_ns, transfer_in_ns, length;
+        char        direction;
+        char        hex[2 * SPI_LOG_MAX_BYTES + 1];
+        uint8_t     bytes[SPI_LOG_MAX_BYTES];
+        uint8_t     n_bytes = 0;
+        unsigned    byte;
+
+        if( ( record == NULL ) || ( sscanf( record, "SPI %u %u %u %c %u %u %u %128s", &seq, &time_in_us, &radio,
+                                            &direction, &busy_in_ns, &transfer_in_ns, &length, hex ) != 8 ) )
+        {
+            continue;
+        }
+        for( const char* c = hex; ( n_bytes < SPI_LOG_MAX_BYTES ) && ( sscanf( c, "%2x", &byte ) == 1 ); c += 2 )
+        {
+            bytes[n_bytes++] = ( uint8_t ) byte;
+        }
+        if( n_bytes == 0 )
+        {
+            continue;
+        }
+
+        if( is_first == true )
+        {
+            capture->first_time_in_us = time_in_us;
+            capture->last_time_in_us  = time_in_us;
+            is_first                  = false;
+        }
+        else
+        {
+            capture->n_lost += seq - last_seq - 1;
+            capture->last_time_in_us += ( uint32_t )( time_in_us - last_time_in_us );
+        }
+        last_seq        = seq;
+        last_time_in_us = time_in_us;
+
+        opcode_stats_t* stats = &capture->opcodes[bytes[0]];
+
+        stats->count++;
+        stats->bytes += length;
+        stats->busy_in_ns += busy_in_ns;
+        stats->transfer_in_ns += transfer_in_ns;
+        if( busy_in_ns > stats->max_busy_in_ns )
+        {
+            stats->max_busy_in_ns = busy_in_ns;
+        }
+        capture->n_transactions++;
+
+        // A write is only judged when it was kept whole
+        const int32_t key = ( direction == 'W' ) ? get_write_key( ( uint8_t ) radio, bytes, n_bytes ) : -1;
+
+        last_write_t* last = ( ( key >= 0 ) && ( n_bytes == length ) ) ? get_last_write( ( uint32_t ) key ) : NULL;
+
+        if( last != NULL )
+        {
+            if( ( last->n_bytes == n_bytes ) && ( memcmp( last->bytes, bytes, n_bytes ) == 0 ) )
+            {
+                stats->redundant++;
+            }
+            last->n_bytes = n_bytes;
+            memcpy( last->bytes, bytes, n_bytes );
+        }
+    }
+    fclose( file );
+    if( capture->n_transactions == 0 )
+    {
+        fprintf( stderr, "%s: no SPI transaction\n", path );
+        return false;
+    }
+    return true;
+}
+
+static void print_capture( const capture_t* capture, uint8_t reference )
+{
+    const double   duration_in_s = ( double ) ( capture->last_time_in_us - capture->first_time_in_us ) / 1e6;
+    const uint32_t n_references  = capture->opcodes[reference].count;
+    uint64_t       bytes         = 0;
+    uint64_t       busy_in_ns    = 0;
+    uint32_t       redundant     = 0;
+
+    printf( "%s: %u transactions over %.1f s, %u lost\n", capture->path, capture->n_transactions, duration_in_s,
+            capture->n_lost );
+    printf( "  %-4s %-22s %8s %9s %9s %10s %10s %10s\n", "op", "name", "count", "redundant", "bytes", "busy us",
+            "max busy", "xfer us" );
+    for( uint16_t op = 0; op < 256; op++ )
+    {
+        const opcode_stats_t* stats = &capture->opcodes[op];
+
+        if( stats->count == 0 )
+        {
+            continue;
+        }
+        printf( "  0x%02X %-22s %8u %9u %9llu %10.1f %10.1f %10.1f\n", op, get_opcode_name( ( uint8_t ) op ),
+                stats->count, stats->redundant, ( unsigned long long ) stats->bytes, stats->busy_in_ns / 1e3,
+                stats->max_busy_in_ns / 1e3, stats->transfer_in_ns / 1e3 );
+        bytes += stats->bytes;
+        busy_in_ns += stats->busy_in_ns;
+        redundant += stats->redundant;
+    }
+    if( n_references != 0 )
+    {
+        printf( "  per %s: %.2f transactions, %.1f bytes, %.1f us waiting for BUSY, %.2f redundant writes\n",
+                get_opcode_name( reference ), ( double ) capture->n_transactions / n_references,
+                ( double ) bytes / n_references, busy_in_ns / 1e3 / n_references, ( double ) redundant / n_references );
+    }
+}
+
+/*!
+ * @brief Compare the transactions of each opcode, divided by the count of the reference opcode in each capture
+ *
+ * @returns Number of opcodes whose count rose by more than the threshold, or which appeared
+ */
+static uint32_t diff_captures( const capture_t* before, const capture_t* after, uint8_t reference,
+                               double threshold_in_percent )
+{
+    double   scale_before = 1.0;
+    double   scale_after  = 1.0;
+    uint32_t n_worse      = 0;
+
+    if( ( before->opcodes[reference].count != 0 ) && ( after->opcodes[reference].count != 0 ) )
+    {
+        scale_before = 1.0 / before->opcodes[reference].count;
+        scale_after  = 1.0 / after->opcodes[reference].count;
+        printf( "Diff per %s (0x%02X):\n", get_opcode_name( reference ), reference );
+    }
+    else
+    {
+        printf( "Diff of the raw counts, no %s (0x%02X) in both captures:\n", get_opcode_name( reference ),
+                reference );
+    }
+    printf( "  %-4s %-22s %10s %10s %8s %10s %10s\n", "op", "name", "before", "after", "change", "bytes bef",
+            "bytes aft" );
+    for( uint16_t op = 0; op < 256; op++ )
+    {
+        const opcode_stats_t* a = &before->opcodes[op];
+        const opcode_stats_t* b = &after->opcodes[op];
+
+        if( ( a->count == 0 ) && ( b->count == 0 ) )
+        {
+            continue;
+        }
+
+        const double count_before = a->count * scale_before;
+        const double count_after  = b->count * scale_after;
+        // An opcode which appears counts as a rise of 100 %
+        const double change =
+            ( count_before != 0 ) ? 100.0 * ( count_after - count_before ) / count_before : 100.0;
+        const bool   is_worse     = ( change > threshold_in_percent );
+
+        printf( "%c 0x%02X %-22s %10.3f %10.3f %7.1f%% %10.2f %10.2f\n", ( is_worse == true ) ? '+' : ' ', op,
+                get_opcode_name( ( uint8_t ) op ), count_before, count_after, change, a->bytes * scale_before,
+                b->bytes * scale_after );
+        if( is_worse == true )
+        {
+            n_worse++;
+        }
+    }
+    return n_worse;
+}
+
+static void print_usage( const char* name )
+{
+    fprintf( stderr, "usage: %s [-r opcode] [-t percent] capture [reference_capture]\n", name );
+    fprintf( stderr, "  with two captures, the first one is the reference and the exit status is 1 when an\n" );
+    fprintf( stderr, "  opcode is sent more than percent more often (default 1) per reference opcode (SetCad)\n" );
+}
+
+/*
+ * -----------------------------------------------------------------------------
+ * --- PUBLIC FUNCTIONS DEFINITION ---------------------------------------------
+ */
+
+int main( int argc, char** argv )
+{
+    uint8_t     reference = SPI_LOG_SET_CAD;
+    double      threshold = 1.0;
+    const char* paths[2];
+    int         n_paths = 0;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( argv[i], "-r" ) == 0 ) && ( ( i + 1 ) < argc ) )
+        {
+            reference = ( uint8_t ) strtoul( argv[++i], NULL, 16 );
+        }
+        else if( ( strcmp( argv[i], "-t" ) == 0 ) && ( ( i + 1 ) < argc ) )
+        {
+            threshold = strtod( argv[++i], NULL );
+        }
+        else if( ( argv[i][0] != '-' ) && ( n_paths < 2 ) )
+        {
+            paths[n_paths++] = argv[i];
+        }
+        else
+        {
+            print_usage( argv[0] );
+            return 2;
+        }
+    }
+    if( n_paths == 0 )
+    {
+        print_usage( argv[0] );
+        return 2;
+    }
+
+    for( int i = 0; i < n_paths; i++ )
+    {
+        if( load_capture( &captures[i], paths[i] ) == false )
+        {
+            return 2;
+        }
+        print_capture( &captures[i], reference );
+    }
+    if( n_paths == 2 )
+    {
+        const uint32_t n_worse = diff_captures( &captures[0], &captures[1], reference, threshold );
+
+        if( n_worse != 0 )
+        {
+            printf( "%u opcodes sent more often than in %s\n", n_worse, captures[0].path );
+            return 1;
+        }
+        printf( "No opcode sent more often than in %s\n", captures[0].path );
+    }
+    return 0;
+}
+
+/* --- EOF ------------------------------------------------------------------ */